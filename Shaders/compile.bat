@@ -1,3 +1,10 @@
 C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader.vert
 C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader_bindless.frag -o frag_bindless.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader_indirect.vert -o vert_indirect.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader_instanced.vert -o vert_instanced.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V shader_bindless_indirect.frag -o frag_bindless_indirect.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V cull.comp -o cull.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V cull.comp -DOCCLUSION -o cull_occlusion.spv
+C:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V hiz.comp -o hiz.spv
 pause
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//model here is the frame's shared rotation, placement comes from the instance
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Instance {
+    mat4 model;
+    vec4 boundingSphere;
+    uint textureIndex;
+};
+
+layout(std430, binding = 2) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+//The depth prepass & the scene draw with this shader in different pipelines -- same depth, bit for bit
+invariant gl_Position;
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+    gl_Position = ubo.proj * ubo.view * instance.model * ubo.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragTextureIndex = instance.textureIndex;
+}
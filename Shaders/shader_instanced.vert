@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//model here is the frame's shared rotation, placement comes from the instance
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+//Binding 0, per vertex
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+//Binding 1, per instance
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in uint instanceTextureIndex;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * instanceModel * ubo.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragTextureIndex = instanceTextureIndex;
+}
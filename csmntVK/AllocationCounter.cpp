@@ -0,0 +1,157 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace allocationCounter {
+	namespace {
+		//Constant initialised, so it's ready before any static constructor allocates
+		std::atomic<uint64_t> s_allocationCount = { 0 };
+
+		void* allocate(std::size_t size)
+		{
+			s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+			return std::malloc(size == 0 ? 1 : size);
+		}
+
+#if __cpp_aligned_new
+		void* allocateAligned(std::size_t size, std::align_val_t alignment)
+		{
+			s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+			const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+			return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+			//aligned_alloc wants a multiple of the alignment
+			return std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+		}
+
+		void freeAligned(void* p)
+		{
+#ifdef _WIN32
+			_aligned_free(p);
+#else
+			std::free(p);
+#endif
+		}
+#endif
+	}
+
+	uint64_t getCount()
+	{
+		return s_allocationCount.load(std::memory_order_relaxed);
+	}
+}
+
+#pragma region REPLACED OPERATORS
+void* operator new(std::size_t size)
+{
+	void* p = allocationCounter::allocate(size);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocationCounter::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocationCounter::allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+#if __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* p = allocationCounter::allocateAligned(size, alignment);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocationCounter::allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocationCounter::allocateAligned(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	allocationCounter::freeAligned(p);
+}
+#endif
+#pragma endregion
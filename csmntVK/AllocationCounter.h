@@ -0,0 +1,21 @@
+#pragma once
+#ifndef _ALLOCATION_COUNTER_
+#define _ALLOCATION_COUNTER_
+
+#include <cstdint>
+
+/////////////////////////////////////////////////////
+//---allocationCounter:
+//---Global operator new/delete are replaced with versions
+//---that count every allocation, from any thread, so the
+//---frame loop can be checked for heap traffic. Only C++
+//---allocations go through here -- malloc (& so most
+//---drivers) doesn't
+/////////////////////////////////////////////////////
+
+namespace allocationCounter {
+	//Allocations since startup -- take the difference around whatever's being checked
+	uint64_t getCount();
+}
+
+#endif // !_ALLOCATION_COUNTER_
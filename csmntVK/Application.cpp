@@ -3,6 +3,12 @@
 #include <iostream>
 #include <set>
 #include <algorithm>
+#include <chrono>
+#include <limits>
+#include "vkHelpers.h"
+#include "MipChain.h"
+#include "Texture.h"
+#include "AllocationCounter.h"
 
 #ifndef _vk_details_h
 #define _vk_details_h
@@ -10,14 +16,16 @@
 #endif
 
 #pragma region CTOR & DTOR
-csmntVkApplication::csmntVkApplication(int winW, int winH)
-	: m_winW(winW), m_winH(winH), m_pWindow(nullptr)
+csmntVkApplication::csmntVkApplication(int winW, int winH, uint32_t framesInFlight, bool headless)
+	: m_winW(winW), m_winH(winH), m_framesInFlight(framesInFlight), m_headless(headless), m_pWindow(nullptr), m_pAllocator(nullptr)
 {
 	//Add a validation layer
 	m_validationLayers.push_back("VK_LAYER_LUNARG_standard_validation");
 
-	//Add required extensions -- swap chain
-	m_deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	//Add required extensions -- swap chain (nothing to present to when headless)
+	if (!m_headless) {
+		m_deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
 
 #if _DEBUG
 	std::cout << "HEY! csmntVK Application Created" << std::endl;
@@ -37,35 +45,295 @@ csmntVkApplication::~csmntVkApplication()
 
 void csmntVkApplication::run()
 {
+	m_startTime = std::chrono::high_resolution_clock::now();
+
+	//Workers first, graphics sizes its per thread command pools from them
+	m_jobSystem.create(m_recordWorkerCount);
+	//Decodes run beside everything else, on threads of their own
+	m_assetLoader.create();
+
 	//Init window and vulkan
-	initWindow();
+	if (!m_headless) {
+		initWindow();
+	}
 	initVulkan();
 
 	//Run until error or closed
-	mainLoop();
+	if (m_headless) {
+		headlessLoop();
+	}
+	else {
+		mainLoop();
+	}
+}
+
+void csmntVkApplication::headlessLoop()
+{
+	//Texture tooling benchmark, no frames needed
+	if (m_mipBenchmarkSize > 0) {
+		runMipBenchmark(m_mipBenchmarkSize);
+		return;
+	}
+
+	//First frame pays for startup
+	m_pGraphics->drawFrameHeadless(this);
+	reportStartupTime();
+
+	if (!m_recordBenchmark) {
+		runHeadlessFrames(std::max(m_headlessFrameCount, m_allocationTestFrames > 0 ? m_ALLOCATION_WARM_UP_FRAMES : 1u) - 1);
+
+		//Self check -- warmed up, the frame loop shouldn't touch the heap at all
+		if (m_allocationTestFrames > 0) {
+			const uint64_t startCount = allocationCounter::getCount();
+			for (uint32_t i = 0; i < m_allocationTestFrames; i++) {
+				m_pGraphics->drawFrameHeadless(this);
+			}
+			const uint64_t allocations = allocationCounter::getCount() - startCount;
+			m_pGraphics->flushReadbacks(this);
+
+			reportAllocationTest(allocations);
+		}
+
+		std::cout << "vertex buffer: " << (m_vertexFormat == VertexFormat::Packed ? "packed, " : "full, ")
+			<< (m_pGraphics->getVertexBufferSize() >> 10) << "KB" << std::endl;
+
+		if (m_pGraphics->isLodSelecting()) {
+			const LodStats& stats = m_pGraphics->getLodStats();
+			const uint64_t frames = std::max<uint64_t>(1, stats.frames);
+			std::cout << "lod selection: " << stats.triangles / frames << " tris/frame, " << stats.fullDetailTriangles / frames
+				<< " at full detail (" << static_cast<double>(stats.fullDetailTriangles) / std::max<uint64_t>(1, stats.triangles) << "x)" << std::endl;
+		}
+
+		if (m_pGraphics->isCpuOcclusionCulling()) {
+			const CpuOcclusionStats& stats = m_pGraphics->getCpuOcclusionStats();
+			const uint64_t frames = std::max<uint64_t>(1, stats.frames);
+			std::cout << "cpu occlusion culling: " << stats.culled / frames << " of " << stats.tested / frames << " draws culled/frame, "
+				<< stats.totalMs / frames << "ms/frame" << std::endl;
+		}
+
+		if (m_pGraphics->isTextureStreaming()) {
+			const TextureStreamStats& stats = m_pGraphics->getTextureStreamStats();
+			std::cout << "texture streaming: " << (stats.residentBytes >> 10) << "KB resident of a " << (stats.budgetBytes >> 10)
+				<< "KB budget, " << stats.streamIns << " stream ins, " << stats.evictions << " evictions, "
+				<< stats.deferred << " deferred" << std::endl;
+		}
+
+		//Self check -- the last frame's indirect draws against culling on the CPU
+		if (m_cullTest && !m_pGraphics->verifyGpuCulling(this)) {
+			throw std::runtime_error("gpu culling doesn't match the CPU reference!");
+		}
+		//Self check -- freed bindless slots are held back until no frame in flight can read them
+		if (m_bindlessTest && !m_pGraphics->verifyBindlessRecycling(this)) {
+			throw std::runtime_error("bindless texture slot recycled while a frame in flight could still read it!");
+		}
+		return;
+	}
+
+	//Same frames again with 1, 2, 4... workers recording
+	const uint32_t maxWorkers = m_jobSystem.getWorkerCount();
+	for (uint32_t workers = 1; ; workers = std::min(workers * 2, maxWorkers)) {
+		m_jobSystem.setActiveWorkerCount(workers);
+		m_pGraphics->resetRecordStats();
+
+		runHeadlessFrames(m_headlessFrameCount);
+
+		const RecordStats& stats = m_pGraphics->getRecordStats();
+		std::cout << "record benchmark: " << m_drawCount << " draws, " << workers << " workers, avg record "
+			<< stats.totalMs / std::max<uint64_t>(1, stats.frames) << "ms/frame" << std::endl;
+
+		if (workers == maxWorkers) {
+			break;
+		}
+	}
+}
+
+void csmntVkApplication::runHeadlessFrames(uint32_t frameCount)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	//No vsync or compositor to wait on -- frames go as fast as the device allows.
+	//The worst frame shows up hitches (streaming, uploads) the average hides
+	double worstFrameMs = 0.0;
+	for (uint32_t i = 0; i < frameCount; i++) {
+		auto frameStart = std::chrono::high_resolution_clock::now();
+		m_pGraphics->drawFrameHeadless(this);
+		worstFrameMs = std::max(worstFrameMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count());
+	}
+
+	//Wait for the last frames and hand back their pixels
+	m_pGraphics->flushReadbacks(this);
+
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "headless frames: " << frameCount << " (" << m_framesInFlight << " in flight) in " << totalMs << "ms, avg "
+		<< totalMs / std::max(1u, frameCount) << "ms, " << 1000.0 * frameCount / totalMs << " fps, worst frame " << worstFrameMs << "ms" << std::endl;
 }
 
 void csmntVkApplication::mainLoop()
 {
+	//Frame timing
+	auto lastTime = std::chrono::high_resolution_clock::now();
+	double totalFrameMs = 0.0, minFrameMs = std::numeric_limits<double>::max(), maxFrameMs = 0.0;
+	uint64_t frameCount = 0;
+
+	//Allocation test -- the heap counted over the frames after the warm up, then the window closes
+	const uint64_t allocationTestEnd = m_allocationTestFrames > 0 ? m_ALLOCATION_WARM_UP_FRAMES + m_allocationTestFrames : 0;
+	uint64_t allocationStartCount = 0, allocations = 0;
+
 	//Run window until error or closed
 	while (!glfwWindowShouldClose(m_pWindow)) {
 		glfwPollEvents();
 
-		//Render Frame
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_vkPhysicalDevice);
-		m_pGraphics->drawFrame(this, swapChainSupport);
+		if (allocationTestEnd > 0 && frameCount == m_ALLOCATION_WARM_UP_FRAMES) {
+			allocationStartCount = allocationCounter::getCount();
+		}
+
+		//Render Frame -- drawFrame only blocks on the in flight fences, so the CPU
+		//can run up to m_framesInFlight frames ahead of the GPU. Swap chain support
+		//is cached, the loop itself doesn't touch the heap
+		m_pGraphics->drawFrame(this, m_swapChainSupport);
+
+		if (frameCount == 0) {
+			reportStartupTime();
+		}
+
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		double frameMs = std::chrono::duration<double, std::milli>(currentTime - lastTime).count();
+		lastTime = currentTime;
+
+		totalFrameMs += frameMs;
+		minFrameMs = std::min(minFrameMs, frameMs);
+		maxFrameMs = std::max(maxFrameMs, frameMs);
+		++frameCount;
+
+		if (frameCount == allocationTestEnd) {
+			allocations = allocationCounter::getCount() - allocationStartCount;
+			glfwSetWindowShouldClose(m_pWindow, GLFW_TRUE);
+		}
+	}
+
+	//all of the operations in drawFrame are asynchronous. That means that when we exit the 
+	//loop in mainLoop, drawing and presentation operations may still be going on. Cleaning 
+	//up resources while that is happening is a bad idea.
+	//(https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Rendering_and_presentation)
+	vkDeviceWaitIdle(m_vkDevice);
+
+	if (frameCount > 0) {
+		const RecordStats& stats = m_pGraphics->getRecordStats();
+		std::cout << "command recording: " << m_drawCount << " draws on " << m_jobSystem.getWorkerCount() << " workers, avg "
+			<< stats.totalMs / std::max<uint64_t>(1, stats.frames) << "ms/frame" << std::endl;
+
+		std::cout << "frames: " << frameCount << " (" << m_framesInFlight << " in flight), avg " << totalFrameMs / frameCount
+			<< "ms, min " << minFrameMs << "ms, max " << maxFrameMs << "ms, " << 1000.0 * frameCount / totalFrameMs << " fps" << std::endl;
+	}
+
+	if (allocationTestEnd > 0) {
+		if (frameCount < allocationTestEnd) {
+			throw std::runtime_error("window closed before the allocation test finished!");
+		}
+		reportAllocationTest(allocations);
+	}
+}
+
+void csmntVkApplication::reportAllocationTest(uint64_t allocations)
+{
+	std::cout << "allocation test: " << allocations << " heap allocations in " << m_allocationTestFrames << " frames ("
+		<< (m_headless ? "headless" : "windowed") << ", after " << m_ALLOCATION_WARM_UP_FRAMES << " to warm up)" << std::endl;
+	if (allocations != 0) {
+		throw std::runtime_error("frame loop allocated after warm up!");
+	}
+}
+
+void csmntVkApplication::runMipBenchmark(uint32_t size)
+{
+	//Something with detail at every scale -- a fine checker over gradients
+	std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint8_t* pPixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+			uint8_t checker = ((x / 4) ^ (y / 4)) & 1 ? 255 : 0;
+			pPixel[0] = checker;
+			pPixel[1] = static_cast<uint8_t>(x * 255 / size);
+			pPixel[2] = static_cast<uint8_t>(y * 255 / size);
+			pPixel[3] = 255;
+		}
+	}
+
+	const uint32_t mipLevels = mipChain::getMipLevelCount(size, size);
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	const uint32_t runs = 3;
+
+	auto elapsedMs = [](std::chrono::high_resolution_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	//Best of a few runs: build (CPU only) & build + upload + wait
+	auto timeUpload = [&](uint32_t levels, const std::function<void(VkImage)>& record) {
+		double best = std::numeric_limits<double>::max();
+		for (uint32_t run = 0; run < runs; run++) {
+			VkImage image;
+			vkHelpers::Allocation imageMemory;
+			vkHelpers::createVkImage(m_vkDevice, *m_pAllocator, size, size, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, usage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory, levels);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			record(image);
+			m_uploadContext.flush(this);
+			best = std::min(best, elapsedMs(start));
+
+			vkHelpers::destroyVkImage(m_vkDevice, *m_pAllocator, image, imageMemory);
+		}
+		return best;
+	};
+
+	std::cout << "mip benchmark: " << size << "x" << size << " RGBA8, " << mipLevels << " levels, best of " << runs << std::endl;
+
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser }) {
+		std::vector<MipLevel> levels;
+		double buildMs = std::numeric_limits<double>::max();
+		for (uint32_t run = 0; run < runs; run++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			mipChain::buildMipChain(pixels.data(), size, size, filter, true, levels);
+			buildMs = std::min(buildMs, elapsedMs(start));
+		}
+
+		double totalMs = timeUpload(mipLevels, [&](VkImage image) {
+			std::vector<uint8_t> chain = mipChain::buildMipChain(pixels.data(), size, size, filter, true, levels);
+			m_uploadContext.uploadImage(this, image, chain.data(), static_cast<VkDeviceSize>(chain.size()), levels);
+		});
+
+		std::cout << "  cpu " << (filter == MipFilter::Box ? "box   " : "kaiser") << ": build " << buildMs << "ms, build + upload "
+			<< totalMs << "ms" << std::endl;
+	}
 
-		//all of the operations in drawFrame are asynchronous. That means that when we exit the 
-		//loop in mainLoop, drawing and presentation operations may still be going on. Cleaning 
-		//up resources while that is happening is a bad idea.
-		//(https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Rendering_and_presentation)
-		vkDeviceWaitIdle(m_vkDevice);
+	if (!Texture::supportsLinearBlit(this, VK_FORMAT_R8G8B8A8_UNORM)) {
+		std::cout << "  gpu blit: skipped, RGBA8 can't be linearly blitted on this device" << std::endl;
+		return;
 	}
+
+	//Mip 0 on its own, so the blit cost can be pulled out of the total
+	double baseMs = timeUpload(1, [&](VkImage image) {
+		m_uploadContext.uploadImage(this, image, pixels.data(), static_cast<VkDeviceSize>(pixels.size()), size, size);
+	});
+	double blitMs = timeUpload(mipLevels, [&](VkImage image) {
+		m_uploadContext.uploadImageGenerateMips(this, image, pixels.data(), static_cast<VkDeviceSize>(pixels.size()), size, size, mipLevels);
+	});
+
+	std::cout << "  gpu blit  : upload + blit " << blitMs << "ms (mip 0 upload alone " << baseMs << "ms, blits ~"
+		<< std::max(0.0, blitMs - baseMs) << "ms)" << std::endl;
+}
+
+void csmntVkApplication::reportStartupTime()
+{
+	double startupMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_startTime).count();
+
+	std::cout << "startup to first frame: " << startupMs << "ms (pipelines: " << m_pipelineCache.getMissCount() << " built in "
+		<< m_pipelineCache.getBuildMs() << "ms, " << m_pipelineCache.getHitCount() << " reused, disk cache "
+		<< (m_pipelineCache.loadedFromDisk() ? "warm" : "cold") << ")" << std::endl;
 }
 
 void csmntVkApplication::initGraphicsModule()
 {
-	m_pGraphics = new csmntVkGraphics();
+	m_pGraphics = new csmntVkGraphics(m_framesInFlight);
 
 	if (!m_pGraphics)
 	{
@@ -73,13 +341,34 @@ void csmntVkApplication::initGraphicsModule()
 		return;
 	}
 
-	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_vkPhysicalDevice);
+	m_pGraphics->setDrawCount(m_drawCount);
+	m_pGraphics->setModelPath(m_modelPath);
+	if (!m_texturePaths.empty()) {
+		m_pGraphics->setTexturePaths(m_texturePaths);
+	}
+	m_pGraphics->setTextureBudget(m_textureBudget);
+	m_pGraphics->setAsyncAssets(m_asyncAssets);
+	m_pGraphics->setVertexFormat(m_vertexFormat);
+	m_pGraphics->setMeshOptimization(m_meshOptimization);
+	m_pGraphics->setLodSelection(m_lodSelection);
+	m_pGraphics->setClusterCulling(m_clusterCulling);
+	m_pGraphics->setOcclusionCulling(m_occlusionCulling);
+	m_pGraphics->setDepthPrepass(m_depthPrepass);
+	m_pGraphics->setCpuOcclusionCulling(m_cpuOcclusionCulling);
+	m_pGraphics->setInstanced(m_instanced);
+
+	if (!m_headless) {
+		refreshSwapChainSupport();
+	}
 
-	m_pGraphics->initGraphicsModule(this, swapChainSupport);
+	m_pGraphics->initGraphicsModule(this, m_swapChainSupport);
 }
 
 void csmntVkApplication::shutdown()
 {
+	//No decode may still be running when the graphics module frees what it would land in
+	m_assetLoader.shutdown();
+
 	if (m_pGraphics)
 	{
 		m_pGraphics->shutdown(this);
@@ -87,19 +376,37 @@ void csmntVkApplication::shutdown()
 		m_pGraphics = nullptr;
 	}
 
+	if (m_pAllocator)
+	{
+		//Saves the pipeline cache back to disk
+		m_pipelineCache.cleanup(this);
+
+		m_uploadContext.cleanup(this);
+
+#if _DEBUG
+		m_pAllocator->dumpStats(std::cout);
+#endif
+		delete m_pAllocator;
+		m_pAllocator = nullptr;
+	}
+
 	vkDestroyDevice(m_vkDevice, nullptr);
 
 	if (m_enableValidationLayers) {
 		DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
+	if (m_vkSurface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
+	}
 
 	vkDestroyInstance(m_vkInstance, nullptr);
 
-	glfwDestroyWindow(m_pWindow);
+	if (m_pWindow) {
+		glfwDestroyWindow(m_pWindow);
 
-	glfwTerminate();
+		glfwTerminate();
+	}
 }
 
 void csmntVkApplication::initVulkan()
@@ -109,7 +416,9 @@ void csmntVkApplication::initVulkan()
 	setupDebugMessenger();
 
 	//Create the window surface
-	createSurface();
+	if (!m_headless) {
+		createSurface();
+	}
 
 	//Pick a GFX card
 	pickPhysicalDevice();
@@ -117,6 +426,12 @@ void csmntVkApplication::initVulkan()
 	//Create Logical device to interface with GFX card
 	createLogicalDevice();
 
+	//Sub-allocator for all buffer & image memory
+	createAllocator();
+
+	//Pipeline cache, seeded from the last run
+	createPipelineCache();
+
 	//Create the graphics module
 	initGraphicsModule();
 }
@@ -143,13 +458,16 @@ void csmntVkApplication::initWindow()
 
 std::vector<const char*> csmntVkApplication::getRequiredExtensions() {
 	
-	uint32_t glfwExtensionCount = 0;
-	
-	//Pass glfw window extensions to vulkan
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	//Pass glfw window extensions to vulkan (no surface extensions when headless)
+	if (!m_headless) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	//Vulkan debug exts
 	if (m_enableValidationLayers) {
@@ -220,7 +538,8 @@ void csmntVkApplication::createVkInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	//1.1 for the core features2/properties2 queries (descriptor indexing)
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 
 	//Create instance info
 	VkInstanceCreateInfo createInfo = {};
@@ -309,8 +628,8 @@ bool csmntVkApplication::isDeviceSuitable(VkPhysicalDevice device)
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
 
 	//Check for swap chain support
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = m_headless;
+	if (extensionsSupported && !m_headless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
@@ -322,9 +641,10 @@ void csmntVkApplication::createLogicalDevice()
 {
 	//Find and describe a Queue family with GFX capabilities
 	QueueFamilyIndices indices = findQueueFamilies(m_vkPhysicalDevice, m_vkSurface);
+	m_queueFamilyIndices = indices;
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 
 	//Priority for scheduling command buffer execution
 	float queuePriority = 1.0f;
@@ -346,13 +666,60 @@ void csmntVkApplication::createLogicalDevice()
 	//request anistropy
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+	//Optional features go through the features2 chain
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.features = deviceFeatures;
+
+	//Bindless: one big partially bound, update-after-bind sampler array, indexed per draw
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	m_bindlessEnabled = m_bindlessRequested && checkDescriptorIndexingSupport(m_vkPhysicalDevice, m_maxBindlessTextures);
+	if (m_bindlessEnabled) {
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		deviceFeatures2.pNext = &indexingFeatures;
+
+		m_deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		m_deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+	}
+	else if (m_bindlessRequested) {
+		std::cerr << "--bindless ignored, not supported on this device -- using per-draw descriptor sets" << std::endl;
+	}
+
+	//GPU driven: indirect draws pick their instance through firstInstance. Multi draw
+	//& the draw count extension are used when there, with fallbacks when not
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_vkPhysicalDevice, &supportedFeatures);
+
+	m_gpuDrivenEnabled = m_gpuDrivenRequested && supportedFeatures.drawIndirectFirstInstance;
+	if (m_gpuDrivenEnabled) {
+		deviceFeatures2.features.drawIndirectFirstInstance = VK_TRUE;
+
+		m_multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		deviceFeatures2.features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+		m_drawIndirectCount = checkDeviceExtensionAvailable(m_vkPhysicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		if (m_drawIndirectCount) {
+			m_deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
+	}
+	else if (m_gpuDrivenRequested) {
+		std::cerr << "--gpu-driven ignored, indirect draws with firstInstance aren't supported on this device -- drawing from the CPU" << std::endl;
+	}
+
 	//Create the logical device
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-	//Features requested here...
-	createInfo.pEnabledFeatures = &deviceFeatures;
+	//Features requested here... (via pNext, pEnabledFeatures has to stay null)
+	createInfo.pNext = &deviceFeatures2;
+	createInfo.pEnabledFeatures = nullptr;
 
 	//Enable swap chain... etc
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
@@ -375,6 +742,82 @@ void csmntVkApplication::createLogicalDevice()
 	//Get the device queue
 	vkGetDeviceQueue(m_vkDevice, indices.graphicsFamily.value(), 0, &m_vkGraphicsQueue);
 	vkGetDeviceQueue(m_vkDevice, indices.presentFamily.value(), 0, &m_vkPresentQueue);
+	vkGetDeviceQueue(m_vkDevice, indices.transferFamily.value(), 0, &m_vkTransferQueue);
+}
+
+bool csmntVkApplication::checkDescriptorIndexingSupport(VkPhysicalDevice device, uint32_t& maxTextures)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1) {
+		return false;
+	}
+
+	//Extension present?
+	if (!checkDeviceExtensionAvailable(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+		return false;
+	}
+
+	//Features we lean on
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features2 = {};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing || !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+		!indexingFeatures.descriptorBindingUpdateUnusedWhilePending || !indexingFeatures.descriptorBindingPartiallyBound ||
+		!indexingFeatures.runtimeDescriptorArray) {
+		return false;
+	}
+
+	//Table size is capped by the update-after-bind limits. A combined image sampler counts as a sampler
+	//& a sampled image, & the fragment stage's resources also take in its colour attachment
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(device, &properties2);
+
+	maxTextures = std::min({ m_BINDLESS_TABLE_SIZE,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		std::max(1u, indexingProperties.maxPerStageUpdateAfterBindResources) - 1 });
+
+	return maxTextures > 0;
+}
+
+bool csmntVkApplication::checkDeviceExtensionAvailable(VkPhysicalDevice device, const char* pExtensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	return std::any_of(availableExtensions.begin(), availableExtensions.end(), [pExtensionName](const VkExtensionProperties& extension) {
+		return strcmp(extension.extensionName, pExtensionName) == 0;
+	});
+}
+
+void csmntVkApplication::createAllocator()
+{
+	m_pAllocator = new vkHelpers::DeviceMemoryAllocator(m_vkDevice, m_vkPhysicalDevice);
+
+	if (!m_pAllocator)
+	{
+		throw std::runtime_error("failed to create device memory allocator!");
+	}
+
+	m_uploadContext.create(this);
+}
+
+void csmntVkApplication::createPipelineCache()
+{
+	m_pipelineCache.create(this, "pipeline_cache.bin");
 }
 
 bool csmntVkApplication::checkDeviceExtensionSupport(VkPhysicalDevice device)
@@ -395,10 +838,31 @@ bool csmntVkApplication::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return requiredExtensions.empty();
 }
 
+void csmntVkApplication::refreshSwapChainSupport()
+{
+	querySwapChainSupport(m_vkPhysicalDevice, m_swapChainSupport);
+}
+
+void csmntVkApplication::recreateSurface()
+{
+	//Swap chain must already be destroyed by the graphics module
+	vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
+	createSurface();
+
+#if _DEBUG
+	std::cout << "HEY! window surface lost, recreated it" << std::endl;
+#endif
+}
+
 SwapChainSupportDetails csmntVkApplication::querySwapChainSupport(VkPhysicalDevice& device)
 {
 	SwapChainSupportDetails details;
+	querySwapChainSupport(device, details);
+	return details;
+}
 
+void csmntVkApplication::querySwapChainSupport(VkPhysicalDevice& device, SwapChainSupportDetails& details)
+{
 	//Basic surface capabilities
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_vkSurface, &details.capabilities);
 
@@ -406,8 +870,9 @@ SwapChainSupportDetails csmntVkApplication::querySwapChainSupport(VkPhysicalDevi
 	uint32_t formatCount;
 	vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_vkSurface, &formatCount, nullptr);
 
+	//resize reuses the cached vectors' storage when the counts don't change
+	details.formats.resize(formatCount);
 	if (formatCount != 0) {
-		details.formats.resize(formatCount);
 		vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_vkSurface, &formatCount, details.formats.data());
 	}
 
@@ -415,12 +880,10 @@ SwapChainSupportDetails csmntVkApplication::querySwapChainSupport(VkPhysicalDevi
 	uint32_t presentModeCount;
 	vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_vkSurface, &presentModeCount, nullptr);
 
+	details.presentModes.resize(presentModeCount);
 	if (presentModeCount != 0) {
-		details.presentModes.resize(presentModeCount);
 		vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_vkSurface, &presentModeCount, details.presentModes.data());
 	}
-
-	return details;
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL csmntVkApplication::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT * pCallbackData, void * pUserData)
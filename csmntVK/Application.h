@@ -10,6 +10,12 @@
 //#include <optional>
 
 #include "Graphics.h"
+#include "vkMemoryAllocator.h"
+#include "UploadContext.h"
+#include "PipelineCache.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include <chrono>
 
 //vkCreateDebugUtilsMessengerEXT function to create the VkDebugUtilsMessengerEXT object. 
 //Unfortunately, because this function is an extension function, it is not automatically loaded. 
@@ -38,7 +44,7 @@ static void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMesse
 
 class csmntVkApplication {
 public:
-	csmntVkApplication(int, int);
+	csmntVkApplication(int, int, uint32_t framesInFlight = 2, bool headless = false);
 	~csmntVkApplication();
 
 	csmntVkApplication(csmntVkApplication&) = delete;
@@ -48,6 +54,55 @@ public:
 	void mainLoop();
 	void shutdown();
 
+	//Headless: render offscreen with no window/surface and hand back each frame's pixels
+	const bool					isHeadless() const { return m_headless; };
+	void						setHeadlessFrameCount(uint32_t count) { m_headlessFrameCount = count; };
+	void						setFrameReadbackCallback(FrameReadbackCallback callback) { m_frameReadbackCallback = callback; };
+	const FrameReadbackCallback& getFrameReadbackCallback() const { return m_frameReadbackCallback; };
+
+	//Scene size & command recording threads (set before run, 0 workers = one per hardware thread)
+	void						setDrawCount(uint32_t count) { m_drawCount = count; };
+	void						setModelPath(const std::string& path) { m_modelPath = path; };
+	void						setVertexFormat(VertexFormat format) { m_vertexFormat = format; };
+	void						setMeshOptimization(bool enable) { m_meshOptimization = enable; };
+	//LOD chains for imported meshes & per draw LOD selection
+	void						setLodSelection(bool enable) { m_lodSelection = enable; };
+	//GPU driven only: cull meshlets rather than whole instances
+	void						setClusterCulling(bool enable) { m_clusterCulling = enable; };
+	//GPU driven only: two phase hi-z occlusion culling, & a depth only pass before the scene
+	void						setOcclusionCulling(bool enable) { m_occlusionCulling = enable; };
+	void						setDepthPrepass(bool enable) { m_depthPrepass = enable; };
+	//Not GPU driven: occlusion culling against a few occluders rasterized on the CPU
+	void						setCpuOcclusionCulling(bool enable) { m_cpuOcclusionCulling = enable; };
+	void						setTexturePaths(const std::vector<std::string>& paths) { m_texturePaths = paths; };
+	//Stream textures within this many bytes of VRAM instead of loading them whole (0 = off)
+	void						setTextureBudget(VkDeviceSize bytes) { m_textureBudget = bytes; };
+	//Start rendering with placeholders while the mesh & textures decode in the background
+	void						setAsyncAssets(bool enable) { m_asyncAssets = enable; };
+	void						setRecordWorkerCount(uint32_t count) { m_recordWorkerCount = count; };
+	//Headless only: repeat the frames once per worker count (1, 2, 4...) and report recording time
+	void						setRecordBenchmark(bool enable) { m_recordBenchmark = enable; };
+	//Headless only: time CPU vs blit mip generation on a size x size texture instead of rendering
+	void						setMipBenchmark(uint32_t size) { m_mipBenchmarkSize = size; };
+	//Ask for the bindless texture path -- only enabled if the device has descriptor indexing
+	void						setBindless(bool enable) { m_bindlessRequested = enable; };
+	const bool					isBindlessEnabled() const { return m_bindlessEnabled; };
+	const uint32_t				getMaxBindlessTextures() const { return m_maxBindlessTextures; };
+	//One instanced draw for the whole draw list instead of a draw (& UBO) per object
+	void						setInstanced(bool enable) { m_instanced = enable; };
+	//Ask for compute culled indirect draws -- only enabled if indirect draws can use firstInstance
+	void						setGpuDriven(bool enable) { m_gpuDrivenRequested = enable; };
+	const bool					isGpuDrivenEnabled() const { return m_gpuDrivenEnabled; };
+	const bool					hasDrawIndirectCount() const { return m_drawIndirectCount; };
+	const bool					hasMultiDrawIndirect() const { return m_multiDrawIndirect; };
+	//Headless only: check the last frame's culling against the CPU, throws on a mismatch
+	void						setCullTest(bool enable) { m_cullTest = enable; };
+	//Headless only: check bindless slot recycling against the frames in flight, throws if a slot comes back early
+	void						setBindlessTest(bool enable) { m_bindlessTest = enable; };
+	//After at least m_ALLOCATION_WARM_UP_FRAMES frames, this many more with the heap allocations counted -- throws if there
+	//are any. Windowed, the frames go through drawFrame & the window closes after them; a resize in between allocates
+	void						setAllocationTest(uint32_t frameCount) { m_allocationTestFrames = frameCount; };
+
 	GLFWwindow*					getWindow() { return m_pWindow; };
 	VkInstance&					getVkInstance() { return m_vkInstance; };
 	VkDebugUtilsMessengerEXT&	getVkDebugMessenger() { return m_debugMessenger; };
@@ -55,16 +110,32 @@ public:
 	VkDevice&					getVkDevice() { return m_vkDevice; };
 	VkQueue&					getGraphicsQueue() { return m_vkGraphicsQueue; };
 	VkQueue&					getPresentQueue() { return m_vkPresentQueue; };
+	VkQueue&					getTransferQueue() { return m_vkTransferQueue; };
+	const QueueFamilyIndices&	getQueueFamilyIndices() const { return m_queueFamilyIndices; };
 	VkSurfaceKHR&				getVkSurfaceKHR() { return m_vkSurface; };
+	vkHelpers::DeviceMemoryAllocator& getAllocator() { return *m_pAllocator; };
+	UploadContext&				getUploadContext() { return m_uploadContext; };
+	PipelineCache&				getPipelineCache() { return m_pipelineCache; };
+	JobSystem&					getJobSystem() { return m_jobSystem; };
+	AssetLoader&				getAssetLoader() { return m_assetLoader; };
 	
 	const int getWindowHeight() const { return m_winH; };
 	const int getWindowWidth() const { return m_winW;};
 	const bool getIsFrameBufferResized() const { return m_frameBufferResized; };
 	void setIsFrameBufferResized(bool b) {m_frameBufferResized = b; };
 
+	//Swap chain support is cached -- only refresh on resize, out of date or surface loss
+	SwapChainSupportDetails&	getSwapChainSupport() { return m_swapChainSupport; };
+	void						refreshSwapChainSupport();
+	void						recreateSurface();
+
 private:
 	void initVulkan();
 	void initWindow();
+	void headlessLoop();
+	void runHeadlessFrames(uint32_t);
+	void reportAllocationTest(uint64_t allocations);
+	void runMipBenchmark(uint32_t size);
 	
 	bool checkValidationLayerSupport();
 	void setupDebugMessenger();
@@ -78,11 +149,19 @@ private:
 	bool isDeviceSuitable(VkPhysicalDevice);
 	
 	void createLogicalDevice();
+	bool checkDescriptorIndexingSupport(VkPhysicalDevice, uint32_t& maxTextures);
+	bool checkDeviceExtensionAvailable(VkPhysicalDevice, const char*);
+	void createAllocator();
+	void createPipelineCache();
+
+	//Startup benchmark -- run() to the first submitted frame
+	void reportStartupTime();
 
 	std::vector<const char*> getRequiredExtensions();
 	bool checkDeviceExtensionSupport(VkPhysicalDevice);
 
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice&);
+	void querySwapChainSupport(VkPhysicalDevice&, SwapChainSupportDetails&);
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 		VkDebugUtilsMessageSeverityFlagBitsEXT,
@@ -94,8 +173,50 @@ private:
 
 	//Window Height & Width (800 x 600 default)
 	int m_winH = 600, m_winW = 800;
+
+	//Frames the CPU may record ahead of the GPU
+	uint32_t					m_framesInFlight = 2;
+
+	//Headless rendering
+	const bool					m_headless = false;
+	uint32_t					m_headlessFrameCount = 1;
+	FrameReadbackCallback		m_frameReadbackCallback;
+	bool						m_recordBenchmark = false;
+	uint32_t					m_mipBenchmarkSize = 0;
+	uint32_t					m_allocationTestFrames = 0;
+	//Frames before the allocation test counts -- pools, caches & the render graph fill up on the first few
+	const uint32_t				m_ALLOCATION_WARM_UP_FRAMES = 100;
+
+	uint32_t					m_drawCount = 1;
+	std::string					m_modelPath;
+	VertexFormat				m_vertexFormat = VertexFormat::Full;
+	bool						m_meshOptimization = true;
+	bool						m_lodSelection = true;
+	bool						m_clusterCulling = true;
+	bool						m_occlusionCulling = true;
+	bool						m_depthPrepass = false;
+	bool						m_cpuOcclusionCulling = false;
+	std::vector<std::string>	m_texturePaths;
+	VkDeviceSize				m_textureBudget = 0;
+	bool						m_asyncAssets = false;
+	uint32_t					m_recordWorkerCount = 0;
+	bool						m_instanced = false;
 	bool						m_frameBufferResized = false;
 
+	//Bindless textures (VK_EXT_descriptor_indexing)
+	bool						m_bindlessRequested = false;
+	bool						m_bindlessEnabled = false;
+	uint32_t					m_maxBindlessTextures = 0;
+	bool						m_bindlessTest = false;
+	const uint32_t				m_BINDLESS_TABLE_SIZE = 16384;
+
+	//GPU driven culling & indirect draws
+	bool						m_gpuDrivenRequested = false;
+	bool						m_gpuDrivenEnabled = false;
+	bool						m_drawIndirectCount = false;
+	bool						m_multiDrawIndirect = false;
+	bool						m_cullTest = false;
+
 	GLFWwindow*					m_pWindow;
 	VkInstance					m_vkInstance;
 	VkDebugUtilsMessengerEXT	m_debugMessenger;
@@ -103,7 +224,26 @@ private:
 	VkDevice					m_vkDevice;
 	VkQueue						m_vkGraphicsQueue;
 	VkQueue						m_vkPresentQueue;
-	VkSurfaceKHR				m_vkSurface;
+	VkQueue						m_vkTransferQueue;
+	QueueFamilyIndices			m_queueFamilyIndices;
+	VkSurfaceKHR				m_vkSurface = VK_NULL_HANDLE;
+
+	SwapChainSupportDetails		m_swapChainSupport;
+
+	//Device memory sub-allocator
+	vkHelpers::DeviceMemoryAllocator* m_pAllocator;
+
+	//Batched staging uploads
+	UploadContext				m_uploadContext;
+
+	//Pipelines & shader modules, persisted to disk between runs
+	PipelineCache				m_pipelineCache;
+
+	std::chrono::high_resolution_clock::time_point m_startTime;
+
+	//Worker threads for command recording
+	JobSystem					m_jobSystem;
+	AssetLoader					m_assetLoader;
 
 	//Graphics Module
 	csmntVkGraphics*			m_pGraphics;
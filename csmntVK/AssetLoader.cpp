@@ -0,0 +1,72 @@
+#include "AssetLoader.h"
+#include <algorithm>
+#include <iostream>
+
+AssetLoader::~AssetLoader()
+{
+	shutdown();
+}
+
+void AssetLoader::create(uint32_t threadCount)
+{
+	//The render thread keeps a core to itself
+	if (threadCount == 0) {
+		threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	m_stop = false;
+
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_threads.emplace_back(&AssetLoader::workerLoop, this);
+	}
+
+#if _DEBUG
+	std::cout << "HEY! asset loader created with " << threadCount << " threads" << std::endl;
+#endif
+}
+
+void AssetLoader::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_tasks.clear();
+	}
+	m_wakeCondition.notify_all();
+
+	//Whatever is mid decode finishes first
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+}
+
+void AssetLoader::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_wakeCondition.notify_one();
+}
+
+void AssetLoader::workerLoop()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+
+			if (m_stop) {
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		//packaged_task catches anything thrown & hands it to the future
+		task();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef _ASSET_LOADER_
+#define _ASSET_LOADER_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <chrono>
+
+/////////////////////////////////////////////////////
+//---AssetLoader:
+//---Background threads for file reads & decodes. Unlike
+//---the JobSystem nobody joins in or waits on a batch --
+//---work is queued, runs whenever a thread frees up, and
+//---comes back through a future. Workers only produce CPU
+//---payloads, uploads stay on the render thread
+/////////////////////////////////////////////////////
+
+class AssetLoader {
+public:
+	AssetLoader() {};
+	~AssetLoader();
+	AssetLoader(AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	//0 = one per hardware thread, less the render thread
+	void create(uint32_t threadCount = 0);
+	//Queued work that hasn't started is dropped -- its futures throw broken_promise
+	void shutdown();
+
+	//Runs fn on a worker, its result (or exception) lands in the future
+	template<typename T>
+	std::future<T> submit(std::function<T()> fn)
+	{
+		std::shared_ptr<std::packaged_task<T()>> pTask = std::make_shared<std::packaged_task<T()>>(std::move(fn));
+		std::future<T> future = pTask->get_future();
+		enqueue([pTask]() { (*pTask)(); });
+		return future;
+	}
+
+	const uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); };
+
+	//Non-blocking check on a future handed out by submit
+	template<typename T>
+	static bool isReady(const std::future<T>& future)
+	{
+		return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+private:
+	void enqueue(std::function<void()> task);
+	void workerLoop();
+
+	std::vector<std::thread>	m_threads;
+
+	std::mutex					m_mutex;
+	std::condition_variable		m_wakeCondition;
+	std::deque<std::function<void()>> m_tasks;
+	bool						m_stop = false;
+};
+
+#endif // !_ASSET_LOADER_
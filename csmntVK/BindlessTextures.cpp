@@ -0,0 +1,189 @@
+#include "BindlessTextures.h"
+#include "Application.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+#pragma region CREATE & CLEANUP
+void BindlessTextureTable::create(csmntVkApplication* pApp, uint32_t capacity, uint32_t framesInFlight)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	m_capacity = capacity;
+	m_framesInFlight = framesInFlight;
+
+	//Slots are written while the set is bound (update after bind), and most of them
+	//are never written at all (partially bound)
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = m_capacity;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	binding.pImmutableSamplers = nullptr;
+
+	VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = 1;
+	bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_vkDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = m_capacity;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_vkDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+
+	//A single set shared by every frame -- slots are only rewritten once nothing reads them
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_vkDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_vkDescriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &m_vkDescriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+
+#if _DEBUG
+	std::cout << "HEY! bindless texture table created with " << m_capacity << " slots" << std::endl;
+#endif
+}
+
+void BindlessTextureTable::cleanup(csmntVkApplication* pApp)
+{
+	//Destroying the pool frees the set
+	vkDestroyDescriptorPool(pApp->getVkDevice(), m_vkDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(pApp->getVkDevice(), m_vkDescriptorSetLayout, nullptr);
+
+	m_vkDescriptorPool = VK_NULL_HANDLE;
+	m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	m_vkDescriptorSet = VK_NULL_HANDLE;
+
+	m_freeSlots.clear();
+	m_retiredSlots.clear();
+	m_nextUnusedSlot = 0;
+	m_liveCount = 0;
+}
+#pragma endregion
+
+#pragma region SLOTS
+uint32_t BindlessTextureTable::addTexture(VkDevice& device, VkImageView imageView, VkSampler sampler)
+{
+	uint32_t slot;
+	if (!m_freeSlots.empty()) {
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else if (m_nextUnusedSlot < m_capacity) {
+		slot = m_nextUnusedSlot++;
+	}
+	else {
+		throw std::runtime_error("bindless texture table is full!");
+	}
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_vkDescriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = slot;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+	m_liveCount++;
+	return slot;
+}
+
+void BindlessTextureTable::removeTexture(uint32_t slot)
+{
+	if (slot >= m_nextUnusedSlot) {
+		throw std::runtime_error("removing a bindless texture slot that was never handed out!");
+	}
+
+	m_retiredSlots.push_back({ slot, m_frameNumber });
+	m_liveCount--;
+}
+
+void BindlessTextureTable::beginFrame(uint64_t frameNumber)
+{
+	m_frameNumber = frameNumber;
+
+	//Retired in frame F -> last read by frame F at the latest, which is done
+	//once we're m_framesInFlight frames further on
+	while (!m_retiredSlots.empty() && m_retiredSlots.front().frameNumber + m_framesInFlight <= frameNumber) {
+		m_freeSlots.push_back(m_retiredSlots.front().slot);
+		m_retiredSlots.pop_front();
+	}
+}
+#pragma endregion
+
+#pragma region SELF CHECK
+bool BindlessTextureTable::verifySlotRecycling(VkDevice& device, VkImageView imageView, VkSampler sampler)
+{
+	//One slot to retire & one per frame it's held back for
+	const size_t available = m_freeSlots.size() + (m_capacity - m_nextUnusedSlot);
+	if (available < m_framesInFlight + 1) {
+		std::cout << "bindless slot recycling check skipped, only " << available << " free slots" << std::endl;
+		return true;
+	}
+
+	const uint64_t startFrame = m_frameNumber;
+	const uint32_t retiredSlot = addTexture(device, imageView, sampler);
+	removeTexture(retiredSlot);
+
+	//Frames that could still be reading it have to be handed something else
+	bool passed = true;
+	std::vector<uint32_t> heldSlots;
+	for (uint32_t i = 0; i < m_framesInFlight; i++) {
+		beginFrame(startFrame + i);
+		passed = passed && std::find(m_freeSlots.begin(), m_freeSlots.end(), retiredSlot) == m_freeSlots.end();
+
+		heldSlots.push_back(addTexture(device, imageView, sampler));
+		passed = passed && heldSlots.back() != retiredSlot;
+	}
+
+	//...& once the retire frame is done it's free again
+	beginFrame(startFrame + m_framesInFlight);
+	const bool recycled = std::find(m_freeSlots.begin(), m_freeSlots.end(), retiredSlot) != m_freeSlots.end();
+
+	std::cout << "bindless slot recycling check: slot " << retiredSlot << " held back for " << m_framesInFlight << " frames, "
+		<< (!passed ? "handed out again early -- MISMATCH" : recycled ? "recycled after" : "never recycled -- MISMATCH") << std::endl;
+
+	//Nothing reads the test slots -- give them back & pick up where the frames left off
+	for (uint32_t slot : heldSlots) {
+		removeTexture(slot);
+	}
+	m_frameNumber = startFrame;
+
+	return passed && recycled;
+}
+#pragma endregion
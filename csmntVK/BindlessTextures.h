@@ -0,0 +1,65 @@
+#pragma once
+#ifndef _BINDLESS_TEXTURES_
+#define _BINDLESS_TEXTURES_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---BindlessTextureTable:
+//---One big update-after-bind array of combined image
+//---samplers (VK_EXT_descriptor_indexing) in a set of its own.
+//---Textures are handed a slot when they load, shaders index
+//---the array with it. Freed slots are held back until
+//---no frame in flight can still be sampling them
+/////////////////////////////////////////////////////
+
+class BindlessTextureTable {
+public:
+	BindlessTextureTable() {};
+	~BindlessTextureTable() {};
+
+	void create(csmntVkApplication*, uint32_t capacity, uint32_t framesInFlight);
+	void cleanup(csmntVkApplication*);
+
+	//Writes the texture into a free slot & returns its index, throws when the table is full
+	uint32_t addTexture(VkDevice&, VkImageView, VkSampler);
+	//The slot keeps its old descriptor until it is recycled, so draws already recorded stay valid
+	void removeTexture(uint32_t slot);
+
+	//Once per frame, after waiting on that frame's fence -- recycles slots nothing can still read
+	void beginFrame(uint64_t frameNumber);
+
+	//Self check with the device idle: retires a slot, then steps through the frames in flight checking
+	//it isn't handed out again before its retire frame is done, & is once it is. Writes the view into the slots it uses
+	bool verifySlotRecycling(VkDevice&, VkImageView, VkSampler);
+
+	const VkDescriptorSetLayout& getDescriptorSetLayout() const { return m_vkDescriptorSetLayout; };
+	const VkDescriptorSet& getDescriptorSet() const { return m_vkDescriptorSet; };
+	const uint32_t getCapacity() const { return m_capacity; };
+	const uint32_t getTextureCount() const { return m_liveCount; };
+
+private:
+	struct RetiredSlot {
+		uint32_t	slot;
+		uint64_t	frameNumber;
+	};
+
+	VkDescriptorSetLayout	m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool		m_vkDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet			m_vkDescriptorSet = VK_NULL_HANDLE;
+
+	uint32_t				m_capacity = 0;
+	uint32_t				m_framesInFlight = 0;
+	uint64_t				m_frameNumber = 0;
+
+	uint32_t				m_nextUnusedSlot = 0;	//slots past this have never been handed out
+	uint32_t				m_liveCount = 0;
+	std::vector<uint32_t>	m_freeSlots;
+	std::deque<RetiredSlot>	m_retiredSlots;
+};
+
+#endif // !_BINDLESS_TEXTURES_
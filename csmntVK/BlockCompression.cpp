@@ -0,0 +1,1641 @@
+#include "BlockCompression.h"
+#include "JobSystem.h"
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+
+//SSE2 is baseline on x64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE 1
+#include <emmintrin.h>
+#else
+#define BLOCK_COMPRESSION_SSE 0
+#endif
+
+namespace blockCompression {
+	namespace {
+		//Decoded block, row major (y * 4 + x), RGBA8
+		typedef uint8_t Texels[16][4];
+
+		uint8_t clampByte(int value)
+		{
+			return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+		}
+
+#pragma region BC1_5
+		void decodeRgb565(uint16_t colour, uint8_t* pOut)
+		{
+			const uint32_t r = (colour >> 11) & 31;
+			const uint32_t g = (colour >> 5) & 63;
+			const uint32_t b = colour & 31;
+			pOut[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+			pOut[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+			pOut[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+			pOut[3] = 255;
+		}
+
+		//Palette exactly as decoders build it -- the encoder searches against the same values
+		void buildBc1Palette(uint16_t c0, uint16_t c1, bool fourColour, uint8_t palette[4][4])
+		{
+			decodeRgb565(c0, palette[0]);
+			decodeRgb565(c1, palette[1]);
+
+			if (fourColour) {
+				for (int c = 0; c < 3; c++) {
+					palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+					palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+				}
+				palette[2][3] = palette[3][3] = 255;
+			}
+			else {
+				for (int c = 0; c < 3; c++) {
+					palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+					palette[3][c] = 0;
+				}
+				palette[2][3] = 255;
+				palette[3][3] = 0;
+			}
+		}
+
+		//fourColour forces the c0 > c1 palette -- BC2 & BC3 colour blocks never use 3 colour + transparent
+		void decodeBc1Block(const uint8_t* pBlock, Texels& out, bool fourColour)
+		{
+			const uint16_t c0 = static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8));
+			const uint16_t c1 = static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8));
+			const uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | (static_cast<uint32_t>(pBlock[7]) << 24);
+
+			uint8_t palette[4][4];
+			buildBc1Palette(c0, c1, fourColour || c0 > c1, palette);
+
+			for (int i = 0; i < 16; i++) {
+				std::memcpy(out[i], palette[(indices >> (2 * i)) & 3], 4);
+			}
+		}
+
+		//BC4 style 8 value ramp, used for BC3 alpha & both BC5 channels
+		void buildBc4Ramp(int a0, int a1, uint8_t ramp[8])
+		{
+			ramp[0] = static_cast<uint8_t>(a0);
+			ramp[1] = static_cast<uint8_t>(a1);
+			if (a0 > a1) {
+				for (int i = 1; i < 7; i++) {
+					ramp[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1) / 7);
+				}
+			}
+			else {
+				for (int i = 1; i < 5; i++) {
+					ramp[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1) / 5);
+				}
+				ramp[6] = 0;
+				ramp[7] = 255;
+			}
+		}
+
+		void decodeBc4Block(const uint8_t* pBlock, Texels& out, int channel)
+		{
+			uint8_t ramp[8];
+			buildBc4Ramp(pBlock[0], pBlock[1], ramp);
+
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; i++) {
+				indices |= static_cast<uint64_t>(pBlock[2 + i]) << (8 * i);
+			}
+			for (int i = 0; i < 16; i++) {
+				out[i][channel] = ramp[(indices >> (3 * i)) & 7];
+			}
+		}
+
+		void decodeBc2Alpha(const uint8_t* pBlock, Texels& out)
+		{
+			for (int i = 0; i < 16; i++) {
+				const uint32_t alpha = (pBlock[i / 2] >> (4 * (i & 1))) & 15;
+				out[i][3] = static_cast<uint8_t>(alpha * 17);
+			}
+		}
+#pragma endregion
+
+#pragma region BC7
+		//2 subset partitions -- bit i is texel i's subset
+		const uint16_t s_bc7Partitions2[64] = {
+			0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+			0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+			0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+			0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+		};
+
+		const uint8_t s_bc7Partitions3[64][16] = {
+			{ 0,0,1,1, 0,0,1,1, 0,2,2,1, 2,2,2,2 }, { 0,0,0,1, 0,0,1,1, 2,2,1,1, 2,2,2,1 }, { 0,0,0,0, 2,0,0,1, 2,2,1,1, 2,2,1,1 }, { 0,2,2,2, 0,0,2,2, 0,0,1,1, 0,1,1,1 },
+			{ 0,0,0,0, 0,0,0,0, 1,1,2,2, 1,1,2,2 }, { 0,0,1,1, 0,0,1,1, 0,0,2,2, 0,0,2,2 }, { 0,0,2,2, 0,0,2,2, 1,1,1,1, 1,1,1,1 }, { 0,0,1,1, 0,0,1,1, 2,2,1,1, 2,2,1,1 },
+			{ 0,0,0,0, 0,0,0,0, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 2,2,2,2, 2,2,2,2 }, { 0,0,1,2, 0,0,1,2, 0,0,1,2, 0,0,1,2 },
+			{ 0,1,1,2, 0,1,1,2, 0,1,1,2, 0,1,1,2 }, { 0,1,2,2, 0,1,2,2, 0,1,2,2, 0,1,2,2 }, { 0,0,1,1, 0,1,1,2, 1,1,2,2, 1,2,2,2 }, { 0,0,1,1, 2,0,0,1, 2,2,0,0, 2,2,2,0 },
+			{ 0,0,0,1, 0,0,1,1, 0,1,1,2, 1,1,2,2 }, { 0,1,1,1, 0,0,1,1, 2,0,0,1, 2,2,0,0 }, { 0,0,0,0, 1,1,2,2, 1,1,2,2, 1,1,2,2 }, { 0,0,2,2, 0,0,2,2, 0,0,2,2, 1,1,1,1 },
+			{ 0,1,1,1, 0,1,1,1, 0,2,2,2, 0,2,2,2 }, { 0,0,0,1, 0,0,0,1, 2,2,2,1, 2,2,2,1 }, { 0,0,0,0, 0,0,1,1, 0,1,2,2, 0,1,2,2 }, { 0,0,0,0, 1,1,0,0, 2,2,1,0, 2,2,1,0 },
+			{ 0,1,2,2, 0,1,2,2, 0,0,1,1, 0,0,0,0 }, { 0,0,1,2, 0,0,1,2, 1,1,2,2, 2,2,2,2 }, { 0,1,1,0, 1,2,2,1, 1,2,2,1, 0,1,1,0 }, { 0,0,0,0, 0,1,1,0, 1,2,2,1, 1,2,2,1 },
+			{ 0,0,2,2, 1,1,0,2, 1,1,0,2, 0,0,2,2 }, { 0,1,1,0, 0,1,1,0, 2,0,0,2, 2,2,2,2 }, { 0,0,1,1, 0,1,2,2, 0,1,2,2, 0,0,1,1 }, { 0,0,0,0, 2,0,0,0, 2,2,1,1, 2,2,2,1 },
+			{ 0,0,0,0, 0,0,0,2, 1,1,2,2, 1,2,2,2 }, { 0,2,2,2, 0,0,2,2, 0,0,1,2, 0,0,1,1 }, { 0,0,1,1, 0,0,1,2, 0,0,2,2, 0,2,2,2 }, { 0,1,2,0, 0,1,2,0, 0,1,2,0, 0,1,2,0 },
+			{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 0,0,0,0 }, { 0,1,2,0, 1,2,0,1, 2,0,1,2, 0,1,2,0 }, { 0,1,2,0, 2,0,1,2, 1,2,0,1, 0,1,2,0 }, { 0,0,1,1, 2,2,0,0, 1,1,2,2, 0,0,1,1 },
+			{ 0,0,1,1, 1,1,2,2, 2,2,0,0, 0,0,1,1 }, { 0,1,0,1, 0,1,0,1, 2,2,2,2, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,2,1, 2,1,2,1 }, { 0,0,2,2, 1,1,2,2, 0,0,2,2, 1,1,2,2 },
+			{ 0,0,2,2, 0,0,1,1, 0,0,2,2, 0,0,1,1 }, { 0,2,2,0, 1,2,2,1, 0,2,2,0, 1,2,2,1 }, { 0,1,0,1, 2,2,2,2, 2,2,2,2, 0,1,0,1 }, { 0,0,0,0, 2,1,2,1, 2,1,2,1, 2,1,2,1 },
+			{ 0,1,0,1, 0,1,0,1, 0,1,0,1, 2,2,2,2 }, { 0,2,2,2, 0,1,1,1, 0,2,2,2, 0,1,1,1 }, { 0,0,0,2, 1,1,1,2, 0,0,0,2, 1,1,1,2 }, { 0,0,0,0, 2,1,1,2, 2,1,1,2, 2,1,1,2 },
+			{ 0,2,2,2, 0,1,1,1, 0,1,1,1, 0,2,2,2 }, { 0,0,0,2, 1,1,1,2, 1,1,1,2, 0,0,0,2 }, { 0,1,1,0, 0,1,1,0, 0,1,1,0, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,1,2, 2,1,1,2 },
+			{ 0,1,1,0, 0,1,1,0, 2,2,2,2, 2,2,2,2 }, { 0,0,2,2, 0,0,1,1, 0,0,1,1, 0,0,2,2 }, { 0,0,2,2, 1,1,2,2, 1,1,2,2, 0,0,2,2 }, { 0,0,0,0, 0,0,0,0, 0,0,0,0, 2,1,1,2 },
+			{ 0,0,0,2, 0,0,0,1, 0,0,0,2, 0,0,0,1 }, { 0,2,2,2, 1,2,2,2, 0,2,2,2, 1,2,2,2 }, { 0,1,0,1, 2,2,2,2, 2,2,2,2, 2,2,2,2 }, { 0,1,1,1, 2,0,1,1, 2,2,0,1, 2,2,2,0 }
+		};
+
+		//Texel whose index drops its top bit, for the second (& third) subset -- subset 0's is always texel 0
+		const uint8_t s_bc7Anchors2[64] = {
+			15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15, 2, 8, 2, 2, 8, 8, 2, 2,
+			15,15, 6, 8, 2, 8,15,15, 2, 8, 2, 2, 2,15,15, 6, 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15
+		};
+		const uint8_t s_bc7Anchors3a[64] = {
+			 3, 3,15,15, 8, 3,15,15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8,15, 3, 3, 6,10, 5, 8, 8, 6, 8, 5,15,15,
+			 8,15, 3, 5, 6,10, 8,15,15, 3,15, 5,15,15,15,15, 3,15, 5, 5, 5, 8, 5,10, 5,10, 8,13,15,12, 3, 3
+		};
+		const uint8_t s_bc7Anchors3b[64] = {
+			15, 8, 8, 3,15,15, 3, 8,15,15,15,15,15,15,15, 8,15, 8,15, 3,15, 8,15, 8, 3,15, 6,10,15,15,10, 8,
+			15, 3,15,10,10, 8, 9,10, 6,15, 8,15, 3, 6, 6, 8,15, 3,15,15,15,15,15,15,15,15,15,15, 3,15,15, 8
+		};
+
+		const uint32_t s_bc7Weights2[4] = { 0, 21, 43, 64 };
+		const uint32_t s_bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+		const uint32_t s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct Bc7Mode {
+			uint32_t	subsets;
+			uint32_t	partitionBits;
+			uint32_t	rotationBits;
+			uint32_t	indexSelectionBits;
+			uint32_t	colourBits;
+			uint32_t	alphaBits;
+			uint32_t	endpointPBits;		//one per endpoint
+			uint32_t	sharedPBits;		//one per subset
+			uint32_t	indexBits;
+			uint32_t	secondaryIndexBits;
+		};
+
+		const Bc7Mode s_bc7Modes[8] = {
+			{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+			{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+			{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+			{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+			{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+			{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+			{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+			{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+		};
+
+		//LSB first reader over a 128 bit block
+		class BitReader {
+		public:
+			BitReader(const uint8_t* pBlock) : m_pBlock(pBlock) {};
+
+			uint32_t read(uint32_t count)
+			{
+				uint32_t value = 0;
+				for (uint32_t i = 0; i < count; i++, m_position++) {
+					value |= ((m_pBlock[m_position >> 3] >> (m_position & 7)) & 1u) << i;
+				}
+				return value;
+			}
+
+		private:
+			const uint8_t*	m_pBlock;
+			uint32_t		m_position = 0;
+		};
+
+		const uint32_t* getBc7Weights(uint32_t bits)
+		{
+			return bits == 2 ? s_bc7Weights2 : (bits == 3 ? s_bc7Weights3 : s_bc7Weights4);
+		}
+
+		uint8_t interpolateBc7(uint32_t e0, uint32_t e1, uint32_t weight)
+		{
+			return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+		}
+
+		uint32_t getBc7Subset(uint32_t subsets, uint32_t partition, uint32_t texel)
+		{
+			if (subsets == 2) {
+				return (s_bc7Partitions2[partition] >> texel) & 1;
+			}
+			if (subsets == 3) {
+				return s_bc7Partitions3[partition][texel];
+			}
+			return 0;
+		}
+
+		bool isBc7Anchor(uint32_t subsets, uint32_t partition, uint32_t texel)
+		{
+			if (texel == 0) {
+				return true;
+			}
+			if (subsets == 2) {
+				return texel == s_bc7Anchors2[partition];
+			}
+			if (subsets == 3) {
+				return texel == s_bc7Anchors3a[partition] || texel == s_bc7Anchors3b[partition];
+			}
+			return false;
+		}
+
+		void decodeBc7Block(const uint8_t* pBlock, Texels& out)
+		{
+			uint32_t modeIndex = 0;
+			while (modeIndex < 8 && !(pBlock[0] & (1 << modeIndex))) {
+				modeIndex++;
+			}
+			//Reserved mode -- spec says transparent black
+			if (modeIndex == 8) {
+				std::memset(out, 0, sizeof(Texels));
+				return;
+			}
+
+			const Bc7Mode& mode = s_bc7Modes[modeIndex];
+			BitReader bits(pBlock);
+			bits.read(modeIndex + 1);
+
+			const uint32_t partition = bits.read(mode.partitionBits);
+			const uint32_t rotation = bits.read(mode.rotationBits);
+			const uint32_t indexSelection = bits.read(mode.indexSelectionBits);
+
+			//Endpoints are stored channel by channel: every R, then every G, every B, every A
+			uint32_t endpoints[6][4] = {};
+			const uint32_t endpointCount = mode.subsets * 2;
+			for (uint32_t c = 0; c < 3; c++) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					endpoints[e][c] = bits.read(mode.colourBits);
+				}
+			}
+			if (mode.alphaBits) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					endpoints[e][3] = bits.read(mode.alphaBits);
+				}
+			}
+
+			uint32_t pBits[6] = {};
+			if (mode.endpointPBits) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					pBits[e] = bits.read(1);
+				}
+			}
+			else if (mode.sharedPBits) {
+				for (uint32_t s = 0; s < mode.subsets; s++) {
+					pBits[s * 2] = pBits[s * 2 + 1] = bits.read(1);
+				}
+			}
+
+			//Unquantise to 8 bits -- P-bits sit below every channel that has them
+			const bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+			for (uint32_t e = 0; e < endpointCount; e++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					uint32_t precision = c < 3 ? mode.colourBits : mode.alphaBits;
+					if (precision == 0) {
+						endpoints[e][c] = 255;
+						continue;
+					}
+					uint32_t value = endpoints[e][c];
+					if (hasPBits) {
+						value = (value << 1) | pBits[e];
+						precision++;
+					}
+					value <<= 8 - precision;
+					endpoints[e][c] = value | (value >> precision);
+				}
+			}
+
+			uint32_t indices[16];
+			for (uint32_t i = 0; i < 16; i++) {
+				indices[i] = bits.read(mode.indexBits - (isBc7Anchor(mode.subsets, partition, i) ? 1 : 0));
+			}
+			uint32_t secondaryIndices[16] = {};
+			if (mode.secondaryIndexBits) {
+				for (uint32_t i = 0; i < 16; i++) {
+					secondaryIndices[i] = bits.read(mode.secondaryIndexBits - (i == 0 ? 1 : 0));
+				}
+			}
+
+			for (uint32_t i = 0; i < 16; i++) {
+				const uint32_t subset = getBc7Subset(mode.subsets, partition, i);
+				const uint32_t* e0 = endpoints[subset * 2];
+				const uint32_t* e1 = endpoints[subset * 2 + 1];
+
+				uint32_t colourIndex = indices[i], colourBits = mode.indexBits;
+				uint32_t alphaIndex = indices[i], alphaBits = mode.indexBits;
+				if (mode.secondaryIndexBits) {
+					//Mode 4's selection bit swaps which index set drives colour
+					if (indexSelection) {
+						colourIndex = secondaryIndices[i];
+						colourBits = mode.secondaryIndexBits;
+					}
+					else {
+						alphaIndex = secondaryIndices[i];
+						alphaBits = mode.secondaryIndexBits;
+					}
+				}
+
+				const uint32_t* colourWeights = getBc7Weights(colourBits);
+				for (uint32_t c = 0; c < 3; c++) {
+					out[i][c] = interpolateBc7(e0[c], e1[c], colourWeights[colourIndex]);
+				}
+				out[i][3] = interpolateBc7(e0[3], e1[3], getBc7Weights(alphaBits)[alphaIndex]);
+
+				if (rotation) {
+					std::swap(out[i][3], out[i][rotation - 1]);
+				}
+			}
+		}
+#pragma endregion
+
+#pragma region ETC2
+		const int s_etcModifiers[8][2] = {
+			{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+		};
+		const int s_etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+		const int s_eacModifiers[16][8] = {
+			{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+			{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 }, { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+			{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+			{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+		};
+
+		//ETC blocks are big endian 64 bit words
+		uint64_t readBigEndian64(const uint8_t* pBlock)
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < 8; i++) {
+				value = (value << 8) | pBlock[i];
+			}
+			return value;
+		}
+
+		uint32_t getBits(uint64_t value, uint32_t high, uint32_t low)
+		{
+			return static_cast<uint32_t>((value >> low) & ((1ull << (high - low + 1)) - 1));
+		}
+
+		int extend4(uint32_t v) { return static_cast<int>(v * 17); }
+		int extend5(uint32_t v) { return static_cast<int>((v << 3) | (v >> 2)); }
+		int extend6(uint32_t v) { return static_cast<int>((v << 2) | (v >> 4)); }
+		int extend7(uint32_t v) { return static_cast<int>((v << 1) | (v >> 6)); }
+
+		//Texel indices are column major: 2 bits per texel, MSBs in bits 31..16, LSBs in 15..0
+		uint32_t getEtcIndex(uint64_t block, uint32_t x, uint32_t y)
+		{
+			const uint32_t texel = x * 4 + y;
+			return (getBits(block, texel + 16, texel + 16) << 1) | getBits(block, texel, texel);
+		}
+
+		void setRgb(uint8_t* pOut, int r, int g, int b)
+		{
+			pOut[0] = clampByte(r);
+			pOut[1] = clampByte(g);
+			pOut[2] = clampByte(b);
+		}
+
+		//Individual/differential (ETC1) + ETC2's T, H & planar modes, RGB only -- alpha untouched
+		void decodeEtc2RgbBlock(const uint8_t* pBlock, Texels& out)
+		{
+			const uint64_t block = readBigEndian64(pBlock);
+			const bool differential = getBits(block, 33, 33) != 0;
+
+			int base[2][3];
+			if (differential) {
+				const int r = static_cast<int>(getBits(block, 63, 59));
+				const int g = static_cast<int>(getBits(block, 55, 51));
+				const int b = static_cast<int>(getBits(block, 47, 43));
+				//3 bit two's complement deltas
+				const int dr = (static_cast<int>(getBits(block, 58, 56)) ^ 4) - 4;
+				const int dg = (static_cast<int>(getBits(block, 50, 48)) ^ 4) - 4;
+				const int db = (static_cast<int>(getBits(block, 42, 40)) ^ 4) - 4;
+
+				//An overflowing delta selects one of the ETC2 modes
+				if (r + dr < 0 || r + dr > 31) {
+					//T mode
+					const int c0[3] = { extend4((getBits(block, 60, 59) << 2) | getBits(block, 57, 56)), extend4(getBits(block, 55, 52)), extend4(getBits(block, 51, 48)) };
+					const int c1[3] = { extend4(getBits(block, 47, 44)), extend4(getBits(block, 43, 40)), extend4(getBits(block, 39, 36)) };
+					const int d = s_etcDistances[(getBits(block, 35, 34) << 1) | getBits(block, 32, 32)];
+
+					int paint[4][3];
+					for (int c = 0; c < 3; c++) {
+						paint[0][c] = c0[c];
+						paint[1][c] = c1[c] + d;
+						paint[2][c] = c1[c];
+						paint[3][c] = c1[c] - d;
+					}
+					for (uint32_t y = 0; y < 4; y++) {
+						for (uint32_t x = 0; x < 4; x++) {
+							const int* p = paint[getEtcIndex(block, x, y)];
+							setRgb(out[y * 4 + x], p[0], p[1], p[2]);
+						}
+					}
+					return;
+				}
+				if (g + dg < 0 || g + dg > 31) {
+					//H mode
+					const uint32_t r0 = getBits(block, 62, 59);
+					const uint32_t g0 = (getBits(block, 58, 56) << 1) | getBits(block, 52, 52);
+					const uint32_t b0 = (getBits(block, 51, 51) << 3) | getBits(block, 49, 47);
+					const uint32_t r1 = getBits(block, 46, 43);
+					const uint32_t g1 = getBits(block, 42, 39);
+					const uint32_t b1 = getBits(block, 38, 35);
+					//The colours' order carries the distance index's low bit
+					const uint32_t order = ((r0 << 8) | (g0 << 4) | b0) >= ((r1 << 8) | (g1 << 4) | b1) ? 1 : 0;
+					const int d = s_etcDistances[(getBits(block, 34, 34) << 2) | (getBits(block, 32, 32) << 1) | order];
+
+					const int c0[3] = { extend4(r0), extend4(g0), extend4(b0) };
+					const int c1[3] = { extend4(r1), extend4(g1), extend4(b1) };
+					int paint[4][3];
+					for (int c = 0; c < 3; c++) {
+						paint[0][c] = c0[c] + d;
+						paint[1][c] = c0[c] - d;
+						paint[2][c] = c1[c] + d;
+						paint[3][c] = c1[c] - d;
+					}
+					for (uint32_t y = 0; y < 4; y++) {
+						for (uint32_t x = 0; x < 4; x++) {
+							const int* p = paint[getEtcIndex(block, x, y)];
+							setRgb(out[y * 4 + x], p[0], p[1], p[2]);
+						}
+					}
+					return;
+				}
+				if (b + db < 0 || b + db > 31) {
+					//Planar mode -- origin, horizontal & vertical colours, linearly extrapolated
+					const int o[3] = {
+						extend6(getBits(block, 62, 57)),
+						extend7((getBits(block, 56, 56) << 6) | getBits(block, 54, 49)),
+						extend6((getBits(block, 48, 48) << 5) | (getBits(block, 44, 43) << 3) | getBits(block, 41, 39)) };
+					const int h[3] = {
+						extend6((getBits(block, 38, 34) << 1) | getBits(block, 32, 32)),
+						extend7(getBits(block, 31, 25)),
+						extend6(getBits(block, 24, 19)) };
+					const int v[3] = {
+						extend6(getBits(block, 18, 13)),
+						extend7(getBits(block, 12, 6)),
+						extend6(getBits(block, 5, 0)) };
+
+					for (int y = 0; y < 4; y++) {
+						for (int x = 0; x < 4; x++) {
+							int rgb[3];
+							for (int c = 0; c < 3; c++) {
+								rgb[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+							}
+							setRgb(out[y * 4 + x], rgb[0], rgb[1], rgb[2]);
+						}
+					}
+					return;
+				}
+
+				base[0][0] = extend5(static_cast<uint32_t>(r));
+				base[0][1] = extend5(static_cast<uint32_t>(g));
+				base[0][2] = extend5(static_cast<uint32_t>(b));
+				base[1][0] = extend5(static_cast<uint32_t>(r + dr));
+				base[1][1] = extend5(static_cast<uint32_t>(g + dg));
+				base[1][2] = extend5(static_cast<uint32_t>(b + db));
+			}
+			else {
+				base[0][0] = extend4(getBits(block, 63, 60));
+				base[1][0] = extend4(getBits(block, 59, 56));
+				base[0][1] = extend4(getBits(block, 55, 52));
+				base[1][1] = extend4(getBits(block, 51, 48));
+				base[0][2] = extend4(getBits(block, 47, 44));
+				base[1][2] = extend4(getBits(block, 43, 40));
+			}
+
+			const uint32_t tables[2] = { getBits(block, 39, 37), getBits(block, 36, 34) };
+			const bool flip = getBits(block, 32, 32) != 0;
+
+			for (uint32_t y = 0; y < 4; y++) {
+				for (uint32_t x = 0; x < 4; x++) {
+					//Two 2x4 halves side by side, or 4x2 stacked when flipped
+					const uint32_t half = flip ? (y >= 2 ? 1 : 0) : (x >= 2 ? 1 : 0);
+					const uint32_t index = getEtcIndex(block, x, y);
+					int modifier = s_etcModifiers[tables[half]][index & 1];
+					if (index & 2) {
+						modifier = -modifier;
+					}
+					setRgb(out[y * 4 + x], base[half][0] + modifier, base[half][1] + modifier, base[half][2] + modifier);
+				}
+			}
+		}
+
+		void decodeEacAlphaBlock(const uint8_t* pBlock, Texels& out)
+		{
+			const uint64_t block = readBigEndian64(pBlock);
+			const int base = static_cast<int>(getBits(block, 63, 56));
+			const int multiplier = static_cast<int>(getBits(block, 55, 52));
+			const int* modifiers = s_eacModifiers[getBits(block, 51, 48)];
+
+			for (uint32_t x = 0; x < 4; x++) {
+				for (uint32_t y = 0; y < 4; y++) {
+					const uint32_t texel = x * 4 + y;
+					const uint32_t index = getBits(block, 47 - texel * 3, 45 - texel * 3);
+					out[y * 4 + x][3] = clampByte(base + modifiers[index] * multiplier);
+				}
+			}
+		}
+#pragma endregion
+
+		void decodeBlock(VkFormat format, const uint8_t* pBlock, Texels& out)
+		{
+			switch (format) {
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				decodeBc1Block(pBlock, out, false);
+				//No alpha in the RGB variant -- the transparent entry is plain black
+				for (int i = 0; i < 16; i++) {
+					out[i][3] = 255;
+				}
+				break;
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				decodeBc1Block(pBlock, out, false);
+				break;
+			case VK_FORMAT_BC2_UNORM_BLOCK:
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+				decodeBc1Block(pBlock + 8, out, true);
+				decodeBc2Alpha(pBlock, out);
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				decodeBc1Block(pBlock + 8, out, true);
+				decodeBc4Block(pBlock, out, 3);
+				break;
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				std::memset(out, 0, sizeof(Texels));
+				decodeBc4Block(pBlock, out, 0);
+				for (int i = 0; i < 16; i++) {
+					out[i][1] = out[i][2] = out[i][0];
+					out[i][3] = 255;
+				}
+				break;
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+				std::memset(out, 0, sizeof(Texels));
+				decodeBc4Block(pBlock, out, 0);
+				decodeBc4Block(pBlock + 8, out, 1);
+				for (int i = 0; i < 16; i++) {
+					out[i][3] = 255;
+				}
+				break;
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				decodeBc7Block(pBlock, out);
+				break;
+			case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+				decodeEtc2RgbBlock(pBlock, out);
+				for (int i = 0; i < 16; i++) {
+					out[i][3] = 255;
+				}
+				break;
+			case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+				decodeEacAlphaBlock(pBlock, out);
+				decodeEtc2RgbBlock(pBlock + 8, out);
+				break;
+			default:
+				throw std::runtime_error("can't decode this block compressed format on the CPU!");
+			}
+		}
+	}
+
+	bool getBlockInfo(VkFormat format, BlockFormatInfo& info)
+	{
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+			info = { 4, 4, 8 };
+			return true;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			info = { 4, 4, 16 };
+			return true;
+		case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+			info = { 5, 5, 16 };
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	VkDeviceSize getImageSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		BlockFormatInfo info;
+		if (!getBlockInfo(format, info)) {
+			throw std::runtime_error("not a block compressed format!");
+		}
+		const VkDeviceSize blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+		const VkDeviceSize blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+		return blocksX * blocksY * info.blockBytes;
+	}
+
+	bool canDecode(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void decodeImage(VkFormat format, const uint8_t* pBlocks, uint32_t width, uint32_t height, uint8_t* pRgba)
+	{
+		BlockFormatInfo info;
+		if (!canDecode(format) || !getBlockInfo(format, info)) {
+			throw std::runtime_error("can't decode this block compressed format on the CPU!");
+		}
+
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+
+		Texels texels;
+		for (uint32_t by = 0; by < blocksY; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				decodeBlock(format, pBlocks + (static_cast<size_t>(by) * blocksX + bx) * info.blockBytes, texels);
+
+				//Edge blocks hang over the image -- drop what's outside
+				const uint32_t w = std::min(4u, width - bx * 4);
+				const uint32_t h = std::min(4u, height - by * 4);
+				for (uint32_t y = 0; y < h; y++) {
+					uint8_t* pRow = pRgba + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * 4;
+					std::memcpy(pRow, texels[y * 4], w * 4);
+				}
+			}
+		}
+	}
+
+#pragma region ENCODING
+	namespace {
+		//One block as SoA floats in 0-255, channel major -- what the SIMD index searches run over
+		struct BlockTexels {
+			alignas(16) float channels[4][16];
+		};
+
+		typedef float PaletteEntry[4];
+
+		const uint32_t s_allTexels = 0xFFFF;
+		const float s_rgbWeights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+		const float s_rgbaWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+		void loadBlockTexels(const uint8_t* pTexels, BlockTexels& out)
+		{
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					out.channels[c][i] = pTexels[i * 4 + c];
+				}
+			}
+		}
+
+		//Nearest palette entry for each texel in mask (weighted squared distance), returns the summed error.
+		//Texels outside mask are left alone
+		float findIndices(const BlockTexels& texels, const PaletteEntry* pPalette, uint32_t paletteSize, const float* weights,
+			uint32_t mask, uint8_t* pIndices)
+		{
+			float error = 0.0f;
+#if BLOCK_COMPRESSION_SSE
+			//4 texels at a time against every entry, first minimum wins like the scalar path
+			for (int base = 0; base < 16; base += 4) {
+				if (!(mask & (0xFu << base))) {
+					continue;
+				}
+
+				__m128 best = _mm_set1_ps(FLT_MAX);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (uint32_t p = 0; p < paletteSize; p++) {
+					__m128 distance = _mm_setzero_ps();
+					for (int c = 0; c < 4; c++) {
+						if (weights[c] == 0.0f) {
+							continue;
+						}
+						const __m128 diff = _mm_sub_ps(_mm_load_ps(&texels.channels[c][base]), _mm_set1_ps(pPalette[p][c]));
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(diff, diff), _mm_set1_ps(weights[c])));
+					}
+					const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+					best = _mm_min_ps(distance, best);
+					bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(p))), _mm_andnot_si128(closer, bestIndex));
+				}
+
+				alignas(16) float bestDistances[4];
+				alignas(16) int32_t bestIndices[4];
+				_mm_store_ps(bestDistances, best);
+				_mm_store_si128(reinterpret_cast<__m128i*>(bestIndices), bestIndex);
+				for (int i = 0; i < 4; i++) {
+					if (mask & (1u << (base + i))) {
+						pIndices[base + i] = static_cast<uint8_t>(bestIndices[i]);
+						error += bestDistances[i];
+					}
+				}
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				if (!(mask & (1u << i))) {
+					continue;
+				}
+
+				float best = FLT_MAX;
+				uint32_t bestIndex = 0;
+				for (uint32_t p = 0; p < paletteSize; p++) {
+					float distance = 0.0f;
+					for (int c = 0; c < 4; c++) {
+						const float diff = texels.channels[c][i] - pPalette[p][c];
+						distance += diff * diff * weights[c];
+					}
+					if (distance < best) {
+						best = distance;
+						bestIndex = p;
+					}
+				}
+				pIndices[i] = static_cast<uint8_t>(bestIndex);
+				error += best;
+			}
+#endif
+			return error;
+		}
+
+		//Principal axis of a covariance matrix by power iteration. Returns the spread the axis
+		//doesn't explain -- a cheap guess at how well a line fits the texels
+		float solvePrincipalAxis(const float covariance[4][4], uint32_t channelCount, uint32_t iterations, float* pAxis)
+		{
+			//Start from the row of the widest channel, it can't be orthogonal to the answer
+			uint32_t widest = 0;
+			float trace = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				pAxis[c] = 0.0f;
+			}
+			for (uint32_t c = 0; c < channelCount; c++) {
+				trace += covariance[c][c];
+				if (covariance[c][c] > covariance[widest][widest]) {
+					widest = c;
+				}
+			}
+			if (covariance[widest][widest] <= 0.0f) {
+				return 0.0f;
+			}
+
+			float axis[4] = {};
+			for (uint32_t c = 0; c < channelCount; c++) {
+				axis[c] = covariance[widest][c];
+			}
+			for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+				float next[4] = {};
+				float largest = 0.0f;
+				for (uint32_t a = 0; a < channelCount; a++) {
+					for (uint32_t b = 0; b < channelCount; b++) {
+						next[a] += covariance[a][b] * axis[b];
+					}
+					largest = std::max(largest, std::fabs(next[a]));
+				}
+				if (largest == 0.0f) {
+					break;
+				}
+				for (uint32_t c = 0; c < channelCount; c++) {
+					axis[c] = next[c] / largest;
+				}
+			}
+
+			float length = 0.0f;
+			for (uint32_t c = 0; c < channelCount; c++) {
+				length += axis[c] * axis[c];
+			}
+			length = std::sqrt(length);
+			if (length == 0.0f) {
+				return trace;
+			}
+
+			float explained = 0.0f;
+			for (uint32_t a = 0; a < channelCount; a++) {
+				pAxis[a] = axis[a] / length;
+			}
+			for (uint32_t a = 0; a < channelCount; a++) {
+				for (uint32_t b = 0; b < channelCount; b++) {
+					explained += pAxis[a] * covariance[a][b] * pAxis[b];
+				}
+			}
+			return std::max(trace - explained, 0.0f);
+		}
+
+		//Mean & principal axis of the masked texels
+		float computePrincipalAxis(const BlockTexels& texels, uint32_t mask, uint32_t channelCount, float* pMean, float* pAxis)
+		{
+			float count = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				pMean[c] = 0.0f;
+				pAxis[c] = 0.0f;
+			}
+			for (int i = 0; i < 16; i++) {
+				if (mask & (1u << i)) {
+					for (uint32_t c = 0; c < channelCount; c++) {
+						pMean[c] += texels.channels[c][i];
+					}
+					count += 1.0f;
+				}
+			}
+			if (count == 0.0f) {
+				return 0.0f;
+			}
+			for (uint32_t c = 0; c < channelCount; c++) {
+				pMean[c] /= count;
+			}
+
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++) {
+				if (mask & (1u << i)) {
+					float d[4];
+					for (uint32_t c = 0; c < channelCount; c++) {
+						d[c] = texels.channels[c][i] - pMean[c];
+					}
+					for (uint32_t a = 0; a < channelCount; a++) {
+						for (uint32_t b = 0; b < channelCount; b++) {
+							covariance[a][b] += d[a] * d[b];
+						}
+					}
+				}
+			}
+
+			return solvePrincipalAxis(covariance, channelCount, 8, pAxis);
+		}
+
+		//Endpoints at the ends of the masked texels' spread along their principal axis
+		void fitEndpointsToAxis(const BlockTexels& texels, uint32_t mask, uint32_t channelCount, float e0[4], float e1[4])
+		{
+			float mean[4], axis[4];
+			computePrincipalAxis(texels, mask, channelCount, mean, axis);
+
+			float low = FLT_MAX, high = -FLT_MAX;
+			for (int i = 0; i < 16; i++) {
+				if (mask & (1u << i)) {
+					float t = 0.0f;
+					for (uint32_t c = 0; c < channelCount; c++) {
+						t += (texels.channels[c][i] - mean[c]) * axis[c];
+					}
+					low = std::min(low, t);
+					high = std::max(high, t);
+				}
+			}
+			if (low > high) {
+				low = high = 0.0f;
+			}
+
+			for (uint32_t c = 0; c < 4; c++) {
+				e0[c] = c < channelCount ? std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f) : 255.0f;
+				e1[c] = c < channelCount ? std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f) : 255.0f;
+			}
+		}
+
+		//Endpoints minimising the error for fixed indices, texel ~ lerp(e0, e1, weights[index]).
+		//Negative weights drop the texel from the fit. False if the system is singular
+		bool fitEndpointsToIndices(const BlockTexels& texels, uint32_t mask, const uint8_t* pIndices, const float* pWeights,
+			uint32_t channelCount, float e0[4], float e1[4])
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[4] = {}, bx[4] = {};
+			for (int i = 0; i < 16; i++) {
+				if (!(mask & (1u << i)) || pWeights[pIndices[i]] < 0.0f) {
+					continue;
+				}
+				const float t = pWeights[pIndices[i]];
+				const float s = 1.0f - t;
+				aa += s * s;
+				ab += s * t;
+				bb += t * t;
+				for (uint32_t c = 0; c < channelCount; c++) {
+					ax[c] += s * texels.channels[c][i];
+					bx[c] += t * texels.channels[c][i];
+				}
+			}
+
+			const float determinant = aa * bb - ab * ab;
+			if (std::fabs(determinant) < 1e-6f) {
+				return false;
+			}
+			for (uint32_t c = 0; c < 4; c++) {
+				if (c < channelCount) {
+					e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+					e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+				}
+				else {
+					e0[c] = e1[c] = 255.0f;
+				}
+			}
+			return true;
+		}
+
+#pragma region BC1_ENCODE
+		struct Bc1Result {
+			uint16_t	c0 = 0;
+			uint16_t	c1 = 0;
+			uint8_t		indices[16] = {};
+			float		error = FLT_MAX;
+		};
+
+		//Index -> position between c0 & c1, per palette mode (-1: the black entry, not on the line)
+		const float s_bc1FourColourWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		const float s_bc1ThreeColourWeights[4] = { 0.0f, 1.0f, 0.5f, -1.0f };
+
+		uint16_t packRgb565(const float* pRgb)
+		{
+			const uint32_t r = static_cast<uint32_t>(std::min(std::max(pRgb[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+			const uint32_t g = static_cast<uint32_t>(std::min(std::max(pRgb[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f));
+			const uint32_t b = static_cast<uint32_t>(std::min(std::max(pRgb[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		//Orders the pair for the wanted palette mode, then indexes & scores it the way decoders will read it
+		void tryBc1Endpoints(const BlockTexels& texels, uint16_t a, uint16_t b, bool fourColour, bool forceFourColour, Bc1Result& best)
+		{
+			Bc1Result candidate;
+			candidate.c0 = fourColour ? std::max(a, b) : std::min(a, b);
+			candidate.c1 = fourColour ? std::min(a, b) : std::max(a, b);
+
+			uint8_t palette[4][4];
+			buildBc1Palette(candidate.c0, candidate.c1, forceFourColour || candidate.c0 > candidate.c1, palette);
+
+			PaletteEntry entries[4];
+			for (int p = 0; p < 4; p++) {
+				for (int c = 0; c < 4; c++) {
+					entries[p][c] = palette[p][c];
+				}
+			}
+
+			candidate.error = findIndices(texels, entries, 4, s_rgbWeights, s_allTexels, candidate.indices);
+			if (candidate.error < best.error) {
+				best = candidate;
+			}
+		}
+
+		void refineBc1(const BlockTexels& texels, bool fourColour, bool forceFourColour, uint32_t iterations, Bc1Result& best)
+		{
+			const float* pWeights = fourColour ? s_bc1FourColourWeights : s_bc1ThreeColourWeights;
+			for (uint32_t i = 0; i < iterations; i++) {
+				float e0[4], e1[4];
+				const float previous = best.error;
+				if (!fitEndpointsToIndices(texels, s_allTexels, best.indices, pWeights, 3, e0, e1)) {
+					break;
+				}
+				tryBc1Endpoints(texels, packRgb565(e0), packRgb565(e1), fourColour, forceFourColour, best);
+				if (best.error >= previous) {
+					break;
+				}
+			}
+		}
+
+		//Nudge each 565 component of both endpoints by one step while it keeps helping
+		void searchBc1Endpoints(const BlockTexels& texels, bool fourColour, bool forceFourColour, Bc1Result& best)
+		{
+			const uint32_t shifts[3] = { 11, 5, 0 };
+			const uint32_t limits[3] = { 31, 63, 31 };
+
+			for (int pass = 0; pass < 8; pass++) {
+				bool improved = false;
+				for (int endpoint = 0; endpoint < 2; endpoint++) {
+					for (int c = 0; c < 3; c++) {
+						for (int step = -1; step <= 1; step += 2) {
+							const uint16_t colour = endpoint == 0 ? best.c0 : best.c1;
+							const int value = static_cast<int>((colour >> shifts[c]) & limits[c]) + step;
+							if (value < 0 || value > static_cast<int>(limits[c])) {
+								continue;
+							}
+
+							const uint16_t moved = static_cast<uint16_t>((colour & ~(limits[c] << shifts[c])) | (static_cast<uint32_t>(value) << shifts[c]));
+							const float previous = best.error;
+							tryBc1Endpoints(texels, endpoint == 0 ? moved : best.c0, endpoint == 0 ? best.c1 : moved, fourColour, forceFourColour, best);
+							improved |= best.error < previous;
+						}
+					}
+				}
+				if (!improved) {
+					break;
+				}
+			}
+		}
+
+		//forceFourColour for BC3's colour half -- allowThreeColour lets BC1 use the black entry for dark texels
+		void encodeBc1Colour(const BlockTexels& texels, EncodeQuality quality, bool allowThreeColour, bool forceFourColour, uint8_t* pBlock)
+		{
+			float e0[4], e1[4];
+			fitEndpointsToAxis(texels, s_allTexels, 3, e0, e1);
+
+			//Pull the ends in a little -- the extremes are rarely worth a whole palette entry
+			for (int c = 0; c < 3; c++) {
+				const float inset = (e1[c] - e0[c]) / 16.0f;
+				e0[c] += inset;
+				e1[c] -= inset;
+			}
+
+			Bc1Result best;
+			tryBc1Endpoints(texels, packRgb565(e0), packRgb565(e1), true, forceFourColour, best);
+
+			if (quality != EncodeQuality::Fast) {
+				refineBc1(texels, true, forceFourColour, quality == EncodeQuality::Best ? 4 : 2, best);
+			}
+			if (quality == EncodeQuality::Best) {
+				searchBc1Endpoints(texels, true, forceFourColour, best);
+
+				if (allowThreeColour && !forceFourColour) {
+					Bc1Result threeColour;
+					tryBc1Endpoints(texels, packRgb565(e0), packRgb565(e1), false, false, threeColour);
+					refineBc1(texels, false, false, 4, threeColour);
+					searchBc1Endpoints(texels, false, false, threeColour);
+					if (threeColour.error < best.error) {
+						best = threeColour;
+					}
+				}
+			}
+
+			uint32_t indices = 0;
+			for (int i = 0; i < 16; i++) {
+				indices |= static_cast<uint32_t>(best.indices[i]) << (2 * i);
+			}
+			pBlock[0] = static_cast<uint8_t>(best.c0);
+			pBlock[1] = static_cast<uint8_t>(best.c0 >> 8);
+			pBlock[2] = static_cast<uint8_t>(best.c1);
+			pBlock[3] = static_cast<uint8_t>(best.c1 >> 8);
+			for (int i = 0; i < 4; i++) {
+				pBlock[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+			}
+		}
+#pragma endregion
+
+#pragma region BC4_ENCODE
+		struct Bc4Result {
+			int			a0 = 0;
+			int			a1 = 0;
+			uint8_t		indices[16] = {};
+			float		error = FLT_MAX;
+		};
+
+		void tryBc4Endpoints(const BlockTexels& texels, int channel, int a0, int a1, Bc4Result& best)
+		{
+			Bc4Result candidate;
+			candidate.a0 = a0;
+			candidate.a1 = a1;
+
+			uint8_t ramp[8];
+			buildBc4Ramp(a0, a1, ramp);
+
+			PaletteEntry entries[8];
+			float weights[4] = {};
+			weights[channel] = 1.0f;
+			for (int p = 0; p < 8; p++) {
+				entries[p][0] = entries[p][1] = entries[p][2] = entries[p][3] = ramp[p];
+			}
+
+			candidate.error = findIndices(texels, entries, 8, weights, s_allTexels, candidate.indices);
+			if (candidate.error < best.error) {
+				best = candidate;
+			}
+		}
+
+		void encodeBc4(const BlockTexels& texels, int channel, EncodeQuality quality, uint8_t* pBlock)
+		{
+			int low = 255, high = 0;
+			//The 6 value ramp has 0 & 255 for free -- its endpoints only need to cover the rest
+			int innerLow = 255, innerHigh = 0;
+			for (int i = 0; i < 16; i++) {
+				const int value = static_cast<int>(texels.channels[channel][i]);
+				low = std::min(low, value);
+				high = std::max(high, value);
+				if (value != 0 && value != 255) {
+					innerLow = std::min(innerLow, value);
+					innerHigh = std::max(innerHigh, value);
+				}
+			}
+
+			Bc4Result best;
+			//8 value ramp wants a0 > a1
+			tryBc4Endpoints(texels, channel, high, low, best);
+
+			if (quality != EncodeQuality::Fast && innerLow <= innerHigh) {
+				tryBc4Endpoints(texels, channel, innerLow, innerHigh, best);
+			}
+			if (quality == EncodeQuality::Best && high > low) {
+				for (int d0 = -2; d0 <= 2; d0++) {
+					for (int d1 = -2; d1 <= 2; d1++) {
+						const int a0 = std::min(high + d0, 255);
+						const int a1 = std::max(low + d1, 0);
+						if (a0 > a1) {
+							tryBc4Endpoints(texels, channel, a0, a1, best);
+						}
+					}
+				}
+			}
+
+			uint64_t indices = 0;
+			for (int i = 0; i < 16; i++) {
+				indices |= static_cast<uint64_t>(best.indices[i]) << (3 * i);
+			}
+			pBlock[0] = static_cast<uint8_t>(best.a0);
+			pBlock[1] = static_cast<uint8_t>(best.a1);
+			for (int i = 0; i < 6; i++) {
+				pBlock[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+			}
+		}
+#pragma endregion
+
+#pragma region BC7_ENCODE
+		struct Bc7Block {
+			uint32_t	mode = 6;
+			uint32_t	partition = 0;
+			uint8_t		endpoints[6][4] = {};		//quantised, p-bits kept apart
+			uint8_t		pBits[6] = {};
+			uint8_t		indices[16] = {};
+			float		error = FLT_MAX;
+		};
+
+		class BitWriter {
+		public:
+			BitWriter(uint8_t* pBlock) : m_pBlock(pBlock) { std::memset(pBlock, 0, 16); };
+
+			void write(uint32_t value, uint32_t count)
+			{
+				for (uint32_t i = 0; i < count; i++, m_position++) {
+					m_pBlock[m_position >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (m_position & 7));
+				}
+			}
+
+		private:
+			uint8_t*	m_pBlock;
+			uint32_t	m_position = 0;
+		};
+
+		//Texel masks of every partition's subsets, [subsets - 1][partition][subset]
+		struct Bc7SubsetMasks {
+			uint16_t	masks[3][64][3];
+
+			Bc7SubsetMasks()
+			{
+				std::memset(masks, 0, sizeof(masks));
+				for (uint32_t subsets = 1; subsets <= 3; subsets++) {
+					for (uint32_t partition = 0; partition < 64; partition++) {
+						for (uint32_t i = 0; i < 16; i++) {
+							masks[subsets - 1][partition][getBc7Subset(subsets, partition, i)] |= static_cast<uint16_t>(1u << i);
+						}
+					}
+				}
+			}
+		};
+
+		uint32_t getBc7SubsetMask(uint32_t subsets, uint32_t partition, uint32_t subset)
+		{
+			static const Bc7SubsetMasks s_masks;
+			return s_masks.masks[subsets - 1][partition][subset];
+		}
+
+		uint32_t getBc7Anchor(uint32_t subsets, uint32_t partition, uint32_t subset)
+		{
+			if (subset == 0) {
+				return 0;
+			}
+			if (subsets == 2) {
+				return s_bc7Anchors2[partition];
+			}
+			return subset == 1 ? s_bc7Anchors3a[partition] : s_bc7Anchors3b[partition];
+		}
+
+		//Same expansion the decoder does -- pBit < 0 for modes without one
+		uint32_t unquantiseBc7(uint32_t value, uint32_t bits, int pBit)
+		{
+			uint32_t precision = bits;
+			if (pBit >= 0) {
+				value = (value << 1) | static_cast<uint32_t>(pBit);
+				precision++;
+			}
+			value <<= 8 - precision;
+			return value | (value >> precision);
+		}
+
+		//Closest code to value once expanded, with the p-bit fixed
+		uint32_t quantiseBc7(float value, uint32_t bits, int pBit)
+		{
+			const int maxCode = (1 << bits) - 1;
+			int code = pBit >= 0 ?
+				static_cast<int>(std::floor((value * ((1 << (bits + 1)) - 1) / 255.0f - pBit) * 0.5f + 0.5f)) :
+				static_cast<int>(std::floor(value * maxCode / 255.0f + 0.5f));
+			code = std::min(std::max(code, 0), maxCode);
+
+			//Rounding in the scaled space can land one code off once the expansion's rounding is in
+			int best = code;
+			float bestError = FLT_MAX;
+			for (int candidate = std::max(code - 1, 0); candidate <= std::min(code + 1, maxCode); candidate++) {
+				const float error = std::fabs(static_cast<float>(unquantiseBc7(static_cast<uint32_t>(candidate), bits, pBit)) - value);
+				if (error < bestError) {
+					bestError = error;
+					best = candidate;
+				}
+			}
+			return static_cast<uint32_t>(best);
+		}
+
+		//Expanded distance of an endpoint from where it wants to be, for a p-bit
+		float getBc7QuantisationError(const Bc7Mode& mode, const float endpoint[4], int pBit)
+		{
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				const uint32_t bits = c < 3 ? mode.colourBits : mode.alphaBits;
+				if (bits) {
+					const float diff = static_cast<float>(unquantiseBc7(quantiseBc7(endpoint[c], bits, pBit), bits, pBit)) - endpoint[c];
+					error += diff * diff;
+				}
+			}
+			return error;
+		}
+
+		//Quantise one subset's endpoints for the block's mode & index its texels. searchPBits indexes every
+		//p-bit choice, otherwise they're picked by how close the endpoints quantise
+		float encodeBc7Subset(const BlockTexels& texels, uint32_t subset, uint32_t mask, const float e0[4], const float e1[4],
+			bool searchPBits, Bc7Block& block)
+		{
+			const Bc7Mode& mode = s_bc7Modes[block.mode];
+			const uint32_t paletteSize = 1u << mode.indexBits;
+			const uint32_t* pWeights = getBc7Weights(mode.indexBits);
+
+			int pBitChoices = mode.endpointPBits ? 4 : (mode.sharedPBits ? 2 : 1);
+			int firstChoice = 0;
+			if (!searchPBits && pBitChoices > 1) {
+				if (mode.endpointPBits) {
+					const int p0 = getBc7QuantisationError(mode, e0, 1) < getBc7QuantisationError(mode, e0, 0) ? 1 : 0;
+					const int p1 = getBc7QuantisationError(mode, e1, 1) < getBc7QuantisationError(mode, e1, 0) ? 1 : 0;
+					firstChoice = p0 | (p1 << 1);
+				}
+				else {
+					firstChoice = getBc7QuantisationError(mode, e0, 1) + getBc7QuantisationError(mode, e1, 1) <
+						getBc7QuantisationError(mode, e0, 0) + getBc7QuantisationError(mode, e1, 0) ? 1 : 0;
+				}
+				pBitChoices = firstChoice + 1;
+			}
+
+			float bestError = FLT_MAX;
+
+			for (int choice = firstChoice; choice < pBitChoices; choice++) {
+				int pBits[2] = { -1, -1 };
+				if (mode.endpointPBits) {
+					pBits[0] = choice & 1;
+					pBits[1] = choice >> 1;
+				}
+				else if (mode.sharedPBits) {
+					pBits[0] = pBits[1] = choice;
+				}
+
+				uint8_t quantised[2][4] = {};
+				uint32_t expanded[2][4];
+				for (int e = 0; e < 2; e++) {
+					const float* pEndpoint = e == 0 ? e0 : e1;
+					for (uint32_t c = 0; c < 4; c++) {
+						const uint32_t bits = c < 3 ? mode.colourBits : mode.alphaBits;
+						if (bits == 0) {
+							expanded[e][c] = 255;
+							continue;
+						}
+						quantised[e][c] = static_cast<uint8_t>(quantiseBc7(pEndpoint[c], bits, pBits[e]));
+						expanded[e][c] = unquantiseBc7(quantised[e][c], bits, pBits[e]);
+					}
+				}
+
+				PaletteEntry palette[16];
+				for (uint32_t p = 0; p < paletteSize; p++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						palette[p][c] = interpolateBc7(expanded[0][c], expanded[1][c], pWeights[p]);
+					}
+				}
+
+				uint8_t indices[16];
+				const float error = findIndices(texels, palette, paletteSize, s_rgbaWeights, mask, indices);
+				if (error < bestError) {
+					bestError = error;
+					std::memcpy(block.endpoints[subset * 2], quantised[0], 4);
+					std::memcpy(block.endpoints[subset * 2 + 1], quantised[1], 4);
+					block.pBits[subset * 2] = static_cast<uint8_t>(std::max(pBits[0], 0));
+					block.pBits[subset * 2 + 1] = static_cast<uint8_t>(std::max(pBits[1], 0));
+					for (uint32_t i = 0; i < 16; i++) {
+						if (mask & (1u << i)) {
+							block.indices[i] = indices[i];
+						}
+					}
+				}
+			}
+			return bestError;
+		}
+
+		void encodeBc7Mode(const BlockTexels& texels, uint32_t modeIndex, uint32_t partition, EncodeQuality quality, Bc7Block& best)
+		{
+			const uint32_t refinements = quality == EncodeQuality::Fast ? 0 : (quality == EncodeQuality::Best ? 2 : 1);
+			const bool searchPBits = quality == EncodeQuality::Best;
+
+			const Bc7Mode& mode = s_bc7Modes[modeIndex];
+			const uint32_t channelCount = mode.alphaBits ? 4 : 3;
+
+			float weights[16];
+			const uint32_t* pWeights = getBc7Weights(mode.indexBits);
+			for (uint32_t i = 0; i < (1u << mode.indexBits); i++) {
+				weights[i] = pWeights[i] / 64.0f;
+			}
+
+			Bc7Block candidate;
+			candidate.mode = modeIndex;
+			candidate.partition = partition;
+			candidate.error = 0.0f;
+
+			for (uint32_t subset = 0; subset < mode.subsets; subset++) {
+				const uint32_t mask = getBc7SubsetMask(mode.subsets, partition, subset);
+
+				float e0[4], e1[4];
+				fitEndpointsToAxis(texels, mask, channelCount, e0, e1);
+				float error = encodeBc7Subset(texels, subset, mask, e0, e1, searchPBits, candidate);
+
+				for (uint32_t i = 0; i < refinements; i++) {
+					if (!fitEndpointsToIndices(texels, mask, candidate.indices, weights, channelCount, e0, e1)) {
+						break;
+					}
+					Bc7Block refined = candidate;
+					const float refinedError = encodeBc7Subset(texels, subset, mask, e0, e1, searchPBits, refined);
+					if (refinedError >= error) {
+						break;
+					}
+					candidate = refined;
+					error = refinedError;
+				}
+
+				candidate.error += error;
+				//Already worse than what we have, the other subsets can't help
+				if (candidate.error >= best.error) {
+					return;
+				}
+			}
+
+			best = candidate;
+		}
+
+		//Partitions sorted by how well a line fits each of their subsets, best first.
+		//Per texel products are summed once, each subset's covariance comes out of those sums
+		void rankBc7Partitions(const BlockTexels& texels, uint32_t subsets, uint32_t partitionCount, uint32_t channelCount,
+			uint32_t* pRanked)
+		{
+			float products[16][4][4];
+			for (int i = 0; i < 16; i++) {
+				for (uint32_t a = 0; a < channelCount; a++) {
+					for (uint32_t b = 0; b < channelCount; b++) {
+						products[i][a][b] = texels.channels[a][i] * texels.channels[b][i];
+					}
+				}
+			}
+
+			std::pair<float, uint32_t> scores[64];
+			for (uint32_t partition = 0; partition < partitionCount; partition++) {
+				float score = 0.0f;
+				for (uint32_t subset = 0; subset < subsets; subset++) {
+					const uint32_t mask = getBc7SubsetMask(subsets, partition, subset);
+
+					float count = 0.0f, sum[4] = {}, covariance[4][4] = {};
+					for (int i = 0; i < 16; i++) {
+						if (!(mask & (1u << i))) {
+							continue;
+						}
+						count += 1.0f;
+						for (uint32_t a = 0; a < channelCount; a++) {
+							sum[a] += texels.channels[a][i];
+							for (uint32_t b = 0; b < channelCount; b++) {
+								covariance[a][b] += products[i][a][b];
+							}
+						}
+					}
+					if (count == 0.0f) {
+						continue;
+					}
+					for (uint32_t a = 0; a < channelCount; a++) {
+						for (uint32_t b = 0; b < channelCount; b++) {
+							covariance[a][b] -= sum[a] * sum[b] / count;
+						}
+					}
+
+					float axis[4];
+					score += solvePrincipalAxis(covariance, channelCount, 3, axis);
+				}
+				scores[partition] = std::make_pair(score, partition);
+			}
+			std::sort(scores, scores + partitionCount);
+
+			for (uint32_t i = 0; i < partitionCount; i++) {
+				pRanked[i] = scores[i].second;
+			}
+		}
+
+		void packBc7Block(Bc7Block block, uint8_t* pOut)
+		{
+			const Bc7Mode& mode = s_bc7Modes[block.mode];
+			const uint32_t highBit = 1u << (mode.indexBits - 1);
+			const uint32_t maxIndex = (1u << mode.indexBits) - 1;
+
+			//Anchors drop their index's top bit -- flip the subset's ends where it's set
+			for (uint32_t subset = 0; subset < mode.subsets; subset++) {
+				if (!(block.indices[getBc7Anchor(mode.subsets, block.partition, subset)] & highBit)) {
+					continue;
+				}
+				for (uint32_t c = 0; c < 4; c++) {
+					std::swap(block.endpoints[subset * 2][c], block.endpoints[subset * 2 + 1][c]);
+				}
+				std::swap(block.pBits[subset * 2], block.pBits[subset * 2 + 1]);
+				for (uint32_t i = 0; i < 16; i++) {
+					if (getBc7Subset(mode.subsets, block.partition, i) == subset) {
+						block.indices[i] = static_cast<uint8_t>(maxIndex - block.indices[i]);
+					}
+				}
+			}
+
+			BitWriter bits(pOut);
+			bits.write(1u << block.mode, block.mode + 1);
+			bits.write(block.partition, mode.partitionBits);
+
+			const uint32_t endpointCount = mode.subsets * 2;
+			for (uint32_t c = 0; c < 3; c++) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					bits.write(block.endpoints[e][c], mode.colourBits);
+				}
+			}
+			if (mode.alphaBits) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					bits.write(block.endpoints[e][3], mode.alphaBits);
+				}
+			}
+
+			if (mode.endpointPBits) {
+				for (uint32_t e = 0; e < endpointCount; e++) {
+					bits.write(block.pBits[e], 1);
+				}
+			}
+			else if (mode.sharedPBits) {
+				for (uint32_t subset = 0; subset < mode.subsets; subset++) {
+					bits.write(block.pBits[subset * 2], 1);
+				}
+			}
+
+			for (uint32_t i = 0; i < 16; i++) {
+				bits.write(block.indices[i], mode.indexBits - (isBc7Anchor(mode.subsets, block.partition, i) ? 1 : 0));
+			}
+		}
+
+		//Modes 4 & 5 (separate alpha indices & channel rotation) aren't searched
+		void encodeBc7(const BlockTexels& texels, EncodeQuality quality, uint8_t* pBlock)
+		{
+			bool opaque = true;
+			for (int i = 0; i < 16; i++) {
+				opaque &= texels.channels[3][i] == 255.0f;
+			}
+
+			Bc7Block best;
+			encodeBc7Mode(texels, 6, 0, quality, best);
+
+			if (quality != EncodeQuality::Fast) {
+				const uint32_t twoSubsetTries = quality == EncodeQuality::Best ? 16 : 4;
+				uint32_t ranked[64];
+
+				if (opaque) {
+					rankBc7Partitions(texels, 2, 64, 3, ranked);
+					for (uint32_t i = 0; i < twoSubsetTries; i++) {
+						encodeBc7Mode(texels, 1, ranked[i], quality, best);
+						encodeBc7Mode(texels, 3, ranked[i], quality, best);
+					}
+
+					if (quality == EncodeQuality::Best) {
+						rankBc7Partitions(texels, 3, 64, 3, ranked);
+						for (uint32_t i = 0; i < 8; i++) {
+							encodeBc7Mode(texels, 2, ranked[i], quality, best);
+						}
+						//Mode 0 only reaches the first 16 partitions
+						rankBc7Partitions(texels, 3, 16, 3, ranked);
+						for (uint32_t i = 0; i < 8; i++) {
+							encodeBc7Mode(texels, 0, ranked[i], quality, best);
+						}
+					}
+				}
+				else {
+					rankBc7Partitions(texels, 2, 64, 4, ranked);
+					for (uint32_t i = 0; i < twoSubsetTries; i++) {
+						encodeBc7Mode(texels, 7, ranked[i], quality, best);
+					}
+				}
+			}
+
+			packBc7Block(best, pBlock);
+		}
+#pragma endregion
+	}
+
+	bool canEncode(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void encodeBlock(VkFormat format, const uint8_t* pTexels, EncodeQuality quality, uint8_t* pBlock)
+	{
+		BlockTexels texels;
+		loadBlockTexels(pTexels, texels);
+
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			encodeBc1Colour(texels, quality, true, false, pBlock);
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			encodeBc4(texels, 3, quality, pBlock);
+			encodeBc1Colour(texels, quality, false, true, pBlock + 8);
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			encodeBc7(texels, quality, pBlock);
+			break;
+		default:
+			throw std::runtime_error("can't encode this block compressed format!");
+		}
+	}
+
+	void encodeImage(VkFormat format, const uint8_t* pRgba, uint32_t width, uint32_t height, EncodeQuality quality,
+		uint8_t* pBlocks, JobSystem* pJobs)
+	{
+		BlockFormatInfo info;
+		if (!canEncode(format) || !getBlockInfo(format, info)) {
+			throw std::runtime_error("can't encode this block compressed format!");
+		}
+
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+
+		//One row of blocks per job
+		auto encodeRow = [&](uint32_t by, uint32_t) {
+			uint8_t texels[64];
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				for (uint32_t y = 0; y < 4; y++) {
+					const uint32_t sy = std::min(by * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++) {
+						const uint32_t sx = std::min(bx * 4 + x, width - 1);
+						std::memcpy(texels + (y * 4 + x) * 4, pRgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+					}
+				}
+				encodeBlock(format, texels, quality, pBlocks + (static_cast<size_t>(by) * blocksX + bx) * info.blockBytes);
+			}
+		};
+
+		if (pJobs) {
+			pJobs->parallelFor(blocksY, encodeRow);
+		}
+		else {
+			for (uint32_t by = 0; by < blocksY; by++) {
+				encodeRow(by, 0);
+			}
+		}
+	}
+#pragma endregion
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef _BLOCK_COMPRESSION_
+#define _BLOCK_COMPRESSION_
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+class JobSystem;
+
+//Footprint of one compressed block
+struct BlockFormatInfo {
+	uint32_t	blockWidth;
+	uint32_t	blockHeight;
+	uint32_t	blockBytes;
+};
+
+//How hard the encoder searches for each block
+enum class EncodeQuality {
+	Fast,		//one endpoint fit per block, BC7 mode 6 only
+	Normal,		//least squares refits, BC7 modes 1/3/7 over the likeliest partitions
+	Best		//endpoint search on top, BC7 modes 0-3/6/7 over more partitions
+};
+
+/////////////////////////////////////////////////////
+//---blockCompression:
+//---CPU side of the block compressed formats. Decodes
+//---BC1-5, BC7 & ETC2 RGB/RGBA blocks to RGBA8 for
+//---devices that can't sample the format themselves,
+//---encodes BC1, BC3 & BC7 for the texture cooker.
+//---Endpoint/index searches run on SSE2 where available
+/////////////////////////////////////////////////////
+
+namespace blockCompression {
+	//False for anything that isn't a block compressed format
+	bool getBlockInfo(VkFormat format, BlockFormatInfo& info);
+
+	//Bytes of a width x height image in format, partial blocks rounded up
+	VkDeviceSize getImageSize(VkFormat format, uint32_t width, uint32_t height);
+
+	//True if decodeImage handles the format (no ASTC, no BC6H, no signed formats)
+	bool canDecode(VkFormat format);
+
+	//Tightly packed RGBA8 out, width * height * 4 bytes. Throws for formats canDecode rejects
+	void decodeImage(VkFormat format, const uint8_t* pBlocks, uint32_t width, uint32_t height, uint8_t* pRgba);
+
+	//True for the formats encodeImage writes (BC1 RGB, BC3, BC7 -- UNORM or sRGB)
+	bool canEncode(VkFormat format);
+
+	//One 4x4 block of RGBA8 texels (row major, 64 bytes) to getBlockInfo(format).blockBytes bytes
+	void encodeBlock(VkFormat format, const uint8_t* pTexels, EncodeQuality quality, uint8_t* pBlock);
+
+	//Tightly packed RGBA8 in, getImageSize bytes of blocks out. Rows of blocks are spread across
+	//pJobs' workers when given. Edge blocks repeat the last row/column. Throws for formats canEncode rejects
+	void encodeImage(VkFormat format, const uint8_t* pRgba, uint32_t width, uint32_t height, EncodeQuality quality,
+		uint8_t* pBlocks, JobSystem* pJobs = nullptr);
+}
+
+#endif // !_BLOCK_COMPRESSION_
@@ -0,0 +1,178 @@
+#include "CookedMesh.h"
+#include "Model.h"
+#include "VertexPacking.h"
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+
+#pragma region LOADING
+void CookedMesh::open(const std::string& path)
+{
+	close();
+	m_file.open(path);
+
+	const uint8_t* pData = m_file.getData();
+	const uint64_t fileSize = m_file.getSize();
+
+	if (fileSize < sizeof(CookedMeshHeader)) {
+		close();
+		throw std::runtime_error("cooked mesh is truncated: " + path);
+	}
+
+	const CookedMeshHeader* pHeader = reinterpret_cast<const CookedMeshHeader*>(pData);
+
+	if (pHeader->magic != s_cookedMeshMagic) {
+		close();
+		throw std::runtime_error("not a cooked mesh: " + path);
+	}
+	if (pHeader->version != s_cookedMeshVersion || pHeader->vertexFormat > static_cast<uint32_t>(VertexFormat::Packed) ||
+		pHeader->vertexStride != vertexPacking::getVertexStride(static_cast<VertexFormat>(pHeader->vertexFormat))) {
+		close();
+		throw std::runtime_error("cooked mesh is out of date, re-cook it: " + path);
+	}
+	if (pHeader->indexSize != 2 && pHeader->indexSize != 4) {
+		close();
+		throw std::runtime_error("cooked mesh has a bad index size: " + path);
+	}
+
+	//Blobs have to sit inside the file & be aligned -- we never copy them out to fix it up
+	const uint64_t vertexBytes = pHeader->vertexCount * pHeader->vertexStride;
+	const uint64_t indexBytes = pHeader->indexCount * pHeader->indexSize;
+	const uint64_t lodBytes = static_cast<uint64_t>(pHeader->lodCount) * sizeof(MeshLod);
+	const uint64_t meshletBytes = static_cast<uint64_t>(pHeader->meshletCount) * sizeof(Meshlet);
+	if (pHeader->vertexOffset % s_cookedBlobAlignment != 0 || pHeader->indexOffset % s_cookedBlobAlignment != 0 ||
+		pHeader->vertexOffset > fileSize || vertexBytes > fileSize - pHeader->vertexOffset ||
+		pHeader->indexOffset > fileSize || indexBytes > fileSize - pHeader->indexOffset ||
+		pHeader->lodOffset % s_cookedBlobAlignment != 0 || pHeader->lodCount == 0 ||
+		pHeader->lodOffset > fileSize || lodBytes > fileSize - pHeader->lodOffset ||
+		pHeader->meshletOffset % s_cookedBlobAlignment != 0 ||
+		pHeader->meshletOffset > fileSize || meshletBytes > fileSize - pHeader->meshletOffset ||
+		pHeader->vertexCount > UINT32_MAX || pHeader->indexCount > UINT32_MAX) {
+		close();
+		throw std::runtime_error("cooked mesh is corrupt: " + path);
+	}
+
+	//Every LOD has to index inside the blob
+	const MeshLod* pLods = reinterpret_cast<const MeshLod*>(pData + pHeader->lodOffset);
+	for (uint32_t i = 0; i < pHeader->lodCount; i++) {
+		if (pLods[i].firstIndex > pHeader->indexCount || pLods[i].indexCount > pHeader->indexCount - pLods[i].firstIndex) {
+			close();
+			throw std::runtime_error("cooked mesh is corrupt: " + path);
+		}
+	}
+
+	//...and every meshlet inside LOD 0
+	const Meshlet* pMeshlets = reinterpret_cast<const Meshlet*>(pData + pHeader->meshletOffset);
+	for (uint32_t i = 0; i < pHeader->meshletCount; i++) {
+		if (pMeshlets[i].firstIndex > pLods[0].indexCount || pMeshlets[i].indexCount > pLods[0].indexCount - pMeshlets[i].firstIndex) {
+			close();
+			throw std::runtime_error("cooked mesh is corrupt: " + path);
+		}
+	}
+
+	m_pHeader = pHeader;
+}
+#pragma endregion
+
+#pragma region COOKING
+namespace meshCooker {
+	namespace {
+		uint64_t alignUp(uint64_t value)
+		{
+			return (value + s_cookedBlobAlignment - 1) & ~(s_cookedBlobAlignment - 1);
+		}
+
+		void writePadding(std::ofstream& file, uint64_t from, uint64_t to)
+		{
+			static const char s_zeros[s_cookedBlobAlignment] = {};
+			file.write(s_zeros, static_cast<std::streamsize>(to - from));
+		}
+	}
+
+	void cookMesh(const MeshData& mesh, const std::string& path, VertexFormat format)
+	{
+		const bool smallIndices = mesh.vertices.size() <= 0xFFFF;
+		const uint32_t vertexStride = vertexPacking::getVertexStride(format);
+
+		CookedMeshHeader header = {};
+		header.magic = s_cookedMeshMagic;
+		header.version = s_cookedMeshVersion;
+		header.vertexStride = vertexStride;
+		header.indexSize = smallIndices ? 2 : 4;
+		header.vertexFormat = static_cast<uint32_t>(format);
+		header.vertexCount = mesh.vertices.size();
+		header.indexCount = mesh.indices.size();
+
+		std::vector<MeshLod> lods = mesh.lods;
+		if (lods.empty()) {
+			lods.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f });
+		}
+		header.lodCount = static_cast<uint32_t>(lods.size());
+		header.lodOffset = alignUp(sizeof(CookedMeshHeader));
+		header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		header.meshletOffset = alignUp(header.lodOffset + lods.size() * sizeof(MeshLod));
+		header.vertexOffset = alignUp(header.meshletOffset + mesh.meshlets.size() * sizeof(Meshlet));
+		header.indexOffset = alignUp(header.vertexOffset + header.vertexCount * vertexStride);
+
+		glm::vec3 boundsMin, boundsMax;
+		vertexPacking::getBounds(mesh.vertices, boundsMin, boundsMax);
+		for (int i = 0; i < 3; i++) {
+			header.boundsMin[i] = boundsMin[i];
+			header.boundsMax[i] = boundsMax[i];
+		}
+
+		//Quantized once here, the runtime only maps it
+		std::vector<PackedVertex> packed;
+		const void* pVertices = mesh.vertices.data();
+		if (format == VertexFormat::Packed) {
+			vertexPacking::packVertices(mesh, boundsMin, boundsMax, packed);
+			pVertices = packed.data();
+		}
+
+		//Same write-to-the-side & swap as the pipeline cache
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to write cooked mesh " + path);
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			writePadding(file, sizeof(header), header.lodOffset);
+
+			file.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(MeshLod));
+			writePadding(file, header.lodOffset + lods.size() * sizeof(MeshLod), header.meshletOffset);
+
+			file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+			writePadding(file, header.meshletOffset + mesh.meshlets.size() * sizeof(Meshlet), header.vertexOffset);
+
+			file.write(reinterpret_cast<const char*>(pVertices), header.vertexCount * vertexStride);
+			writePadding(file, header.vertexOffset + header.vertexCount * vertexStride, header.indexOffset);
+
+			if (smallIndices) {
+				std::vector<uint16_t> indices16(mesh.indices.begin(), mesh.indices.end());
+				file.write(reinterpret_cast<const char*>(indices16.data()), indices16.size() * sizeof(uint16_t));
+			}
+			else {
+				file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+			}
+
+			if (!file.good()) {
+				throw std::runtime_error("failed to write cooked mesh " + path);
+			}
+		}
+
+		std::remove(path.c_str());
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+			throw std::runtime_error("failed to write cooked mesh " + path);
+		}
+	}
+
+	bool isCookedPath(const std::string& path)
+	{
+		const std::string ext = ".cmesh";
+		return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+	}
+}
+#pragma endregion
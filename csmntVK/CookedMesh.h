@@ -0,0 +1,76 @@
+#pragma once
+#ifndef _COOKED_MESH_
+#define _COOKED_MESH_
+
+#include <string>
+#include <cstdint>
+#include "MappedFile.h"
+
+struct MeshData;
+struct MeshLod;
+struct Meshlet;
+enum class VertexFormat : uint32_t;
+
+//On-disk layout of a cooked mesh (.cmesh), little endian:
+//header, then the LOD table, meshlet table, vertex blob & index blob, each starting on a s_cookedBlobAlignment boundary.
+//Vertices are raw Vertex or PackedVertex structs, indices are u16 or u32 -- the blobs go straight into staging
+const uint32_t	s_cookedMeshMagic = 0x48534D43;		//"CMSH"
+const uint32_t	s_cookedMeshVersion = 4;
+const uint64_t	s_cookedBlobAlignment = 64;
+
+struct CookedMeshHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vertexStride;		//sizeof the format's vertex when cooked -- a mismatch means a stale file
+	uint32_t	indexSize;			//2 or 4
+	uint32_t	vertexFormat;		//VertexFormat
+	uint32_t	lodCount;			//MeshLods in the table, at least 1
+	uint32_t	meshletCount;		//Meshlets over LOD 0, 0 if none were built
+	uint32_t	padding;
+	uint64_t	vertexCount;
+	uint64_t	indexCount;
+	uint64_t	vertexOffset;
+	uint64_t	indexOffset;
+	uint64_t	lodOffset;
+	uint64_t	meshletOffset;
+	float		boundsMin[3];		//packed positions are quantized against these
+	float		boundsMax[3];
+};
+
+/////////////////////////////////////////////////////
+//---CookedMesh:
+//---Maps a .cmesh & validates the header, then hands out
+//---pointers into the mapping. No parsing, no copies
+/////////////////////////////////////////////////////
+
+class CookedMesh {
+public:
+	CookedMesh() {};
+	~CookedMesh() {};
+
+	//Throws on a missing, truncated or out of date file
+	void open(const std::string& path);
+	void close() { m_file.close(); m_pHeader = nullptr; };
+
+	const bool isOpen() const { return m_pHeader != nullptr; };
+	const CookedMeshHeader& getHeader() const { return *m_pHeader; };
+	const void* getVertexData() const { return m_file.getData() + m_pHeader->vertexOffset; };
+	const void* getIndexData() const { return m_file.getData() + m_pHeader->indexOffset; };
+	const MeshLod* getLods() const { return reinterpret_cast<const MeshLod*>(m_file.getData() + m_pHeader->lodOffset); };
+	const Meshlet* getMeshlets() const { return reinterpret_cast<const Meshlet*>(m_file.getData() + m_pHeader->meshletOffset); };
+
+private:
+	MappedFile				m_file;
+	const CookedMeshHeader*	m_pHeader = nullptr;
+};
+
+namespace meshCooker {
+	//Write mesh to path in the cooked format, picking 16 bit indices when they fit.
+	//A mesh without a LOD chain is written as a single LOD, meshlets are written if it has them
+	void cookMesh(const MeshData& mesh, const std::string& path, VertexFormat format);
+
+	//True for paths the cooked loader should handle
+	bool isCookedPath(const std::string& path);
+}
+
+#endif // !_COOKED_MESH_
@@ -0,0 +1,643 @@
+#include "GpuCulling.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <array>
+
+#pragma region CREATE & CLEANUP
+void GpuCulling::create(csmntVkApplication* pApp, uint32_t framesInFlight, const std::vector<GpuInstance>& instances, const std::vector<Meshlet>& clusters,
+	bool occlusionCulling)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	if (clusters.empty() || !fitsClusterDraws(instances.size(), clusters.size())) {
+		throw std::runtime_error("gpu culling needs between 1 & " + std::to_string(s_maxDrawSlots) + " instance / cluster pairs!");
+	}
+
+	m_instances = instances;
+	m_clusters = clusters;
+	m_framesInFlight = framesInFlight;
+	m_occlusionCulling = occlusionCulling;
+	m_phaseCount = m_occlusionCulling ? 2 : 1;
+	m_frameConstants.assign(m_framesInFlight, CullConstants());
+
+	//Count variant if the device has it, else draw every slot (culled ones have no instances)
+	m_multiDraw = pApp->hasMultiDrawIndirect();
+	if (pApp->hasDrawIndirectCount()) {
+		m_pfnDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+	m_useDrawCount = m_pfnDrawIndexedIndirectCount != nullptr;
+
+	//Instances -- static, straight into device local memory
+	VkDeviceSize instanceSize = std::max<VkDeviceSize>(getInstanceBufferSize(), sizeof(GpuInstance));
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), instanceSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_instanceBuffer, m_instanceBufferMemory);
+
+	if (!m_instances.empty()) {
+		pApp->getUploadContext().uploadBuffer(pApp, m_instanceBuffer, m_instances.data(), getInstanceBufferSize(), 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	//Clusters -- static too, shared by every instance
+	VkDeviceSize clusterSize = m_clusters.size() * sizeof(Meshlet);
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), clusterSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterBuffer, m_clusterBufferMemory);
+	pApp->getUploadContext().uploadBuffer(pApp, m_clusterBuffer, m_clusters.data(), clusterSize, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	//Cull constants, written straight into the mapping each frame
+	VkDeviceSize constantSize = s_constantRegionSize * m_framesInFlight;
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), constantSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_constantBuffer, m_constantBufferMemory);
+
+	//Draw commands & counts, one region per frame in flight & phase (transfer src for verify())
+	const uint32_t regionCount = m_framesInFlight * m_phaseCount;
+	VkDeviceSize drawSize = getDrawRegionStride() * regionCount;
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawBuffer, m_drawBufferMemory);
+
+	VkDeviceSize countSize = alignRegion(sizeof(uint32_t)) * regionCount;
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), countSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_countBuffer, m_countBufferMemory);
+
+	//Written by the early phase before the late one reads it, every frame
+	if (m_occlusionCulling) {
+		VkDeviceSize visibilitySize = getVisibilityRegionStride() * m_framesInFlight;
+		vkHelpers::createVkBuffer(device, pApp->getAllocator(), visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_visibilityBuffer, m_visibilityBufferMemory);
+	}
+
+	createDescriptors(device);
+	createPipeline(pApp);
+
+#if _DEBUG
+	std::cout << "HEY! gpu culling " << m_instances.size() << " instances x " << m_clusters.size() << " clusters, "
+		<< (m_useDrawCount ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirect fallback")
+		<< (m_occlusionCulling ? ", two phase occlusion culling" : "") << std::endl;
+#endif
+}
+
+void GpuCulling::createDescriptors(VkDevice& device)
+{
+	//0 = instances (read), 1 = draw commands (write), 2 = draw count, 3 = constants, 4 = clusters (read),
+	//occlusion culling: 5 = visibility, 6 = hi-z pyramid
+	const uint32_t bindingCount = m_occlusionCulling ? 7 : 5;
+	std::array<VkDescriptorSetLayoutBinding, 7> bindings = {};
+	for (uint32_t i = 0; i < bindingCount; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 3 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+			i == 6 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_vkDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+	}
+
+	//A set per frame & phase, each pointing at its own draws & count
+	const uint32_t setCount = m_framesInFlight * m_phaseCount;
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = (m_occlusionCulling ? 5 : 4) * setCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = setCount;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = setCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = m_occlusionCulling ? 3 : 2;
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = setCount;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_vkDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, m_vkDescriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_vkDescriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	m_vkDescriptorSets.resize(setCount);
+	if (vkAllocateDescriptorSets(device, &allocInfo, m_vkDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate culling descriptor sets!");
+	}
+
+	//The pyramid comes later, from setOcclusionPyramid
+	const uint32_t bufferBindingCount = m_occlusionCulling ? 6 : 5;
+
+	for (uint32_t set = 0; set < setCount; set++) {
+		const uint32_t frame = set / m_phaseCount;
+
+		std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+		bufferInfos[0].buffer = m_instanceBuffer;
+		bufferInfos[0].offset = 0;
+		bufferInfos[0].range = VK_WHOLE_SIZE;
+
+		bufferInfos[1].buffer = m_drawBuffer;
+		bufferInfos[1].offset = set * getDrawRegionStride();
+		bufferInfos[1].range = getDrawRegionStride();
+
+		bufferInfos[2].buffer = m_countBuffer;
+		bufferInfos[2].offset = set * alignRegion(sizeof(uint32_t));
+		bufferInfos[2].range = sizeof(uint32_t);
+
+		bufferInfos[3].buffer = m_constantBuffer;
+		bufferInfos[3].offset = frame * s_constantRegionSize;
+		bufferInfos[3].range = sizeof(CullConstants);
+
+		bufferInfos[4].buffer = m_clusterBuffer;
+		bufferInfos[4].offset = 0;
+		bufferInfos[4].range = VK_WHOLE_SIZE;
+
+		bufferInfos[5].buffer = m_visibilityBuffer;
+		bufferInfos[5].offset = frame * getVisibilityRegionStride();
+		bufferInfos[5].range = getVisibilityRegionStride();
+
+		std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
+		for (uint32_t i = 0; i < bufferBindingCount; i++) {
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = m_vkDescriptorSets[set];
+			descriptorWrites[i].dstBinding = i;
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorType = bindings[i].descriptorType;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(device, bufferBindingCount, descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void GpuCulling::createPipeline(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	//Constants outgrew the 128 bytes of push constants every device has, they're a uniform now.
+	//Only the phase is pushed
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_vkDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling pipeline layout!");
+	}
+
+	PipelineCache& pipelineCache = pApp->getPipelineCache();
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	//Same shader built with OCCLUSION, for the visibility & pyramid bindings
+	pipelineInfo.stage.module = pipelineCache.getShaderModule(device, m_occlusionCulling ? "../Shaders/cull_occlusion.spv" : "../Shaders/cull.spv");
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_vkPipelineLayout;
+
+	//Owned by the cache
+	m_vkPipeline = pipelineCache.getComputePipeline(device, pipelineInfo);
+}
+
+void GpuCulling::cleanup(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	//Takes the cached pipeline with it
+	pApp->getPipelineCache().releasePipelineLayout(device, m_vkPipelineLayout);
+	vkDestroyPipelineLayout(device, m_vkPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, m_vkDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_vkDescriptorSetLayout, nullptr);
+
+	if (m_visibilityBuffer != VK_NULL_HANDLE) {
+		vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_visibilityBuffer, m_visibilityBufferMemory);
+		m_visibilityBuffer = VK_NULL_HANDLE;
+	}
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_countBuffer, m_countBufferMemory);
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_drawBuffer, m_drawBufferMemory);
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_constantBuffer, m_constantBufferMemory);
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_clusterBuffer, m_clusterBufferMemory);
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_instanceBuffer, m_instanceBufferMemory);
+
+	m_vkPipelineLayout = VK_NULL_HANDLE;
+	m_vkDescriptorPool = VK_NULL_HANDLE;
+	m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	m_vkDescriptorSets.clear();
+	m_vkPipeline = VK_NULL_HANDLE;
+	m_instances.clear();
+	m_clusters.clear();
+}
+#pragma endregion
+
+#pragma region RECORDING
+void GpuCulling::setOcclusionPyramid(VkDevice& device, VkImageView view, VkSampler sampler, VkExtent2D size, uint32_t levelCount)
+{
+	m_pyramidSize = glm::vec2(static_cast<float>(size.width), static_cast<float>(size.height));
+	m_pyramidLevels = levelCount;
+
+	VkDescriptorImageInfo pyramidInfo = {};
+	pyramidInfo.sampler = sampler;
+	pyramidInfo.imageView = view;
+	pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(m_vkDescriptorSets.size());
+	for (size_t set = 0; set < m_vkDescriptorSets.size(); set++) {
+		descriptorWrites[set] = {};
+		descriptorWrites[set].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[set].dstSet = m_vkDescriptorSets[set];
+		descriptorWrites[set].dstBinding = 6;
+		descriptorWrites[set].dstArrayElement = 0;
+		descriptorWrites[set].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[set].descriptorCount = 1;
+		descriptorWrites[set].pImageInfo = &pyramidInfo;
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void GpuCulling::setFrameConstants(size_t frame, const glm::mat4& viewProj, const glm::mat4& meshTransform, const glm::vec3& cameraPosition,
+	const glm::mat4& previousViewProj, bool previousPyramid)
+{
+	CullConstants& constants = m_frameConstants[frame];
+	constants.meshTransform = meshTransform;
+	extractFrustumPlanes(viewProj, constants.frustumPlanes);
+	constants.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+	constants.instanceCount = getInstanceCount();
+	constants.clusterCount = getClusterCount();
+	constants.compact = m_useDrawCount ? 1 : 0;
+	constants.previousPyramid = m_occlusionCulling && previousPyramid ? 1 : 0;
+	constants.viewProj = viewProj;
+	constants.previousViewProj = previousViewProj;
+	constants.pyramidSize = m_pyramidSize;
+	constants.pyramidLevels = m_pyramidLevels;
+
+	//The frame's fence has already been waited on, nothing is still reading its region
+	memcpy(static_cast<uint8_t*>(m_constantBufferMemory.pMapped) + frame * s_constantRegionSize, &constants, sizeof(CullConstants));
+}
+
+void GpuCulling::recordCull(VkCommandBuffer commandBuffer, size_t frame, Phase phase)
+{
+	//Every phase's count at once, so the late cull doesn't need a fill & barrier of its own.
+	//The frame's fence has already been waited on, nothing is still reading last time's draws
+	if (phase != Phase::Late) {
+		const VkDeviceSize countStride = alignRegion(sizeof(uint32_t));
+		const VkDeviceSize countOffset = getRegion(frame, Phase::All) * countStride;
+		const VkDeviceSize countSize = countStride * (m_phaseCount - 1) + sizeof(uint32_t);
+		vkCmdFillBuffer(commandBuffer, m_countBuffer, countOffset, countSize, 0);
+
+		VkBufferMemoryBarrier clearBarrier = {};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		clearBarrier.buffer = m_countBuffer;
+		clearBarrier.offset = countOffset;
+		clearBarrier.size = countSize;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, 1, &clearBarrier, 0, nullptr);
+	}
+
+	const uint32_t phaseIndex = static_cast<uint32_t>(phase);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkPipelineLayout, 0, 1, &m_vkDescriptorSets[getRegion(frame, phase)], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_vkPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &phaseIndex);
+
+	//A thread per instance / cluster pair
+	uint32_t groupCount = (getDrawSlotCount() + s_workgroupSize - 1) / s_workgroupSize;
+	if (groupCount > 0) {
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+	}
+}
+
+void GpuCulling::recordDraw(VkCommandBuffer commandBuffer, size_t frame, Phase phase)
+{
+	const uint32_t slotCount = getDrawSlotCount();
+	const uint32_t region = getRegion(frame, phase);
+	const VkDeviceSize drawOffset = region * getDrawRegionStride();
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	if (m_useDrawCount) {
+		m_pfnDrawIndexedIndirectCount(commandBuffer, m_drawBuffer, drawOffset, m_countBuffer, region * alignRegion(sizeof(uint32_t)), slotCount, stride);
+	}
+	else if (m_multiDraw) {
+		vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffer, drawOffset, slotCount, stride);
+	}
+	else {
+		//No multi draw either -- one indirect call per slot
+		for (uint32_t i = 0; i < slotCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffer, drawOffset + i * stride, 1, stride);
+		}
+	}
+}
+#pragma endregion
+
+#pragma region FRUSTUM
+void GpuCulling::extractFrustumPlanes(const glm::mat4& viewProj, glm::vec4* pPlanes)
+{
+	//Gribb/Hartmann -- rows of the matrix (glm is column major).
+	//Near uses the -1..1 depth range our projection is built with, which is conservative for 0..1
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	pPlanes[0] = rows[3] + rows[0];		//left
+	pPlanes[1] = rows[3] - rows[0];		//right
+	pPlanes[2] = rows[3] + rows[1];		//bottom
+	pPlanes[3] = rows[3] - rows[1];		//top
+	pPlanes[4] = rows[3] + rows[2];		//near
+	pPlanes[5] = rows[3] - rows[2];		//far
+
+	for (int i = 0; i < 6; i++) {
+		pPlanes[i] /= glm::length(glm::vec3(pPlanes[i]));
+	}
+}
+
+bool GpuCulling::isVisible(const glm::vec4* pPlanes, const glm::vec4& sphere, bool& ambiguous)
+{
+	//Same test as cull.comp -- ambiguous when a plane is too close to call given float differences
+	bool visible = true;
+	ambiguous = false;
+	for (int i = 0; i < 6; i++) {
+		float distance = glm::dot(glm::vec3(pPlanes[i]), glm::vec3(sphere)) + pPlanes[i].w + sphere.w;
+		visible = visible && distance > 0.0f;
+		ambiguous = ambiguous || std::abs(distance) < 1e-4f * (1.0f + std::abs(sphere.w));
+	}
+	return visible;
+}
+
+bool GpuCulling::isClusterVisible(const CullConstants& constants, const GpuInstance& instance, const Meshlet& cluster, bool& ambiguous)
+{
+	//Same tests as cull.comp -- the instance first, then the cluster's own sphere & cone
+	bool instanceAmbiguous = false;
+	if (!isVisible(constants.frustumPlanes, instance.boundingSphere, instanceAmbiguous)) {
+		ambiguous = instanceAmbiguous;
+		return false;
+	}
+
+	const glm::mat4 toWorld = instance.model * constants.meshTransform;
+	const glm::vec4 sphere = getClusterSphere(constants, instance, cluster);
+	const glm::vec3 centre = glm::vec3(sphere);
+	const float radius = sphere.w;
+
+	bool sphereAmbiguous = false;
+	bool visible = isVisible(constants.frustumPlanes, glm::vec4(centre, radius), sphereAmbiguous);
+
+	const glm::vec3 axis = glm::normalize(glm::mat3(toWorld) * glm::vec3(cluster.cone));
+	const glm::vec3 view = centre - glm::vec3(constants.cameraPosition);
+	const float viewLength = glm::length(view);
+	const float facing = cluster.cone.w * (viewLength + radius) + radius - glm::dot(view, axis);
+	visible = visible && facing > 0.0f;
+
+	ambiguous = instanceAmbiguous || sphereAmbiguous || std::abs(facing) < 1e-4f * (1.0f + viewLength + radius);
+	return visible;
+}
+
+glm::vec4 GpuCulling::getClusterSphere(const CullConstants& constants, const GpuInstance& instance, const Meshlet& cluster)
+{
+	const glm::mat4 toWorld = instance.model * constants.meshTransform;
+	const float scale = std::max({ glm::length(glm::vec3(toWorld[0])), glm::length(glm::vec3(toWorld[1])), glm::length(glm::vec3(toWorld[2])) });
+	return glm::vec4(glm::vec3(toWorld * glm::vec4(glm::vec3(cluster.boundingSphere), 1.0f)), cluster.boundingSphere.w * scale);
+}
+
+bool GpuCulling::isOccluded(const CullConstants& constants, const glm::vec4& sphere, const std::vector<float>& pyramidDepths, bool& ambiguous)
+{
+	//cull.comp's box, but against every level 0 texel under it rather than the 2x2 of whichever level fits.
+	//A level only ever holds the farthest of the texels under it, so anything the GPU hid is hidden here too
+	ambiguous = false;
+	glm::vec2 uvMin = glm::vec2(1.0f);
+	glm::vec2 uvMax = glm::vec2(0.0f);
+	float nearest = 1.0f;
+	for (int c = 0; c < 8; c++) {
+		const glm::vec3 corner = glm::vec3(sphere) + sphere.w * glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+		const glm::vec4 clip = constants.viewProj * glm::vec4(corner, 1.0f);
+		ambiguous = ambiguous || std::abs(clip.w) < 1e-5f || std::abs(clip.z) < 1e-5f * (1.0f + std::abs(clip.w));
+		if (clip.w <= 0.0f || clip.z < 0.0f) {
+			return false;
+		}
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		uvMin = glm::min(uvMin, glm::vec2(ndc) * 0.5f + 0.5f);
+		uvMax = glm::max(uvMax, glm::vec2(ndc) * 0.5f + 0.5f);
+		nearest = std::min(nearest, ndc.z);
+	}
+
+	//Texels the box only just reaches could go either way on the GPU, so only those it's well into count
+	const float margin = 1e-3f;
+	const glm::ivec2 size = glm::ivec2(constants.pyramidSize);
+	const glm::ivec2 lo = glm::clamp(glm::ivec2(glm::floor(glm::clamp(uvMin, 0.0f, 1.0f) * constants.pyramidSize + margin)), glm::ivec2(0), size - 1);
+	const glm::ivec2 hi = glm::clamp(glm::ivec2(glm::floor(glm::clamp(uvMax, 0.0f, 1.0f) * constants.pyramidSize - margin)), glm::ivec2(0), size - 1);
+	if (hi.x < lo.x || hi.y < lo.y) {
+		ambiguous = true;
+		return false;
+	}
+
+	float farthest = 0.0f;
+	for (int32_t y = lo.y; y <= hi.y; y++) {
+		for (int32_t x = lo.x; x <= hi.x; x++) {
+			farthest = std::max(farthest, pyramidDepths[static_cast<size_t>(y) * size.x + x]);
+		}
+	}
+
+	ambiguous = ambiguous || std::abs(nearest - farthest) < 1e-5f;
+	return nearest > farthest;
+}
+
+glm::vec4 GpuCulling::transformBoundingSphere(const glm::mat4& model, float radius)
+{
+	glm::vec3 centre = glm::vec3(model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+	return glm::vec4(centre, radius * scale);
+}
+
+Meshlet GpuCulling::getWholeMeshCluster(uint32_t indexCount, float boundingRadius)
+{
+	Meshlet cluster = {};
+	cluster.boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, boundingRadius);
+	cluster.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	cluster.firstIndex = 0;
+	cluster.indexCount = indexCount;
+	return cluster;
+}
+#pragma endregion
+
+#pragma region VERIFY
+bool GpuCulling::verify(csmntVkApplication* pApp, size_t frame, const std::vector<float>& pyramidDepths)
+{
+	VkDevice& device = pApp->getVkDevice();
+	const uint32_t instanceCount = getInstanceCount();
+	const uint32_t clusterCount = getClusterCount();
+	const uint32_t pairCount = getDrawSlotCount();
+	const VkDeviceSize drawRegionSize = std::max<VkDeviceSize>(getDrawRegionSize(), sizeof(VkDrawIndexedIndirectCommand));
+	const VkDeviceSize countStride = alignRegion(sizeof(uint32_t));
+
+	//Each phase's count, then each phase's draws, into one host visible buffer
+	VkBuffer readback;
+	vkHelpers::Allocation readbackMemory;
+	VkDeviceSize readbackSize = (sizeof(uint32_t) + drawRegionSize) * m_phaseCount;
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readback, readbackMemory);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = pApp->getQueueFamilyIndices().graphicsFamily.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling readback command pool!");
+	}
+
+	VkCommandBuffer commandBuffer = vkHelpers::beginSingleTimeCommands(commandPool, device);
+
+	const uint32_t firstRegion = getRegion(frame, Phase::All);
+	const VkDeviceSize drawsOffset = sizeof(uint32_t) * m_phaseCount;
+	for (uint32_t phase = 0; phase < m_phaseCount; phase++) {
+		std::array<VkBufferCopy, 2> regions = {};
+		regions[0].srcOffset = (firstRegion + phase) * countStride;
+		regions[0].dstOffset = phase * sizeof(uint32_t);
+		regions[0].size = sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, m_countBuffer, readback, 1, &regions[0]);
+
+		regions[1].srcOffset = (firstRegion + phase) * getDrawRegionStride();
+		regions[1].dstOffset = drawsOffset + phase * drawRegionSize;
+		regions[1].size = drawRegionSize;
+		vkCmdCopyBuffer(commandBuffer, m_drawBuffer, readback, 1, &regions[1]);
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = readback;
+	barrier.offset = 0;
+	barrier.size = readbackSize;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	vkHelpers::endSingleTimeCommands(commandBuffer, pApp->getGraphicsQueue(), device, commandPool);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+
+	std::vector<uint32_t> gpuCounts(m_phaseCount);
+	memcpy(gpuCounts.data(), readbackMemory.pMapped, sizeof(uint32_t) * m_phaseCount);
+	std::vector<VkDrawIndexedIndirectCommand> draws(static_cast<size_t>(pairCount) * m_phaseCount);
+	for (uint32_t phase = 0; phase < m_phaseCount; phase++) {
+		memcpy(draws.data() + static_cast<size_t>(phase) * pairCount,
+			static_cast<const uint8_t*>(readbackMemory.pMapped) + drawsOffset + phase * drawRegionSize, getDrawRegionSize());
+	}
+
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), readback, readbackMemory);
+
+	//What the GPU kept -- packed draws when counted, else every slot with an instance.
+	//Clusters are sorted by firstIndex, so a draw's range finds its cluster. No pair may be drawn by both phases
+	std::vector<uint8_t> gpuVisible(pairCount, 0);
+	uint32_t errors = 0, gpuCount = 0, lateCount = 0;
+
+	for (uint32_t phase = 0; phase < m_phaseCount; phase++) {
+		const uint32_t slotCount = m_useDrawCount ? std::min(gpuCounts[phase], pairCount) : pairCount;
+		gpuCount += gpuCounts[phase];
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			const VkDrawIndexedIndirectCommand& draw = draws[static_cast<size_t>(phase) * pairCount + i];
+			if (draw.instanceCount == 0) {
+				continue;
+			}
+
+			auto cluster = std::lower_bound(m_clusters.begin(), m_clusters.end(), draw.firstIndex,
+				[](const Meshlet& m, uint32_t firstIndex) { return m.firstIndex < firstIndex; });
+			if (cluster == m_clusters.end() || cluster->firstIndex != draw.firstIndex || cluster->indexCount != draw.indexCount ||
+				draw.instanceCount != 1 || draw.vertexOffset != 0 || draw.firstInstance >= instanceCount) {
+				errors++;
+				continue;
+			}
+
+			const uint32_t pair = draw.firstInstance * clusterCount + static_cast<uint32_t>(cluster - m_clusters.begin());
+			if (gpuVisible[pair]) {
+				errors++;
+				continue;
+			}
+			gpuVisible[pair] = 1;
+			lateCount += phase;
+		}
+	}
+
+	//CPU reference, same constants the frame was culled with. What the GPU hides that the CPU draws has to be
+	//behind the pyramid the late phase re-tested it against -- anything else was culled for no reason
+	const CullConstants& constants = m_frameConstants[frame];
+	if (m_occlusionCulling && pyramidDepths.size() != static_cast<size_t>(constants.pyramidSize.x) * static_cast<size_t>(constants.pyramidSize.y)) {
+		throw std::runtime_error("hi-z pyramid read back doesn't match the culling pyramid size!");
+	}
+
+	uint32_t cpuCount = 0, cpuSureCount = 0, cpuCulledCount = 0, ambiguousCount = 0, mismatches = 0, occludedCount = 0, overCulledCount = 0;
+	for (uint32_t i = 0; i < pairCount; i++) {
+		bool ambiguous;
+		bool visible = isClusterVisible(constants, m_instances[i / clusterCount], m_clusters[i % clusterCount], ambiguous);
+		cpuCount += visible ? 1 : 0;
+		cpuSureCount += (visible && !ambiguous) ? 1 : 0;
+		cpuCulledCount += (!visible && !ambiguous) ? 1 : 0;
+
+		if (ambiguous) {
+			ambiguousCount++;
+		}
+		else if (m_occlusionCulling && visible && !gpuVisible[i]) {
+			bool occlusionAmbiguous;
+			const glm::vec4 sphere = getClusterSphere(constants, m_instances[i / clusterCount], m_clusters[i % clusterCount]);
+			if (isOccluded(constants, sphere, pyramidDepths, occlusionAmbiguous)) {
+				occludedCount++;
+			}
+			else if (occlusionAmbiguous) {
+				ambiguousCount++;
+			}
+			else {
+				overCulledCount++;
+			}
+		}
+		else if (visible != (gpuVisible[i] != 0)) {
+			mismatches++;
+		}
+	}
+
+	uint32_t gpuVisibleCount = static_cast<uint32_t>(std::count(gpuVisible.begin(), gpuVisible.end(), 1));
+	bool countMatches = gpuCount == gpuVisibleCount;
+
+	//A scene that's all in view (or all out of it) passes whatever the shader does -- no check at all
+	const bool coversBothSides = cpuSureCount > 0 && cpuCulledCount > 0;
+
+	std::cout << "gpu culling check (" << (m_useDrawCount ? "draw count" : "fallback") << "): " << gpuVisibleCount << "/" << pairCount
+		<< " clusters visible on the GPU (" << instanceCount << " instances x " << clusterCount << "), " << cpuCount << " on the CPU, "
+		<< mismatches << " mismatches, " << errors << " bad draws, " << ambiguousCount << " too close to call"
+		<< (countMatches ? "" : ", draw count disagrees")
+		<< (coversBothSides ? "" : ", scene needs clusters both in & out of view (try more --draws)") << std::endl;
+	if (m_occlusionCulling) {
+		std::cout << "occlusion culling: " << occludedCount << " hidden behind the pyramid, " << overCulledCount << " hidden in front of it, "
+			<< lateCount << " drawn by the late phase"
+			<< (constants.previousPyramid ? "" : " (no previous pyramid, early phase didn't test)") << std::endl;
+	}
+
+	return mismatches == 0 && overCulledCount == 0 && errors == 0 && countMatches && coversBothSides;
+}
+#pragma endregion
@@ -0,0 +1,184 @@
+#pragma once
+#ifndef _GPU_CULLING_
+#define _GPU_CULLING_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <algorithm>
+#include "vkMemoryAllocator.h"
+#include "Model.h"
+#include "../Libraries/glm/glm.hpp"
+
+class csmntVkApplication;
+
+//Per instance data the cull shader & vertex shader read (std430, matches cull.comp / shader_indirect.vert)
+struct GpuInstance {
+	glm::mat4	model;
+	glm::vec4	boundingSphere;		//world space centre & radius
+	uint32_t	textureIndex;
+	uint32_t	padding[3];
+};
+
+/////////////////////////////////////////////////////
+//---GpuCulling:
+//---GPU driven draws. Instances & the mesh's clusters live in
+//---storage buffers, a compute pass culls every instance /
+//---cluster pair each frame (frustum, then the cluster's
+//---normal cone against the camera) & writes a
+//---VkDrawIndexedIndirectCommand per survivor, covering just
+//---that cluster's index range (+ a count). They're drawn with
+//---vkCmdDrawIndexedIndirectCount -- or plain
+//---vkCmdDrawIndexedIndirect over every pair, culled ones
+//---zeroed out, where the count variant is missing.
+//---A mesh without meshlets is one cluster, i.e. per instance
+//---culling. CPU cost per frame doesn't depend on either count.
+//---With occlusion culling every frame culls twice: the early
+//---phase also tests against last frame's hi-z pyramid & draws
+//---what passes, the late phase re-tests what it hid against
+//---the pyramid those draws built & draws what shows up. The
+//---two have their own draws & counts
+/////////////////////////////////////////////////////
+
+class GpuCulling {
+public:
+	//Matches cull.comp
+	enum class Phase : uint32_t {
+		All = 0,		//no occlusion culling, the one pass
+		Early,
+		Late
+	};
+
+	GpuCulling() {};
+	~GpuCulling() {};
+
+	//Instances & clusters are uploaded through the app's UploadContext -- flush before the first frame.
+	//Clusters must be sorted by firstIndex & not overlap, see getWholeMeshCluster for meshes without meshlets.
+	//Occlusion culling needs setOcclusionPyramid before the first frame
+	void create(csmntVkApplication*, uint32_t framesInFlight, const std::vector<GpuInstance>&, const std::vector<Meshlet>& clusters,
+		bool occlusionCulling = false);
+	void cleanup(csmntVkApplication*);
+
+	//The hi-z pyramid both phases read in SHADER_READ_ONLY_OPTIMAL, with every level in view.
+	//Again whenever it's recreated, with no frame in flight
+	void setOcclusionPyramid(VkDevice&, VkImageView, VkSampler, VkExtent2D size, uint32_t levelCount);
+
+	//Once per frame before its culls: viewProj's frustum & the camera. meshTransform takes mesh space into the
+	//space the instances' model matrices expect. previousViewProj is what last frame's pyramid was built with,
+	//previousPyramid whether there is one worth testing against (not on the first frame or after a resize)
+	void setFrameConstants(size_t frame, const glm::mat4& viewProj, const glm::mat4& meshTransform, const glm::vec3& cameraPosition,
+		const glm::mat4& previousViewProj = glm::mat4(1.0f), bool previousPyramid = false);
+	//Outside a render pass: cull into the phase's draws, All & Early clearing every phase's count first.
+	//Writes the draw, count & visibility buffers (& reads the pyramid) -- whoever uses them next owns the barrier in between
+	void recordCull(VkCommandBuffer, size_t frame, Phase = Phase::All);
+	//Inside the render pass, with the graphics pipeline, buffers & sets bound
+	void recordDraw(VkCommandBuffer, size_t frame, Phase = Phase::All);
+
+	//Reads the frame's draws back & checks them against culling on the CPU (device must be idle).
+	//With occlusion culling the GPU may only drop more, & only what's behind pyramidDepths -- the
+	//pyramid's level 0 (HiZPyramid::readLevel0) as the frame's late phase tested against it
+	bool verify(csmntVkApplication*, size_t frame, const std::vector<float>& pyramidDepths);
+
+	const VkBuffer& getInstanceBuffer() const { return m_instanceBuffer; };
+	const VkBuffer& getDrawBuffer() const { return m_drawBuffer; };
+	const VkBuffer& getCountBuffer() const { return m_countBuffer; };
+	const VkBuffer& getVisibilityBuffer() const { return m_visibilityBuffer; };
+	const bool isOcclusionCulling() const { return m_occlusionCulling; };
+	const VkDeviceSize getInstanceBufferSize() const { return m_instances.size() * sizeof(GpuInstance); };
+	const uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); };
+	const uint32_t getClusterCount() const { return static_cast<uint32_t>(m_clusters.size()); };
+	const bool usesDrawCount() const { return m_useDrawCount; };
+
+	//World space bounding sphere of an object space sphere about the origin
+	static glm::vec4 transformBoundingSphere(const glm::mat4& model, float radius);
+
+	//The whole index range as one cluster that never backface culls
+	static Meshlet getWholeMeshCluster(uint32_t indexCount, float boundingRadius);
+	//Whether a draw slot per instance / cluster pair stays within the draw buffer's budget
+	static bool fitsClusterDraws(size_t instanceCount, size_t clusterCount) { return instanceCount * clusterCount <= s_maxDrawSlots; };
+
+private:
+	//std140 uniform, one region per frame (matches cull.comp)
+	struct CullConstants {
+		glm::mat4	meshTransform;
+		glm::vec4	frustumPlanes[6];
+		glm::vec4	cameraPosition;
+		uint32_t	instanceCount;
+		uint32_t	clusterCount;
+		uint32_t	compact;		//1 = visible draws packed & counted, 0 = one slot per pair
+		uint32_t	previousPyramid;
+		glm::mat4	viewProj;
+		glm::mat4	previousViewProj;
+		glm::vec2	pyramidSize;
+		uint32_t	pyramidLevels;
+		uint32_t	padding;
+	};
+
+	static void extractFrustumPlanes(const glm::mat4& viewProj, glm::vec4* pPlanes);
+	static bool isVisible(const glm::vec4* pPlanes, const glm::vec4& sphere, bool& ambiguous);
+	static bool isClusterVisible(const CullConstants&, const GpuInstance&, const Meshlet&, bool& ambiguous);
+	static glm::vec4 getClusterSphere(const CullConstants&, const GpuInstance&, const Meshlet&);
+	static bool isOccluded(const CullConstants&, const glm::vec4& sphere, const std::vector<float>& pyramidDepths, bool& ambiguous);
+
+	void createDescriptors(VkDevice&);
+	void createPipeline(csmntVkApplication*);
+
+	const uint32_t getDrawSlotCount() const { return getInstanceCount() * getClusterCount(); };
+	const VkDeviceSize getDrawRegionSize() const { return static_cast<VkDeviceSize>(getDrawSlotCount()) * sizeof(VkDrawIndexedIndirectCommand); };
+	//Storage buffer regions are bound at multiples of these
+	const VkDeviceSize getDrawRegionStride() const { return alignRegion(std::max<VkDeviceSize>(getDrawRegionSize(), sizeof(VkDrawIndexedIndirectCommand))); };
+	const VkDeviceSize getVisibilityRegionStride() const { return alignRegion(static_cast<VkDeviceSize>(getDrawSlotCount()) * sizeof(uint32_t)); };
+	//Draws & counts per frame, then per phase
+	const uint32_t getRegion(size_t frame, Phase phase) const { return static_cast<uint32_t>(frame) * m_phaseCount + (phase == Phase::Late ? 1 : 0); };
+	static VkDeviceSize alignRegion(VkDeviceSize size) { return (size + s_regionAlignment - 1) / s_regionAlignment * s_regionAlignment; };
+
+	std::vector<GpuInstance>	m_instances;	//kept for the CPU reference
+	std::vector<Meshlet>		m_clusters;
+	uint32_t					m_framesInFlight = 0;
+	bool						m_occlusionCulling = false;
+	uint32_t					m_phaseCount = 1;
+
+	VkBuffer					m_instanceBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_instanceBufferMemory;
+	VkBuffer					m_clusterBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_clusterBufferMemory;
+
+	//Host visible, rewritten by recordCull once the frame's fence is signalled
+	VkBuffer					m_constantBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_constantBufferMemory;
+
+	//One region per frame in flight & phase
+	VkBuffer					m_drawBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_drawBufferMemory;
+	VkBuffer					m_countBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_countBufferMemory;
+	//Occlusion culling -- what the early phase made of each pair, for the late one. A region per frame
+	VkBuffer					m_visibilityBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_visibilityBufferMemory;
+
+	VkDescriptorSetLayout		m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool			m_vkDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_vkDescriptorSets;		//per region
+	VkPipelineLayout			m_vkPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline					m_vkPipeline = VK_NULL_HANDLE;
+
+	bool						m_useDrawCount = false;
+	bool						m_multiDraw = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_pfnDrawIndexedIndirectCount = nullptr;
+
+	//Occlusion culling -- the pyramid's level 0 & level count, for the constants
+	glm::vec2					m_pyramidSize = glm::vec2(0.0f);
+	uint32_t					m_pyramidLevels = 0;
+
+	//What each frame was culled against, for verify()
+	std::vector<CullConstants>	m_frameConstants;
+
+	static const uint32_t		s_workgroupSize = 64;
+	//A multiple of the largest minUniformBufferOffsetAlignment the spec allows, so any device can bind each frame's region
+	static const VkDeviceSize	s_constantRegionSize = 512;
+	//Largest minStorageBufferOffsetAlignment the spec allows, same for the storage regions
+	static const VkDeviceSize	s_regionAlignment = 256;
+	//20MB of draws per frame -- past that a mesh is culled per instance only
+	static const uint32_t		s_maxDrawSlots = 1 << 20;
+};
+
+#endif // !_GPU_CULLING_
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <set>
 #include <algorithm>
+#include <cmath>
 
 #ifndef _vk_details_h
 #define _vk_details_h
@@ -22,7 +23,8 @@
 #include "uniformBuffer.h"
 
 #pragma region CTOR & DTOR
-csmntVkGraphics::csmntVkGraphics()
+csmntVkGraphics::csmntVkGraphics(uint32_t framesInFlight)
+	: m_MAX_FRAMES_IN_FLIGHT(std::max(1u, framesInFlight))
 {
 #if _DEBUG
 	std::cout << "HEY! csmntVK Graphics Module Created" << std::endl;
@@ -40,37 +42,140 @@ csmntVkGraphics::~csmntVkGraphics()
 #pragma region INIT & SHUTDOWN
 void csmntVkGraphics::initGraphicsModule(csmntVkApplication* pApp, SwapChainSupportDetails& swapChainSupport)
 {
-	//Create models
-	m_pModel = new Model();
+	m_headless = pApp->isHeadless();
+	m_bindless = pApp->isBindlessEnabled();
+	m_gpuDriven = pApp->isGpuDrivenEnabled();
+
+	//Asked for but can't work with the rest -- said whatever the build, or a benchmark quietly measures
+	//something other than what it was given. Features that are only on by default go without a word
+	auto dropRequested = [](bool& feature, bool keep, const char* pMessage) {
+		if (feature && !keep) {
+			std::cerr << pMessage << std::endl;
+		}
+		feature = feature && keep;
+	};
+
+	//GPU driven draws are already instanced
+	dropRequested(m_instanced, !m_gpuDriven, "--instanced ignored, GPU driven draws are already instanced");
+	//...and keep their texture slots on the GPU, where streaming can't repoint them
+	m_textureStreaming = m_textureBudget > 0;
+	dropRequested(m_textureStreaming, !m_gpuDriven, "--texture-budget ignored, GPU driven draws don't stream textures, loading them whole");
+	//...and the mesh's bounds & index count too, so they wait for their assets here
+	dropRequested(m_asyncAssets, !m_gpuDriven, "--async-assets ignored, GPU driven draws wait for the mesh before the first frame");
+	m_lodSelection = m_lodSelection && !m_gpuDriven;
+	//Clusters only pay off where the GPU culls them
+	m_clusterCulling = m_clusterCulling && m_gpuDriven;
+	//...& occlusion culling & the prepass draw from its indirect draws
+	m_occlusionCulling = m_occlusionCulling && m_gpuDriven;
+	dropRequested(m_depthPrepass, m_gpuDriven, "--depth-prepass ignored, it draws from GPU driven indirect draws (--gpu-driven)");
+	//...which makes the CPU's redundant
+	dropRequested(m_cpuOcclusionCulling, !m_gpuDriven, "--cpu-occlusion-cull ignored, GPU driven draws are occlusion culled on the GPU");
+
+	//Decoding starts first, it overlaps everything up to the uploads
+	startAssetLoads(pApp);
 
 	//Create all required functionality for graphics pipeline
 	createSwapChain(pApp, swapChainSupport);
 	createImageViews(pApp->getVkDevice());
+	createOcclusionBuffer();
 
-	createRenderPass(pApp);
+	buildRenderGraph(pApp);
 
 	createDescriptorSetLayout(pApp->getVkDevice());
+	if (m_bindless) {
+		m_bindlessTextures.create(pApp, pApp->getMaxBindlessTextures(), m_MAX_FRAMES_IN_FLIGHT);
+	}
+	createPipelineLayout(pApp->getVkDevice());
 
-	createPipeline(pApp->getVkDevice());
-
-	createCommandPool(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), pApp->getVkSurfaceKHR());
-
-	//Depth Buffer
-	createDepthResources(pApp);
+	createPipelines(pApp);
 
-	createFramebuffers(pApp->getVkDevice());
+	createCommandPools(pApp);
 
 	//Textures
 	createTexture(pApp);
 	createTextureSampler(pApp);
 
-	createVertexBuffer(pApp);
-	createIndexBuffer(pApp);
+	//Bindless: textures get a slot in the table instead of a binding per set
+	if (m_bindless) {
+		for (uint32_t i = 0; i < getTextureCount(); i++) {
+			m_textureSlots.push_back(m_bindlessTextures.addTexture(pApp->getVkDevice(), getTextureView(i), m_linearTexSampler));
+		}
+		m_slotTextureVersions.assign(m_textureSlots.size(), 0);
+	}
+	else {
+		m_frameTextureVersions.assign(m_MAX_FRAMES_IN_FLIGHT, 0);
+	}
+
+	//Create models -- built-in quads unless a mesh file was given, which they stand in for while it loads
+	if (m_modelLoad.valid() && !m_asyncAssets) {
+		m_pModel = m_modelLoad.get().release();
+	}
+	else {
+		m_pModel = new Model(m_vertexFormat);
+	}
+
+	createVertexBuffer(pApp, *m_pModel, m_vkVertexBuffer, m_vkVertexBufferMemory);
+	createIndexBuffer(pApp, *m_pModel, m_vkIndexBuffer, m_vkIndexBufferMemory);
+	m_vkIndexCount = m_pModel->getLod(0).indexCount;
+	m_vkIndexType = m_pModel->getIndexType();
+
+	//Geometry is in staging now, drop the CPU copy / file mapping -- occluders keep their own
+	if (m_cpuOcclusionCulling) {
+		captureOccluderMesh(*m_pModel, m_occluderMesh);
+	}
+	m_pModel->releaseSourceData();
+
+	//Per draw transforms, each gets its own UBO in the ring
+	createDrawList();
+
+	//GPU driven: the draw list becomes instances the compute pass culls every frame,
+	//a cluster at a time when the mesh has meshlets & the draw slots fit
+	if (m_gpuDriven) {
+		std::vector<GpuInstance> instances(m_drawList.size());
+		for (size_t i = 0; i < m_drawList.size(); i++) {
+			instances[i].model = m_drawList[i].model;
+			instances[i].boundingSphere = GpuCulling::transformBoundingSphere(m_drawList[i].model, m_pModel->getBoundingRadius());
+			instances[i].textureIndex = m_drawList[i].textureIndex;
+		}
+
+		std::vector<Meshlet> clusters;
+		if (m_clusterCulling && GpuCulling::fitsClusterDraws(instances.size(), m_pModel->getMeshlets().size())) {
+			clusters = m_pModel->getMeshlets();
+		}
+#if _DEBUG
+		else if (m_clusterCulling) {
+			std::cout << "HEY! " << instances.size() << " instances x " << m_pModel->getMeshlets().size()
+				<< " meshlets is too many draw slots, culling per instance" << std::endl;
+		}
+#endif
+		m_clusterCulling = !clusters.empty();
+		if (clusters.empty()) {
+			clusters.push_back(GpuCulling::getWholeMeshCluster(m_vkIndexCount, m_pModel->getBoundingRadius()));
+		}
+		m_gpuCulling.create(pApp, m_MAX_FRAMES_IN_FLIGHT, instances, clusters, m_occlusionCulling);
+		if (m_occlusionCulling) {
+			m_gpuCulling.setOcclusionPyramid(pApp->getVkDevice(), m_hiZ.getView(), m_hiZ.getSampler(), m_hiZ.getExtent(), m_hiZ.getLevelCount());
+		}
+	}
+
+	//Texture & mesh uploads go out in a single submit
+	pApp->getUploadContext().flush(pApp);
+
 	createUniformBuffers(pApp);
 
+	//Instanced: the draw list is streamed into binding 1 every frame
+	if (m_instanced) {
+		m_instanceBuffer.create(pApp, m_MAX_FRAMES_IN_FLIGHT, std::max(m_MIN_INSTANCES_PER_FRAME, static_cast<uint32_t>(m_drawList.size())));
+		m_instanceScratch.reserve(m_drawList.size());
+	}
+
 	createDescriptorPool(pApp->getVkDevice());
 	createDescriptorSets(pApp->getVkDevice());
 
+	if (m_headless) {
+		createReadbackBuffer(pApp);
+	}
+
 	createCommandBuffers(pApp->getVkDevice());
 
 	createSemaphoresAndFences(pApp->getVkDevice());
@@ -78,23 +183,39 @@ void csmntVkGraphics::initGraphicsModule(csmntVkApplication* pApp, SwapChainSupp
 
 void csmntVkGraphics::shutdown(csmntVkApplication* pApp)
 {
-	cleanupSwapChain(pApp->getVkDevice());
+	cleanupSwapChain(pApp);
 
 	vkDestroyDescriptorPool(pApp->getVkDevice(), m_vkDescriptorPool, nullptr);
 
 	vkDestroyDescriptorSetLayout(pApp->getVkDevice(), m_vkDescriptorSetLayout, nullptr);
 
-	for (size_t i = 0; i < m_vkSwapChainImages.size(); i++) {
-		vkDestroyBuffer(pApp->getVkDevice(), m_uniformBuffers[i], nullptr);
-		vkFreeMemory(pApp->getVkDevice(), m_uniformBuffersMemory[i], nullptr);
+	if (m_bindless) {
+		m_bindlessTextures.cleanup(pApp);
+		m_textureSlots.clear();
+	}
+
+	if (m_gpuDriven) {
+		m_gpuCulling.cleanup(pApp);
+	}
+
+	//Pipelines themselves belong to the pipeline cache, which drops them with the layout
+	pApp->getPipelineCache().releasePipelineLayout(pApp->getVkDevice(), m_vkPipelineLayout);
+	vkDestroyPipelineLayout(pApp->getVkDevice(), m_vkPipelineLayout, nullptr);
+
+	m_uniformRing.cleanup(pApp);
+
+	if (m_instanced) {
+		m_instanceBuffer.cleanup(pApp);
+	}
+
+	if (m_readbackBuffer != VK_NULL_HANDLE) {
+		vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_readbackBuffer, m_readbackBufferMemory);
 	}
 
 	//buffers
-	vkDestroyBuffer(pApp->getVkDevice(), m_vkIndexBuffer, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), m_vkIndexBufferMemory, nullptr);
+	vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_vkIndexBuffer, m_vkIndexBufferMemory);
 
-	vkDestroyBuffer(pApp->getVkDevice(), m_vkVertexBuffer, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), m_vkVertexBufferMemory, nullptr);
+	vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_vkVertexBuffer, m_vkVertexBufferMemory);
 
 	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroySemaphore(pApp->getVkDevice(), m_vkRenderFinishedSemaphores[i], nullptr);
@@ -102,7 +223,7 @@ void csmntVkGraphics::shutdown(csmntVkApplication* pApp)
 		vkDestroyFence(pApp->getVkDevice(), m_vkInFlightFences[i], nullptr);
 	}
 
-	vkDestroyCommandPool(pApp->getVkDevice(), m_vkCommandPool, nullptr);
+	destroyCommandPools(pApp->getVkDevice());
 
 	//Cleanup Models
 	if (m_pModel)
@@ -113,6 +234,7 @@ void csmntVkGraphics::shutdown(csmntVkApplication* pApp)
 
 	vkDestroySampler(pApp->getVkDevice(), m_linearTexSampler, nullptr);
 
+	cleanupAssetLoads(pApp);
 	cleanupTexture(pApp);
 }
 #pragma endregion
@@ -123,12 +245,12 @@ void csmntVkGraphics::createDescriptorSetLayout(VkDevice& device)
 	//uniform buffers
 	VkDescriptorSetLayoutBinding uboLayoutBinding = {};
 	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-	//image sampler
+	//image sampler (bindless keeps its textures in a set of their own)
 	VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
 	samplerLayoutBinding.binding = 1;
 	samplerLayoutBinding.descriptorCount = 1;
@@ -136,8 +258,23 @@ void csmntVkGraphics::createDescriptorSetLayout(VkDevice& device)
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+	//GPU driven: the vertex shader fetches its instance's transform
+	VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+	instanceLayoutBinding.binding = 2;
+	instanceLayoutBinding.descriptorCount = 1;
+	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	instanceLayoutBinding.pImmutableSamplers = nullptr;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
 	//create the layout info
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+	std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding };
+	if (!m_bindless) {
+		bindings.push_back(samplerLayoutBinding);
+	}
+	if (m_gpuDriven) {
+		bindings.push_back(instanceLayoutBinding);
+	}
+
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -150,58 +287,125 @@ void csmntVkGraphics::createDescriptorSetLayout(VkDevice& device)
 
 void csmntVkGraphics::createDescriptorSets(VkDevice& device)
 {
-	std::vector<VkDescriptorSetLayout> layouts(m_vkSwapChainImages.size(), m_vkDescriptorSetLayout);
+	//One set per frame in flight -- they're recorded per frame now, not per swap chain image
+	std::vector<VkDescriptorSetLayout> layouts(m_MAX_FRAMES_IN_FLIGHT, m_vkDescriptorSetLayout);
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = m_vkDescriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(m_vkSwapChainImages.size());
+	allocInfo.descriptorSetCount = m_MAX_FRAMES_IN_FLIGHT;
 	allocInfo.pSetLayouts = layouts.data();
 
-	m_vkDescriptorSets.resize(m_vkSwapChainImages.size());
+	m_vkDescriptorSets.resize(m_MAX_FRAMES_IN_FLIGHT);
 	if (vkAllocateDescriptorSets(device, &allocInfo, m_vkDescriptorSets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < m_vkSwapChainImages.size(); i++) {
+	for (size_t i = 0; i < m_vkDescriptorSets.size(); i++) {
 		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = m_uniformBuffers[i];
+		//dynamic offsets pick the ring region (and object) at bind time
+		bufferInfo.buffer = m_uniformRing.getVkBuffer();
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
 		VkDescriptorImageInfo imageInfo = {};
 		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = m_pTexture->getVkImageView();
+		imageInfo.imageView = getTextureView(0);
 		imageInfo.sampler = m_linearTexSampler;
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
-
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = m_vkDescriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
+		VkDescriptorBufferInfo instanceInfo = {};
+		instanceInfo.buffer = m_gpuCulling.getInstanceBuffer();
+		instanceInfo.offset = 0;
+		instanceInfo.range = VK_WHOLE_SIZE;
+
+		std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+		VkWriteDescriptorSet uboWrite = {};
+		uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		uboWrite.dstSet = m_vkDescriptorSets[i];
+		uboWrite.dstBinding = 0;
+		uboWrite.dstArrayElement = 0;
+		uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		uboWrite.descriptorCount = 1;
+		uboWrite.pBufferInfo = &bufferInfo;
+		descriptorWrites.push_back(uboWrite);
+
+		if (!m_bindless) {
+			VkWriteDescriptorSet samplerWrite = {};
+			samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			samplerWrite.dstSet = m_vkDescriptorSets[i];
+			samplerWrite.dstBinding = 1;
+			samplerWrite.dstArrayElement = 0;
+			samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			samplerWrite.descriptorCount = 1;
+			samplerWrite.pImageInfo = &imageInfo;
+			descriptorWrites.push_back(samplerWrite);
+		}
 
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = m_vkDescriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+		if (m_gpuDriven) {
+			VkWriteDescriptorSet instanceWrite = {};
+			instanceWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			instanceWrite.dstSet = m_vkDescriptorSets[i];
+			instanceWrite.dstBinding = 2;
+			instanceWrite.dstArrayElement = 0;
+			instanceWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			instanceWrite.descriptorCount = 1;
+			instanceWrite.pBufferInfo = &instanceInfo;
+			descriptorWrites.push_back(instanceWrite);
+		}
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
 
-void csmntVkGraphics::createPipeline(VkDevice& device)
+void csmntVkGraphics::createPipelineLayout(VkDevice& device)
 {
-	auto vertShaderCode = vkHelpers::readFile("../Shaders/vert.spv");
-	auto fragShaderCode = vkHelpers::readFile("../Shaders/frag.spv");
+	//Pipeline Layout -- only depends on the descriptor set layout, so it outlives swap chain recreation
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_vkDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
+	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+
+	//Bindless: set 1 is the texture table, the draw's texture index is a push constant
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { m_vkDescriptorSetLayout, m_bindlessTextures.getDescriptorSetLayout() };
 
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, &device);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, &device);
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	if (m_bindless) {
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	}
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+}
+
+void csmntVkGraphics::createPipelines(csmntVkApplication* pApp)
+{
+	m_vkGraphicsPipeline = createPipeline(pApp);
+	if (m_depthPrepass) {
+		m_vkDepthPipeline = createPipeline(pApp, true);
+	}
+}
+
+VkPipeline csmntVkGraphics::createPipeline(csmntVkApplication* pApp, bool depthOnly)
+{
+	PipelineCache& pipelineCache = pApp->getPipelineCache();
+
+	//Modules are cached by path, so repeat lookups hand back the same handles
+	//GPU driven draws read their transform (& texture index) from the instance buffer,
+	//instanced ones from binding 1. Both hand the fragment shader a flat texture index
+	VkShaderModule vertShaderModule = pipelineCache.getShaderModule(pApp->getVkDevice(),
+		m_gpuDriven ? "../Shaders/vert_indirect.spv" : m_instanced ? "../Shaders/vert_instanced.spv" : "../Shaders/vert.spv");
+	VkShaderModule fragShaderModule = pipelineCache.getShaderModule(pApp->getVkDevice(),
+		!m_bindless ? "../Shaders/frag.spv" : (m_gpuDriven || m_instanced) ? "../Shaders/frag_bindless_indirect.spv" : "../Shaders/frag_bindless.spv");
 
 	//Vertex Shader
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
@@ -225,15 +429,31 @@ void csmntVkGraphics::createPipeline(VkDevice& device)
 	//Store Stages
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	//Vertex Input - from Model Vertex format
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	//Vertex Input - from Model Vertex format, plus InstanceData on binding 1 when instanced
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	if (m_vertexFormat == VertexFormat::Packed) {
+		auto vertexAttributes = PackedVertex::getAttributeDescriptions();
+		bindingDescriptions.push_back(PackedVertex::getBindingDescription());
+		attributeDescriptions.assign(vertexAttributes.begin(), vertexAttributes.end());
+	}
+	else {
+		auto vertexAttributes = Vertex::getAttributeDescriptions();
+		bindingDescriptions.push_back(Vertex::getBindingDescription());
+		attributeDescriptions.assign(vertexAttributes.begin(), vertexAttributes.end());
+	}
+
+	if (m_instanced) {
+		auto instanceAttributes = InstanceData::getAttributeDescriptions();
+		bindingDescriptions.push_back(InstanceData::getBindingDescription());
+		attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+	}
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -241,26 +461,14 @@ void csmntVkGraphics::createPipeline(VkDevice& device)
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	//Define a Viewport
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)m_vkSwapChainExtent.width;
-	viewport.height = (float)m_vkSwapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	//Scissor rect
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = m_vkSwapChainExtent;
-
+	//Viewport & scissor are dynamic (set when recording), so the pipeline
+	//doesn't depend on the swap chain extent and survives a resize
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
 
 	//Rasteriser
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
@@ -324,7 +532,7 @@ void csmntVkGraphics::createPipeline(VkDevice& device)
 	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colorBlending.logicOpEnable = VK_FALSE;
 	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
+	colorBlending.attachmentCount = depthOnly ? 0 : 1;
 	colorBlending.pAttachments = &colorBlendAttachment;
 	colorBlending.blendConstants[0] = 0.0f; // Optional
 	colorBlending.blendConstants[1] = 0.0f; // Optional
@@ -334,42 +542,32 @@ void csmntVkGraphics::createPipeline(VkDevice& device)
 	//A limited amount of the state that we've specified in the previous structs 
 	//can actually be changed without recreating the pipeline. Examples are the 
 	//size of the viewport, line width and blend constants.
-	/*VkDynamicState dynamicStates[] = {
-    VK_DYNAMIC_STATE_VIEWPORT,
-    VK_DYNAMIC_STATE_LINE_WIDTH
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
 	};
 
 	VkPipelineDynamicStateCreateInfo dynamicState = {};
 	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dynamicStates;*/
+	dynamicState.pDynamicStates = dynamicStates;
 
 	//Depth Stencil
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
 	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	//After a prepass the scene's nearest surfaces are already in, at exactly their depth
+	depthStencil.depthCompareOp = (m_depthPrepass && !depthOnly) ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.0f; // Optional
 	depthStencil.maxDepthBounds = 1.0f; // Optional
 
-	//Pipeline Layout
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &m_vkDescriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout!");
-	}
-
 	//Create the pipeline object
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
+	//Depth only -- no fragment shader, depth comes out of the rasteriser
+	pipelineInfo.stageCount = depthOnly ? 1 : 2;
 	pipelineInfo.pStages = shaderStages;
 
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -379,125 +577,178 @@ void csmntVkGraphics::createPipeline(VkDevice& device)
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr; // Optional
+	pipelineInfo.pDynamicState = &dynamicState;
 
 	pipelineInfo.layout = m_vkPipelineLayout;
 
-	pipelineInfo.renderPass = m_vkRenderPass;
+	pipelineInfo.renderPass = m_renderGraph.getRenderPass(depthOnly ? m_prepassPass : m_scenePass);
 	pipelineInfo.subpass = 0;
 
 	//Single pipeline
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_vkGraphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create graphics pipeline!");
-	}
-
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	//Built through the on-disk VkPipelineCache, identical create infos are only built once
+	return pipelineCache.getGraphicsPipeline(pApp->getVkDevice(), pipelineInfo);
 }
 
-void csmntVkGraphics::createRenderPass(csmntVkApplication* pApp)
+void csmntVkGraphics::buildRenderGraph(csmntVkApplication* pApp)
 {
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = m_vkSwapChainImageFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	//Subpasses
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	//Subpass Dependency - make the render pass wait for the VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT stage
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	//Depth
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.format = findDepthFormat(pApp->getVkPhysicalDevice());
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference depthAttachmentRef = {};
-	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	//Subpass
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-	subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-	//Create the pass
-	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-	renderPassInfo.pAttachments = attachments.data();
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(pApp->getVkDevice(), &renderPassInfo, nullptr, &m_vkRenderPass) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create render pass!");
+	//Swap chain images are ready once the acquire semaphore's wait at colour output is through.
+	//Offscreen targets are only read back after their fence, so nothing to wait on
+	if (m_headless) {
+		m_backbuffer = m_renderGraph.importImage("offscreen target", m_vkSwapChainImageFormat, m_vkSwapChainExtent,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+	else {
+		m_backbuffer = m_renderGraph.importImage("swap chain image", m_vkSwapChainImageFormat, m_vkSwapChainExtent,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 	}
-}
 
-void csmntVkGraphics::createFramebuffers(VkDevice& device)
-{
-	m_vkSwapChainFramebuffers.resize(m_vkSwapChainImageViews.size());
-
-	for (size_t i = 0; i < m_vkSwapChainImageViews.size(); i++) {
-		
-		std::array<VkImageView, 2> attachments = {
-			m_vkSwapChainImageViews[i],
-			m_vkDepthImageView
-		};
-
-		VkFramebufferCreateInfo framebufferInfo = {};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = m_vkRenderPass;
-		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebufferInfo.pAttachments = attachments.data();
-		framebufferInfo.width = m_vkSwapChainExtent.width;
-		framebufferInfo.height = m_vkSwapChainExtent.height;
-		framebufferInfo.layers = 1;
-
-		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_vkSwapChainFramebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create framebuffer!");
+	//Never loaded or stored -- lazily allocated where the device has such memory. Unless something
+	//reads it after the pass that draws it: the hi-z build samples it, the scene loads the prepass'
+	RenderGraph::Resource depth = m_renderGraph.createImage("depth", findDepthFormat(pApp->getVkPhysicalDevice(), m_occlusionCulling), m_vkSwapChainExtent);
+
+	VkClearValue clearColor = {};
+	clearColor.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+	VkClearValue clearDepth = {};
+	clearDepth.depthStencil = { 1.0f, 0 };
+
+	//GPU driven: cull into the indirect draws first. With occlusion culling the early cull tests against last
+	//frame's pyramid & its survivors are drawn (or laid down by the prepass), the pyramid is rebuilt from that
+	//depth, & the late cull re-tests what the early one hid -- the scene draws both phases' survivors
+	std::vector<GpuCulling::Phase> scenePhases = { GpuCulling::Phase::All };
+	if (m_gpuDriven) {
+		m_cullDraws = m_renderGraph.importBuffer("indirect draws");
+		m_cullCount = m_renderGraph.importBuffer("draw count");
+
+		const GpuCulling::Phase firstPhase = m_occlusionCulling ? GpuCulling::Phase::Early : GpuCulling::Phase::All;
+		if (m_occlusionCulling) {
+			m_hiZ.create(pApp, m_vkSwapChainExtent, m_MAX_FRAMES_IN_FLIGHT);
+			m_hiZBuilt = false;
+
+			//Left the way the late cull reads it, which is how the next frame's early cull wants it
+			m_pyramid = m_renderGraph.importImage("hi-z pyramid", HiZPyramid::s_format, m_hiZ.getExtent(),
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			m_cullVisibility = m_renderGraph.importBuffer("cull visibility");
 		}
+
+		RenderGraph::Pass cullPass = m_renderGraph.addPass(m_occlusionCulling ? "early cull" : "gpu cull", RenderGraph::PassType::Compute,
+			[this, firstPhase](VkCommandBuffer commandBuffer, size_t frame) {
+			m_gpuCulling.recordCull(commandBuffer, frame, firstPhase);
+		});
+		m_renderGraph.write(cullPass, m_cullDraws, RenderGraph::Usage::Storage);
+		m_renderGraph.write(cullPass, m_cullCount, RenderGraph::Usage::Storage);
+		if (m_occlusionCulling) {
+			m_renderGraph.read(cullPass, m_pyramid, RenderGraph::Usage::Sampled);
+			m_renderGraph.write(cullPass, m_cullVisibility, RenderGraph::Usage::Storage);
+		}
+
+		if (m_depthPrepass) {
+			m_prepassPass = m_renderGraph.addPass("depth prepass", RenderGraph::PassType::Graphics, [this, firstPhase](VkCommandBuffer commandBuffer, size_t frame) {
+				recordIndirectDraws(commandBuffer, frame, m_vkDepthPipeline, { firstPhase });
+			});
+			m_renderGraph.setDepthAttachment(m_prepassPass, depth, &clearDepth);
+			m_renderGraph.read(m_prepassPass, m_cullDraws, RenderGraph::Usage::Indirect);
+			m_renderGraph.read(m_prepassPass, m_cullCount, RenderGraph::Usage::Indirect);
+		}
+
+		if (m_occlusionCulling) {
+			//No prepass -- the early survivors are shaded straight away, the scene pass adds the late ones
+			if (!m_depthPrepass) {
+				RenderGraph::Pass earlyPass = m_renderGraph.addPass("scene early", RenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer, size_t frame) {
+					recordIndirectDraws(commandBuffer, frame, m_vkGraphicsPipeline, { GpuCulling::Phase::Early });
+				});
+				m_renderGraph.addColorAttachment(earlyPass, m_backbuffer, &clearColor);
+				m_renderGraph.setDepthAttachment(earlyPass, depth, &clearDepth);
+				m_renderGraph.read(earlyPass, m_cullDraws, RenderGraph::Usage::Indirect);
+				m_renderGraph.read(earlyPass, m_cullCount, RenderGraph::Usage::Indirect);
+			}
+
+			RenderGraph::Pass hiZPass = m_renderGraph.addPass("hi-z", RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer, size_t frame) {
+				m_hiZ.recordBuild(commandBuffer, frame);
+			});
+			m_renderGraph.read(hiZPass, depth, RenderGraph::Usage::Sampled);
+			m_renderGraph.write(hiZPass, m_pyramid, RenderGraph::Usage::Storage);
+
+			RenderGraph::Pass latePass = m_renderGraph.addPass("late cull", RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer, size_t frame) {
+				m_gpuCulling.recordCull(commandBuffer, frame, GpuCulling::Phase::Late);
+			});
+			m_renderGraph.read(latePass, m_pyramid, RenderGraph::Usage::Sampled);
+			m_renderGraph.read(latePass, m_cullVisibility, RenderGraph::Usage::Storage);
+			m_renderGraph.write(latePass, m_cullDraws, RenderGraph::Usage::Storage);
+			m_renderGraph.write(latePass, m_cullCount, RenderGraph::Usage::Storage);
+
+			scenePhases = m_depthPrepass ? std::vector<GpuCulling::Phase>{ GpuCulling::Phase::Early, GpuCulling::Phase::Late } :
+				std::vector<GpuCulling::Phase>{ GpuCulling::Phase::Late };
+		}
+	}
+
+	m_scenePass = m_renderGraph.addPass("scene", RenderGraph::PassType::Graphics, [this, scenePhases](VkCommandBuffer commandBuffer, size_t frame) {
+		if (m_gpuDriven) {
+			recordIndirectDraws(commandBuffer, frame, m_vkGraphicsPipeline, scenePhases);
+		}
+		else if (m_instanced) {
+			recordInlineDraws(commandBuffer, frame);
+		}
+		else if (!m_frameSecondaries.empty()) {
+			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(m_frameSecondaries.size()), m_frameSecondaries.data());
+		}
+	});
+
+	//Whatever drew before the scene pass is kept
+	const bool earlyScene = m_occlusionCulling && !m_depthPrepass;
+	m_renderGraph.addColorAttachment(m_scenePass, m_backbuffer, earlyScene ? nullptr : &clearColor);
+	m_renderGraph.setDepthAttachment(m_scenePass, depth, (earlyScene || m_depthPrepass) ? nullptr : &clearDepth);
+
+	if (m_gpuDriven) {
+		m_renderGraph.read(m_scenePass, m_cullDraws, RenderGraph::Usage::Indirect);
+		m_renderGraph.read(m_scenePass, m_cullCount, RenderGraph::Usage::Indirect);
+	}
+	//Draw list frames come from the secondaries
+	if (!m_gpuDriven && !m_instanced) {
+		m_renderGraph.setSubpassContents(m_scenePass, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	}
+
+	//Headless -- copy the finished target into its readback slice, visible to the host once the fence signals
+	if (m_headless) {
+		m_readback = m_renderGraph.importBuffer("readback", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+		RenderGraph::Pass readbackPass = m_renderGraph.addPass("readback", RenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer, size_t frame) {
+			//Offscreen targets map 1:1 onto frames in flight
+			VkBufferImageCopy region = {};
+			region.bufferOffset = frame * m_readbackSliceSize;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { m_vkSwapChainExtent.width, m_vkSwapChainExtent.height, 1 };
+
+			vkCmdCopyImageToBuffer(commandBuffer, m_renderGraph.getImage(m_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				m_renderGraph.getBuffer(m_readback), 1, &region);
+		});
+		m_renderGraph.read(readbackPass, m_backbuffer, RenderGraph::Usage::Transfer);
+		m_renderGraph.write(readbackPass, m_readback, RenderGraph::Usage::Transfer);
+	}
+
+	m_renderGraph.compile(pApp);
+
+	//The depth image is new with every compile
+	if (m_occlusionCulling) {
+		m_hiZ.setDepthView(pApp->getVkDevice(), m_renderGraph.getImageView(depth));
 	}
 }
 
-void csmntVkGraphics::createCommandPool(VkDevice& device, VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface)
+void csmntVkGraphics::createCommandPools(csmntVkApplication* pApp)
 {
-	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice, surface);
+	const QueueFamilyIndices& queueFamilyIndices = pApp->getQueueFamilyIndices();
 
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-	poolInfo.flags = 0; // Optional
 
 	//VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: 
 	//Hint that command buffers are rerecorded with new commands very often 
@@ -506,146 +757,386 @@ void csmntVkGraphics::createCommandPool(VkDevice& device, VkPhysicalDevice& phys
 	//Allow command buffers to be rerecorded individually, without this flag 
 	//they all have to be reset together
 	//(https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Command_buffers)
+	//Everything is re-recorded every frame and each pool is reset as a whole
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	const uint32_t workerCount = pApp->getJobSystem().getWorkerCount();
 
-	if (vkCreateCommandPool(device, &poolInfo, nullptr, &m_vkCommandPool) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create command pool!");
+	//Primary pool per frame in flight, plus one per worker per frame for the
+	//secondaries -- pools aren't thread safe, and a frame's pools can only be
+	//reset once the GPU is done with it
+	m_vkFrameCommandPools.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_workerCommandPools.resize(m_MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t frame = 0; frame < m_MAX_FRAMES_IN_FLIGHT; frame++) {
+		if (vkCreateCommandPool(pApp->getVkDevice(), &poolInfo, nullptr, &m_vkFrameCommandPools[frame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+
+		m_workerCommandPools[frame].resize(workerCount);
+		for (WorkerCommandPool& workerPool : m_workerCommandPools[frame]) {
+			if (vkCreateCommandPool(pApp->getVkDevice(), &poolInfo, nullptr, &workerPool.pool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create worker command pool!");
+			}
+		}
 	}
 }
 
-void csmntVkGraphics::createVertexBuffer(csmntVkApplication* pApp)
+void csmntVkGraphics::destroyCommandPools(VkDevice& device)
 {
-	//Vertices from models
-	const std::vector<Vertex> verts = m_pModel->getVertices();
+	//Destroying a pool frees its command buffers
+	for (size_t frame = 0; frame < m_vkFrameCommandPools.size(); frame++) {
+		vkDestroyCommandPool(device, m_vkFrameCommandPools[frame], nullptr);
 
-	VkDeviceSize bufferSize = sizeof(verts[0]) * verts.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT 
-		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		for (WorkerCommandPool& workerPool : m_workerCommandPools[frame]) {
+			vkDestroyCommandPool(device, workerPool.pool, nullptr);
+		}
+	}
+
+	m_vkFrameCommandPools.clear();
+	m_workerCommandPools.clear();
+	m_vkCommandBuffers.clear();
+}
 
-	void* data;
-	vkMapMemory(pApp->getVkDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, verts.data(), (size_t)bufferSize);
-	vkUnmapMemory(pApp->getVkDevice(), stagingBufferMemory);
+void csmntVkGraphics::createVertexBuffer(csmntVkApplication* pApp, const Model& model, VkBuffer& buffer, vkHelpers::Allocation& memory)
+{
+	//Vertices from models
+	VkDeviceSize bufferSize = model.getVertexDataSize();
 
-	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT
-		| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vkVertexBuffer, m_vkVertexBufferMemory);
-	vkHelpers::copyVkBuffer(pApp, stagingBuffer, m_vkVertexBuffer, bufferSize, m_vkCommandPool);
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
 
-	vkDestroyBuffer(pApp->getVkDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), stagingBufferMemory, nullptr);
+	//Staged & recorded into the current upload batch
+	pApp->getUploadContext().uploadBuffer(pApp, buffer, model.getVertexData(), bufferSize, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
-void csmntVkGraphics::createIndexBuffer(csmntVkApplication* pApp)
+void csmntVkGraphics::createIndexBuffer(csmntVkApplication* pApp, const Model& model, VkBuffer& buffer, vkHelpers::Allocation& memory)
 {
 	//indices from model
-	const std::vector<uint16_t> indices = m_pModel->getIndices();
-	m_vkIndexCount = indices.size();
+	VkDeviceSize bufferSize = model.getIndexDataSize();
 
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		| VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	pApp->getUploadContext().uploadBuffer(pApp, buffer, model.getIndexData(), bufferSize, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+}
 
-	void* data;
-	vkMapMemory(pApp->getVkDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(pApp->getVkDevice(), stagingBufferMemory);
+void csmntVkGraphics::createUniformBuffers(csmntVkApplication* pApp) {
+	//One ring region per frame in flight, big enough for a UBO per draw (256 covers any minUniformBufferOffsetAlignment).
+	//GPU driven & instanced frames only push the one shared UBO
+	VkDeviceSize drawUniforms = (m_gpuDriven || m_instanced) ? 1 : static_cast<VkDeviceSize>(m_drawList.size());
+	VkDeviceSize regionSize = std::max<VkDeviceSize>(m_UNIFORM_REGION_SIZE, drawUniforms * 256);
+	m_uniformRing.create(pApp, m_MAX_FRAMES_IN_FLIGHT, regionSize);
+}
 
-	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT
-		| VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vkIndexBuffer, m_vkIndexBufferMemory);
+void csmntVkGraphics::createDrawList()
+{
+	//Lay the model out on a square grid, shrunk so the whole grid fits where one model would.
+	//GPU driven spreads it wider than the view so the culling has something to do
+	uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_drawCount))));
+	float scale = 1.0f / gridSize;
+	float spread = m_gpuDriven ? 3.0f : 1.0f;
+
+	m_drawList.resize(m_drawCount);
+	for (uint32_t i = 0; i < m_drawCount; i++) {
+		float x = (gridSize > 1) ? (((i % gridSize) + 0.5f) * scale * 2.0f - 1.0f) * spread : 0.0f;
+		float y = (gridSize > 1) ? (((i / gridSize) + 0.5f) * scale * 2.0f - 1.0f) * spread : 0.0f;
+
+		m_drawList[i].model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f)), glm::vec3(scale));
+		m_drawList[i].uniformOffset = 0;
+		m_drawList[i].lod = 0;
+		m_drawList[i].visible = true;
+		//Round robin over whatever is in the table
+		m_drawList[i].textureIndex = m_textureSlots.empty() ? 0 : m_textureSlots[i % m_textureSlots.size()];
+	}
+}
 
-	vkHelpers::copyVkBuffer(pApp, stagingBuffer, m_vkIndexBuffer, bufferSize, m_vkCommandPool);
+void csmntVkGraphics::createCommandBuffers(VkDevice& device)
+{
+	//One primary per frame in flight, re-recorded every frame
+	m_vkCommandBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t frame = 0; frame < m_MAX_FRAMES_IN_FLIGHT; frame++) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_vkFrameCommandPools[frame];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		//VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, 
+		//but cannot be called from other command buffers.
+		//VK_COMMAND_BUFFER_LEVEL_SECONDARY: Cannot be submitted directly, but can be 
+		//called from primary command buffers.
+		//(https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Command_buffers)
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &m_vkCommandBuffers[frame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+	}
+}
+
+VkCommandBuffer csmntVkGraphics::acquireSecondaryCommandBuffer(VkDevice& device, size_t frame, uint32_t worker)
+{
+	WorkerCommandPool& workerPool = m_workerCommandPools[frame][worker];
+
+	//Buffers are kept across frames, the pool reset puts them back in the initial state
+	if (workerPool.used == workerPool.secondaries.size()) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = workerPool.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		workerPool.secondaries.push_back(commandBuffer);
+	}
 
-	vkDestroyBuffer(pApp->getVkDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), stagingBufferMemory, nullptr);
+	return workerPool.secondaries[workerPool.used++];
 }
 
-void csmntVkGraphics::createUniformBuffers(csmntVkApplication* pApp) {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+void csmntVkGraphics::recordDrawRange(VkCommandBuffer commandBuffer, size_t frame, VkFramebuffer framebuffer, uint32_t firstDraw, uint32_t drawCount)
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = m_renderGraph.getRenderPass(m_scenePass);
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
 
-	m_uniformBuffers.resize(m_vkSwapChainImages.size());
-	m_uniformBuffersMemory.resize(m_vkSwapChainImages.size());
+	//Secondaries inherit no state -- bind everything again
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
 
-	for (size_t i = 0; i < m_vkSwapChainImages.size(); i++) {
-		vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			m_uniformBuffers[i], m_uniformBuffersMemory[i]);
+	//Dynamic viewport & scissor cover the whole swap chain image
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)m_vkSwapChainExtent.width;
+	viewport.height = (float)m_vkSwapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = m_vkSwapChainExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	//Drawing -- offsets for gathering multiple buffers and drawing
+	VkBuffer vertexBuffers[] = { m_vkVertexBuffer };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_vkIndexBuffer, 0, m_vkIndexType);
+
+	//Every texture in one bind, draws just pick an index
+	if (m_bindless) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
+			1, 1, &m_bindlessTextures.getDescriptorSet(), 0, nullptr);
+	}
+
+	for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++) {
+		if (!m_drawList[i].visible) {
+			continue;
+		}
+
+		//each draw's UBO sits at its own dynamic offset in this frame's ring region
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
+			0, 1, &m_vkDescriptorSets[frame], 1, &m_drawList[i].uniformOffset);
+
+		if (m_bindless) {
+			vkCmdPushConstants(commandBuffer, m_vkPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &m_drawList[i].textureIndex);
+		}
+
+		const MeshLod& lod = m_pModel->getLod(m_drawList[i].lod);
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record secondary command buffer!");
 	}
 }
 
-void csmntVkGraphics::createCommandBuffers(VkDevice& device)
+void csmntVkGraphics::submitInstances(const InstanceData* pInstances, uint32_t count, uint32_t lod)
 {
-	m_vkCommandBuffers.resize(m_vkSwapChainFramebuffers.size());
-
-	//Clear values
-	std::array<VkClearValue, 2> clearValues = {};
-	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-	clearValues[1].depthStencil = { 1.0f, 0 };
-
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = m_vkCommandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t)m_vkCommandBuffers.size();
-
-	//VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, 
-	//but cannot be called from other command buffers.
-	//VK_COMMAND_BUFFER_LEVEL_SECONDARY: Cannot be submitted directly, but can be 
-	//called from primary command buffers.
-	//(https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Command_buffers)
+	if (count == 0) {
+		return;
+	}
+
+	InstanceBatch batch;
+	batch.firstInstance = m_instanceBuffer.push(pInstances, count);
+	batch.instanceCount = count;
+	batch.lod = lod;
+	m_instanceBatches.push_back(batch);
+}
+
+void csmntVkGraphics::bindInlineDrawState(VkCommandBuffer commandBuffer, size_t frame, VkPipeline pipeline)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)m_vkSwapChainExtent.width;
+	viewport.height = (float)m_vkSwapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
 
-	if (vkAllocateCommandBuffers(device, &allocInfo, m_vkCommandBuffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate command buffers!");
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = m_vkSwapChainExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	//Instances sit on binding 1, every region in the one buffer -- firstInstance picks the frame's
+	VkBuffer vertexBuffers[] = { m_vkVertexBuffer, m_instanceBuffer.getVkBuffer() };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, m_instanced ? 2 : 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_vkIndexBuffer, 0, m_vkIndexType);
+
+	//One bind for the whole frame -- the instance index comes from each draw's firstInstance
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
+		0, 1, &m_vkDescriptorSets[frame], 1, &m_frameUniformOffset);
+
+	if (m_bindless) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
+			1, 1, &m_bindlessTextures.getDescriptorSet(), 0, nullptr);
 	}
+}
 
-	//Record comand buffers
-	for (size_t i = 0; i < m_vkCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-		beginInfo.pInheritanceInfo = nullptr; // Optional
+void csmntVkGraphics::recordIndirectDraws(VkCommandBuffer commandBuffer, size_t frame, VkPipeline pipeline, const std::vector<GpuCulling::Phase>& phases)
+{
+	bindInlineDrawState(commandBuffer, frame, pipeline);
+	for (GpuCulling::Phase phase : phases) {
+		m_gpuCulling.recordDraw(commandBuffer, frame, phase);
+	}
+}
 
-		if (vkBeginCommandBuffer(m_vkCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+void csmntVkGraphics::recordInlineDraws(VkCommandBuffer commandBuffer, size_t frame)
+{
+	bindInlineDrawState(commandBuffer, frame, m_vkGraphicsPipeline);
 
-		//Render Pass
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = m_vkRenderPass;
-		renderPassInfo.framebuffer = m_vkSwapChainFramebuffers[i];
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = m_vkSwapChainExtent;
+	//N instances of one LOD of the model per vkCmdDrawIndexed
+	for (const InstanceBatch& batch : m_instanceBatches) {
+		const MeshLod& lod = m_pModel->getLod(batch.lod);
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, batch.instanceCount, lod.firstIndex, 0, batch.firstInstance);
+	}
+}
 
-		//Clear to clear values
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+bool csmntVkGraphics::verifyGpuCulling(csmntVkApplication* pApp)
+{
+	if (!m_gpuDriven) {
+		std::cout << "gpu culling check skipped, GPU driven rendering isn't enabled" << std::endl;
+		return true;
+	}
 
-		vkCmdBeginRenderPass(m_vkCommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	//Last submitted frame, once the device is done with it
+	vkDeviceWaitIdle(pApp->getVkDevice());
+	size_t lastFrame = (m_currentFrame + m_MAX_FRAMES_IN_FLIGHT - 1) % m_MAX_FRAMES_IN_FLIGHT;
+	//Only one pyramid, so it's still the one that frame's late phase culled against
+	std::vector<float> pyramidDepths;
+	if (m_occlusionCulling) {
+		m_hiZ.readLevel0(pApp, pyramidDepths);
+	}
+	return m_gpuCulling.verify(pApp, lastFrame, pyramidDepths);
+}
 
-		vkCmdBindPipeline(m_vkCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
+bool csmntVkGraphics::verifyBindlessRecycling(csmntVkApplication* pApp)
+{
+	if (!m_bindless || getTextureCount() == 0) {
+		std::cout << "bindless slot recycling check skipped, no bindless textures" << std::endl;
+		return true;
+	}
 
-		//Drawing -- offsets for gathering multiple buffers and drawing
-		VkBuffer vertexBuffers[] = { m_vkVertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(m_vkCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(m_vkCommandBuffers[i], m_vkIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+	//The check steps the table's frames along for real, so nothing may still be in flight
+	vkDeviceWaitIdle(pApp->getVkDevice());
+	return m_bindlessTextures.verifySlotRecycling(pApp->getVkDevice(), getTextureView(0), m_linearTexSampler);
+}
 
-		vkCmdBindDescriptorSets(m_vkCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
-			0, 1, &m_vkDescriptorSets[i], 0, nullptr);
+void csmntVkGraphics::recordCommandBuffer(csmntVkApplication* pApp, size_t frame, uint32_t imageIndex)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-		//vkCmdDraw(m_vkCommandBuffers[i], static_cast<uint32_t>(m_pModel->getVertices().size()), 1, 0, 0);
-		vkCmdDrawIndexed(m_vkCommandBuffers[i], static_cast<uint32_t>(m_vkIndexCount), 1, 0, 0, 0);
+	VkDevice& device = pApp->getVkDevice();
+	JobSystem& jobSystem = pApp->getJobSystem();
 
-		vkCmdEndRenderPass(m_vkCommandBuffers[i]);
+	//The frame's fence has signalled, so everything recorded from its pools is done with
+	vkResetCommandPool(device, m_vkFrameCommandPools[frame], 0);
+	for (WorkerCommandPool& workerPool : m_workerCommandPools[frame]) {
+		vkResetCommandPool(device, workerPool.pool, 0);
+		workerPool.used = 0;
+	}
 
-		if (vkEndCommandBuffer(m_vkCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	//This frame's images & buffers into the graph, before the jobs inherit its framebuffer
+	m_renderGraph.setImage(m_backbuffer, m_vkSwapChainImages[imageIndex], m_vkSwapChainImageViews[imageIndex]);
+	if (m_gpuDriven) {
+		m_renderGraph.setBuffer(m_cullDraws, m_gpuCulling.getDrawBuffer());
+		m_renderGraph.setBuffer(m_cullCount, m_gpuCulling.getCountBuffer());
+		m_gpuCulling.setFrameConstants(frame, m_frameViewProj, m_frameMeshTransform, m_frameCameraPosition, m_previousViewProj, m_hiZBuilt);
 	}
+	if (m_occlusionCulling) {
+		m_renderGraph.setImage(m_pyramid, m_hiZ.getImage(), m_hiZ.getView());
+		m_renderGraph.setBuffer(m_cullVisibility, m_gpuCulling.getVisibilityBuffer());
+	}
+	if (m_headless) {
+		m_renderGraph.setBuffer(m_readback, m_readbackBuffer);
+	}
+	VkFramebuffer framebuffer = m_renderGraph.getFramebuffer(m_scenePass);
+
+	//Split the draw list into jobs, each recorded into its own secondary on whichever worker picks it up.
+	//GPU driven & instanced frames are a handful of commands whatever the draw count, no jobs needed
+	const uint32_t drawCount = (m_gpuDriven || m_instanced) ? 0 : static_cast<uint32_t>(m_drawList.size());
+	const uint32_t jobCount = (drawCount + m_DRAWS_PER_JOB - 1) / m_DRAWS_PER_JOB;
+	m_frameSecondaries.resize(jobCount);
+
+	jobSystem.parallelFor(jobCount, [&](uint32_t job, uint32_t worker) {
+		uint32_t firstDraw = job * m_DRAWS_PER_JOB;
+		uint32_t count = std::min(m_DRAWS_PER_JOB, drawCount - firstDraw);
+
+		VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(device, frame, worker);
+		recordDrawRange(commandBuffer, frame, framebuffer, firstDraw, count);
+
+		//keep submission order == draw list order, whoever recorded it
+		m_frameSecondaries[job] = commandBuffer;
+	});
+
+	VkCommandBuffer commandBuffer = m_vkCommandBuffers[frame];
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = nullptr; // Optional
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+
+	//Culling, the scene & the readback, with whatever barriers lie between them
+	m_renderGraph.execute(commandBuffer, frame);
+
+	//The next frame's early cull tests against the pyramid this one builds, seen the way this one saw it
+	m_previousViewProj = m_frameViewProj;
+	m_hiZBuilt = m_occlusionCulling;
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+
+	m_recordStats.totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	++m_recordStats.frames;
 }
 
 void csmntVkGraphics::createSemaphoresAndFences(VkDevice& device)
@@ -672,8 +1163,14 @@ void csmntVkGraphics::createSemaphoresAndFences(VkDevice& device)
 	}
 }
 
-void csmntVkGraphics::createSwapChain(csmntVkApplication* pApp, SwapChainSupportDetails& swapChainSupport)
+void csmntVkGraphics::createSwapChain(csmntVkApplication* pApp, SwapChainSupportDetails& swapChainSupport, VkSwapchainKHR oldSwapChain)
 {
+	//No surface to present to, render into our own images instead
+	if (m_headless) {
+		createOffscreenTargets(pApp);
+		return;
+	}
+
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, pApp->getWindow());
@@ -699,7 +1196,7 @@ void csmntVkGraphics::createSwapChain(csmntVkApplication* pApp, SwapChainSupport
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
 	//Decide if images are exclusive to queue families or concurrent
-	QueueFamilyIndices indices = findQueueFamilies(pApp->getVkPhysicalDevice(), pApp->getVkSurfaceKHR());
+	const QueueFamilyIndices& indices = pApp->getQueueFamilyIndices();
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
 	if (indices.graphicsFamily != indices.presentFamily) {
@@ -726,7 +1223,7 @@ void csmntVkGraphics::createSwapChain(csmntVkApplication* pApp, SwapChainSupport
 
 	//resizing the window etc requires chains to be created from scratch...
 	//here's where you have to reference the dead one
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapChain;
 
 	if (vkCreateSwapchainKHR(pApp->getVkDevice(), &createInfo, nullptr, &m_vkSwapChain) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create swap chain!");
@@ -742,6 +1239,39 @@ void csmntVkGraphics::createSwapChain(csmntVkApplication* pApp, SwapChainSupport
 	m_vkSwapChainExtent = extent;
 }
 
+void csmntVkGraphics::createOffscreenTargets(csmntVkApplication* pApp)
+{
+	m_vkSwapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	m_vkSwapChainExtent = { static_cast<uint32_t>(pApp->getWindowWidth()), static_cast<uint32_t>(pApp->getWindowHeight()) };
+
+	//One target per frame in flight, so a frame can render while an older one is read back
+	m_vkSwapChainImages.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_offscreenImagesMemory.resize(m_MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < m_vkSwapChainImages.size(); i++) {
+		vkHelpers::createVkImage(pApp->getVkDevice(), pApp->getAllocator(), m_vkSwapChainExtent.width, m_vkSwapChainExtent.height,
+			m_vkSwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vkSwapChainImages[i], m_offscreenImagesMemory[i]);
+	}
+
+#if _DEBUG
+	std::cout << "HEY! created " << m_vkSwapChainImages.size() << " offscreen targets (" 
+		<< m_vkSwapChainExtent.width << "x" << m_vkSwapChainExtent.height << ")" << std::endl;
+#endif
+}
+
+void csmntVkGraphics::createReadbackBuffer(csmntVkApplication* pApp)
+{
+	//Single host visible buffer sliced per target, mapped once by the allocator
+	m_readbackSliceSize = static_cast<VkDeviceSize>(m_vkSwapChainExtent.width) * m_vkSwapChainExtent.height * 4;
+	VkDeviceSize bufferSize = m_readbackSliceSize * m_vkSwapChainImages.size();
+
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_readbackBuffer, m_readbackBufferMemory);
+
+	m_readbackPending.assign(m_vkSwapChainImages.size(), 0);
+}
+
 void csmntVkGraphics::createImageViews(VkDevice& device)
 {
 	m_vkSwapChainImageViews.resize(m_vkSwapChainImages.size());
@@ -755,36 +1285,121 @@ void csmntVkGraphics::createImageViews(VkDevice& device)
 
 void csmntVkGraphics::createDescriptorPool(VkDevice& device)
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	//Bindless sets carry no sampler, the table has its own pool
+	std::vector<VkDescriptorPoolSize> poolSizes(1);
 	//uniform buffers
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(m_vkSwapChainImages.size());
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[0].descriptorCount = m_MAX_FRAMES_IN_FLIGHT;
 	//image sampler
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(m_vkSwapChainImages.size());
+	if (!m_bindless) {
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_MAX_FRAMES_IN_FLIGHT });
+	}
+	//GPU driven instances
+	if (m_gpuDriven) {
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_MAX_FRAMES_IN_FLIGHT });
+	}
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(m_vkSwapChainImages.size());
+	poolInfo.maxSets = m_MAX_FRAMES_IN_FLIGHT;
 
 	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_vkDescriptorPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor pool!");
 	}
 }
 
+void csmntVkGraphics::startAssetLoads(csmntVkApplication* pApp)
+{
+	AssetLoader& loader = pApp->getAssetLoader();
+
+	if (!m_modelPath.empty()) {
+		const std::string path = m_modelPath;
+		ModelLoadOptions options;
+		options.vertexFormat = m_vertexFormat;
+		options.optimize = m_meshOptimization;
+		options.generateLods = m_lodSelection;
+		options.buildMeshlets = m_clusterCulling;
+		m_modelLoad = loader.submit<std::unique_ptr<Model>>([path, options]() {
+			return std::unique_ptr<Model>(new Model(path, options));
+		});
+	}
+
+	//Streamed textures read their own sources, a level range at a time
+	if (m_textureStreaming) {
+		return;
+	}
+
+	const size_t textureCount = m_bindless ? m_texturePaths.size() : 1;
+	for (size_t i = 0; i < textureCount; i++) {
+		const std::string path = m_texturePaths[i];
+		m_textureLoads.push_back(loader.submit<std::unique_ptr<TextureData>>([pApp, path]() {
+			std::unique_ptr<TextureData> pData(new TextureData());
+			Texture::loadTextureData(pApp, path, MipGeneration::Auto, *pData);
+			return pData;
+		}));
+	}
+}
+
 void csmntVkGraphics::createTexture(csmntVkApplication* pApp)
 {
-	m_pTexture = new Texture(pApp, m_vkCommandPool, "../Assets/Textures/profile.png", 4);
+	//Without bindless there's the one binding to sample from
+	const size_t textureCount = m_bindless ? m_texturePaths.size() : 1;
 
-	if (!m_pTexture)
-	{
-		std::runtime_error("failed to create the texture container!");
+	if (m_textureStreaming) {
+		m_textureStreamer.create(pApp, m_MAX_FRAMES_IN_FLIGHT, m_textureBudget);
+		for (size_t i = 0; i < textureCount; i++) {
+			m_textureStreamer.addTexture(pApp, m_texturePaths[i]);
+		}
+		return;
 	}
+
+	//Placeholders get swapped out as the decodes finish, otherwise wait for them here
+	for (size_t i = 0; i < textureCount; i++) {
+		if (m_asyncAssets) {
+			m_pTextures.push_back(createPlaceholderTexture(pApp));
+		}
+		else {
+			std::unique_ptr<TextureData> pData = m_textureLoads[i].get();
+			m_pTextures.push_back(new Texture(pApp, *pData));
+		}
+	}
+	m_textureVersions.assign(textureCount, 0);
+	m_pLoadedTextures.assign(textureCount, nullptr);
+	m_loadedTextureTickets.assign(textureCount, 0);
+}
+
+Texture* csmntVkGraphics::createPlaceholderTexture(csmntVkApplication* pApp)
+{
+	//A single mid grey texel
+	TextureData data;
+	data.width = 1;
+	data.height = 1;
+	data.pixels = { 128, 128, 128, 255 };
+	data.levels = { { 0, 1, 1 } };
+	data.pData = data.pixels.data();
+	data.dataSize = static_cast<VkDeviceSize>(data.pixels.size());
+
+	return new Texture(pApp, data);
+}
+
+const uint32_t csmntVkGraphics::getTextureVersion(uint32_t texture) const
+{
+	return m_textureStreaming ? m_textureStreamer.getViewVersion(texture) : m_textureVersions[texture];
+}
+
+const uint32_t csmntVkGraphics::getTextureCount() const
+{
+	return m_textureStreaming ? m_textureStreamer.getTextureCount() : static_cast<uint32_t>(m_pTextures.size());
+}
+
+VkImageView csmntVkGraphics::getTextureView(uint32_t texture) const
+{
+	return m_textureStreaming ? m_textureStreamer.getImageView(texture) : m_pTextures[texture]->getVkImageView();
 }
 
-void csmntVkGraphics::recreateSwapChain(csmntVkApplication* pApp, SwapChainSupportDetails& swapChainSupport)
+void csmntVkGraphics::recreateSwapChain(csmntVkApplication* pApp, SwapChainSupportDetails& swapChainSupport, bool surfaceLost)
 {
 	//Check for minimized window state
 	int width = 0, height = 0;
@@ -793,19 +1408,57 @@ void csmntVkGraphics::recreateSwapChain(csmntVkApplication* pApp, SwapChainSuppo
 		glfwWaitEvents();
 	}
 
-	//Recreate the swap chain if window surface changes to non compatible
-	vkDeviceWaitIdle(pApp->getVkDevice());
+	VkDevice& device = pApp->getVkDevice();
 
-	//cleanup
-	cleanupSwapChain(pApp->getVkDevice());
+	//Only our own submits can still be using the images, views & framebuffers --
+	//wait on their fences rather than idling the whole device
+	vkWaitForFences(device, static_cast<uint32_t>(m_vkInFlightFences.size()), m_vkInFlightFences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
 
-	createSwapChain(pApp, swapChainSupport);
-	createImageViews(pApp->getVkDevice());
-	createRenderPass(pApp);
-	createPipeline(pApp->getVkDevice());
-	createDepthResources(pApp);
-	createFramebuffers(pApp->getVkDevice());
-	createCommandBuffers(pApp->getVkDevice());
+	VkSwapchainKHR oldSwapChain = m_vkSwapChain;
+	VkFormat oldFormat = m_vkSwapChainImageFormat;
+
+	//Only one retired chain at a time -- a resize hot on the heels of another can't wait for the last one's turn
+	destroyRetiredSwapChain(pApp);
+
+	//Extent dependent resources & the render graph -- pipeline & layouts stay
+	cleanupSwapChainResources(pApp);
+
+	//A lost surface has to be rebuilt before we can query or create against it, and its swap chain
+	//can't be handed on or outlive it. The fences don't cover presents, so wait those out first
+	if (surfaceLost) {
+		vkQueueWaitIdle(pApp->getPresentQueue());
+		vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+		oldSwapChain = VK_NULL_HANDLE;
+
+		pApp->recreateSurface();
+	}
+
+	//The cached support details are stale after a resize/out of date/surface loss
+	pApp->refreshSwapChainSupport();
+
+	//Hand the old chain on, but its images may still be queued for present -- drawFrame destroys it
+	//once every frame in flight has been through the new chain
+	createSwapChain(pApp, swapChainSupport, oldSwapChain);
+	m_vkRetiredSwapChain = oldSwapChain;
+	m_retiredSwapChainFrame = m_frameNumber;
+
+	createImageViews(device);
+	createOcclusionBuffer();
+
+	//Transient images & framebuffers follow the extent. The pipeline only has to match the render pass'
+	//formats -- keep it unless they changed
+	buildRenderGraph(pApp);
+	if (m_vkSwapChainImageFormat != oldFormat) {
+		createPipelines(pApp);
+		//The old format's pipelines only worked with the old passes, & the fences above say they're done
+		pApp->getPipelineCache().evictStalePipelines(device);
+	}
+	//...& so does the pyramid, the cull has to read the new one
+	if (m_occlusionCulling) {
+		m_gpuCulling.setOcclusionPyramid(device, m_hiZ.getView(), m_hiZ.getSampler(), m_hiZ.getExtent(), m_hiZ.getLevelCount());
+	}
+
+	//Command buffers are recorded per frame against whatever the framebuffers are now, nothing to redo
 
 #if _DEBUG
 	static size_t creations = 0;
@@ -814,21 +1467,6 @@ void csmntVkGraphics::recreateSwapChain(csmntVkApplication* pApp, SwapChainSuppo
 #endif
 }
 
-VkShaderModule csmntVkGraphics::createShaderModule(const std::vector<char>& code, VkDevice* device)
-{
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(*device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create shader module!");
-	}
-
-	return shaderModule;
-}
-
 void csmntVkGraphics::createTextureSampler(csmntVkApplication* pApp)
 {
 	//Create a linear sampler w/Anistro
@@ -848,23 +1486,13 @@ void csmntVkGraphics::createTextureSampler(csmntVkApplication* pApp)
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	//Whole chain -- each image view's level count is what actually bounds it
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	if (vkCreateSampler(pApp->getVkDevice(), &samplerInfo, nullptr, &m_linearTexSampler) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
 	}
 }
-
-void csmntVkGraphics::createDepthResources(csmntVkApplication* pApp)
-{
-	VkFormat depthFormat = findDepthFormat(pApp->getVkPhysicalDevice());
-
-	vkHelpers::createVkImage(pApp->getVkDevice(), pApp->getVkPhysicalDevice(),
-		m_vkSwapChainExtent.width, m_vkSwapChainExtent.height, depthFormat,
-		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-		m_vkDepthImage, m_vkDepthImageMemory);
-	m_vkDepthImageView = vkHelpers::createVkImageView(pApp->getVkDevice(), m_vkDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-}
 #pragma endregion
 
 #pragma region EVERY FRAME
@@ -875,22 +1503,36 @@ void csmntVkGraphics::drawFrame(csmntVkApplication* pApp, SwapChainSupportDetail
 	//Wait for frame to finish before continuing with another
 	vkWaitForFences(pApp->getVkDevice(), 1, &m_vkInFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
 
+	//That fence was for the submit m_MAX_FRAMES_IN_FLIGHT back -- once it's one on the new chain, every frame
+	//in flight has cycled through it & the presents queued on the retired chain are behind us
+	if (m_vkRetiredSwapChain != VK_NULL_HANDLE && m_frameNumber >= m_retiredSwapChainFrame + m_MAX_FRAMES_IN_FLIGHT) {
+		vkDestroySwapchainKHR(pApp->getVkDevice(), m_vkRetiredSwapChain, nullptr);
+		m_vkRetiredSwapChain = VK_NULL_HANDLE;
+	}
+
 	uint32_t imageIndex;
 	result = vkAcquireNextImageKHR(pApp->getVkDevice(), m_vkSwapChain, std::numeric_limits<uint64_t>::max(), m_vkImageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
-	updateUniformBuffer(imageIndex, pApp->getVkDevice());
-
 	//check if swapchain needs recreation
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_ERROR_SURFACE_LOST_KHR) {
 		pApp->setIsFrameBufferResized(false);
 
-		recreateSwapChain(pApp, swapChainSupport);
+		recreateSwapChain(pApp, swapChainSupport, result == VK_ERROR_SURFACE_LOST_KHR);
 		return;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
 
+	//Command buffer, pools & uniform region all belong to the frame, which the fence
+	//wait above has already freed up -- only the framebuffer depends on the image
+	if (m_bindless) {
+		m_bindlessTextures.beginFrame(m_frameNumber);
+	}
+	updateAssets(pApp, m_currentFrame);
+	updateUniformBuffer(static_cast<uint32_t>(m_currentFrame), pApp->getVkDevice(), pApp->getJobSystem());
+	recordCommandBuffer(pApp, m_currentFrame, imageIndex);
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -902,7 +1544,7 @@ void csmntVkGraphics::drawFrame(csmntVkApplication* pApp, SwapChainSupportDetail
 
 	//bind command buffer
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_vkCommandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &m_vkCommandBuffers[m_currentFrame];
 
 	VkSemaphore signalSemaphores[] = { m_vkRenderFinishedSemaphores[m_currentFrame] };
 	submitInfo.signalSemaphoreCount = 1;
@@ -916,6 +1558,8 @@ void csmntVkGraphics::drawFrame(csmntVkApplication* pApp, SwapChainSupportDetail
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
 
+	m_frameNumber++;
+
 	//Present to swap chain
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -936,9 +1580,9 @@ void csmntVkGraphics::drawFrame(csmntVkApplication* pApp, SwapChainSupportDetail
 	result = vkQueuePresentKHR(pApp->getPresentQueue(), &presentInfo);
 
 	//check swapchain again
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || pApp->getIsFrameBufferResized()) {
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_SURFACE_LOST_KHR || pApp->getIsFrameBufferResized()) {
 		pApp->setIsFrameBufferResized(false);
-		recreateSwapChain(pApp, swapChainSupport);
+		recreateSwapChain(pApp, swapChainSupport, result == VK_ERROR_SURFACE_LOST_KHR);
 	}
 	else if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to present swap chain image!");
@@ -948,62 +1592,524 @@ void csmntVkGraphics::drawFrame(csmntVkApplication* pApp, SwapChainSupportDetail
 	m_currentFrame = (m_currentFrame + 1) % m_MAX_FRAMES_IN_FLIGHT;
 }
 
-void csmntVkGraphics::updateUniformBuffer(uint32_t currentImage, VkDevice& device)
+void csmntVkGraphics::drawFrameHeadless(csmntVkApplication* pApp)
+{
+	//Offscreen targets map 1:1 onto frames in flight
+	const size_t frame = m_currentFrame;
+
+	//Wait for the target's last frame, then its pixels are safe to read
+	vkWaitForFences(pApp->getVkDevice(), 1, &m_vkInFlightFences[frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	deliverReadback(pApp, frame);
+
+	if (m_bindless) {
+		m_bindlessTextures.beginFrame(m_frameNumber);
+	}
+	updateAssets(pApp, frame);
+	updateUniformBuffer(static_cast<uint32_t>(frame), pApp->getVkDevice(), pApp->getJobSystem());
+	recordCommandBuffer(pApp, frame, static_cast<uint32_t>(frame));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_vkCommandBuffers[frame];
+
+	vkResetFences(pApp->getVkDevice(), 1, &m_vkInFlightFences[frame]);
+
+	if (vkQueueSubmit(pApp->getGraphicsQueue(), 1, &submitInfo, m_vkInFlightFences[frame]) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit headless draw command buffer!");
+	}
+
+	m_readbackPending[frame] = ++m_headlessFrameNumber;
+	m_frameNumber++;
+
+	//Advance frame
+	m_currentFrame = (m_currentFrame + 1) % m_MAX_FRAMES_IN_FLIGHT;
+}
+
+void csmntVkGraphics::flushReadbacks(csmntVkApplication* pApp)
+{
+	//Oldest first, starting at the next frame to be reused
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		size_t frame = (m_currentFrame + i) % m_MAX_FRAMES_IN_FLIGHT;
+
+		vkWaitForFences(pApp->getVkDevice(), 1, &m_vkInFlightFences[frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		deliverReadback(pApp, frame);
+	}
+}
+
+void csmntVkGraphics::deliverReadback(csmntVkApplication* pApp, size_t slice)
+{
+	if (m_readbackPending[slice] == 0) {
+		return;
+	}
+
+	const FrameReadbackCallback& callback = pApp->getFrameReadbackCallback();
+	if (callback) {
+		const uint8_t* pPixels = static_cast<const uint8_t*>(m_readbackBufferMemory.pMapped) + slice * m_readbackSliceSize;
+		callback(pPixels, m_vkSwapChainExtent.width, m_vkSwapChainExtent.height, m_readbackPending[slice] - 1);
+	}
+
+	m_readbackPending[slice] = 0;
+}
+
+void csmntVkGraphics::updateUniformBuffer(uint32_t currentFrame, VkDevice& device, JobSystem& jobSystem)
 {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+	//Packed positions are unpacked by the model matrix, before anything else touches them
+	m_frameMeshTransform = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 rotation = m_frameMeshTransform * m_pModel->getDequantizeTransform();
+
+	m_frameCameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
 	UniformBufferObject ubo = {};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.view = glm::lookAt(m_frameCameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	ubo.proj = glm::perspective(glm::radians(45.0f), m_vkSwapChainExtent.width / (float)m_vkSwapChainExtent.height, 0.1f, 10.0f);
 	ubo.proj[1][1] *= -1;
 
-	void* data;
-	vkMapMemory(device, m_uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(device, m_uniformBuffersMemory[currentImage]);
+	m_frameViewProj = ubo.proj * ubo.view;
+	m_frameProjScale = std::abs(ubo.proj[1][1]);
+
+	//straight into the persistently mapped ring, no map/unmap -- one UBO per draw
+	m_uniformRing.beginRegion(currentFrame);
+
+	//GPU driven & instanced -- one shared UBO, instances carry their own transforms
+	if (m_gpuDriven || m_instanced) {
+		ubo.model = rotation;
+		m_frameUniformOffset = m_uniformRing.push(ubo);
+	}
+	if (m_gpuDriven) {
+		return;
+	}
+
+	if (m_cpuOcclusionCulling) {
+		cullOccludedDraws(jobSystem);
+	}
+	if (m_lodSelection) {
+		selectLods();
+	}
+
+	//Instanced -- the whole draw list goes out as one batch per LOD
+	if (m_instanced) {
+		m_instanceBuffer.beginRegion(currentFrame);
+		m_instanceBatches.clear();
+
+		//Counting sort by LOD, so each LOD's instances are contiguous
+		const uint32_t lodCount = m_pModel->getLodCount();
+		m_lodInstanceOffsets.assign(lodCount + 1, 0);
+		for (const DrawItem& draw : m_drawList) {
+			m_lodInstanceOffsets[draw.lod + 1] += draw.visible ? 1 : 0;
+		}
+		for (uint32_t lod = 0; lod < lodCount; lod++) {
+			m_lodInstanceOffsets[lod + 1] += m_lodInstanceOffsets[lod];
+		}
+
+		m_instanceScratch.resize(m_drawList.size());
+		for (const DrawItem& draw : m_drawList) {
+			if (!draw.visible) {
+				continue;
+			}
+			InstanceData& instance = m_instanceScratch[m_lodInstanceOffsets[draw.lod]++];
+			instance.model = draw.model;
+			instance.textureIndex = draw.textureIndex;
+		}
+
+		//Offsets now sit at each LOD's end
+		uint32_t first = 0;
+		for (uint32_t lod = 0; lod < lodCount; lod++) {
+			submitInstances(m_instanceScratch.data() + first, m_lodInstanceOffsets[lod] - first, lod);
+			first = m_lodInstanceOffsets[lod];
+		}
+		return;
+	}
+
+	for (DrawItem& draw : m_drawList) {
+		if (!draw.visible) {
+			continue;
+		}
+		ubo.model = draw.model * rotation;
+		draw.uniformOffset = m_uniformRing.push(ubo);
+	}
+}
+
+void csmntVkGraphics::selectLods()
+{
+	const float radius = m_pModel->getBoundingRadius();
+	const float halfScreenHeight = 0.5f * static_cast<float>(m_vkSwapChainExtent.height);
+
+	for (DrawItem& draw : m_drawList) {
+		glm::vec4 sphere = GpuCulling::transformBoundingSphere(draw.model, radius);
+		const float scale = radius > 0.0f ? sphere.w / radius : 1.0f;
+
+		//Nearest point of the bounds sets the scale -- anything the camera is inside of gets LOD 0
+		const float depth = (m_frameViewProj * glm::vec4(glm::vec3(sphere), 1.0f)).w - sphere.w;
+		const float pixelsPerUnit = depth > 0.0f ? scale * m_frameProjScale * halfScreenHeight / depth : 1e30f;
+
+		draw.lod = m_pModel->selectLod(draw.lod, pixelsPerUnit, m_LOD_ERROR_PIXELS, m_LOD_HYSTERESIS);
+		m_lodStats.triangles += m_pModel->getLod(draw.lod).indexCount / 3;
+	}
+
+	m_lodStats.fullDetailTriangles += static_cast<uint64_t>(m_pModel->getLod(0).indexCount / 3) * m_drawList.size();
+	m_lodStats.frames++;
+}
+
+void csmntVkGraphics::createOcclusionBuffer()
+{
+	if (m_cpuOcclusionCulling) {
+		m_occlusionRasterizer.create(m_CPU_OCCLUSION_WIDTH, std::max(1u, m_CPU_OCCLUSION_WIDTH * m_vkSwapChainExtent.height / std::max(1u, m_vkSwapChainExtent.width)));
+	}
+}
+
+void csmntVkGraphics::captureOccluderMesh(const Model& model, OccluderMesh& mesh)
+{
+	//Packed positions are snorm16 within the bounds -- undo both, so draws' transforms apply as they are
+	mesh.positions.resize(model.getVertexCount());
+	for (uint32_t i = 0; i < model.getVertexCount(); i++) {
+		if (model.getVertexFormat() == VertexFormat::Packed) {
+			const PackedVertex& vertex = static_cast<const PackedVertex*>(model.getVertexData())[i];
+			const glm::vec3 unpacked = glm::max(glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]) / 32767.0f, glm::vec3(-1.0f));
+			mesh.positions[i] = glm::vec3(model.getDequantizeTransform() * glm::vec4(unpacked, 1.0f));
+		}
+		else {
+			mesh.positions[i] = static_cast<const Vertex*>(model.getVertexData())[i].pos;
+		}
+	}
+
+	//LOD 0 only -- simplified LODs can stick out past the surface they stand in for
+	const MeshLod& lod = model.getLod(0);
+	mesh.indices.resize(lod.indexCount);
+	for (uint32_t i = 0; i < lod.indexCount; i++) {
+		mesh.indices[i] = model.getIndexType() == VK_INDEX_TYPE_UINT16 ?
+			static_cast<const uint16_t*>(model.getIndexData())[lod.firstIndex + i] : static_cast<const uint32_t*>(model.getIndexData())[lod.firstIndex + i];
+	}
+
+	mesh.boundsMin = glm::vec3(0.0f);
+	mesh.boundsMax = glm::vec3(0.0f);
+	if (!mesh.positions.empty()) {
+		mesh.boundsMin = mesh.boundsMax = mesh.positions[0];
+		for (const glm::vec3& position : mesh.positions) {
+			mesh.boundsMin = glm::min(mesh.boundsMin, position);
+			mesh.boundsMax = glm::max(mesh.boundsMax, position);
+		}
+	}
+}
+
+void csmntVkGraphics::cullOccludedDraws(JobSystem& jobSystem)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	//The nearest draws in front of the camera are the likeliest to cover the screen -- they're the occluders
+	auto viewDepth = [this](uint32_t draw) {
+		const float depth = (m_frameViewProj * m_drawList[draw].model[3]).w;
+		return depth > 0.0f ? depth : std::numeric_limits<float>::max();
+	};
+	const uint32_t occluderCount = std::min(m_CPU_OCCLUDERS, static_cast<uint32_t>(m_drawList.size()));
+	m_occluderScratch.resize(m_drawList.size());
+	for (uint32_t i = 0; i < m_drawList.size(); i++) {
+		m_occluderScratch[i] = i;
+	}
+	std::partial_sort(m_occluderScratch.begin(), m_occluderScratch.begin() + occluderCount, m_occluderScratch.end(), [&viewDepth](uint32_t a, uint32_t b) {
+		return viewDepth(a) < viewDepth(b);
+	});
+
+	m_occlusionRasterizer.clear();
+	for (uint32_t i = 0; i < occluderCount; i++) {
+		m_occlusionRasterizer.addOccluder(m_occluderMesh.positions.data(), m_occluderMesh.indices.data(), static_cast<uint32_t>(m_occluderMesh.indices.size()),
+			m_frameViewProj * m_drawList[m_occluderScratch[i]].model * m_frameMeshTransform);
+	}
+	m_occlusionRasterizer.rasterize(&jobSystem);
+
+	//Occluders are tested too -- whatever hides behind the one in front still goes
+	uint32_t culled = 0;
+	for (DrawItem& draw : m_drawList) {
+		draw.visible = m_occlusionRasterizer.isBoxVisible(m_occluderMesh.boundsMin, m_occluderMesh.boundsMax, m_frameViewProj * draw.model * m_frameMeshTransform);
+		culled += draw.visible ? 0 : 1;
+	}
+
+	m_cpuOcclusionStats.tested += m_drawList.size();
+	m_cpuOcclusionStats.culled += culled;
+	m_cpuOcclusionStats.totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	m_cpuOcclusionStats.frames++;
+}
+
+void csmntVkGraphics::updateAssets(csmntVkApplication* pApp, size_t frame)
+{
+	//Retired in frame F -> last used by frame F at the latest, which is done
+	//once we're m_MAX_FRAMES_IN_FLIGHT frames further on
+	while (!m_retiredAssets.empty() && m_retiredAssets.front().frameNumber + m_MAX_FRAMES_IN_FLIGHT <= m_frameNumber) {
+		m_retiredAssets.front().destroy(pApp);
+		m_retiredAssets.pop_front();
+	}
+
+	if (m_asyncAssets) {
+		updateAssetLoads(pApp);
+	}
+	if (m_textureStreaming) {
+		updateTextureStreaming(pApp);
+	}
+	if (m_asyncAssets || m_textureStreaming) {
+		refreshTextureDescriptors(pApp, frame);
+	}
+}
+
+void csmntVkGraphics::updateAssetLoads(csmntVkApplication* pApp)
+{
+	UploadContext& upload = pApp->getUploadContext();
+
+	//Uploads that have landed swap in -- what they replace may still be in use by the frames in flight
+	if (m_pLoadedModel && upload.isComplete(pApp, m_loadedModelTicket)) {
+		Model* pOldModel = m_pModel;
+		VkBuffer oldVertexBuffer = m_vkVertexBuffer, oldIndexBuffer = m_vkIndexBuffer;
+		vkHelpers::Allocation oldVertexMemory = m_vkVertexBufferMemory, oldIndexMemory = m_vkIndexBufferMemory;
+		m_retiredAssets.push_back({ m_frameNumber, [=](csmntVkApplication* pApp) mutable {
+			vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), oldIndexBuffer, oldIndexMemory);
+			vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), oldVertexBuffer, oldVertexMemory);
+			delete pOldModel;
+		} });
+
+		m_pModel = m_pLoadedModel;
+		m_vkVertexBuffer = m_loadedVertexBuffer;
+		m_vkVertexBufferMemory = m_loadedVertexBufferMemory;
+		m_vkIndexBuffer = m_loadedIndexBuffer;
+		m_vkIndexBufferMemory = m_loadedIndexBufferMemory;
+		m_vkIndexCount = m_pModel->getLod(0).indexCount;
+		m_vkIndexType = m_pModel->getIndexType();
+		m_pLoadedModel = nullptr;
+		m_occluderMesh = std::move(m_loadedOccluderMesh);
+
+		//LOD picks were into the old chain
+		for (DrawItem& draw : m_drawList) {
+			draw.lod = 0;
+		}
+	}
+
+	for (size_t t = 0; t < m_pLoadedTextures.size(); t++) {
+		if (m_pLoadedTextures[t] && upload.isComplete(pApp, m_loadedTextureTickets[t])) {
+			Texture* pOldTexture = m_pTextures[t];
+			m_retiredAssets.push_back({ m_frameNumber, [pOldTexture](csmntVkApplication* pApp) {
+				pOldTexture->cleanupTexture(pApp);
+				delete pOldTexture;
+			} });
+
+			m_pTextures[t] = m_pLoadedTextures[t];
+			m_pLoadedTextures[t] = nullptr;
+			m_textureVersions[t]++;
+		}
+	}
+
+	//Finished decodes get staged -- get() rethrows anything the load threw
+	bool uploading = false;
+	if (AssetLoader::isReady(m_modelLoad)) {
+		m_pLoadedModel = m_modelLoad.get().release();
+		createVertexBuffer(pApp, *m_pLoadedModel, m_loadedVertexBuffer, m_loadedVertexBufferMemory);
+		createIndexBuffer(pApp, *m_pLoadedModel, m_loadedIndexBuffer, m_loadedIndexBufferMemory);
+		if (m_cpuOcclusionCulling) {
+			captureOccluderMesh(*m_pLoadedModel, m_loadedOccluderMesh);
+		}
+		m_pLoadedModel->releaseSourceData();
+		m_loadedModelTicket = 0;
+		uploading = true;
+	}
+
+	for (size_t t = 0; t < m_textureLoads.size(); t++) {
+		if (AssetLoader::isReady(m_textureLoads[t])) {
+			std::unique_ptr<TextureData> pData = m_textureLoads[t].get();
+			m_pLoadedTextures[t] = new Texture(pApp, *pData);
+			m_loadedTextureTickets[t] = 0;
+			uploading = true;
+		}
+	}
+
+	//One batch for everything that came in this frame, polled from here on
+	if (uploading) {
+		const uint64_t ticket = upload.submit(pApp);
+		if (m_pLoadedModel && m_loadedModelTicket == 0) {
+			m_loadedModelTicket = ticket;
+		}
+		for (size_t t = 0; t < m_pLoadedTextures.size(); t++) {
+			if (m_pLoadedTextures[t] && m_loadedTextureTickets[t] == 0) {
+				m_loadedTextureTickets[t] = ticket;
+			}
+		}
+	}
+}
+
+const bool csmntVkGraphics::areAssetsLoaded() const
+{
+	if (m_modelLoad.valid() || m_pLoadedModel) {
+		return false;
+	}
+	for (size_t t = 0; t < m_textureLoads.size(); t++) {
+		if (m_textureLoads[t].valid() || m_pLoadedTextures[t]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void csmntVkGraphics::updateTextureStreaming(csmntVkApplication* pApp)
+{
+	const uint32_t textureCount = m_textureStreamer.getTextureCount();
+
+	//Sizes come from last frame's camera -- the first frame has none & draws the mip tails
+	if (m_frameNumber > 0) {
+		const float radius = m_pModel->getBoundingRadius();
+		const float screenHeight = static_cast<float>(m_vkSwapChainExtent.height);
+
+		for (size_t i = 0; i < m_drawList.size(); i++) {
+			glm::vec4 sphere = GpuCulling::transformBoundingSphere(m_drawList[i].model, radius);
+			glm::vec4 clip = m_frameViewProj * glm::vec4(glm::vec3(sphere), 1.0f);
+			const float clipRadius = sphere.w * m_frameProjScale;
+
+			//Off screen draws don't ask for anything
+			if (clip.w + sphere.w <= 0.0f || std::abs(clip.x) > clip.w + clipRadius || std::abs(clip.y) > clip.w + clipRadius) {
+				continue;
+			}
+
+			//Projected diameter in pixels, anything the camera is inside of wants the lot
+			const float pixels = clip.w > sphere.w ? clipRadius / clip.w * screenHeight : std::numeric_limits<float>::max();
+			m_textureStreamer.requestSize(m_bindless ? static_cast<uint32_t>(i % textureCount) : 0, pixels);
+		}
+	}
+
+	m_textureStreamer.update(pApp, m_frameNumber);
+}
+
+void csmntVkGraphics::refreshTextureDescriptors(csmntVkApplication* pApp, size_t frame)
+{
+	const uint32_t textureCount = getTextureCount();
+
+	if (m_bindless) {
+		for (uint32_t t = 0; t < textureCount; t++) {
+			const uint32_t version = getTextureVersion(t);
+			if (m_slotTextureVersions[t] == version) {
+				continue;
+			}
+
+			//New view into a new slot -- the old slot keeps its view for the frames in flight
+			const uint32_t slot = m_bindlessTextures.addTexture(pApp->getVkDevice(), getTextureView(t), m_linearTexSampler);
+			m_bindlessTextures.removeTexture(m_textureSlots[t]);
+			m_textureSlots[t] = slot;
+			m_slotTextureVersions[t] = version;
+
+			for (size_t i = t; i < m_drawList.size(); i += textureCount) {
+				m_drawList[i].textureIndex = slot;
+			}
+		}
+	}
+	else if (m_frameTextureVersions[frame] != getTextureVersion(0)) {
+		//The fence wait freed this frame's set, so it can be rewritten in place
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = getTextureView(0);
+		imageInfo.sampler = m_linearTexSampler;
+
+		VkWriteDescriptorSet samplerWrite = {};
+		samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		samplerWrite.dstSet = m_vkDescriptorSets[frame];
+		samplerWrite.dstBinding = 1;
+		samplerWrite.dstArrayElement = 0;
+		samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		samplerWrite.descriptorCount = 1;
+		samplerWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(pApp->getVkDevice(), 1, &samplerWrite, 0, nullptr);
+		m_frameTextureVersions[frame] = getTextureVersion(0);
+	}
 }
 #pragma endregion
 
 #pragma region CLEANUP
+void csmntVkGraphics::cleanupAssetLoads(csmntVkApplication* pApp)
+{
+	//Nothing may still be copying into a loaded asset
+	pApp->getUploadContext().flush(pApp);
+
+	for (RetiredAsset& retired : m_retiredAssets) {
+		retired.destroy(pApp);
+	}
+	m_retiredAssets.clear();
+
+	if (m_pLoadedModel) {
+		vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_loadedIndexBuffer, m_loadedIndexBufferMemory);
+		vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_loadedVertexBuffer, m_loadedVertexBufferMemory);
+		delete m_pLoadedModel;
+		m_pLoadedModel = nullptr;
+	}
+
+	for (Texture*& pTexture : m_pLoadedTextures) {
+		if (pTexture) {
+			pTexture->cleanupTexture(pApp);
+			delete pTexture;
+			pTexture = nullptr;
+		}
+	}
+
+	//The loader has been shut down by now, anything still queued never ran
+	m_modelLoad = std::future<std::unique_ptr<Model>>();
+	m_textureLoads.clear();
+}
+
 void csmntVkGraphics::cleanupTexture(csmntVkApplication* pApp)
 {
-	if (m_pTexture)
-	{
-		m_pTexture->cleanupTexture(pApp);
-		delete m_pTexture;
-		m_pTexture = nullptr;
+	for (Texture* pTexture : m_pTextures) {
+		pTexture->cleanupTexture(pApp);
+		delete pTexture;
+	}
+	m_pTextures.clear();
+
+	if (m_textureStreaming) {
+		m_textureStreamer.cleanup(pApp);
 	}
 }
 
-void csmntVkGraphics::cleanupSwapChain(VkDevice& device)
+void csmntVkGraphics::cleanupSwapChain(csmntVkApplication* pApp)
 {
-	//cleanup depth buffer
-	vkDestroyImageView(device, m_vkDepthImageView, nullptr);
-	vkDestroyImage(device, m_vkDepthImage, nullptr);
-	vkFreeMemory(device, m_vkDepthImageMemory, nullptr);
+	VkDevice& device = pApp->getVkDevice();
 
-	//Destroy all framebuffers
-	for (auto framebuffer : m_vkSwapChainFramebuffers) {
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	cleanupSwapChainResources(pApp);
+
+	if (!m_headless) {
+		destroyRetiredSwapChain(pApp);
+		vkDestroySwapchainKHR(device, m_vkSwapChain, nullptr);
+		m_vkSwapChain = VK_NULL_HANDLE;
 	}
+}
+
+void csmntVkGraphics::destroyRetiredSwapChain(csmntVkApplication* pApp)
+{
+	if (m_vkRetiredSwapChain == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkQueueWaitIdle(pApp->getPresentQueue());
+	vkDestroySwapchainKHR(pApp->getVkDevice(), m_vkRetiredSwapChain, nullptr);
+	m_vkRetiredSwapChain = VK_NULL_HANDLE;
+}
 
-	//free up command buffers
-	vkFreeCommandBuffers(device, m_vkCommandPool, static_cast<uint32_t>(m_vkCommandBuffers.size()), m_vkCommandBuffers.data());
+void csmntVkGraphics::cleanupSwapChainResources(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
 
-	vkDestroyPipeline(device, m_vkGraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(device, m_vkPipelineLayout, nullptr);
-	vkDestroyRenderPass(device, m_vkRenderPass, nullptr);
+	//Render passes, framebuffers & transient images (depth)
+	m_renderGraph.cleanup(pApp);
+	if (m_occlusionCulling) {
+		m_hiZ.cleanup(pApp);
+	}
 
 	//destroy all image views
 	for (auto imageView : m_vkSwapChainImageViews) {
 		vkDestroyImageView(device, imageView, nullptr);
 	}
 
-	vkDestroySwapchainKHR(device, m_vkSwapChain, nullptr);
+	//Swap chain images belong to the swap chain, offscreen targets are ours
+	if (m_headless) {
+		for (size_t i = 0; i < m_vkSwapChainImages.size(); i++) {
+			vkHelpers::destroyVkImage(device, pApp->getAllocator(), m_vkSwapChainImages[i], m_offscreenImagesMemory[i]);
+		}
+	}
 }
 #pragma endregion
 
@@ -1027,7 +2133,7 @@ VkSurfaceFormatKHR csmntVkGraphics::chooseSwapSurfaceFormat(const std::vector<Vk
 	return availableFormats[0];
 }
 
-VkPresentModeKHR csmntVkGraphics::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes)
+VkPresentModeKHR csmntVkGraphics::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
 	//should always be available
 	VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
@@ -1072,8 +2178,18 @@ VkExtent2D csmntVkGraphics::chooseSwapExtent(const VkSurfaceCapabilitiesKHR & ca
 #pragma endregion
 
 #pragma region DEPTH BUFFER HELPERS
-VkFormat csmntVkGraphics::findDepthFormat(VkPhysicalDevice& physicalDevice) 
+VkFormat csmntVkGraphics::findDepthFormat(VkPhysicalDevice& physicalDevice, bool sampled) 
 {
+	//D16 is always there for both
+	if (sampled) {
+		return vkHelpers::findSupportedFormat(
+			physicalDevice,
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+		);
+	}
+
 	return vkHelpers::findSupportedFormat(
 		physicalDevice,
 		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
@@ -5,13 +5,79 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <deque>
+#include <memory>
+#include <future>
 
 #include "vkDetailsStructs.h"
+#include "vkMemoryAllocator.h"
 #include "Model.h"
 #include "Texture.h"
+#include "UniformRingBuffer.h"
+#include "BindlessTextures.h"
+#include "GpuCulling.h"
+#include "InstanceBuffer.h"
+#include "TextureStreamer.h"
+#include "AssetLoader.h"
+#include "RenderGraph.h"
+#include "HiZPyramid.h"
+#include "OcclusionRasterizer.h"
+#include "../Libraries/glm/glm.hpp"
 
 //Graphics knows about Application, for passing params easier
 class csmntVkApplication;
+class JobSystem;
+
+//Headless readback -- tightly packed RGBA8 rows, valid only for the duration of the call
+using FrameReadbackCallback = std::function<void(const uint8_t* pPixels, uint32_t width, uint32_t height, uint64_t frameNumber)>;
+
+//One entry in the scene's draw list
+struct DrawItem {
+	glm::mat4	model;
+	uint32_t	uniformOffset;		//dynamic offset of this frame's UBO
+	uint32_t	textureIndex;		//slot in the bindless texture table
+	uint32_t	lod;				//picked per frame, kept for the hysteresis
+	bool		visible;			//false when CPU occlusion culling hid it this frame
+};
+
+//Instances of the model drawn by one vkCmdDrawIndexed
+struct InstanceBatch {
+	uint32_t	firstInstance;
+	uint32_t	instanceCount;
+	uint32_t	lod;
+};
+
+//Positions & LOD 0's indices kept for the CPU occlusion rasterizer, once the model's copy is released
+struct OccluderMesh {
+	std::vector<glm::vec3>	positions;		//object space, dequantized
+	std::vector<uint32_t>	indices;
+	glm::vec3				boundsMin = glm::vec3(0.0f);
+	glm::vec3				boundsMax = glm::vec3(0.0f);
+};
+
+//Draws CPU occlusion culling tested & hid, & what it cost
+struct CpuOcclusionStats {
+	uint64_t	tested = 0;
+	uint64_t	culled = 0;
+	double		totalMs = 0.0;
+	uint64_t	frames = 0;
+};
+
+//CPU time spent recording command buffers
+struct RecordStats {
+	double		totalMs = 0.0;
+	uint64_t	frames = 0;
+};
+
+//Triangles submitted with LOD selection vs what LOD 0 everywhere would have cost
+struct LodStats {
+	uint64_t	triangles = 0;
+	uint64_t	fullDetailTriangles = 0;
+	uint64_t	frames = 0;
+};
 
 /////////////////////////////////////////////////////
 //---csmntVkGraphics:
@@ -20,7 +86,7 @@ class csmntVkApplication;
 
 class csmntVkGraphics {
 public:
-	csmntVkGraphics();
+	csmntVkGraphics(uint32_t framesInFlight = 2);
 	~csmntVkGraphics();
 	csmntVkGraphics(csmntVkGraphics&) = delete;
 	csmntVkGraphics& operator=(const csmntVkGraphics&) = delete;
@@ -31,93 +97,321 @@ public:
 
 	void drawFrame(csmntVkApplication*, SwapChainSupportDetails&);
 
-	void recreateSwapChain(csmntVkApplication*, SwapChainSupportDetails&);
+	//Headless: render into the offscreen targets & read back finished frames
+	void drawFrameHeadless(csmntVkApplication*);
+	void flushReadbacks(csmntVkApplication*);
+
+	void recreateSwapChain(csmntVkApplication*, SwapChainSupportDetails&, bool surfaceLost = false);
+
+	//Number of copies of the model drawn each frame (set before init)
+	void setDrawCount(uint32_t count) { m_drawCount = std::max(1u, count); };
+
+	//Draw the list as instances of the model rather than a draw each (set before init)
+	void setInstanced(bool enable) { m_instanced = enable; };
+
+	//Instanced mode only -- queue instances for the frame being built, drawn in one vkCmdDrawIndexed.
+	//Call after the frame's instance region has been started (updateUniformBuffer)
+	void submitInstances(const InstanceData* pInstances, uint32_t count, uint32_t lod = 0);
+
+	//Mesh to load instead of the built-in quads: .obj, .gltf/.glb or cooked .cmesh (set before init)
+	void setModelPath(const std::string& path) { m_modelPath = path; };
+	//Layout of the vertex buffer & the pipeline's vertex input (set before init)
+	void setVertexFormat(VertexFormat format) { m_vertexFormat = format; };
+	//Reorder imported meshes for the vertex cache, overdraw & fetch (set before init, on by default)
+	void setMeshOptimization(bool enable) { m_meshOptimization = enable; };
+	//Build LOD chains for imported meshes & pick one per draw from its screen space error (set before init,
+	//on by default). GPU driven draws bake one index range into their indirect commands & stay on LOD 0
+	void setLodSelection(bool enable) { m_lodSelection = enable; };
+	const bool isLodSelecting() const { return m_lodSelection; };
+	//Split meshes into meshlets the GPU driven cull pass culls one by one against the frustum & by their
+	//normal cones, instead of whole instances (set before init, on by default, GPU driven only)
+	void setClusterCulling(bool enable) { m_clusterCulling = enable; };
+	const bool isClusterCulling() const { return m_clusterCulling; };
+	//Two phase occlusion culling against a hi-z pyramid of the frame's depth: draw what last frame's pyramid
+	//doesn't hide, rebuild it, then draw whatever that reveals (set before init, on by default, GPU driven only)
+	void setOcclusionCulling(bool enable) { m_occlusionCulling = enable; };
+	const bool isOcclusionCulling() const { return m_occlusionCulling; };
+	//Lay depth down in a depth only pass first, so the scene shades each pixel once (set before init, GPU driven only)
+	void setDepthPrepass(bool enable) { m_depthPrepass = enable; };
+	//Rasterize the nearest draws into a small depth buffer on the CPU & skip draws hidden behind them before
+	//they're recorded -- no readback to wait on (set before init, off by default, not GPU driven)
+	void setCpuOcclusionCulling(bool enable) { m_cpuOcclusionCulling = enable; };
+	const bool isCpuOcclusionCulling() const { return m_cpuOcclusionCulling; };
+	const CpuOcclusionStats& getCpuOcclusionStats() const { return m_cpuOcclusionStats; };
+	const LodStats& getLodStats() const { return m_lodStats; };
+	const VkDeviceSize getVertexBufferSize() const { return m_pModel ? m_pModel->getVertexDataSize() : 0; };
+	//Textures to load: .ktx2 (pre-compressed mips) or anything stb_image reads (set before init).
+	//Bindless draws round robin over them, otherwise only the first is sampled
+	void setTexturePaths(const std::vector<std::string>& paths) { m_texturePaths = paths; };
+	//Stream textures from the mip tail up within this much VRAM, 0 loads them whole (set before init).
+	//GPU driven draws bake their texture slots into the instance buffer, so they never stream
+	void setTextureBudget(VkDeviceSize bytes) { m_textureBudget = bytes; };
+	const bool isTextureStreaming() const { return m_textureStreaming; };
+	//Draw placeholders (grey texels, the built-in quads) while the mesh & textures decode on the app's
+	//AssetLoader, swapping the real ones in as their uploads land (set before init). GPU driven draws bake
+	//mesh bounds & texture slots into the instance buffer, so they wait for their assets at init instead
+	void setAsyncAssets(bool enable) { m_asyncAssets = enable; };
+	//True once every asset started at init has been swapped in
+	const bool areAssetsLoaded() const;
+	const TextureStreamStats& getTextureStreamStats() const { return m_textureStreamer.getStats(); };
+
+	//Bindless mode only -- textures register here to get the index draws sample with
+	BindlessTextureTable& getBindlessTextures() { return m_bindlessTextures; };
+	//Bindless mode only -- checks freed slots aren't reused while a frame in flight could read them
+	bool verifyBindlessRecycling(csmntVkApplication*);
+
+	//GPU driven mode only -- checks the last frame's culling against the CPU
+	bool verifyGpuCulling(csmntVkApplication*);
+
+	const RecordStats& getRecordStats() const { return m_recordStats; };
+	void resetRecordStats() { m_recordStats = RecordStats(); };
 
 private:
 	//How many frames should be processed concurrently?
-	const int					m_MAX_FRAMES_IN_FLIGHT = 2;
+	const uint32_t				m_MAX_FRAMES_IN_FLIGHT;
 	size_t						m_currentFrame = 0;
+	uint64_t					m_frameNumber = 0;		//frames submitted so far
+
+	//Bytes of uniform data each frame can push into the ring (grows with the draw count)
+	const VkDeviceSize			m_UNIFORM_REGION_SIZE = 1024 * 1024;
+	//Screen space error a LOD may show, & the margin it needs before a draw coarsens
+	const float					m_LOD_ERROR_PIXELS = 1.0f;
+	const float					m_LOD_HYSTERESIS = 0.25f;
+
+	//Instance buffer floor, per frame
+	const uint32_t				m_MIN_INSTANCES_PER_FRAME = 1024;
+
+	//Draws recorded into each secondary command buffer
+	const uint32_t				m_DRAWS_PER_JOB = 256;
+
+	//CPU occlusion -- nearest draws rasterized as occluders, into a buffer this wide
+	const uint32_t				m_CPU_OCCLUDERS = 8;
+	const uint32_t				m_CPU_OCCLUSION_WIDTH = 256;
 
 	VkSwapchainKHR				m_vkSwapChain;
+	//The chain the last recreate replaced, until every frame in flight has been through the new one
+	VkSwapchainKHR				m_vkRetiredSwapChain = VK_NULL_HANDLE;
+	uint64_t					m_retiredSwapChainFrame = 0;	//m_frameNumber when it was retired
 	std::vector<VkImage>		m_vkSwapChainImages;
 	VkFormat					m_vkSwapChainImageFormat;
 	VkExtent2D					m_vkSwapChainExtent;
 	std::vector<VkImageView>    m_vkSwapChainImageViews;
 
+	//Headless -- offscreen targets stand in for the swap chain images
+	bool						m_headless = false;
+	std::vector<vkHelpers::Allocation> m_offscreenImagesMemory;
+
+	//Pooled readback staging, one slice per offscreen target
+	VkBuffer					m_readbackBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_readbackBufferMemory;
+	VkDeviceSize				m_readbackSliceSize = 0;
+	std::vector<uint64_t>		m_readbackPending;		//frame number + 1 waiting in each slice, 0 = none
+	uint64_t					m_headlessFrameNumber = 0;
+
 	VkDescriptorSetLayout		m_vkDescriptorSetLayout;
 	VkPipelineLayout			m_vkPipelineLayout;
-	VkRenderPass				m_vkRenderPass;
 	VkPipeline					m_vkGraphicsPipeline;
-	std::vector<VkFramebuffer>	m_vkSwapChainFramebuffers;
-	VkCommandPool				m_vkCommandPool;
+	VkPipeline					m_vkDepthPipeline = VK_NULL_HANDLE;		//depth prepass only
+
+	//The frame's passes -- GPU culling, the depth prepass, the scene, the hi-z build & the headless readback.
+	//Rebuilt with the swap chain, imported resources are bound to it every frame
+	RenderGraph					m_renderGraph;
+	RenderGraph::Pass			m_scenePass = 0;
+	RenderGraph::Pass			m_prepassPass = 0;
+	RenderGraph::Resource		m_backbuffer = 0;
+	RenderGraph::Resource		m_cullDraws = 0;
+	RenderGraph::Resource		m_cullCount = 0;
+	RenderGraph::Resource		m_cullVisibility = 0;
+	RenderGraph::Resource		m_pyramid = 0;
+	RenderGraph::Resource		m_readback = 0;
+
+	//Per frame in flight: a primary pool & buffer, and a secondary pool per worker
+	struct WorkerCommandPool {
+		VkCommandPool					pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer>	secondaries;
+		size_t							used = 0;
+	};
+	std::vector<VkCommandPool>	m_vkFrameCommandPools;
 	std::vector<VkCommandBuffer> m_vkCommandBuffers;
+	std::vector<std::vector<WorkerCommandPool>> m_workerCommandPools;
+	std::vector<VkCommandBuffer> m_frameSecondaries;
+	RecordStats					m_recordStats;
 
 	std::vector<VkSemaphore>	m_vkImageAvailableSemaphores;
 	std::vector<VkSemaphore>	m_vkRenderFinishedSemaphores;
 	std::vector<VkFence>		m_vkInFlightFences;
 
 	VkBuffer					m_vkVertexBuffer;
-	VkDeviceMemory				m_vkVertexBufferMemory;
+	vkHelpers::Allocation		m_vkVertexBufferMemory;
 	VkBuffer					m_vkIndexBuffer;
-	VkDeviceMemory				m_vkIndexBufferMemory;
-	uint16_t					m_vkIndexCount;
+	vkHelpers::Allocation		m_vkIndexBufferMemory;
+	uint32_t					m_vkIndexCount;
+	VkIndexType					m_vkIndexType = VK_INDEX_TYPE_UINT16;
+
+	UniformRingBuffer			m_uniformRing;
 
-	std::vector<VkBuffer>		m_uniformBuffers;
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory;
+	//Scene
+	uint32_t					m_drawCount = 1;
+	std::vector<DrawItem>		m_drawList;
 
 	VkDescriptorPool			m_vkDescriptorPool;
 	std::vector<VkDescriptorSet> m_vkDescriptorSets;
 
+	//Bindless -- set 1 is one big texture array, draws push the index they sample
+	bool						m_bindless = false;
+	BindlessTextureTable		m_bindlessTextures;
+	std::vector<uint32_t>		m_textureSlots;
+
+	//GPU driven -- the draw list lives on the GPU, culled by compute into indirect draws
+	bool						m_gpuDriven = false;
+	GpuCulling					m_gpuCulling;
+	uint32_t					m_frameUniformOffset = 0;
+	glm::mat4					m_frameViewProj;
+	glm::mat4					m_frameMeshTransform;		//the frame's shared rotation, without dequantizing
+	glm::vec3					m_frameCameraPosition;
+	bool						m_clusterCulling = true;
+	bool						m_depthPrepass = false;
+
+	//Occlusion culling -- the pyramid follows the swap chain, each frame's early phase tests against the last one's
+	bool						m_occlusionCulling = true;
+	HiZPyramid					m_hiZ;
+	glm::mat4					m_previousViewProj;
+	bool						m_hiZBuilt = false;		//a frame has built the pyramid since it was (re)created
+
+	//CPU occlusion culling -- draws tested against the nearest few before anything is recorded
+	bool						m_cpuOcclusionCulling = false;
+	OcclusionRasterizer			m_occlusionRasterizer;
+	OccluderMesh				m_occluderMesh;
+	OccluderMesh				m_loadedOccluderMesh;		//m_pLoadedModel's, swapped in with it
+	std::vector<uint32_t>		m_occluderScratch;
+	CpuOcclusionStats			m_cpuOcclusionStats;
+
+	//Instanced -- per instance data on vertex binding 1
+	bool						m_instanced = false;
+	InstanceBuffer				m_instanceBuffer;
+	std::vector<InstanceBatch>	m_instanceBatches;
+	std::vector<InstanceData>	m_instanceScratch;
+	std::vector<uint32_t>		m_lodInstanceOffsets;
+
 	//Models etc... for testing
+	std::string					m_modelPath;
+	VertexFormat				m_vertexFormat = VertexFormat::Full;
+	bool						m_meshOptimization = true;
+	bool						m_lodSelection = true;
+	LodStats					m_lodStats;
 	Model*						m_pModel;
-	Texture*					m_pTexture;
+	std::vector<std::string>	m_texturePaths = { "../Assets/Textures/profile.png" };
+	std::vector<Texture*>		m_pTextures;
+
+	//Streaming -- views change under the draws, descriptors follow them at the start of each frame
+	VkDeviceSize				m_textureBudget = 0;
+	bool						m_textureStreaming = false;
+	TextureStreamer				m_textureStreamer;
+	std::vector<uint32_t>		m_frameTextureVersions;		//view version each frame's set points at
+	std::vector<uint32_t>		m_slotTextureVersions;		//view version each bindless slot holds
+	float						m_frameProjScale = 0.0f;	//pixels across per unit radius at unit depth
+
+	//Asset loads -- decoded on the AssetLoader, staged once ready, swapped in once uploaded
+	bool						m_asyncAssets = false;
+	std::future<std::unique_ptr<Model>> m_modelLoad;
+	std::vector<std::future<std::unique_ptr<TextureData>>> m_textureLoads;
+	std::vector<uint32_t>		m_textureVersions;			//bumped per texture swapped in
+	Model*						m_pLoadedModel = nullptr;
+	VkBuffer					m_loadedVertexBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_loadedVertexBufferMemory;
+	VkBuffer					m_loadedIndexBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_loadedIndexBufferMemory;
+	uint64_t					m_loadedModelTicket = 0;
+	std::vector<Texture*>		m_pLoadedTextures;
+	std::vector<uint64_t>		m_loadedTextureTickets;
+
+	//Swapped out resources, destroyed once no frame in flight can use them
+	struct RetiredAsset {
+		uint64_t				frameNumber;
+		std::function<void(csmntVkApplication*)> destroy;
+	};
+	std::deque<RetiredAsset>	m_retiredAssets;
 
 	VkSampler					m_linearTexSampler;
 
-	//Depth Buffer
-	VkImage						m_vkDepthImage;
-	VkDeviceMemory				m_vkDepthImageMemory;
-	VkImageView					m_vkDepthImageView;
-
-	void createSwapChain(csmntVkApplication*, SwapChainSupportDetails&);
+	void createSwapChain(csmntVkApplication*, SwapChainSupportDetails&, VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+	void createOffscreenTargets(csmntVkApplication*);
+	void createReadbackBuffer(csmntVkApplication*);
+	void deliverReadback(csmntVkApplication*, size_t);
 
 	void createImageViews(VkDevice&);
 
-	void cleanupSwapChain(VkDevice&);
+	void cleanupSwapChain(csmntVkApplication*);
+	void cleanupSwapChainResources(csmntVkApplication*);
+	//Right away, once the present queue is idle -- for when it can't wait its turn
+	void destroyRetiredSwapChain(csmntVkApplication*);
 
 	void createDescriptorSetLayout(VkDevice&);
 
-	void createPipeline(VkDevice&);
-	void createRenderPass(csmntVkApplication*);
-	void createFramebuffers(VkDevice&);
-	void createCommandPool(VkDevice&, VkPhysicalDevice&, VkSurfaceKHR&);
+	void createPipelineLayout(VkDevice&);
+	//The scene's, & the depth prepass' (vertex stage only) when there is one
+	void createPipelines(csmntVkApplication*);
+	VkPipeline createPipeline(csmntVkApplication*, bool depthOnly = false);
+	//Declares the frame's passes & compiles them against the current swap chain
+	void buildRenderGraph(csmntVkApplication*);
+	void createCommandPools(csmntVkApplication*);
+	void destroyCommandPools(VkDevice&);
 	
-	void createVertexBuffer(csmntVkApplication*);
-	void createIndexBuffer(csmntVkApplication*);
+	void createVertexBuffer(csmntVkApplication*, const Model&, VkBuffer&, vkHelpers::Allocation&);
+	void createIndexBuffer(csmntVkApplication*, const Model&, VkBuffer&, vkHelpers::Allocation&);
 	void createUniformBuffers(csmntVkApplication*);
-	void updateUniformBuffer(uint32_t, VkDevice&);
+	void updateUniformBuffer(uint32_t, VkDevice&, JobSystem&);
+	void createDrawList();
 
 	void createTextureSampler(csmntVkApplication*);
 
-	//Depth Buffer
-	void createDepthResources(csmntVkApplication*);
-	void cleanupDepthResources(csmntVkApplication*);
-	VkFormat findDepthFormat(VkPhysicalDevice&);
+	//Depth Buffer -- sampled: one the hi-z build can read, without stencil
+	VkFormat findDepthFormat(VkPhysicalDevice&, bool sampled = false);
 
 	void createTexture(csmntVkApplication*);
 	void cleanupTexture(csmntVkApplication*);
+	Texture* createPlaceholderTexture(csmntVkApplication*);
+	const uint32_t getTextureCount() const;
+	VkImageView getTextureView(uint32_t texture) const;
+	const uint32_t getTextureVersion(uint32_t texture) const;
+
+	//Asset loads are queued before any device objects are made, so decoding overlaps them
+	void startAssetLoads(csmntVkApplication*);
+	void cleanupAssetLoads(csmntVkApplication*);
+
+	//Start of every frame, after its fence wait: frees retired assets, swaps in loads & stream ins,
+	//then points the frame's descriptors at whatever changed
+	void updateAssets(csmntVkApplication*, size_t frame);
+	void updateAssetLoads(csmntVkApplication*);
+	//Per draw LOD from this frame's camera -- after m_frameViewProj is set
+	void selectLods();
+	//CPU occlusion -- the buffer follows the swap chain's aspect, the mesh is copied before the model lets go of it
+	void createOcclusionBuffer();
+	void captureOccluderMesh(const Model&, OccluderMesh&);
+	//Sets each draw's visible from this frame's camera -- after m_frameViewProj is set
+	void cullOccludedDraws(JobSystem&);
+
+	//Feeds last frame's on-screen sizes to the streamer
+	void updateTextureStreaming(csmntVkApplication*);
+	void refreshTextureDescriptors(csmntVkApplication*, size_t frame);
 
 	void createDescriptorPool(VkDevice&);
 	void createDescriptorSets(VkDevice&);
 
 	void createCommandBuffers(VkDevice&);
+	void recordCommandBuffer(csmntVkApplication*, size_t frame, uint32_t imageIndex);
+	void recordDrawRange(VkCommandBuffer, size_t frame, VkFramebuffer, uint32_t firstDraw, uint32_t drawCount);
+	//Pipeline, viewport & the bindings every inline draw shares
+	void bindInlineDrawState(VkCommandBuffer, size_t frame, VkPipeline);
+	void recordInlineDraws(VkCommandBuffer, size_t frame);
+	//GPU driven -- each phase's culled draws, in order
+	void recordIndirectDraws(VkCommandBuffer, size_t frame, VkPipeline, const std::vector<GpuCulling::Phase>& phases);
+	VkCommandBuffer acquireSecondaryCommandBuffer(VkDevice&, size_t frame, uint32_t worker);
 	void createSemaphoresAndFences(VkDevice&);
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>&);
-	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>);
+	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>&);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR&, GLFWwindow*);
-
-	VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice*);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,422 @@
+#include "HiZPyramid.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#pragma region CREATE & CLEANUP
+void HiZPyramid::create(csmntVkApplication* pApp, VkExtent2D depthExtent, uint32_t framesInFlight)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	//Rounding down keeps every level an exact 2:1 of the one below, a level 0 texel covers at most 3x3 depth texels
+	auto previousPowerOf2 = [](uint32_t value) {
+		uint32_t power = 1;
+		while (power * 2 <= value && power * 2 <= (1u << (s_maxLevels - 1))) {
+			power *= 2;
+		}
+		return power;
+	};
+
+	m_depthExtent = depthExtent;
+	m_extent = { previousPowerOf2(depthExtent.width), previousPowerOf2(depthExtent.height) };
+	m_levelCount = 1;
+	while ((std::max(m_extent.width, m_extent.height) >> m_levelCount) > 0) {
+		m_levelCount++;
+	}
+	m_framesInFlight = framesInFlight;
+
+	vkHelpers::createVkImage(device, pApp->getAllocator(), m_extent.width, m_extent.height, s_format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_imageMemory, m_levelCount);
+
+	m_view = vkHelpers::createVkImageView(device, m_image, s_format, VK_IMAGE_ASPECT_COLOR_BIT, m_levelCount);
+
+	//A storage view per level, the build writes them all
+	m_levelViews.resize(m_levelCount);
+	for (uint32_t level = 0; level < m_levelCount; level++) {
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = m_image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = s_format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &viewInfo, nullptr, &m_levelViews[level]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create hi-z level view!");
+		}
+	}
+
+	//Readers texelFetch exact texels, never filter
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(m_levelCount);
+	samplerInfo.mipLodBias = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z sampler!");
+	}
+
+	VkDeviceSize counterSize = sizeof(uint32_t) * m_framesInFlight;
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), counterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_counterBuffer, m_counterBufferMemory);
+
+	createDescriptors(device);
+	createPipeline(pApp);
+	transitionToShaderRead(pApp);
+
+#if _DEBUG
+	std::cout << "HEY! hi-z pyramid " << m_extent.width << "x" << m_extent.height << ", " << m_levelCount << " levels" << std::endl;
+#endif
+}
+
+void HiZPyramid::createDescriptors(VkDevice& device)
+{
+	//0 = depth buffer, 1 = a storage image per level, 2 = finished workgroup counters
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = s_maxLevels;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	for (VkDescriptorSetLayoutBinding& binding : bindings) {
+		binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		binding.pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_vkDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	for (size_t i = 0; i < poolSizes.size(); i++) {
+		poolSizes[i].type = bindings[i].descriptorType;
+		poolSizes[i].descriptorCount = bindings[i].descriptorCount;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_vkDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z descriptor pool!");
+	}
+
+	//One set for every frame -- each frame's counter is picked by push constant
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_vkDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_vkDescriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &m_vkDescriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate hi-z descriptor set!");
+	}
+
+	//The shader indexes every element, levels past the top repeat it
+	std::array<VkDescriptorImageInfo, s_maxLevels> levelInfos = {};
+	for (uint32_t level = 0; level < s_maxLevels; level++) {
+		levelInfos[level].sampler = VK_NULL_HANDLE;
+		levelInfos[level].imageView = m_levelViews[std::min(level, m_levelCount - 1)];
+		levelInfos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	VkDescriptorBufferInfo counterInfo = {};
+	counterInfo.buffer = m_counterBuffer;
+	counterInfo.offset = 0;
+	counterInfo.range = VK_WHOLE_SIZE;
+
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = m_vkDescriptorSet;
+	descriptorWrites[0].dstBinding = 1;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[0].descriptorCount = s_maxLevels;
+	descriptorWrites[0].pImageInfo = levelInfos.data();
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = m_vkDescriptorSet;
+	descriptorWrites[1].dstBinding = 2;
+	descriptorWrites[1].dstArrayElement = 0;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[1].descriptorCount = 1;
+	descriptorWrites[1].pBufferInfo = &counterInfo;
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void HiZPyramid::createPipeline(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(BuildConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_vkDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z pipeline layout!");
+	}
+
+	PipelineCache& pipelineCache = pApp->getPipelineCache();
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = pipelineCache.getShaderModule(device, "../Shaders/hiz.spv");
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_vkPipelineLayout;
+
+	//Owned by the cache
+	m_vkPipeline = pipelineCache.getComputePipeline(device, pipelineInfo);
+}
+
+void HiZPyramid::transitionToShaderRead(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	//Frames import the pyramid as it was left by the last one, so it has to start out in that layout
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = pApp->getQueueFamilyIndices().graphicsFamily.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z command pool!");
+	}
+
+	VkCommandBuffer commandBuffer = vkHelpers::beginSingleTimeCommands(commandPool, device);
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = m_levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkHelpers::endSingleTimeCommands(commandBuffer, pApp->getGraphicsQueue(), device, commandPool);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+void HiZPyramid::cleanup(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	//Takes the cached pipeline with it -- the next create() may well get the same layout handle back
+	pApp->getPipelineCache().releasePipelineLayout(device, m_vkPipelineLayout);
+	vkDestroyPipelineLayout(device, m_vkPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, m_vkDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_vkDescriptorSetLayout, nullptr);
+
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), m_counterBuffer, m_counterBufferMemory);
+
+	vkDestroySampler(device, m_sampler, nullptr);
+	for (VkImageView view : m_levelViews) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+	vkDestroyImageView(device, m_view, nullptr);
+	vkHelpers::destroyVkImage(device, pApp->getAllocator(), m_image, m_imageMemory);
+
+	m_vkPipelineLayout = VK_NULL_HANDLE;
+	m_vkDescriptorPool = VK_NULL_HANDLE;
+	m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	m_vkDescriptorSet = VK_NULL_HANDLE;
+	m_vkPipeline = VK_NULL_HANDLE;
+	m_sampler = VK_NULL_HANDLE;
+	m_levelViews.clear();
+	m_view = VK_NULL_HANDLE;
+	m_levelCount = 0;
+}
+#pragma endregion
+
+#pragma region EVERY FRAME
+void HiZPyramid::setDepthView(VkDevice& device, VkImageView depthView)
+{
+	VkDescriptorImageInfo depthInfo = {};
+	depthInfo.sampler = m_sampler;
+	depthInfo.imageView = depthView;
+	depthInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_vkDescriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &depthInfo;
+
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void HiZPyramid::recordBuild(VkCommandBuffer commandBuffer, size_t frame)
+{
+	//The frame's fence has already been waited on, nobody is still counting on last time's value
+	const VkDeviceSize counterOffset = frame * sizeof(uint32_t);
+	vkCmdFillBuffer(commandBuffer, m_counterBuffer, counterOffset, sizeof(uint32_t), 0);
+
+	VkBufferMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.buffer = m_counterBuffer;
+	clearBarrier.offset = counterOffset;
+	clearBarrier.size = sizeof(uint32_t);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+	//A workgroup per 32x32 tile of level 0
+	const uint32_t groupsX = (m_extent.width + s_tileSize - 1) / s_tileSize;
+	const uint32_t groupsY = (m_extent.height + s_tileSize - 1) / s_tileSize;
+
+	BuildConstants constants = {};
+	constants.depthSize[0] = static_cast<int32_t>(m_depthExtent.width);
+	constants.depthSize[1] = static_cast<int32_t>(m_depthExtent.height);
+	constants.pyramidSize[0] = static_cast<int32_t>(m_extent.width);
+	constants.pyramidSize[1] = static_cast<int32_t>(m_extent.height);
+	constants.levelCount = static_cast<int32_t>(m_levelCount);
+	constants.groupCount = groupsX * groupsY;
+	constants.frame = static_cast<uint32_t>(frame);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkPipelineLayout, 0, 1, &m_vkDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_vkPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BuildConstants), &constants);
+	vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
+#pragma endregion
+
+#pragma region SELF CHECK
+void HiZPyramid::readLevel0(csmntVkApplication* pApp, std::vector<float>& depths)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	VkBuffer readback;
+	vkHelpers::Allocation readbackMemory;
+	VkDeviceSize readbackSize = static_cast<VkDeviceSize>(m_extent.width) * m_extent.height * sizeof(float);
+	vkHelpers::createVkBuffer(device, pApp->getAllocator(), readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readback, readbackMemory);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = pApp->getQueueFamilyIndices().graphicsFamily.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z readback command pool!");
+	}
+
+	VkCommandBuffer commandBuffer = vkHelpers::beginSingleTimeCommands(commandPool, device);
+
+	//Out of & back into the layout frames expect to find it in
+	std::array<VkImageMemoryBarrier, 2> barriers = {};
+	for (VkImageMemoryBarrier& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barriers[0]);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { m_extent.width, m_extent.height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1, &region);
+
+	VkBufferMemoryBarrier hostBarrier = {};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.buffer = readback;
+	hostBarrier.offset = 0;
+	hostBarrier.size = readbackSize;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 1, &hostBarrier, 1, &barriers[1]);
+
+	vkHelpers::endSingleTimeCommands(commandBuffer, pApp->getGraphicsQueue(), device, commandPool);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+
+	depths.resize(static_cast<size_t>(m_extent.width) * m_extent.height);
+	memcpy(depths.data(), readbackMemory.pMapped, static_cast<size_t>(readbackSize));
+
+	vkHelpers::destroyVkBuffer(device, pApp->getAllocator(), readback, readbackMemory);
+}
+#pragma endregion
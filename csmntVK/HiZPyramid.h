@@ -0,0 +1,95 @@
+#pragma once
+#ifndef _HIZ_PYRAMID_
+#define _HIZ_PYRAMID_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "vkMemoryAllocator.h"
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---HiZPyramid:
+//---Hierarchical Z for occlusion culling. A mip chain where
+//---each texel holds the farthest depth under it, so a
+//---bounds' nearest depth past the texel(s) covering it means
+//---it's hidden. Level 0 is the depth buffer rounded down to a
+//---power of 2, built along with every other level in one
+//---dispatch: workgroups reduce their 32x32 tile down to
+//---level 5 in shared memory & the last one to finish
+//---carries on to 1x1, instead of a dispatch & barrier per
+//---level. Follows the swap chain extent -- recreate it with
+//---the render graph
+/////////////////////////////////////////////////////
+
+class HiZPyramid {
+public:
+	HiZPyramid() {};
+	~HiZPyramid() {};
+
+	//Left in SHADER_READ_ONLY_OPTIMAL, contents undefined until the first recordBuild()
+	void create(csmntVkApplication*, VkExtent2D depthExtent, uint32_t framesInFlight);
+	void cleanup(csmntVkApplication*);
+
+	//The depth buffer to build from, a depth aspect view read in SHADER_READ_ONLY_OPTIMAL.
+	//Call before the first recordBuild() & whenever the view changes, with no frame in flight
+	void setDepthView(VkDevice&, VkImageView depthView);
+
+	//Outside a render pass: the whole chain from the depth buffer. Every level is written in GENERAL
+	//& the depth buffer read -- the caller owns the barriers on either side
+	void recordBuild(VkCommandBuffer, size_t frame);
+
+	//Level 0 back to the host, row by row, for checking culling against. No frame may be in flight
+	void readLevel0(csmntVkApplication*, std::vector<float>& depths);
+
+	const VkImage& getImage() const { return m_image; };
+	//Every level, for texelFetch through getSampler()
+	const VkImageView& getView() const { return m_view; };
+	const VkSampler& getSampler() const { return m_sampler; };
+	const VkExtent2D getExtent() const { return m_extent; };
+	const uint32_t getLevelCount() const { return m_levelCount; };
+
+	static const VkFormat		s_format = VK_FORMAT_R32_SFLOAT;
+	//Matches hiz.comp -- level 0 up to 8192 across
+	static const uint32_t		s_maxLevels = 14;
+
+private:
+	//Matches hiz.comp
+	struct BuildConstants {
+		int32_t		depthSize[2];
+		int32_t		pyramidSize[2];
+		int32_t		levelCount;
+		uint32_t	groupCount;
+		uint32_t	frame;
+	};
+
+	void createDescriptors(VkDevice&);
+	void createPipeline(csmntVkApplication*);
+	void transitionToShaderRead(csmntVkApplication*);
+
+	VkExtent2D					m_depthExtent = { 0, 0 };
+	VkExtent2D					m_extent = { 0, 0 };
+	uint32_t					m_levelCount = 0;
+	uint32_t					m_framesInFlight = 0;
+
+	VkImage						m_image = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_imageMemory;
+	VkImageView					m_view = VK_NULL_HANDLE;
+	std::vector<VkImageView>	m_levelViews;
+	VkSampler					m_sampler = VK_NULL_HANDLE;
+
+	//Workgroups done with their tile, one counter per frame in flight -- the last one in builds the tail
+	VkBuffer					m_counterBuffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation		m_counterBufferMemory;
+
+	VkDescriptorSetLayout		m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool			m_vkDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet				m_vkDescriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout			m_vkPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline					m_vkPipeline = VK_NULL_HANDLE;
+
+	//Level 0 texels per workgroup, across
+	static const uint32_t		s_tileSize = 32;
+};
+
+#endif // !_HIZ_PYRAMID_
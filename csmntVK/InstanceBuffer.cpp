@@ -0,0 +1,48 @@
+#include "InstanceBuffer.h"
+#include <stdexcept>
+#include <cstring>
+#include "vkHelpers.h"
+#include "Application.h"
+
+void InstanceBuffer::create(csmntVkApplication* pApp, uint32_t regionCount, uint32_t instancesPerRegion)
+{
+	m_instancesPerRegion = instancesPerRegion;
+	m_regionCount = regionCount;
+
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(m_instancesPerRegion) * m_regionCount * sizeof(InstanceData);
+
+	//Rewritten every frame, so host visible -- read straight over the bus like the UBOs
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), bufferSize,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_buffer, m_bufferMemory);
+
+	if (!m_bufferMemory.pMapped) {
+		throw std::runtime_error("instance buffer memory is not host visible!");
+	}
+
+	beginRegion(0);
+}
+
+void InstanceBuffer::cleanup(csmntVkApplication* pApp)
+{
+	vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_buffer, m_bufferMemory);
+}
+
+void InstanceBuffer::beginRegion(uint32_t region)
+{
+	m_cursor = region * m_instancesPerRegion;
+	m_regionEnd = m_cursor + m_instancesPerRegion;
+}
+
+uint32_t InstanceBuffer::push(const InstanceData* pInstances, uint32_t count)
+{
+	if (m_cursor + count > m_regionEnd) {
+		throw std::runtime_error("instance buffer region overflow!");
+	}
+
+	uint32_t firstInstance = m_cursor;
+	memcpy(static_cast<InstanceData*>(m_bufferMemory.pMapped) + firstInstance, pInstances, count * sizeof(InstanceData));
+	m_cursor += count;
+
+	return firstInstance;
+}
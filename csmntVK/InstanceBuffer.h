@@ -0,0 +1,48 @@
+#pragma once
+#ifndef _INSTANCE_BUFFER_
+#define _INSTANCE_BUFFER_
+
+#include <vulkan/vulkan.h>
+#include "vkMemoryAllocator.h"
+#include "Model.h"
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---InstanceBuffer:
+//---Per instance vertex data (binding 1), one persistently
+//---mapped region per frame in flight. Instances are pushed
+//---into the current region each frame; the buffer is bound
+//---once at offset 0 and draws find their instances through
+//---firstInstance
+/////////////////////////////////////////////////////
+
+class InstanceBuffer {
+public:
+	InstanceBuffer() {};
+	~InstanceBuffer() {};
+
+	void create(csmntVkApplication*, uint32_t regionCount, uint32_t instancesPerRegion);
+	void cleanup(csmntVkApplication*);
+
+	//Rewind to the start of a region -- only once the GPU is done with its frame
+	void beginRegion(uint32_t region);
+
+	//Copy instances into the current region, returns the firstInstance to draw them with
+	uint32_t push(const InstanceData* pInstances, uint32_t count);
+
+	const VkBuffer& getVkBuffer() const { return m_buffer; };
+	const uint32_t getCapacity() const { return m_instancesPerRegion; };
+
+private:
+	VkBuffer				m_buffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation	m_bufferMemory;
+
+	uint32_t				m_instancesPerRegion = 0;
+	uint32_t				m_regionCount = 0;
+
+	uint32_t				m_regionEnd = 0;
+	uint32_t				m_cursor = 0;
+};
+
+#endif // !_INSTANCE_BUFFER_
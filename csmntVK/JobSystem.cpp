@@ -0,0 +1,131 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <iostream>
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+void JobSystem::create(uint32_t workerCount)
+{
+	if (workerCount == 0) {
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_stop = false;
+
+	//Worker 0 is whoever calls parallelFor
+	for (uint32_t i = 1; i < workerCount; i++) {
+		m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+
+	m_activeWorkers = workerCount;
+
+#if _DEBUG
+	std::cout << "HEY! job system created with " << workerCount << " workers" << std::endl;
+#endif
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+}
+
+void JobSystem::setActiveWorkerCount(uint32_t count)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_activeWorkers = std::min(std::max(1u, count), getWorkerCount());
+}
+
+void JobSystem::runParallel(uint32_t jobCount, const JobRef& job)
+{
+	if (jobCount == 0) {
+		return;
+	}
+
+	//Not worth waking anyone up for
+	if (jobCount == 1 || m_activeWorkers == 1) {
+		for (uint32_t i = 0; i < jobCount; i++) {
+			job.pInvoke(job.pFunction, i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = job;
+		m_jobCount = jobCount;
+		m_nextJob = 0;
+		m_jobsRemaining = jobCount;
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	//Lend a hand rather than sleep
+	runJobs(0);
+
+	//Wait for the stragglers, and for every worker to let go of fn
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_jobsRemaining == 0 && m_busyWorkers == 0; });
+	m_job.pFunction = nullptr;
+}
+
+void JobSystem::runJobs(uint32_t workerIndex)
+{
+	for (;;) {
+		uint32_t job = m_nextJob.fetch_add(1);
+		if (job >= m_jobCount) {
+			break;
+		}
+
+		m_job.pInvoke(m_job.pFunction, job, workerIndex);
+
+		if (m_jobsRemaining.fetch_sub(1) == 1) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_doneCondition.notify_all();
+		}
+	}
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex)
+{
+	uint64_t seenGeneration = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&] { return m_stop || (m_generation != seenGeneration && m_job.pFunction != nullptr); });
+
+			if (m_stop) {
+				return;
+			}
+
+			seenGeneration = m_generation;
+
+			//Sit this batch out when benchmarking with fewer workers
+			if (workerIndex >= m_activeWorkers) {
+				continue;
+			}
+
+			++m_busyWorkers;
+		}
+
+		runJobs(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busyWorkers;
+		}
+		m_doneCondition.notify_all();
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef _JOB_SYSTEM_
+#define _JOB_SYSTEM_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/////////////////////////////////////////////////////
+//---JobSystem:
+//---Fixed pool of worker threads for fork/join work
+//---(parallelFor). The calling thread joins in as worker 0,
+//---so per-worker resources (command pools etc) can be
+//---indexed by the worker index handed to each job
+/////////////////////////////////////////////////////
+
+class JobSystem {
+public:
+	JobSystem() {};
+	~JobSystem();
+	JobSystem(JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//workerCount includes the calling thread, 0 = one per hardware thread
+	void create(uint32_t workerCount = 0);
+	void shutdown();
+
+	//Run every job & block until they are all done -- fn(jobIndex, workerIndex). fn is only
+	//borrowed for the call, never copied into a std::function, so it costs no heap allocation
+	template<typename Function>
+	void parallelFor(uint32_t jobCount, const Function& fn)
+	{
+		JobRef job = { &fn, [](const void* pFunction, uint32_t jobIndex, uint32_t workerIndex) {
+			(*static_cast<const Function*>(pFunction))(jobIndex, workerIndex);
+		} };
+		runParallel(jobCount, job);
+	}
+
+	const uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_threads.size()) + 1; };
+
+	//Limit how many workers pick up jobs (benchmarking), clamped to getWorkerCount()
+	void setActiveWorkerCount(uint32_t count);
+	const uint32_t getActiveWorkerCount() const { return m_activeWorkers; };
+
+private:
+	//A parallelFor's fn, type erased without owning it
+	struct JobRef {
+		const void*		pFunction;
+		void			(*pInvoke)(const void* pFunction, uint32_t jobIndex, uint32_t workerIndex);
+	};
+
+	void runParallel(uint32_t jobCount, const JobRef& job);
+	void workerLoop(uint32_t workerIndex);
+	void runJobs(uint32_t workerIndex);
+
+	std::vector<std::thread>	m_threads;
+
+	std::mutex					m_mutex;
+	std::condition_variable		m_wakeCondition;
+	std::condition_variable		m_doneCondition;
+
+	//Current batch -- only replaced once every worker has let go of the last one
+	JobRef						m_job = { nullptr, nullptr };
+	uint32_t					m_jobCount = 0;
+	std::atomic<uint32_t>		m_nextJob = { 0 };
+	std::atomic<uint32_t>		m_jobsRemaining = { 0 };
+	uint32_t					m_busyWorkers = 0;
+	uint64_t					m_generation = 0;
+
+	uint32_t					m_activeWorkers = 1;
+	bool						m_stop = false;
+};
+
+#endif // !_JOB_SYSTEM_
@@ -0,0 +1,338 @@
+#include "Ktx2File.h"
+#include "BlockCompression.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+void Ktx2File::open(const std::string& path)
+{
+	close();
+	m_file.open(path);
+
+	const uint8_t* pData = m_file.getData();
+	const uint64_t fileSize = m_file.getSize();
+
+	if (fileSize < sizeof(Ktx2Header)) {
+		close();
+		throw std::runtime_error("ktx2 file is truncated: " + path);
+	}
+
+	const Ktx2Header* pHeader = reinterpret_cast<const Ktx2Header*>(pData);
+
+	if (std::memcmp(pHeader->identifier, s_ktx2Identifier, sizeof(s_ktx2Identifier)) != 0) {
+		close();
+		throw std::runtime_error("not a ktx2 file: " + path);
+	}
+	//Anything that would need inflating or re-laying out before upload
+	if (pHeader->supercompressionScheme != 0 || pHeader->pixelDepth > 1 || pHeader->layerCount > 1 || pHeader->faceCount != 1) {
+		close();
+		throw std::runtime_error("ktx2 file isn't a plain 2D texture: " + path);
+	}
+	if (getExpectedLevelSize(static_cast<VkFormat>(pHeader->vkFormat), 1, 1) == 0) {
+		close();
+		throw std::runtime_error("ktx2 file has an unsupported format: " + path);
+	}
+
+	const uint32_t levelCount = std::max(pHeader->levelCount, 1u);
+	if (pHeader->pixelWidth == 0 || pHeader->pixelHeight == 0 ||
+		levelCount > mipChain::getMipLevelCount(pHeader->pixelWidth, pHeader->pixelHeight) ||
+		fileSize < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex)) {
+		close();
+		throw std::runtime_error("ktx2 file is corrupt: " + path);
+	}
+
+	//Levels have to sit inside the file, block aligned & the size the format says -- they go to the GPU as is
+	const VkDeviceSize blockBytes = getExpectedLevelSize(static_cast<VkFormat>(pHeader->vkFormat), 1, 1);
+	const Ktx2LevelIndex* pLevels = reinterpret_cast<const Ktx2LevelIndex*>(pData + sizeof(Ktx2Header));
+	for (uint32_t i = 0; i < levelCount; i++) {
+		const uint32_t width = std::max(pHeader->pixelWidth >> i, 1u);
+		const uint32_t height = std::max(pHeader->pixelHeight >> i, 1u);
+		if (pLevels[i].byteOffset % blockBytes != 0 ||
+			pLevels[i].byteOffset > fileSize || pLevels[i].byteLength > fileSize - pLevels[i].byteOffset ||
+			pLevels[i].byteLength != getExpectedLevelSize(static_cast<VkFormat>(pHeader->vkFormat), width, height)) {
+			close();
+			throw std::runtime_error("ktx2 file is corrupt: " + path);
+		}
+	}
+
+	m_pHeader = pHeader;
+	m_pLevels = pLevels;
+	m_levelCount = levelCount;
+}
+
+const uint8_t* Ktx2File::getPackedLevels(std::vector<MipLevel>& levels, VkDeviceSize& size) const
+{
+	uint64_t begin = UINT64_MAX, end = 0;
+	for (uint32_t i = 0; i < m_levelCount; i++) {
+		begin = std::min(begin, m_pLevels[i].byteOffset);
+		end = std::max(end, m_pLevels[i].byteOffset + m_pLevels[i].byteLength);
+	}
+
+	levels.resize(m_levelCount);
+	for (uint32_t i = 0; i < m_levelCount; i++) {
+		levels[i].offset = m_pLevels[i].byteOffset - begin;
+		levels[i].width = std::max(m_pHeader->pixelWidth >> i, 1u);
+		levels[i].height = std::max(m_pHeader->pixelHeight >> i, 1u);
+	}
+
+	size = end - begin;
+	return m_file.getData() + begin;
+}
+
+VkDeviceSize Ktx2File::getExpectedLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	BlockFormatInfo info;
+	if (blockCompression::getBlockInfo(format, info)) {
+		return blockCompression::getImageSize(format, width, height);
+	}
+	if (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB) {
+		return static_cast<VkDeviceSize>(width) * height * 4;
+	}
+	return 0;
+}
+
+void Ktx2File::decodeLevels(std::vector<MipLevel>& levels, std::vector<uint8_t>& rgba) const
+{
+	levels.resize(m_levelCount);
+	rgba.clear();
+	for (uint32_t i = 0; i < m_levelCount; i++) {
+		levels[i].offset = rgba.size();
+		levels[i].width = std::max(getWidth() >> i, 1u);
+		levels[i].height = std::max(getHeight() >> i, 1u);
+
+		rgba.resize(rgba.size() + static_cast<size_t>(levels[i].width) * levels[i].height * 4);
+		blockCompression::decodeImage(getFormat(), getLevelData(i), levels[i].width, levels[i].height, rgba.data() + levels[i].offset);
+	}
+}
+
+namespace ktx2 {
+	namespace {
+		//Encodings looked for next to a .ktx2 -- profile.ktx2, profile.bc7.ktx2, profile.etc2.ktx2...
+		const char* s_variants[] = { "bc7", "bc3", "bc1", "astc", "etc2" };
+
+		bool fileExists(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			return file.good();
+		}
+
+		//Data format descriptor values (Khronos Data Format spec)
+		const uint32_t s_dfdModelRgbsda = 1;
+		const uint32_t s_dfdModelBc1a = 128;
+		const uint32_t s_dfdModelBc3 = 130;
+		const uint32_t s_dfdModelBc7 = 134;
+		const uint32_t s_dfdPrimariesBt709 = 1;
+		const uint32_t s_dfdTransferLinear = 1;
+		const uint32_t s_dfdTransferSrgb = 2;
+		const uint32_t s_dfdChannelAlpha = 15;
+		const uint32_t s_dfdQualifierLinear = 0x10;
+
+		struct DfdSample {
+			uint32_t	bitOffset;
+			uint32_t	bitLength;
+			uint32_t	channel;
+			uint32_t	upper;
+		};
+
+		//Basic descriptor block for one of the formats we write
+		std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format)
+		{
+			const bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+				format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+			//Alpha is never sRGB encoded
+			const uint32_t alphaChannel = s_dfdChannelAlpha | (srgb ? s_dfdQualifierLinear : 0);
+
+			uint32_t model, blockDimension, bytesPlane;
+			std::vector<DfdSample> samples;
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				model = s_dfdModelRgbsda;
+				blockDimension = 0;
+				bytesPlane = 4;
+				samples = { { 0, 7, 0, 255 }, { 8, 7, 1, 255 }, { 16, 7, 2, 255 }, { 24, 7, alphaChannel, 255 } };
+				break;
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				model = s_dfdModelBc1a;
+				blockDimension = 0x0303;
+				bytesPlane = 8;
+				samples = { { 0, 63, 0, UINT32_MAX } };
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				model = s_dfdModelBc3;
+				blockDimension = 0x0303;
+				bytesPlane = 16;
+				samples = { { 0, 63, alphaChannel, UINT32_MAX }, { 64, 63, 0, UINT32_MAX } };
+				break;
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				model = s_dfdModelBc7;
+				blockDimension = 0x0303;
+				bytesPlane = 16;
+				samples = { { 0, 127, 0, UINT32_MAX } };
+				break;
+			default:
+				throw std::runtime_error("no ktx2 data format descriptor for this format!");
+			}
+
+			const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+			std::vector<uint32_t> words = {
+				4 + blockSize,														//total size
+				0,																	//vendor 0 (Khronos), type 0 (basic)
+				2 | (blockSize << 16),												//version 2
+				model | (s_dfdPrimariesBt709 << 8) | ((srgb ? s_dfdTransferSrgb : s_dfdTransferLinear) << 16),
+				blockDimension,
+				bytesPlane,
+				0
+			};
+			for (const DfdSample& sample : samples) {
+				words.push_back(sample.bitOffset | (sample.bitLength << 16) | (sample.channel << 24));
+				words.push_back(0);
+				words.push_back(0);
+				words.push_back(sample.upper);
+			}
+			return words;
+		}
+
+		uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	bool isKtx2Path(const std::string& path)
+	{
+		const std::string ext = ".ktx2";
+		return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+	}
+
+	VkFormat getUnormFormat(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_SRGB:			return VK_FORMAT_R8G8B8A8_UNORM;
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:		return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case VK_FORMAT_BC2_SRGB_BLOCK:			return VK_FORMAT_BC2_UNORM_BLOCK;
+		case VK_FORMAT_BC3_SRGB_BLOCK:			return VK_FORMAT_BC3_UNORM_BLOCK;
+		case VK_FORMAT_BC7_SRGB_BLOCK:			return VK_FORMAT_BC7_UNORM_BLOCK;
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:	return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:	return VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK;
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:	return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:		return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:		return VK_FORMAT_ASTC_5x5_UNORM_BLOCK;
+		default:								return format;
+		}
+	}
+
+	VkFormat openSampledVariant(VkPhysicalDevice& physicalDevice, const std::string& path, Ktx2File& file)
+	{
+		std::vector<std::string> paths;
+		if (fileExists(path)) {
+			paths.push_back(path);
+		}
+		const std::string stem = path.substr(0, path.size() - std::string(".ktx2").size());
+		for (const char* variant : s_variants) {
+			const std::string variantPath = stem + "." + variant + ".ktx2";
+			if (fileExists(variantPath)) {
+				paths.push_back(variantPath);
+			}
+		}
+		if (paths.empty()) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+
+		//Only the headers & level index get touched here, the mappings are cheap
+		std::vector<VkFormat> formats;
+		for (const std::string& filePath : paths) {
+			file.open(filePath);
+			formats.push_back(getUnormFormat(file.getFormat()));
+		}
+		file.close();
+
+		try {
+			VkFormat format = vkHelpers::findSupportedFormat(physicalDevice, formats, VK_IMAGE_TILING_OPTIMAL,
+				VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+			file.open(paths[std::find(formats.begin(), formats.end(), format) - formats.begin()]);
+			return format;
+		}
+		catch (const std::runtime_error&) {
+			//Nothing the device can sample -- the caller transcodes
+		}
+
+		for (size_t i = 0; i < paths.size(); i++) {
+			if (blockCompression::canDecode(formats[i])) {
+				file.open(paths[i]);
+				return VK_FORMAT_UNDEFINED;
+			}
+		}
+		throw std::runtime_error("no variant of " + path + " can be sampled or decoded on this device!");
+	}
+
+	void writeKtx2(const std::string& path, VkFormat format, const std::vector<MipLevel>& levels, const uint8_t* pData)
+	{
+		if (levels.empty()) {
+			throw std::runtime_error("failed to write " + path + ", no levels!");
+		}
+
+		const std::vector<uint32_t> dfd = buildDataFormatDescriptor(format);
+		const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+		Ktx2Header header = {};
+		std::memcpy(header.identifier, s_ktx2Identifier, sizeof(s_ktx2Identifier));
+		header.vkFormat = static_cast<uint32_t>(format);
+		header.typeSize = 1;
+		header.pixelWidth = levels[0].width;
+		header.pixelHeight = levels[0].height;
+		header.faceCount = 1;
+		header.levelCount = levelCount;
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+		header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+		//Levels go smallest first, each on a block (& 4 byte) boundary
+		const uint64_t alignment = std::max<uint64_t>(Ktx2File::getExpectedLevelSize(format, 1, 1), 4);
+		std::vector<Ktx2LevelIndex> levelIndex(levelCount);
+		uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+		for (uint32_t i = levelCount; i-- > 0;) {
+			offset = alignUp(offset, alignment);
+			levelIndex[i].byteOffset = offset;
+			levelIndex[i].byteLength = Ktx2File::getExpectedLevelSize(format, levels[i].width, levels[i].height);
+			levelIndex[i].uncompressedByteLength = levelIndex[i].byteLength;
+			offset += levelIndex[i].byteLength;
+		}
+
+		//Same write-to-the-side & swap as the mesh cooker
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to write " + path);
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+			file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+
+			uint64_t position = header.dfdByteOffset + header.dfdByteLength;
+			static const char s_zeros[16] = {};
+			for (uint32_t i = levelCount; i-- > 0;) {
+				file.write(s_zeros, static_cast<std::streamsize>(levelIndex[i].byteOffset - position));
+				file.write(reinterpret_cast<const char*>(pData + levels[i].offset), static_cast<std::streamsize>(levelIndex[i].byteLength));
+				position = levelIndex[i].byteOffset + levelIndex[i].byteLength;
+			}
+
+			if (!file.good()) {
+				throw std::runtime_error("failed to write " + path);
+			}
+		}
+
+		std::remove(path.c_str());
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+			throw std::runtime_error("failed to write " + path);
+		}
+	}
+}
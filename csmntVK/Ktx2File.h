@@ -0,0 +1,102 @@
+#pragma once
+#ifndef _KTX2_FILE_
+#define _KTX2_FILE_
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "MappedFile.h"
+#include "MipChain.h"
+
+//KTX 2.0 file header (khronos.org/ktx), little endian. A level index of
+//levelCount Ktx2LevelIndex entries follows it straight away
+struct Ktx2Header {
+	uint8_t		identifier[12];
+	uint32_t	vkFormat;
+	uint32_t	typeSize;
+	uint32_t	pixelWidth;
+	uint32_t	pixelHeight;
+	uint32_t	pixelDepth;
+	uint32_t	layerCount;
+	uint32_t	faceCount;
+	uint32_t	levelCount;		//0 = generate mips at load -- treated as 1 here
+	uint32_t	supercompressionScheme;
+	uint32_t	dfdByteOffset;
+	uint32_t	dfdByteLength;
+	uint32_t	kvdByteOffset;
+	uint32_t	kvdByteLength;
+	uint64_t	sgdByteOffset;
+	uint64_t	sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+	uint64_t	byteOffset;
+	uint64_t	byteLength;
+	uint64_t	uncompressedByteLength;
+};
+
+const uint8_t s_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+/////////////////////////////////////////////////////
+//---Ktx2File:
+//---Maps a .ktx2 & validates the header & level index.
+//---Only plain 2D textures -- no supercompression,
+//---arrays, cubemaps or 3D. Level data is handed out
+//---as pointers into the mapping, ready for staging
+/////////////////////////////////////////////////////
+
+class Ktx2File {
+public:
+	Ktx2File() {};
+	~Ktx2File() {};
+
+	//Throws on a missing, truncated or unsupported file
+	void open(const std::string& path);
+	void close() { m_file.close(); m_pHeader = nullptr; m_pLevels = nullptr; };
+
+	const bool isOpen() const { return m_pHeader != nullptr; };
+	const VkFormat getFormat() const { return static_cast<VkFormat>(m_pHeader->vkFormat); };
+	const uint32_t getWidth() const { return m_pHeader->pixelWidth; };
+	const uint32_t getHeight() const { return m_pHeader->pixelHeight; };
+	const uint32_t getLevelCount() const { return m_levelCount; };
+
+	//Level 0 is the full size image
+	const uint8_t* getLevelData(uint32_t level) const { return m_file.getData() + m_pLevels[level].byteOffset; };
+	const VkDeviceSize getLevelSize(uint32_t level) const { return m_pLevels[level].byteLength; };
+
+	//Levels sit back to back (smallest first) -- one range covering all of them, with each
+	//level's offset into it, so the whole chain stages with a single copy
+	const uint8_t* getPackedLevels(std::vector<MipLevel>& levels, VkDeviceSize& size) const;
+
+	//Bytes a level of this format should take, 0 if the format isn't one we load
+	static VkDeviceSize getExpectedLevelSize(VkFormat, uint32_t width, uint32_t height);
+
+	//Every level to tightly packed RGBA8, largest first like a mipChain chain. Throws if blockCompression can't decode the format
+	void decodeLevels(std::vector<MipLevel>& levels, std::vector<uint8_t>& rgba) const;
+
+private:
+	MappedFile				m_file;
+	const Ktx2Header*		m_pHeader = nullptr;
+	const Ktx2LevelIndex*	m_pLevels = nullptr;
+	uint32_t				m_levelCount = 0;
+};
+
+namespace ktx2 {
+	//True for paths the KTX2 loader should handle
+	bool isKtx2Path(const std::string& path);
+
+	//Colour textures are sampled as UNORM like the stb path -- sRGB encoded files follow suit
+	VkFormat getUnormFormat(VkFormat format);
+
+	//Opens the first of path & its name.bc7/bc3/bc1/astc/etc2.ktx2 siblings the device can sample, returning
+	//the format to sample it as. Falls back to the first one blockCompression can decode & returns
+	//VK_FORMAT_UNDEFINED -- the caller decodes it (decodeLevels). Throws if there's neither
+	VkFormat openSampledVariant(VkPhysicalDevice&, const std::string& path, Ktx2File& file);
+
+	//Plain 2D KTX2 out: level index, a basic data format descriptor & the levels, smallest first.
+	//levels index into pData like a mipChain chain. BC1 RGB, BC3, BC7 & RGBA8 only
+	void writeKtx2(const std::string& path, VkFormat format, const std::vector<MipLevel>& levels, const uint8_t* pData);
+}
+
+#endif // !_KTX2_FILE_
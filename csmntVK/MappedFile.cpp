@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+void MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open file " + path);
+	}
+	m_fileHandle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		close();
+		throw std::runtime_error("failed to map empty file " + path);
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mappingHandle) {
+		close();
+		throw std::runtime_error("failed to create file mapping for " + path);
+	}
+
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData) {
+		close();
+		throw std::runtime_error("failed to map view of " + path);
+	}
+}
+
+void MappedFile::close()
+{
+	if (m_pData) {
+		UnmapViewOfFile(m_pData);
+		m_pData = nullptr;
+	}
+	if (m_mappingHandle) {
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = nullptr;
+	}
+	if (m_fileHandle) {
+		CloseHandle(m_fileHandle);
+		m_fileHandle = nullptr;
+	}
+	m_size = 0;
+}
+#else
+void MappedFile::open(const std::string& path)
+{
+	close();
+
+	m_fd = ::open(path.c_str(), O_RDONLY);
+	if (m_fd < 0) {
+		throw std::runtime_error("failed to open file " + path);
+	}
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0 || info.st_size == 0) {
+		close();
+		throw std::runtime_error("failed to map empty file " + path);
+	}
+	m_size = static_cast<size_t>(info.st_size);
+
+	void* pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (pData == MAP_FAILED) {
+		close();
+		throw std::runtime_error("failed to mmap " + path);
+	}
+
+	//Going straight through it once, front to back
+	madvise(pData, m_size, MADV_SEQUENTIAL);
+	m_pData = static_cast<const uint8_t*>(pData);
+}
+
+void MappedFile::close()
+{
+	if (m_pData) {
+		munmap(const_cast<uint8_t*>(m_pData), m_size);
+		m_pData = nullptr;
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_size = 0;
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef _MAPPED_FILE_
+#define _MAPPED_FILE_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/////////////////////////////////////////////////////
+//---MappedFile:
+//---Read-only memory mapping of a whole file
+//---(CreateFileMapping on Windows, mmap elsewhere).
+//---Pages come in on first touch, nothing is copied up front
+/////////////////////////////////////////////////////
+
+class MappedFile {
+public:
+	MappedFile() {};
+	~MappedFile();
+	MappedFile(MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//Throws if the file can't be opened or mapped
+	void open(const std::string& path);
+	void close();
+
+	const bool isOpen() const { return m_pData != nullptr; };
+	const uint8_t* getData() const { return m_pData; };
+	const size_t getSize() const { return m_size; };
+
+private:
+	const uint8_t*	m_pData = nullptr;
+	size_t			m_size = 0;
+
+#ifdef _WIN32
+	void*			m_fileHandle = nullptr;
+	void*			m_mappingHandle = nullptr;
+#else
+	int				m_fd = -1;
+#endif
+};
+
+#endif // !_MAPPED_FILE_
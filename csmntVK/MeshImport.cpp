@@ -0,0 +1,973 @@
+#include "MeshImport.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+
+#include "../Libraries/glm/gtc/matrix_transform.hpp"
+#include "../Libraries/glm/gtc/quaternion.hpp"
+#include "../Libraries/glm/gtc/type_ptr.hpp"
+
+namespace meshImport {
+
+#pragma region OBJ
+	namespace {
+		inline bool isLineSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		inline const char* skipLineSpace(const char* p)
+		{
+			while (isLineSpace(*p)) {
+				p++;
+			}
+			return p;
+		}
+
+		inline const char* skipLine(const char* p)
+		{
+			while (*p != '\0' && *p != '\n') {
+				p++;
+			}
+			return *p == '\n' ? p + 1 : p;
+		}
+
+		//OBJ indices are 1 based, negatives count back from the end
+		uint32_t resolveObjIndex(long index, size_t count, const std::string& path)
+		{
+			long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+			if (index == 0 || resolved < 0 || static_cast<size_t>(resolved) >= count) {
+				throw std::runtime_error("obj face index out of range in " + path);
+			}
+			return static_cast<uint32_t>(resolved);
+		}
+	}
+
+	void loadOBJ(const std::string& path, MeshData& mesh)
+	{
+		std::vector<char> text = vkHelpers::readFile(path);
+		text.push_back('\0');
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> colours;
+		std::vector<glm::vec2> texCoords;
+
+		//(position, texcoord + 1) -> output vertex, so shared corners stay shared
+		std::unordered_map<uint64_t, uint32_t> vertexLookup;
+		std::vector<uint32_t> face;
+
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		mesh.normals.clear();
+		mesh.tangents.clear();
+
+		const char* p = text.data();
+		while (*p != '\0') {
+			p = skipLineSpace(p);
+
+			if (p[0] == 'v' && isLineSpace(p[1])) {
+				char* pEnd;
+				glm::vec3 pos;
+				pos.x = strtof(p + 2, &pEnd);
+				pos.y = strtof(pEnd, &pEnd);
+				pos.z = strtof(pEnd, &pEnd);
+				positions.push_back(pos);
+
+				//Optional vertex colour after the position
+				const char* pColour = skipLineSpace(pEnd);
+				glm::vec3 colour(1.0f);
+				if (*pColour != '\n' && *pColour != '\0') {
+					colour.r = strtof(pColour, &pEnd);
+					colour.g = strtof(pEnd, &pEnd);
+					colour.b = strtof(pEnd, &pEnd);
+				}
+				colours.push_back(colour);
+			}
+			else if (p[0] == 'v' && p[1] == 't' && isLineSpace(p[2])) {
+				char* pEnd;
+				glm::vec2 texCoord;
+				texCoord.x = strtof(p + 3, &pEnd);
+				texCoord.y = strtof(pEnd, &pEnd);
+				//OBJ has v going up, we sample with v going down
+				texCoords.push_back({ texCoord.x, 1.0f - texCoord.y });
+			}
+			else if (p[0] == 'f' && isLineSpace(p[1])) {
+				face.clear();
+				p += 2;
+
+				for (;;) {
+					p = skipLineSpace(p);
+					if (*p == '\n' || *p == '\0') {
+						break;
+					}
+
+					char* pEnd;
+					long posIndex = strtol(p, &pEnd, 10);
+					if (pEnd == p) {
+						throw std::runtime_error("bad obj face in " + path);
+					}
+					p = pEnd;
+
+					long texIndex = 0;
+					if (*p == '/') {
+						p++;
+						if (*p != '/') {
+							texIndex = strtol(p, &pEnd, 10);
+							p = pEnd;
+						}
+						//Normals aren't part of Vertex, packing generates its own
+						if (*p == '/') {
+							strtol(p + 1, &pEnd, 10);
+							p = pEnd;
+						}
+					}
+
+					uint32_t pos = resolveObjIndex(posIndex, positions.size(), path);
+					uint32_t tex = texIndex != 0 ? resolveObjIndex(texIndex, texCoords.size(), path) + 1 : 0;
+
+					uint64_t key = (static_cast<uint64_t>(pos) << 32) | tex;
+					auto it = vertexLookup.find(key);
+					if (it == vertexLookup.end()) {
+						Vertex vertex;
+						vertex.pos = positions[pos];
+						vertex.colour = colours[pos];
+						vertex.texCoord = tex != 0 ? texCoords[tex - 1] : glm::vec2(0.0f);
+
+						it = vertexLookup.emplace(key, static_cast<uint32_t>(mesh.vertices.size())).first;
+						mesh.vertices.push_back(vertex);
+					}
+					face.push_back(it->second);
+				}
+
+				//Fan out polygons
+				for (size_t i = 2; i < face.size(); i++) {
+					mesh.indices.push_back(face[0]);
+					mesh.indices.push_back(face[i - 1]);
+					mesh.indices.push_back(face[i]);
+				}
+			}
+
+			p = skipLine(p);
+		}
+
+		if (mesh.indices.empty()) {
+			throw std::runtime_error("obj has no faces: " + path);
+		}
+	}
+#pragma endregion
+
+#pragma region JSON
+	namespace {
+		//Just enough JSON for glTF
+		struct JsonValue {
+			enum Type { Null, Bool, Number, String, Array, Object };
+
+			Type		type = Null;
+			bool		boolean = false;
+			double		number = 0.0;
+			std::string	string;
+			std::vector<JsonValue> array;
+			std::vector<std::pair<std::string, JsonValue>> object;
+
+			const JsonValue* find(const char* key) const
+			{
+				for (const auto& member : object) {
+					if (member.first == key) {
+						return &member.second;
+					}
+				}
+				return nullptr;
+			}
+
+			double getNumber(const char* key, double fallback) const
+			{
+				const JsonValue* pValue = find(key);
+				return pValue && pValue->type == Number ? pValue->number : fallback;
+			}
+
+			int getIndex(const char* key) const
+			{
+				return static_cast<int>(getNumber(key, -1.0));
+			}
+
+			size_t size() const { return array.size(); };
+			const JsonValue& operator[](size_t i) const { return array[i]; };
+		};
+
+		class JsonParser {
+		public:
+			JsonParser(const char* pBegin, const char* pEnd) : m_p(pBegin), m_pEnd(pEnd) {};
+
+			JsonValue parse()
+			{
+				JsonValue value = parseValue(0);
+				skipSpace();
+				if (m_p != m_pEnd) {
+					fail();
+				}
+				return value;
+			}
+
+		private:
+			//glTF nests a handful of levels, anything this deep is garbage
+			static const int s_maxDepth = 64;
+
+			const char*	m_p;
+			const char*	m_pEnd;
+
+			void fail()
+			{
+				throw std::runtime_error("malformed gltf json!");
+			}
+
+			void skipSpace()
+			{
+				while (m_p < m_pEnd && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) {
+					m_p++;
+				}
+			}
+
+			void expect(char c)
+			{
+				skipSpace();
+				if (m_p >= m_pEnd || *m_p != c) {
+					fail();
+				}
+				m_p++;
+			}
+
+			bool consumeLiteral(const char* literal)
+			{
+				size_t length = strlen(literal);
+				if (static_cast<size_t>(m_pEnd - m_p) >= length && memcmp(m_p, literal, length) == 0) {
+					m_p += length;
+					return true;
+				}
+				return false;
+			}
+
+			JsonValue parseValue(int depth)
+			{
+				if (depth > s_maxDepth) {
+					fail();
+				}
+
+				skipSpace();
+				if (m_p >= m_pEnd) {
+					fail();
+				}
+
+				JsonValue value;
+				switch (*m_p) {
+				case '{':
+					value.type = JsonValue::Object;
+					m_p++;
+					skipSpace();
+					if (m_p < m_pEnd && *m_p == '}') {
+						m_p++;
+						break;
+					}
+					for (;;) {
+						skipSpace();
+						std::string key = parseString();
+						expect(':');
+						value.object.emplace_back(std::move(key), parseValue(depth + 1));
+						skipSpace();
+						if (m_p < m_pEnd && *m_p == ',') {
+							m_p++;
+							continue;
+						}
+						expect('}');
+						break;
+					}
+					break;
+				case '[':
+					value.type = JsonValue::Array;
+					m_p++;
+					skipSpace();
+					if (m_p < m_pEnd && *m_p == ']') {
+						m_p++;
+						break;
+					}
+					for (;;) {
+						value.array.push_back(parseValue(depth + 1));
+						skipSpace();
+						if (m_p < m_pEnd && *m_p == ',') {
+							m_p++;
+							continue;
+						}
+						expect(']');
+						break;
+					}
+					break;
+				case '"':
+					value.type = JsonValue::String;
+					value.string = parseString();
+					break;
+				case 't':
+				case 'f':
+					value.type = JsonValue::Bool;
+					value.boolean = *m_p == 't';
+					if (!consumeLiteral(value.boolean ? "true" : "false")) {
+						fail();
+					}
+					break;
+				case 'n':
+					if (!consumeLiteral("null")) {
+						fail();
+					}
+					break;
+				default: {
+					//strtod needs a terminator, numbers are short so copy them out
+					char buffer[64];
+					size_t length = 0;
+					while (m_p + length < m_pEnd && length < sizeof(buffer) - 1 && m_p[length] != '\0' && strchr("+-0123456789.eE", m_p[length])) {
+						buffer[length] = m_p[length];
+						length++;
+					}
+					buffer[length] = '\0';
+
+					char* pEnd;
+					value.type = JsonValue::Number;
+					value.number = strtod(buffer, &pEnd);
+					if (length == 0 || pEnd != buffer + length) {
+						fail();
+					}
+					m_p += length;
+					break;
+				}
+				}
+
+				return value;
+			}
+
+			std::string parseString()
+			{
+				if (m_p >= m_pEnd || *m_p != '"') {
+					fail();
+				}
+				m_p++;
+
+				std::string result;
+				while (m_p < m_pEnd && *m_p != '"') {
+					char c = *m_p++;
+					if (c != '\\') {
+						result += c;
+						continue;
+					}
+					if (m_p >= m_pEnd) {
+						fail();
+					}
+
+					c = *m_p++;
+					switch (c) {
+					case 'b': result += '\b'; break;
+					case 'f': result += '\f'; break;
+					case 'n': result += '\n'; break;
+					case 'r': result += '\r'; break;
+					case 't': result += '\t'; break;
+					case 'u': {
+						if (m_pEnd - m_p < 4) {
+							fail();
+						}
+						char hex[5] = { m_p[0], m_p[1], m_p[2], m_p[3], '\0' };
+						uint32_t codePoint = static_cast<uint32_t>(strtoul(hex, nullptr, 16));
+						m_p += 4;
+
+						//UTF-8 encode (names & uris only, surrogate pairs aren't stitched back together)
+						if (codePoint < 0x80) {
+							result += static_cast<char>(codePoint);
+						}
+						else if (codePoint < 0x800) {
+							result += static_cast<char>(0xC0 | (codePoint >> 6));
+							result += static_cast<char>(0x80 | (codePoint & 0x3F));
+						}
+						else {
+							result += static_cast<char>(0xE0 | (codePoint >> 12));
+							result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+							result += static_cast<char>(0x80 | (codePoint & 0x3F));
+						}
+						break;
+					}
+					default: result += c; break;
+					}
+				}
+
+				if (m_p >= m_pEnd) {
+					fail();
+				}
+				m_p++;
+				return result;
+			}
+		};
+	}
+#pragma endregion
+
+#pragma region GLTF
+	namespace {
+		const uint32_t s_glbMagic = 0x46546C67;		//"glTF"
+		const uint32_t s_glbChunkJson = 0x4E4F534A;	//"JSON"
+		const uint32_t s_glbChunkBin = 0x004E4942;	//"BIN\0"
+
+		//Component types
+		const uint32_t s_gltfByte = 5120;
+		const uint32_t s_gltfUnsignedByte = 5121;
+		const uint32_t s_gltfShort = 5122;
+		const uint32_t s_gltfUnsignedShort = 5123;
+		const uint32_t s_gltfUnsignedInt = 5125;
+		const uint32_t s_gltfFloat = 5126;
+
+		const int s_gltfTriangles = 4;
+
+		struct GltfDocument {
+			JsonValue						json;
+			std::vector<std::vector<char>>	buffers;
+			std::string						directory;
+		};
+
+		struct AccessorView {
+			const uint8_t*	pData = nullptr;		//null = all zeros (no bufferView)
+			size_t			count = 0;
+			size_t			stride = 0;
+			uint32_t		componentType = 0;
+			uint32_t		components = 0;
+			bool			normalized = false;
+		};
+
+		std::vector<char> decodeBase64(const std::string& text, size_t start)
+		{
+			auto decodeChar = [](char c) -> int {
+				if (c >= 'A' && c <= 'Z') return c - 'A';
+				if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+				if (c >= '0' && c <= '9') return c - '0' + 52;
+				if (c == '+') return 62;
+				if (c == '/') return 63;
+				return -1;
+			};
+
+			std::vector<char> data;
+			data.reserve((text.size() - start) * 3 / 4);
+
+			uint32_t accumulator = 0;
+			int bits = 0;
+			for (size_t i = start; i < text.size(); i++) {
+				int value = decodeChar(text[i]);
+				if (value < 0) {
+					if (text[i] == '=') {
+						break;
+					}
+					throw std::runtime_error("bad base64 in gltf data uri!");
+				}
+				accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+				bits += 6;
+				if (bits >= 8) {
+					bits -= 8;
+					data.push_back(static_cast<char>((accumulator >> bits) & 0xFF));
+				}
+			}
+			return data;
+		}
+
+		std::string decodeUri(const std::string& uri)
+		{
+			std::string result;
+			for (size_t i = 0; i < uri.size(); i++) {
+				if (uri[i] == '%' && i + 2 < uri.size()) {
+					char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+					result += static_cast<char>(strtoul(hex, nullptr, 16));
+					i += 2;
+				}
+				else {
+					result += uri[i];
+				}
+			}
+			return result;
+		}
+
+		uint32_t readU32(const std::vector<char>& data, size_t offset)
+		{
+			uint32_t value;
+			memcpy(&value, data.data() + offset, sizeof(value));
+			return value;
+		}
+
+		void loadBuffers(GltfDocument& doc, std::vector<char>* pGlbBin)
+		{
+			const JsonValue* pBuffers = doc.json.find("buffers");
+			if (!pBuffers) {
+				return;
+			}
+
+			for (size_t i = 0; i < pBuffers->size(); i++) {
+				const JsonValue& buffer = (*pBuffers)[i];
+				const JsonValue* pUri = buffer.find("uri");
+				size_t byteLength = static_cast<size_t>(buffer.getNumber("byteLength", 0.0));
+
+				std::vector<char> data;
+				if (!pUri) {
+					//No uri = the GLB binary chunk, and only for the first buffer
+					if (i != 0 || !pGlbBin) {
+						throw std::runtime_error("gltf buffer has no uri!");
+					}
+					data = std::move(*pGlbBin);
+				}
+				else if (pUri->string.compare(0, 5, "data:") == 0) {
+					size_t comma = pUri->string.find(";base64,");
+					if (comma == std::string::npos) {
+						throw std::runtime_error("only base64 gltf data uris are supported!");
+					}
+					data = decodeBase64(pUri->string, comma + 8);
+				}
+				else {
+					data = vkHelpers::readFile(doc.directory + decodeUri(pUri->string));
+				}
+
+				if (data.size() < byteLength) {
+					throw std::runtime_error("gltf buffer is shorter than its byteLength!");
+				}
+				doc.buffers.push_back(std::move(data));
+			}
+		}
+
+		size_t componentSize(uint32_t componentType)
+		{
+			switch (componentType) {
+			case s_gltfByte:
+			case s_gltfUnsignedByte: return 1;
+			case s_gltfShort:
+			case s_gltfUnsignedShort: return 2;
+			case s_gltfUnsignedInt:
+			case s_gltfFloat: return 4;
+			default: throw std::runtime_error("unknown gltf component type!");
+			}
+		}
+
+		uint32_t componentCount(const std::string& type)
+		{
+			if (type == "SCALAR") return 1;
+			if (type == "VEC2") return 2;
+			if (type == "VEC3") return 3;
+			if (type == "VEC4") return 4;
+			throw std::runtime_error("unsupported gltf accessor type " + type);
+		}
+
+		AccessorView getAccessor(const GltfDocument& doc, int index)
+		{
+			const JsonValue* pAccessors = doc.json.find("accessors");
+			if (!pAccessors || index < 0 || static_cast<size_t>(index) >= pAccessors->size()) {
+				throw std::runtime_error("gltf accessor index out of range!");
+			}
+			const JsonValue& accessor = (*pAccessors)[index];
+
+			if (accessor.find("sparse")) {
+				throw std::runtime_error("sparse gltf accessors are not supported!");
+			}
+
+			AccessorView view;
+			view.count = static_cast<size_t>(accessor.getNumber("count", 0.0));
+			view.componentType = static_cast<uint32_t>(accessor.getNumber("componentType", 0.0));
+			const JsonValue* pType = accessor.find("type");
+			view.components = componentCount(pType ? pType->string : "");
+			const JsonValue* pNormalized = accessor.find("normalized");
+			view.normalized = pNormalized && pNormalized->boolean;
+
+			const size_t elementSize = componentSize(view.componentType) * view.components;
+			view.stride = elementSize;
+
+			int bufferViewIndex = accessor.getIndex("bufferView");
+			if (bufferViewIndex < 0) {
+				return view;
+			}
+
+			const JsonValue* pBufferViews = doc.json.find("bufferViews");
+			if (!pBufferViews || static_cast<size_t>(bufferViewIndex) >= pBufferViews->size()) {
+				throw std::runtime_error("gltf bufferView index out of range!");
+			}
+			const JsonValue& bufferView = (*pBufferViews)[bufferViewIndex];
+
+			int bufferIndex = bufferView.getIndex("buffer");
+			if (bufferIndex < 0 || static_cast<size_t>(bufferIndex) >= doc.buffers.size()) {
+				throw std::runtime_error("gltf buffer index out of range!");
+			}
+			const std::vector<char>& buffer = doc.buffers[bufferIndex];
+
+			size_t viewOffset = static_cast<size_t>(bufferView.getNumber("byteOffset", 0.0));
+			size_t viewLength = static_cast<size_t>(bufferView.getNumber("byteLength", 0.0));
+			size_t byteStride = static_cast<size_t>(bufferView.getNumber("byteStride", 0.0));
+			size_t accessorOffset = static_cast<size_t>(accessor.getNumber("byteOffset", 0.0));
+
+			if (byteStride != 0) {
+				view.stride = byteStride;
+			}
+
+			//Last element has to end inside the view, and the view inside the buffer
+			if (viewOffset > buffer.size() || viewLength > buffer.size() - viewOffset ||
+				(view.count > 0 && accessorOffset + (view.count - 1) * view.stride + elementSize > viewLength)) {
+				throw std::runtime_error("gltf accessor runs off the end of its buffer!");
+			}
+
+			view.pData = reinterpret_cast<const uint8_t*>(buffer.data()) + viewOffset + accessorOffset;
+			return view;
+		}
+
+		//Element i of a float/normalized accessor, widened to floats
+		void readFloats(const AccessorView& view, size_t i, float* pOut)
+		{
+			if (!view.pData) {
+				for (uint32_t c = 0; c < view.components; c++) {
+					pOut[c] = 0.0f;
+				}
+				return;
+			}
+
+			const uint8_t* pElement = view.pData + i * view.stride;
+			for (uint32_t c = 0; c < view.components; c++) {
+				switch (view.componentType) {
+				case s_gltfFloat: {
+					float value;
+					memcpy(&value, pElement + c * 4, 4);
+					pOut[c] = value;
+					break;
+				}
+				case s_gltfUnsignedByte: {
+					float value = pElement[c];
+					pOut[c] = view.normalized ? value / 255.0f : value;
+					break;
+				}
+				case s_gltfUnsignedShort: {
+					uint16_t value;
+					memcpy(&value, pElement + c * 2, 2);
+					pOut[c] = view.normalized ? value / 65535.0f : value;
+					break;
+				}
+				case s_gltfByte: {
+					float value = static_cast<int8_t>(pElement[c]);
+					pOut[c] = view.normalized ? std::max(value / 127.0f, -1.0f) : value;
+					break;
+				}
+				case s_gltfShort: {
+					int16_t value;
+					memcpy(&value, pElement + c * 2, 2);
+					pOut[c] = view.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+					break;
+				}
+				default:
+					throw std::runtime_error("unsupported gltf attribute component type!");
+				}
+			}
+		}
+
+		uint32_t readIndex(const AccessorView& view, size_t i)
+		{
+			const uint8_t* pElement = view.pData + i * view.stride;
+			switch (view.componentType) {
+			case s_gltfUnsignedByte:
+				return *pElement;
+			case s_gltfUnsignedShort: {
+				uint16_t value;
+				memcpy(&value, pElement, 2);
+				return value;
+			}
+			case s_gltfUnsignedInt: {
+				uint32_t value;
+				memcpy(&value, pElement, 4);
+				return value;
+			}
+			default:
+				throw std::runtime_error("unsupported gltf index component type!");
+			}
+		}
+
+		void appendPrimitive(const GltfDocument& doc, const JsonValue& primitive, const glm::mat4& transform, MeshData& mesh)
+		{
+			if (static_cast<int>(primitive.getNumber("mode", s_gltfTriangles)) != s_gltfTriangles) {
+				return;
+			}
+
+			const JsonValue* pAttributes = primitive.find("attributes");
+			if (!pAttributes || pAttributes->getIndex("POSITION") < 0) {
+				return;
+			}
+
+			AccessorView positions = getAccessor(doc, pAttributes->getIndex("POSITION"));
+			if (positions.componentType != s_gltfFloat || positions.components != 3 || !positions.pData) {
+				throw std::runtime_error("gltf positions must be float3!");
+			}
+
+			AccessorView colours, texCoords, normals, tangents;
+			bool hasColours = pAttributes->getIndex("COLOR_0") >= 0;
+			bool hasTexCoords = pAttributes->getIndex("TEXCOORD_0") >= 0;
+			bool hasNormals = pAttributes->getIndex("NORMAL") >= 0;
+			bool hasTangents = pAttributes->getIndex("TANGENT") >= 0;
+			if (hasColours) {
+				colours = getAccessor(doc, pAttributes->getIndex("COLOR_0"));
+				hasColours = colours.count >= positions.count && colours.components >= 3;
+			}
+			if (hasTexCoords) {
+				texCoords = getAccessor(doc, pAttributes->getIndex("TEXCOORD_0"));
+				hasTexCoords = texCoords.count >= positions.count && texCoords.components == 2;
+			}
+			if (hasNormals) {
+				normals = getAccessor(doc, pAttributes->getIndex("NORMAL"));
+				hasNormals = normals.count >= positions.count && normals.components == 3;
+			}
+			if (hasTangents) {
+				tangents = getAccessor(doc, pAttributes->getIndex("TANGENT"));
+				hasTangents = hasNormals && tangents.count >= positions.count && tangents.components == 4;
+			}
+
+			//Mirroring transforms flip the winding (& the tangent frame's handedness)
+			const bool flip = glm::determinant(glm::mat3(transform)) < 0.0f;
+			const glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+			const uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+			mesh.vertices.reserve(mesh.vertices.size() + positions.count);
+
+			//Zeroes mark vertices without them, for packing to generate
+			if (hasNormals || !mesh.normals.empty()) {
+				mesh.normals.resize(baseVertex, glm::vec3(0.0f));
+				mesh.tangents.resize(baseVertex, glm::vec4(0.0f));
+			}
+
+			for (size_t i = 0; i < positions.count; i++) {
+				float values[4];
+				Vertex vertex;
+
+				readFloats(positions, i, values);
+				vertex.pos = glm::vec3(transform * glm::vec4(values[0], values[1], values[2], 1.0f));
+
+				vertex.colour = glm::vec3(1.0f);
+				if (hasColours) {
+					readFloats(colours, i, values);
+					vertex.colour = glm::vec3(values[0], values[1], values[2]);
+				}
+
+				//glTF uvs already have v going down
+				vertex.texCoord = glm::vec2(0.0f);
+				if (hasTexCoords) {
+					readFloats(texCoords, i, values);
+					vertex.texCoord = glm::vec2(values[0], values[1]);
+				}
+
+				if (!mesh.normals.empty()) {
+					glm::vec3 normal(0.0f);
+					glm::vec4 tangent(0.0f);
+					if (hasNormals) {
+						readFloats(normals, i, values);
+						normal = normalTransform * glm::vec3(values[0], values[1], values[2]);
+						normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+					}
+					if (hasTangents) {
+						readFloats(tangents, i, values);
+						glm::vec3 direction = glm::mat3(transform) * glm::vec3(values[0], values[1], values[2]);
+						if (glm::dot(direction, direction) > 0.0f) {
+							tangent = glm::vec4(glm::normalize(direction), (values[3] < 0.0f) != flip ? -1.0f : 1.0f);
+						}
+					}
+					mesh.normals.push_back(normal);
+					mesh.tangents.push_back(tangent);
+				}
+
+				mesh.vertices.push_back(vertex);
+			}
+
+			int indicesIndex = primitive.getIndex("indices");
+			if (indicesIndex >= 0) {
+				AccessorView indices = getAccessor(doc, indicesIndex);
+				if (!indices.pData || indices.components != 1) {
+					throw std::runtime_error("bad gltf index accessor!");
+				}
+
+				for (size_t i = 0; i + 2 < indices.count; i += 3) {
+					uint32_t tri[3] = { readIndex(indices, i), readIndex(indices, i + 1), readIndex(indices, i + 2) };
+					for (uint32_t index : tri) {
+						if (index >= positions.count) {
+							throw std::runtime_error("gltf index out of range!");
+						}
+					}
+					if (flip) {
+						std::swap(tri[1], tri[2]);
+					}
+					mesh.indices.push_back(baseVertex + tri[0]);
+					mesh.indices.push_back(baseVertex + tri[1]);
+					mesh.indices.push_back(baseVertex + tri[2]);
+				}
+			}
+			else {
+				for (uint32_t i = 0; i + 2 < positions.count; i += 3) {
+					mesh.indices.push_back(baseVertex + i);
+					mesh.indices.push_back(baseVertex + (flip ? i + 2 : i + 1));
+					mesh.indices.push_back(baseVertex + (flip ? i + 1 : i + 2));
+				}
+			}
+		}
+
+		void appendMesh(const GltfDocument& doc, int meshIndex, const glm::mat4& transform, MeshData& mesh)
+		{
+			const JsonValue* pMeshes = doc.json.find("meshes");
+			if (!pMeshes || meshIndex < 0 || static_cast<size_t>(meshIndex) >= pMeshes->size()) {
+				throw std::runtime_error("gltf mesh index out of range!");
+			}
+
+			const JsonValue* pPrimitives = (*pMeshes)[meshIndex].find("primitives");
+			if (!pPrimitives) {
+				return;
+			}
+			for (size_t i = 0; i < pPrimitives->size(); i++) {
+				appendPrimitive(doc, (*pPrimitives)[i], transform, mesh);
+			}
+		}
+
+		glm::mat4 getNodeTransform(const JsonValue& node)
+		{
+			if (const JsonValue* pMatrix = node.find("matrix")) {
+				if (pMatrix->size() != 16) {
+					throw std::runtime_error("gltf node matrix must have 16 values!");
+				}
+				//Column major, same as glm
+				float values[16];
+				for (size_t i = 0; i < 16; i++) {
+					values[i] = static_cast<float>((*pMatrix)[i].number);
+				}
+				return glm::make_mat4(values);
+			}
+
+			glm::mat4 transform(1.0f);
+			if (const JsonValue* pTranslation = node.find("translation")) {
+				if (pTranslation->size() == 3) {
+					transform = glm::translate(transform, glm::vec3((*pTranslation)[0].number, (*pTranslation)[1].number, (*pTranslation)[2].number));
+				}
+			}
+			if (const JsonValue* pRotation = node.find("rotation")) {
+				if (pRotation->size() == 4) {
+					//glTF stores xyzw, glm::quat takes wxyz
+					glm::quat rotation(static_cast<float>((*pRotation)[3].number), static_cast<float>((*pRotation)[0].number),
+						static_cast<float>((*pRotation)[1].number), static_cast<float>((*pRotation)[2].number));
+					transform = transform * glm::mat4_cast(rotation);
+				}
+			}
+			if (const JsonValue* pScale = node.find("scale")) {
+				if (pScale->size() == 3) {
+					transform = glm::scale(transform, glm::vec3((*pScale)[0].number, (*pScale)[1].number, (*pScale)[2].number));
+				}
+			}
+			return transform;
+		}
+
+		void appendNode(const GltfDocument& doc, int nodeIndex, const glm::mat4& parent, MeshData& mesh, int depth)
+		{
+			const JsonValue* pNodes = doc.json.find("nodes");
+			if (!pNodes || nodeIndex < 0 || static_cast<size_t>(nodeIndex) >= pNodes->size() || depth > 64) {
+				throw std::runtime_error("bad gltf node hierarchy!");
+			}
+			const JsonValue& node = (*pNodes)[nodeIndex];
+
+			glm::mat4 transform = parent * getNodeTransform(node);
+
+			if (node.getIndex("mesh") >= 0) {
+				appendMesh(doc, node.getIndex("mesh"), transform, mesh);
+			}
+
+			if (const JsonValue* pChildren = node.find("children")) {
+				for (size_t i = 0; i < pChildren->size(); i++) {
+					appendNode(doc, static_cast<int>((*pChildren)[i].number), transform, mesh, depth + 1);
+				}
+			}
+		}
+	}
+
+	void loadGLTF(const std::string& path, MeshData& mesh)
+	{
+		std::vector<char> file = vkHelpers::readFile(path);
+
+		GltfDocument doc;
+		size_t slash = path.find_last_of("/\\");
+		doc.directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+		std::vector<char> glbBin;
+		const char* pJsonBegin = file.data();
+		const char* pJsonEnd = file.data() + file.size();
+
+		//GLB: 12 byte header, then a JSON chunk & an optional BIN chunk
+		if (file.size() >= 12 && readU32(file, 0) == s_glbMagic) {
+			if (readU32(file, 4) != 2) {
+				throw std::runtime_error("only glTF 2.0 binaries are supported: " + path);
+			}
+
+			size_t offset = 12;
+			bool foundJson = false;
+			while (offset + 8 <= file.size()) {
+				uint32_t chunkLength = readU32(file, offset);
+				uint32_t chunkType = readU32(file, offset + 4);
+				offset += 8;
+				if (chunkLength > file.size() - offset) {
+					throw std::runtime_error("truncated glb chunk in " + path);
+				}
+
+				if (chunkType == s_glbChunkJson && !foundJson) {
+					pJsonBegin = file.data() + offset;
+					pJsonEnd = pJsonBegin + chunkLength;
+					foundJson = true;
+				}
+				else if (chunkType == s_glbChunkBin && glbBin.empty()) {
+					glbBin.assign(file.data() + offset, file.data() + offset + chunkLength);
+				}
+				offset += (chunkLength + 3) & ~3u;
+			}
+
+			if (!foundJson) {
+				throw std::runtime_error("glb has no json chunk: " + path);
+			}
+		}
+
+		doc.json = JsonParser(pJsonBegin, pJsonEnd).parse();
+		loadBuffers(doc, &glbBin);
+
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		mesh.normals.clear();
+		mesh.tangents.clear();
+
+		//Walk the default scene, or every mesh untransformed if there isn't one
+		const JsonValue* pScenes = doc.json.find("scenes");
+		if (pScenes && pScenes->size() > 0) {
+			int sceneIndex = doc.json.getIndex("scene");
+			const JsonValue& scene = (*pScenes)[sceneIndex >= 0 && static_cast<size_t>(sceneIndex) < pScenes->size() ? sceneIndex : 0];
+
+			if (const JsonValue* pRoots = scene.find("nodes")) {
+				for (size_t i = 0; i < pRoots->size(); i++) {
+					appendNode(doc, static_cast<int>((*pRoots)[i].number), glm::mat4(1.0f), mesh, 0);
+				}
+			}
+		}
+		else if (const JsonValue* pMeshes = doc.json.find("meshes")) {
+			for (size_t i = 0; i < pMeshes->size(); i++) {
+				appendMesh(doc, static_cast<int>(i), glm::mat4(1.0f), mesh);
+			}
+		}
+
+		if (mesh.indices.empty()) {
+			throw std::runtime_error("gltf has no triangles: " + path);
+		}
+	}
+#pragma endregion
+
+	void loadMesh(const std::string& path, MeshData& mesh)
+	{
+		size_t dot = path.find_last_of('.');
+		std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+		if (ext == ".obj") {
+			loadOBJ(path, mesh);
+		}
+		else if (ext == ".gltf" || ext == ".glb") {
+			loadGLTF(path, mesh);
+		}
+		else {
+			throw std::runtime_error("unknown mesh format: " + path);
+		}
+	}
+}
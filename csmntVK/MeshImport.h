@@ -0,0 +1,21 @@
+#pragma once
+#ifndef _MESH_IMPORT_
+#define _MESH_IMPORT_
+
+#include <string>
+#include "Model.h"
+
+//Text mesh importers -- all of them throw std::runtime_error on bad input
+namespace meshImport {
+	//Wavefront OBJ: v (with optional rgb), vt & f (polygons fan triangulated, negative indices ok)
+	void loadOBJ(const std::string& path, MeshData& mesh);
+
+	//glTF 2.0, .gltf (external or data: uri buffers) or .glb. Triangle primitives only,
+	//node transforms of the default scene are baked in
+	void loadGLTF(const std::string& path, MeshData& mesh);
+
+	//Picks a loader from the extension
+	void loadMesh(const std::string& path, MeshData& mesh);
+}
+
+#endif // !_MESH_IMPORT_
@@ -0,0 +1,324 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace meshOptimizer {
+	namespace {
+		const uint32_t s_unused = std::numeric_limits<uint32_t>::max();
+
+		//Triangles using each vertex, as offsets into one flat list
+		struct Adjacency {
+			std::vector<uint32_t>	offsets;		//vertexCount + 1
+			std::vector<uint32_t>	triangles;
+		};
+
+		void buildAdjacency(const std::vector<uint32_t>& indices, uint32_t vertexCount, Adjacency& adjacency)
+		{
+			adjacency.offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : indices) {
+				adjacency.offsets[index + 1]++;
+			}
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				adjacency.offsets[v + 1] += adjacency.offsets[v];
+			}
+
+			std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+			adjacency.triangles.resize(indices.size());
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency.triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		//FIFO cache simulation -- a vertex is a hit while fewer than cacheSize misses came after it
+		class FifoCache {
+		public:
+			FifoCache(uint32_t vertexCount, uint32_t cacheSize) : m_timestamps(vertexCount, 0), m_cacheSize(cacheSize) {};
+
+			//True on a miss, which pushes the vertex in
+			bool access(uint32_t vertex)
+			{
+				if (m_timestamps[vertex] != 0 && m_time - m_timestamps[vertex] < m_cacheSize) {
+					return false;
+				}
+				m_timestamps[vertex] = ++m_time;
+				return true;
+			}
+
+			//Everything misses from here on
+			void flush() { m_time += m_cacheSize; };
+
+		private:
+			std::vector<uint32_t>	m_timestamps;
+			uint32_t				m_time = 0;
+			uint32_t				m_cacheSize;
+		};
+	}
+
+	VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats stats;
+		if (indices.empty()) {
+			return stats;
+		}
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> referenced(vertexCount, false);
+		uint32_t misses = 0, referencedCount = 0;
+
+		for (uint32_t index : indices) {
+			misses += cache.access(index) ? 1 : 0;
+			if (!referenced[index]) {
+				referenced[index] = true;
+				referencedCount++;
+			}
+		}
+
+		stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+		stats.atvr = static_cast<float>(misses) / referencedCount;
+		return stats;
+	}
+
+	void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		const uint32_t cacheSize = s_vertexCacheSize;
+		clusters.clear();
+
+		Adjacency adjacency;
+		buildAdjacency(indices, vertexCount, adjacency);
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+		}
+
+		std::vector<uint32_t> cacheTimes(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		uint32_t time = cacheSize + 1;
+		uint32_t cursor = 0;
+
+		//Fan vertex, & whether it came from a restart rather than the last fan's candidates
+		uint32_t fan = 0;
+		bool restarted = true;
+		while (cursor < vertexCount && liveTriangles[cursor] == 0) {
+			cursor++;
+		}
+		fan = cursor;
+
+		while (fan < vertexCount) {
+			if (restarted) {
+				clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+
+			//Emit every triangle left around the fan vertex
+			candidates.clear();
+			for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+				const uint32_t triangle = adjacency.triangles[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+				emitted[triangle] = true;
+
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t v = indices[triangle * 3 + c];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+
+					if (time - cacheTimes[v] > cacheSize) {
+						cacheTimes[v] = time++;
+					}
+				}
+			}
+
+			//Next fan: the candidate that will still be in the cache once its own triangles are out,
+			//oldest first so the cache isn't wasted
+			uint32_t next = s_unused;
+			int bestPriority = -1;
+			for (uint32_t v : candidates) {
+				if (liveTriangles[v] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - cacheTimes[v] + 2 * liveTriangles[v] <= cacheSize) {
+					priority = static_cast<int>(time - cacheTimes[v]);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			restarted = next == s_unused;
+			if (restarted) {
+				//Most recently touched vertex with work left, then the next one in input order
+				while (!deadEnds.empty() && next == s_unused) {
+					const uint32_t v = deadEnds.back();
+					deadEnds.pop_back();
+					if (liveTriangles[v] > 0) {
+						next = v;
+					}
+				}
+				while (next == s_unused && cursor < vertexCount) {
+					if (liveTriangles[cursor] > 0) {
+						next = cursor;
+					}
+					cursor++;
+				}
+			}
+			fan = next == s_unused ? vertexCount : next;
+		}
+
+		indices.swap(output);
+	}
+
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, std::vector<uint32_t>& clusters, float threshold)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0) {
+			return;
+		}
+		clusters.push_back(triangleCount);
+
+		//Soft boundaries -- within a cluster the cache warms up as it goes, so cut wherever the
+		//piece so far is already within threshold of the whole cluster's ACMR
+		std::vector<uint32_t> pieces;
+		FifoCache cache(static_cast<uint32_t>(vertices.size()), s_vertexCacheSize);
+		for (size_t c = 0; c + 1 < clusters.size(); c++) {
+			const uint32_t start = clusters[c], end = clusters[c + 1];
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = start * 3; i < end * 3; i++) {
+				clusterMisses += cache.access(indices[i]) ? 1 : 0;
+			}
+			const float clusterAcmr = static_cast<float>(clusterMisses) / (end - start);
+
+			cache.flush();
+			uint32_t pieceStart = start, pieceMisses = 0;
+			pieces.push_back(start);
+			for (uint32_t t = start; t < end; t++) {
+				for (uint32_t k = 0; k < 3; k++) {
+					pieceMisses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+				}
+
+				const float pieceAcmr = static_cast<float>(pieceMisses) / (t + 1 - pieceStart);
+				if (t + 1 < end && pieceAcmr <= clusterAcmr * threshold) {
+					pieceStart = t + 1;
+					pieceMisses = 0;
+					pieces.push_back(pieceStart);
+					cache.flush();
+				}
+			}
+		}
+		pieces.push_back(triangleCount);
+
+		//Area weighted centroid & normal per piece, against the mesh's centroid
+		struct Piece {
+			uint32_t	start;
+			uint32_t	end;
+			float		sortKey;
+		};
+		std::vector<Piece> sorted(pieces.size() - 1);
+
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		std::vector<glm::vec3> centroids(sorted.size()), normals(sorted.size());
+
+		for (size_t p = 0; p < sorted.size(); p++) {
+			glm::vec3 centroid(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (uint32_t t = pieces[p]; t < pieces[p + 1]; t++) {
+				const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+				const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				const float faceArea = glm::length(faceNormal);
+
+				centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+				normal += faceNormal;
+				area += faceArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+			centroids[p] = area > 0.0f ? centroid / area : vertices[indices[pieces[p] * 3]].pos;
+			normals[p] = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+			sorted[p] = { pieces[p], pieces[p + 1], 0.0f };
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+		//Pieces facing away from the centre are the ones in front from most viewpoints
+		for (size_t p = 0; p < sorted.size(); p++) {
+			sorted[p].sortKey = glm::dot(centroids[p] - meshCentroid, normals[p]);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Piece& a, const Piece& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		clusters.clear();
+		for (const Piece& piece : sorted) {
+			clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+			output.insert(output.end(), indices.begin() + piece.start * 3, indices.begin() + piece.end * 3);
+		}
+		indices.swap(output);
+	}
+
+	void optimizeVertexFetch(MeshData& mesh)
+	{
+		std::vector<uint32_t> remap(mesh.vertices.size(), s_unused);
+		uint32_t vertexCount = 0;
+		for (uint32_t& index : mesh.indices) {
+			if (remap[index] == s_unused) {
+				remap[index] = vertexCount++;
+			}
+			index = remap[index];
+		}
+
+		const bool hasNormals = !mesh.normals.empty();
+		std::vector<Vertex> vertices(vertexCount);
+		std::vector<glm::vec3> normals(hasNormals ? vertexCount : 0);
+		std::vector<glm::vec4> tangents(hasNormals ? vertexCount : 0);
+		for (size_t v = 0; v < remap.size(); v++) {
+			if (remap[v] == s_unused) {
+				continue;
+			}
+			vertices[remap[v]] = mesh.vertices[v];
+			if (hasNormals) {
+				normals[remap[v]] = mesh.normals[v];
+				tangents[remap[v]] = mesh.tangents[v];
+			}
+		}
+
+		mesh.vertices.swap(vertices);
+		mesh.normals.swap(normals);
+		mesh.tangents.swap(tangents);
+	}
+
+	MeshOptimizeStats optimizeMesh(MeshData& mesh)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+
+		MeshOptimizeStats stats;
+		stats.before = analyzeVertexCache(mesh.indices, vertexCount);
+
+		std::vector<uint32_t> clusters;
+		optimizeVertexCache(mesh.indices, vertexCount, clusters);
+		optimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+		stats.clusterCount = static_cast<uint32_t>(clusters.size());
+		optimizeVertexFetch(mesh);
+
+		stats.after = analyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats;
+	}
+}
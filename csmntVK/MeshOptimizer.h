@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _MESH_OPTIMIZER_
+#define _MESH_OPTIMIZER_
+
+#include <vector>
+#include <cstdint>
+#include "Model.h"
+
+//Post transform cache behaviour of an index order, simulated as a FIFO
+struct VertexCacheStats {
+	float		acmr = 0.0f;		//vertices transformed per triangle -- 0.5 is the ideal for big regular meshes
+	float		atvr = 0.0f;		//vertices transformed per vertex referenced -- 1.0 is the ideal
+};
+
+struct MeshOptimizeStats {
+	VertexCacheStats	before;
+	VertexCacheStats	after;
+	uint32_t			clusterCount = 0;	//groups the overdraw pass sorted
+	double				milliseconds = 0.0;
+};
+
+/////////////////////////////////////////////////////
+//---meshOptimizer:
+//---Reorders an imported mesh for the GPU without changing
+//---what it draws. Triangles go in Tipsify order (vertex
+//---cache), the resulting clusters are then sorted outside
+//---in (overdraw), & finally vertices are renumbered in
+//---first use order (fetch locality)
+/////////////////////////////////////////////////////
+
+namespace meshOptimizer {
+	//FIFO size assumed by the reordering & the stats. Real caches vary, 16 is a safe lower bound
+	const uint32_t s_vertexCacheSize = 16;
+
+	VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = s_vertexCacheSize);
+
+	//Tipsify (Sander et al. 2007). Hands back the first triangle of every cluster -- a run the fan walk
+	//had to restart from the dead end stack, where the cache starts cold anyway
+	void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters);
+
+	//Splits clusters further while each piece stays within threshold of its ACMR, then draws the
+	//outward facing pieces first so they occlude the ones behind. Expects optimizeVertexCache's order
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, std::vector<uint32_t>& clusters, float threshold = 1.05f);
+
+	//Vertices renumbered in first use order, unreferenced ones dropped. Normals & tangents follow
+	void optimizeVertexFetch(MeshData& mesh);
+
+	//All three, in order
+	MeshOptimizeStats optimizeMesh(MeshData& mesh);
+}
+
+#endif // !_MESH_OPTIMIZER_
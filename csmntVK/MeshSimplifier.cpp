@@ -0,0 +1,280 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+
+#pragma region QUADRIC
+void MeshSimplifier::Quadric::addPlane(const glm::vec3& normal, float distance, float area)
+{
+	a00 += area * normal.x * normal.x;
+	a01 += area * normal.x * normal.y;
+	a02 += area * normal.x * normal.z;
+	a11 += area * normal.y * normal.y;
+	a12 += area * normal.y * normal.z;
+	a22 += area * normal.z * normal.z;
+	b0 += area * normal.x * distance;
+	b1 += area * normal.y * distance;
+	b2 += area * normal.z * distance;
+	c += area * distance * distance;
+	weight += area;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& other)
+{
+	a00 += other.a00; a01 += other.a01; a02 += other.a02;
+	a11 += other.a11; a12 += other.a12; a22 += other.a22;
+	b0 += other.b0; b1 += other.b1; b2 += other.b2;
+	c += other.c;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::evaluate(const glm::vec3& p) const
+{
+	const double x = p.x, y = p.y, z = p.z;
+	const double result = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+		+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+	//Rounding can take a perfect fit just below zero
+	return std::max(result, 0.0);
+}
+#pragma endregion
+
+#pragma region SIMPLIFIER
+MeshSimplifier::MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	: m_vertices(vertices), m_indices(indices)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	//Vertices at the same position are one point of the surface -- split by uvs or colours
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> positionLookup;
+	std::vector<uint32_t> wedgeCounts;
+	m_positionIds.resize(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		auto it = positionLookup.emplace(vertices[v].pos, static_cast<uint32_t>(wedgeCounts.size())).first;
+		if (it->second == wedgeCounts.size()) {
+			wedgeCounts.push_back(0);
+		}
+		wedgeCounts[it->second]++;
+		m_positionIds[v] = it->second;
+	}
+
+	//Plane of every triangle into its corners' quadrics
+	m_quadrics.resize(wedgeCounts.size());
+	for (size_t i = 0; i + 2 < m_indices.size(); i += 3) {
+		const glm::vec3& p0 = vertices[m_indices[i]].pos;
+		const glm::vec3 normal = glm::cross(vertices[m_indices[i + 1]].pos - p0, vertices[m_indices[i + 2]].pos - p0);
+		const float length = glm::length(normal);
+		if (length <= 0.0f) {
+			continue;
+		}
+		const glm::vec3 unitNormal = normal / length;
+		for (int c = 0; c < 3; c++) {
+			m_quadrics[m_positionIds[m_indices[i + c]]].addPlane(unitNormal, -glm::dot(unitNormal, p0), length * 0.5f);
+		}
+	}
+
+	//Edges with one triangle on them (by position, so seams aren't borders) mark the border.
+	//Seam & border vertices stay put, everything else may collapse
+	std::unordered_map<uint64_t, uint32_t> edgeCounts;
+	for (size_t i = 0; i + 2 < m_indices.size(); i += 3) {
+		for (int e = 0; e < 3; e++) {
+			uint64_t a = m_positionIds[m_indices[i + e]], b = m_positionIds[m_indices[i + (e + 1) % 3]];
+			if (a > b) {
+				std::swap(a, b);
+			}
+			edgeCounts[(a << 32) | b]++;
+		}
+	}
+
+	std::vector<bool> borderPositions(wedgeCounts.size(), false);
+	for (const auto& edge : edgeCounts) {
+		if (edge.second == 1) {
+			borderPositions[edge.first >> 32] = true;
+			borderPositions[edge.first & 0xFFFFFFFF] = true;
+		}
+	}
+
+	m_locked.resize(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		m_locked[v] = wedgeCounts[m_positionIds[v]] > 1 || borderPositions[m_positionIds[v]];
+	}
+
+	m_remap.resize(vertexCount);
+}
+
+bool MeshSimplifier::flipsTriangle(uint32_t from, uint32_t to) const
+{
+	for (uint32_t a = m_adjacencyOffsets[from]; a < m_adjacencyOffsets[from + 1]; a++) {
+		const uint32_t* pTriangle = &m_indices[m_adjacency[a] * 3];
+		uint32_t corners[3] = { m_remap[pTriangle[0]], m_remap[pTriangle[1]], m_remap[pTriangle[2]] };
+
+		//Already collapsed this pass, or about to be
+		if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2] ||
+			corners[0] == to || corners[1] == to || corners[2] == to) {
+			continue;
+		}
+
+		const glm::vec3 before = glm::cross(m_vertices[corners[1]].pos - m_vertices[corners[0]].pos, m_vertices[corners[2]].pos - m_vertices[corners[0]].pos);
+		for (uint32_t& corner : corners) {
+			if (corner == from) {
+				corner = to;
+			}
+		}
+		const glm::vec3 after = glm::cross(m_vertices[corners[1]].pos - m_vertices[corners[0]].pos, m_vertices[corners[2]].pos - m_vertices[corners[0]].pos);
+
+		//Turned over, or squashed flat on the way
+		if (glm::dot(before, after) <= 0.0f) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MeshSimplifier::simplify(size_t targetIndexCount, float maxError)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(m_vertices.size());
+	const double maxCost = static_cast<double>(maxError) * maxError;
+
+	//Passes of independent collapses, cheapest first -- no priority queue to keep up to date,
+	//each pass re-costs everything from the merged quadrics
+	while (m_indices.size() > targetIndexCount) {
+		const uint32_t triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+
+		m_adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t index : m_indices) {
+			m_adjacencyOffsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+		}
+		std::vector<uint32_t> cursor(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+		m_adjacency.resize(m_indices.size());
+		for (size_t i = 0; i < m_indices.size(); i++) {
+			m_adjacency[cursor[m_indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		//Both directions of every edge, unless the moving end is locked. Shared edges show up twice, harmlessly
+		m_collapses.clear();
+		for (size_t i = 0; i < m_indices.size(); i += 3) {
+			for (int e = 0; e < 3; e++) {
+				const uint32_t a = m_indices[i + e], b = m_indices[i + (e + 1) % 3];
+				const uint32_t ends[2][2] = { { a, b }, { b, a } };
+				for (const auto& end : ends) {
+					if (m_locked[end[0]]) {
+						continue;
+					}
+					Quadric quadric = m_quadrics[m_positionIds[end[0]]];
+					quadric.add(m_quadrics[m_positionIds[end[1]]]);
+					const double cost = quadric.weight > 0.0 ? quadric.evaluate(m_vertices[end[1]].pos) / quadric.weight : 0.0;
+					m_collapses.push_back({ end[0], end[1], static_cast<float>(cost) });
+				}
+			}
+		}
+		if (m_collapses.empty()) {
+			break;
+		}
+		std::sort(m_collapses.begin(), m_collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		//An interior collapse takes two triangles with it -- stop once the target is in reach
+		const uint32_t targetTriangles = static_cast<uint32_t>(targetIndexCount / 3);
+		const uint32_t collapseBudget = (triangleCount - targetTriangles) / 2 + 1;
+
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			m_remap[v] = v;
+		}
+		std::vector<bool> touched(vertexCount, false);
+		uint32_t collapseCount = 0;
+		float passCost = 0.0f;
+
+		for (const Collapse& collapse : m_collapses) {
+			if (collapse.cost > maxCost || collapseCount >= collapseBudget) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to] || flipsTriangle(collapse.from, collapse.to)) {
+				continue;
+			}
+
+			m_remap[collapse.from] = collapse.to;
+			m_quadrics[m_positionIds[collapse.to]].add(m_quadrics[m_positionIds[collapse.from]]);
+			touched[collapse.from] = touched[collapse.to] = true;
+			passCost = std::max(passCost, collapse.cost);
+			collapseCount++;
+		}
+		if (collapseCount == 0) {
+			break;
+		}
+		m_error = std::max(m_error, std::sqrt(passCost));
+
+		//Collapsed triangles drop out
+		size_t write = 0;
+		for (size_t i = 0; i < m_indices.size(); i += 3) {
+			const uint32_t a = m_remap[m_indices[i]], b = m_remap[m_indices[i + 1]], c = m_remap[m_indices[i + 2]];
+			if (a != b && b != c && a != c) {
+				m_indices[write++] = a;
+				m_indices[write++] = b;
+				m_indices[write++] = c;
+			}
+		}
+		m_indices.resize(write);
+	}
+}
+#pragma endregion
+
+#pragma region LOD CHAIN
+namespace meshSimplifier {
+	namespace {
+		//Below this many triangles a LOD isn't worth its draw
+		const uint32_t s_minLodTriangles = 64;
+		const uint32_t s_maxLods = 8;
+		//Each LOD has to lose at least this much of the last one, or the chain stops
+		const float s_minLodReduction = 0.75f;
+		//Past this fraction of the bounding radius the shape is gone -- no point carrying it
+		const float s_maxLodError = 0.1f;
+	}
+
+	void buildLodChain(MeshData& mesh)
+	{
+		mesh.lods.clear();
+		mesh.lods.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f });
+
+		float radius = 0.0f;
+		for (const Vertex& vertex : mesh.vertices) {
+			radius = std::max(radius, glm::length(vertex.pos));
+		}
+
+		MeshSimplifier simplifier(mesh.vertices, mesh.indices);
+		std::vector<uint32_t> lodIndices;
+		std::vector<uint32_t> clusters;
+
+		while (mesh.lods.size() < s_maxLods && mesh.lods.back().indexCount / 3 > s_minLodTriangles) {
+			const size_t lastIndexCount = mesh.lods.back().indexCount;
+			simplifier.simplify(lastIndexCount / 2, radius * s_maxLodError);
+
+			const std::vector<uint32_t>& indices = simplifier.getIndices();
+			if (indices.size() > lastIndexCount * s_minLodReduction) {
+				break;
+			}
+
+			//Each LOD gets its own cache order, the vertex order stays LOD 0's
+			lodIndices = indices;
+			meshOptimizer::optimizeVertexCache(lodIndices, static_cast<uint32_t>(mesh.vertices.size()), clusters);
+
+			MeshLod lod;
+			lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+			lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+			lod.error = simplifier.getError();
+			mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+			mesh.lods.push_back(lod);
+		}
+	}
+}
+#pragma endregion
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef _MESH_SIMPLIFIER_
+#define _MESH_SIMPLIFIER_
+
+#include <vector>
+#include <cstdint>
+#include "Model.h"
+
+/////////////////////////////////////////////////////
+//---MeshSimplifier:
+//---Quadric error edge collapse (Garland & Heckbert).
+//---Collapses keep one end of the edge instead of placing a
+//---new vertex, so every LOD indexes the same vertex buffer.
+//---Borders & uv/colour seams are locked so LODs don't tear.
+//---simplify() can be called again with a lower target &
+//---carries on from where it got to -- quadrics & the error
+//---keep accumulating, so each LOD's bound covers the ones
+//---before it
+/////////////////////////////////////////////////////
+
+class MeshSimplifier {
+public:
+	MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	~MeshSimplifier() {};
+	MeshSimplifier(MeshSimplifier&) = delete;
+	MeshSimplifier& operator=(const MeshSimplifier&) = delete;
+
+	//Collapses until there are at most targetIndexCount indices left, or the cheapest collapse
+	//left would push the error past maxError (mesh units)
+	void simplify(size_t targetIndexCount, float maxError);
+
+	const std::vector<uint32_t>& getIndices() const { return m_indices; };
+	//RMS distance from the collapsed vertices to the original surface around them, worst so far
+	const float getError() const { return m_error; };
+
+private:
+	//Symmetric 4x4 plane quadric, area weighted -- evaluate / weight is a mean squared distance
+	struct Quadric {
+		double	a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double	b0 = 0, b1 = 0, b2 = 0;
+		double	c = 0;
+		double	weight = 0;
+
+		void addPlane(const glm::vec3& normal, float distance, float area);
+		void add(const Quadric& other);
+		double evaluate(const glm::vec3& p) const;
+	};
+
+	struct Collapse {
+		uint32_t	from;
+		uint32_t	to;
+		float		cost;		//squared
+	};
+
+	//Would moving from onto to turn any of from's triangles over
+	bool flipsTriangle(uint32_t from, uint32_t to) const;
+
+	const std::vector<Vertex>&	m_vertices;
+	std::vector<uint32_t>		m_indices;
+	std::vector<Quadric>		m_quadrics;		//per position, seams share one
+	std::vector<uint32_t>		m_positionIds;
+	std::vector<bool>			m_locked;
+	float						m_error = 0.0f;
+
+	//Per pass -- triangles around each vertex, offsets into one flat list
+	std::vector<uint32_t>		m_adjacencyOffsets;
+	std::vector<uint32_t>		m_adjacency;
+	std::vector<uint32_t>		m_remap;
+	std::vector<Collapse>		m_collapses;
+};
+
+namespace meshSimplifier {
+	//Halves the triangle count per LOD while the error stays small next to the mesh, appending each
+	//LOD's (cache ordered) indices after LOD 0's. Fills mesh.lods, LOD 0 first
+	void buildLodChain(MeshData& mesh);
+}
+
+#endif // !_MESH_SIMPLIFIER_
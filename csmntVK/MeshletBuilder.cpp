@@ -0,0 +1,175 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+
+namespace meshletBuilder {
+	namespace {
+		const uint32_t s_none = std::numeric_limits<uint32_t>::max();
+
+		//A cone that can't cull anything -- see computeMeshletBounds
+		const glm::vec4 s_openCone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+
+	Meshlet computeMeshletBounds(const std::vector<Vertex>& vertices, const uint32_t* pIndices, uint32_t indexCount)
+	{
+		Meshlet meshlet = {};
+		meshlet.indexCount = indexCount;
+
+		//Centre of the box, then whatever radius reaches every corner
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (uint32_t i = 0; i < indexCount; i++) {
+			boundsMin = glm::min(boundsMin, vertices[pIndices[i]].pos);
+			boundsMax = glm::max(boundsMax, vertices[pIndices[i]].pos);
+		}
+		const glm::vec3 centre = indexCount > 0 ? (boundsMin + boundsMax) * 0.5f : glm::vec3(0.0f);
+		float radiusSquared = 0.0f;
+		for (uint32_t i = 0; i < indexCount; i++) {
+			const glm::vec3 offset = vertices[pIndices[i]].pos - centre;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		meshlet.boundingSphere = glm::vec4(centre, std::sqrt(radiusSquared));
+
+		//Cone axis is the average facing, its spread the widest normal away from it.
+		//Degenerate triangles draw nothing, so they don't get a say
+		std::vector<glm::vec3> normals;
+		normals.reserve(indexCount / 3);
+		glm::vec3 axis(0.0f);
+		for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+			const glm::vec3& p0 = vertices[pIndices[i]].pos;
+			const glm::vec3 normal = glm::cross(vertices[pIndices[i + 1]].pos - p0, vertices[pIndices[i + 2]].pos - p0);
+			const float length = glm::length(normal);
+			if (length > 0.0f) {
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		meshlet.cone = s_openCone;
+		const float axisLength = glm::length(axis);
+		if (normals.empty() || axisLength <= 1e-6f) {
+			return meshlet;
+		}
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals) {
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		}
+
+		//A cone of 90 degrees or more always has someone facing the camera.
+		//w is the sine of the spread -- the cull shader's test needs it, not the cosine
+		if (minDot > 0.0f) {
+			meshlet.cone = glm::vec4(axis, std::sqrt(std::max(0.0f, 1.0f - minDot * minDot)));
+		}
+		return meshlet;
+	}
+
+	void buildMeshlets(MeshData& mesh)
+	{
+		mesh.meshlets.clear();
+
+		//LOD 0 is always first in the index buffer
+		const uint32_t indexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+		const uint32_t triangleCount = indexCount / 3;
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		if (triangleCount == 0) {
+			return;
+		}
+
+		//Triangles using each vertex, as offsets into one flat list
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++) {
+			adjacencyOffsets[mesh.indices[i] + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		{
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < triangleCount * 3; i++) {
+				adjacency[cursor[mesh.indices[i]]++] = i / 3;
+			}
+		}
+
+		//Stamped with the meshlet being built, so nothing needs clearing between meshlets
+		std::vector<uint32_t> vertexMeshlet(vertexCount, s_none);
+		std::vector<uint32_t> candidateMeshlet(triangleCount, s_none);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> candidates;
+
+		std::vector<uint32_t> output;
+		output.reserve(triangleCount * 3);
+		uint32_t seedCursor = 0;
+
+		while (output.size() < triangleCount * 3) {
+			const uint32_t meshletIndex = static_cast<uint32_t>(mesh.meshlets.size());
+			const uint32_t firstIndex = static_cast<uint32_t>(output.size());
+			uint32_t meshletVertices = 0, meshletTriangles = 0;
+			candidates.clear();
+
+			while (emitted[seedCursor]) {
+				seedCursor++;
+			}
+
+			for (uint32_t next = seedCursor; next != s_none; ) {
+				emitted[next] = true;
+				meshletTriangles++;
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t v = mesh.indices[next * 3 + c];
+					output.push_back(v);
+					if (vertexMeshlet[v] == meshletIndex) {
+						continue;
+					}
+					vertexMeshlet[v] = meshletIndex;
+					meshletVertices++;
+
+					//Its triangles become candidates to grow into
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+						const uint32_t triangle = adjacency[a];
+						if (!emitted[triangle] && candidateMeshlet[triangle] != meshletIndex) {
+							candidateMeshlet[triangle] = meshletIndex;
+							candidates.push_back(triangle);
+						}
+					}
+				}
+				if (meshletTriangles == s_maxMeshletTriangles) {
+					break;
+				}
+
+				//Fewest new vertices wins -- emitted candidates drop out as we go
+				next = s_none;
+				uint32_t bestNewVertices = 4;
+				for (size_t i = 0; i < candidates.size(); ) {
+					const uint32_t triangle = candidates[i];
+					if (emitted[triangle]) {
+						candidates[i] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					uint32_t newVertices = 0;
+					for (uint32_t c = 0; c < 3; c++) {
+						newVertices += vertexMeshlet[mesh.indices[triangle * 3 + c]] == meshletIndex ? 0 : 1;
+					}
+					if (meshletVertices + newVertices <= s_maxMeshletVertices && newVertices < bestNewVertices) {
+						bestNewVertices = newVertices;
+						next = triangle;
+						if (newVertices == 0) {
+							break;
+						}
+					}
+					i++;
+				}
+			}
+
+			Meshlet meshlet = computeMeshletBounds(mesh.vertices, output.data() + firstIndex, meshletTriangles * 3);
+			meshlet.firstIndex = firstIndex;
+			meshlet.vertexCount = meshletVertices;
+			mesh.meshlets.push_back(meshlet);
+		}
+
+		std::copy(output.begin(), output.end(), mesh.indices.begin());
+	}
+}
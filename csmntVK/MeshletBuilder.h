@@ -0,0 +1,33 @@
+#pragma once
+#ifndef _MESHLET_BUILDER_
+#define _MESHLET_BUILDER_
+
+#include <vector>
+#include <cstdint>
+#include "Model.h"
+
+/////////////////////////////////////////////////////
+//---meshletBuilder:
+//---Splits LOD 0 into small clusters the GPU can cull one
+//---by one. Meshlets grow greedily from a seed triangle over
+//---whichever neighbour adds the fewest new vertices, so they
+//---stay compact, & their triangles are regrouped so each is
+//---one contiguous index range. Seeds follow the existing
+//---order, which keeps most of the overdraw order intact
+/////////////////////////////////////////////////////
+
+namespace meshletBuilder {
+	//Small enough to cull finely, big enough that a draw per meshlet isn't all overhead.
+	//Same limits as the usual mesh shader meshlets, so the data carries over
+	const uint32_t s_maxMeshletVertices = 64;
+	const uint32_t s_maxMeshletTriangles = 124;
+
+	//Bounding sphere & normal cone of one index range. Ranges whose normals spread too far
+	//(or cancel out) get a cone that never backface culls
+	Meshlet computeMeshletBounds(const std::vector<Vertex>& vertices, const uint32_t* pIndices, uint32_t indexCount);
+
+	//Regroups LOD 0's triangles into meshlets & fills mesh.meshlets. Other LODs aren't touched
+	void buildMeshlets(MeshData& mesh);
+}
+
+#endif // !_MESHLET_BUILDER_
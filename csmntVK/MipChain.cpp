@@ -0,0 +1,279 @@
+#include "MipChain.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//SSE2 is baseline on x64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE 1
+#include <emmintrin.h>
+#else
+#define MIP_CHAIN_SSE 0
+#endif
+
+namespace {
+	//One RGBA pixel of the float working image
+#if MIP_CHAIN_SSE
+	typedef __m128 Pixel;
+	inline Pixel loadPixel(const float* p) { return _mm_loadu_ps(p); }
+	inline void storePixel(float* p, Pixel v) { _mm_storeu_ps(p, v); }
+	inline Pixel zeroPixel() { return _mm_setzero_ps(); }
+	inline Pixel addPixel(Pixel a, Pixel b) { return _mm_add_ps(a, b); }
+	inline Pixel scalePixel(Pixel a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+	inline Pixel clampPixel(Pixel a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+#else
+	struct Pixel { float v[4]; };
+	inline Pixel loadPixel(const float* p) { Pixel r; memcpy(r.v, p, sizeof(r.v)); return r; }
+	inline void storePixel(float* p, Pixel a) { memcpy(p, a.v, sizeof(a.v)); }
+	inline Pixel zeroPixel() { return Pixel{ { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+	inline Pixel addPixel(Pixel a, Pixel b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+	inline Pixel scalePixel(Pixel a, float s) { for (int i = 0; i < 4; i++) a.v[i] *= s; return a; }
+	inline Pixel clampPixel(Pixel a) { for (int i = 0; i < 4; i++) a.v[i] = std::min(std::max(a.v[i], 0.0f), 1.0f); return a; }
+#endif
+
+	//Linear -> 8 bit goes through a table this fine, plenty for 256 output values
+	const uint32_t s_encodeTableSize = 4096;
+
+	struct ColourTables {
+		float	decode[256];
+		uint8_t	encode[s_encodeTableSize + 1];
+	};
+
+	float srgbToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	struct ColourTableSet {
+		ColourTables	linear;
+		ColourTables	srgb;
+
+		ColourTableSet()
+		{
+			for (int i = 0; i < 256; i++) {
+				linear.decode[i] = i / 255.0f;
+				srgb.decode[i] = srgbToLinear(i / 255.0f);
+			}
+			for (uint32_t i = 0; i <= s_encodeTableSize; i++) {
+				float c = static_cast<float>(i) / s_encodeTableSize;
+				linear.encode[i] = static_cast<uint8_t>(c * 255.0f + 0.5f);
+				srgb.encode[i] = static_cast<uint8_t>(linearToSrgb(c) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const ColourTables& getTables(bool srgb)
+	{
+		//Built once, on first use from whichever thread gets here first
+		static const ColourTableSet tables;
+		return srgb ? tables.srgb : tables.linear;
+	}
+
+	//Rows of the level being filtered -- level 0 is decoded a row at a time from the 8 bit
+	//source instead of keeping a float copy of the biggest level around
+	struct RowSource {
+		const float*		pFloat = nullptr;
+		const uint8_t*		pBytes = nullptr;
+		const ColourTables*	pTables = nullptr;
+		uint32_t			width = 0;
+		std::vector<float>	rowCache[2];
+
+		const float* getRow(uint32_t y, int slot)
+		{
+			if (pFloat) {
+				return pFloat + static_cast<size_t>(y) * width * 4;
+			}
+
+			std::vector<float>& row = rowCache[slot];
+			row.resize(static_cast<size_t>(width) * 4);
+			const uint8_t* pIn = pBytes + static_cast<size_t>(y) * width * 4;
+			for (uint32_t x = 0; x < width * 4; x += 4) {
+				row[x + 0] = pTables->decode[pIn[x + 0]];
+				row[x + 1] = pTables->decode[pIn[x + 1]];
+				row[x + 2] = pTables->decode[pIn[x + 2]];
+				row[x + 3] = pIn[x + 3] / 255.0f;		//alpha is always linear
+			}
+			return row.data();
+		}
+	};
+
+	//Modified Bessel function of the first kind, order 0
+	double besselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; k++) {
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	//Weights for a 2:1 decimation -- output pixel i sits between source pixels 2i & 2i+1
+	const int s_kaiserRadius = 3;
+	const double s_kaiserBeta = 4.0;
+
+	void buildKaiserWeights(float* pWeights)
+	{
+		const double pi = 3.14159265358979323846;
+		double total = 0.0;
+		for (int k = 0; k < 2 * s_kaiserRadius; k++) {
+			//distance from the output centre, in source pixels
+			double t = (k - s_kaiserRadius + 1) - 0.5;
+			double x = t / 2.0;		//cutoff at half the source rate
+			double sinc = std::sin(pi * x) / (pi * x);
+			double r = t / s_kaiserRadius;
+			double window = besselI0(s_kaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(s_kaiserBeta);
+			pWeights[k] = static_cast<float>(sinc * window);
+			total += pWeights[k];
+		}
+		for (int k = 0; k < 2 * s_kaiserRadius; k++) {
+			pWeights[k] = static_cast<float>(pWeights[k] / total);
+		}
+	}
+
+	void downsampleBox(RowSource& src, uint32_t srcWidth, uint32_t srcHeight, float* pDst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			const float* pRow0 = src.getRow(std::min(2 * y, srcHeight - 1), 0);
+			const float* pRow1 = src.getRow(std::min(2 * y + 1, srcHeight - 1), 1);
+			float* pOut = pDst + static_cast<size_t>(y) * dstWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+				uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+
+				Pixel sum = addPixel(addPixel(loadPixel(pRow0 + x0), loadPixel(pRow0 + x1)),
+					addPixel(loadPixel(pRow1 + x0), loadPixel(pRow1 + x1)));
+				storePixel(pOut + x * 4, scalePixel(sum, 0.25f));
+			}
+		}
+	}
+
+	//Separable -- rows first into scratch, then columns. Edges clamp
+	void downsampleKaiser(RowSource& src, uint32_t srcWidth, uint32_t srcHeight, float* pDst, uint32_t dstWidth, uint32_t dstHeight,
+		std::vector<float>& scratch)
+	{
+		float weights[2 * s_kaiserRadius];
+		buildKaiserWeights(weights);
+
+		//A dimension that's already 1 just carries through
+		const bool filterX = srcWidth > 1;
+		const bool filterY = srcHeight > 1;
+
+		scratch.resize(static_cast<size_t>(dstWidth) * srcHeight * 4);
+
+		for (uint32_t y = 0; y < srcHeight; y++) {
+			const float* pRow = src.getRow(y, 0);
+			float* pOut = scratch.data() + static_cast<size_t>(y) * dstWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				if (!filterX) {
+					storePixel(pOut + x * 4, loadPixel(pRow + x * 4));
+					continue;
+				}
+
+				Pixel sum = zeroPixel();
+				for (int k = 0; k < 2 * s_kaiserRadius; k++) {
+					int sx = std::min(std::max(static_cast<int>(2 * x) + k - s_kaiserRadius + 1, 0), static_cast<int>(srcWidth) - 1);
+					sum = addPixel(sum, scalePixel(loadPixel(pRow + sx * 4), weights[k]));
+				}
+				storePixel(pOut + x * 4, sum);
+			}
+		}
+
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			float* pOut = pDst + static_cast<size_t>(y) * dstWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				if (!filterY) {
+					storePixel(pOut + x * 4, loadPixel(scratch.data() + static_cast<size_t>(y) * dstWidth * 4 + x * 4));
+					continue;
+				}
+
+				Pixel sum = zeroPixel();
+				for (int k = 0; k < 2 * s_kaiserRadius; k++) {
+					int sy = std::min(std::max(static_cast<int>(2 * y) + k - s_kaiserRadius + 1, 0), static_cast<int>(srcHeight) - 1);
+					sum = addPixel(sum, scalePixel(loadPixel(scratch.data() + (static_cast<size_t>(sy) * dstWidth + x) * 4), weights[k]));
+				}
+				storePixel(pOut + x * 4, sum);
+			}
+		}
+	}
+
+	void encodeLevel(const float* pSrc, size_t pixelCount, const ColourTables& tables, uint8_t* pDst)
+	{
+		float pixel[4];
+		for (size_t i = 0; i < pixelCount; i++) {
+			//Kaiser lobes can overshoot -- clamp before the table lookup
+			storePixel(pixel, clampPixel(loadPixel(pSrc + i * 4)));
+
+			for (int c = 0; c < 3; c++) {
+				pDst[i * 4 + c] = tables.encode[static_cast<uint32_t>(pixel[c] * s_encodeTableSize + 0.5f)];
+			}
+			//Alpha is always linear
+			pDst[i * 4 + 3] = static_cast<uint8_t>(pixel[3] * 255.0f + 0.5f);
+		}
+	}
+}
+
+namespace mipChain {
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+			levels++;
+		}
+		return levels;
+	}
+
+	std::vector<uint8_t> buildMipChain(const uint8_t* pPixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb,
+		std::vector<MipLevel>& levels)
+	{
+		const ColourTables& tables = getTables(srgb);
+		const uint32_t levelCount = getMipLevelCount(width, height);
+
+		//Lay the levels out first, so the output is allocated once
+		levels.resize(levelCount);
+		VkDeviceSize totalSize = 0;
+		for (uint32_t i = 0; i < levelCount; i++) {
+			levels[i].offset = totalSize;
+			levels[i].width = std::max(1u, width >> i);
+			levels[i].height = std::max(1u, height >> i);
+			totalSize += static_cast<VkDeviceSize>(levels[i].width) * levels[i].height * 4;
+		}
+
+		std::vector<uint8_t> chain(static_cast<size_t>(totalSize));
+		memcpy(chain.data(), pPixels, static_cast<size_t>(width) * height * 4);
+
+		//Past level 1 each level filters the float copy of the one above, so rounding never accumulates
+		RowSource source;
+		source.pBytes = pPixels;
+		source.pTables = &tables;
+
+		std::vector<float> current, next, scratch;
+		for (uint32_t i = 1; i < levelCount; i++) {
+			const MipLevel& src = levels[i - 1];
+			const MipLevel& dst = levels[i];
+			next.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+			source.width = src.width;
+
+			if (filter == MipFilter::Kaiser) {
+				downsampleKaiser(source, src.width, src.height, next.data(), dst.width, dst.height, scratch);
+			}
+			else {
+				downsampleBox(source, src.width, src.height, next.data(), dst.width, dst.height);
+			}
+
+			encodeLevel(next.data(), static_cast<size_t>(dst.width) * dst.height, tables, chain.data() + dst.offset);
+			current.swap(next);
+			source.pFloat = current.data();
+		}
+
+		return chain;
+	}
+}
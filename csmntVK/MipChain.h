@@ -0,0 +1,38 @@
+#pragma once
+#ifndef _MIP_CHAIN_
+#define _MIP_CHAIN_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+//One level of a packed mip chain -- offset from the start of the chain's data
+struct MipLevel {
+	VkDeviceSize	offset;
+	uint32_t		width;
+	uint32_t		height;
+};
+
+enum class MipFilter {
+	Box,		//2x2 average -- cheap, a little soft & prone to aliasing
+	Kaiser		//6 tap Kaiser windowed sinc -- sharper, for offline/import
+};
+
+/////////////////////////////////////////////////////
+//---mipChain:
+//---CPU mip generation for RGBA8 images. Filtering runs
+//---on linear float RGBA (SSE when available) -- sRGB
+//---data is linearised first & re-encoded per level, so
+//---minified textures keep their brightness
+/////////////////////////////////////////////////////
+
+namespace mipChain {
+	//Full chain down to 1x1
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	//Every level, level 0 included, packed tightly one after another
+	std::vector<uint8_t> buildMipChain(const uint8_t* pPixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb,
+		std::vector<MipLevel>& levels);
+}
+
+#endif // !_MIP_CHAIN_
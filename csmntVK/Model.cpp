@@ -0,0 +1,162 @@
+#include "Model.h"
+#include "MeshImport.h"
+#include "VertexPacking.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <iostream>
+
+Model::Model(VertexFormat format)
+	: m_vertexFormat(format), m_vertexStride(vertexPacking::getVertexStride(format))
+{
+	m_mesh.vertices = {
+		{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+		{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+		{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+		{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},
+
+		{{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+		{{0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+		{{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+		{{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
+	};
+	m_mesh.indices = {
+		0, 1, 2, 2, 3, 0,
+		4, 5, 6, 6, 7, 4
+	};
+
+	setFromMeshData();
+}
+
+Model::Model(const std::string& path, const ModelLoadOptions& options)
+	: m_vertexFormat(options.vertexFormat), m_vertexStride(vertexPacking::getVertexStride(options.vertexFormat))
+{
+	const VertexFormat format = options.vertexFormat;
+
+	if (meshCooker::isCookedPath(path)) {
+		//Hand out pointers straight into the mapping
+		m_cooked.open(path);
+		const CookedMeshHeader& header = m_cooked.getHeader();
+
+		//Nothing to convert with -- the blob goes to the GPU as it is
+		if (header.vertexFormat != static_cast<uint32_t>(format)) {
+			m_cooked.close();
+			throw std::runtime_error("cooked mesh has " + std::string(header.vertexFormat == static_cast<uint32_t>(VertexFormat::Packed) ? "packed" : "full") +
+				" vertices, run with that vertex format or re-cook it: " + path);
+		}
+
+		m_pVertexData = m_cooked.getVertexData();
+		m_vertexCount = static_cast<uint32_t>(header.vertexCount);
+		m_pIndexData = m_cooked.getIndexData();
+		m_indexCount = static_cast<uint32_t>(header.indexCount);
+		m_indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		m_lods.assign(m_cooked.getLods(), m_cooked.getLods() + header.lodCount);
+		m_meshlets.assign(m_cooked.getMeshlets(), m_cooked.getMeshlets() + header.meshletCount);
+
+		//Farthest corner of the cooked bounds
+		glm::vec3 extent;
+		for (int i = 0; i < 3; i++) {
+			extent[i] = std::max(std::abs(header.boundsMin[i]), std::abs(header.boundsMax[i]));
+		}
+		m_boundingRadius = glm::length(extent);
+
+		if (format == VertexFormat::Packed) {
+			m_dequantize = vertexPacking::getDequantizeTransform(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+				glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+		}
+		return;
+	}
+
+	meshImport::loadMesh(path, m_mesh);
+
+	//Authored order is rarely cache friendly -- same triangles, drawn in a better order
+	if (options.optimize) {
+#if !_DEBUG
+		meshOptimizer::optimizeMesh(m_mesh);
+#else
+		MeshOptimizeStats stats = meshOptimizer::optimizeMesh(m_mesh);
+		std::cout << "HEY! " << path << " optimized in " << stats.milliseconds << "ms, ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+			<< ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+#endif
+	}
+	//Meshlets regroup LOD 0 only, so they go before the LODs are appended
+	if (options.buildMeshlets) {
+		meshletBuilder::buildMeshlets(m_mesh);
+	}
+	if (options.generateLods) {
+		meshSimplifier::buildLodChain(m_mesh);
+	}
+	setFromMeshData();
+}
+
+void Model::setFromMeshData()
+{
+	m_pVertexData = m_mesh.vertices.data();
+	m_vertexCount = static_cast<uint32_t>(m_mesh.vertices.size());
+
+	//Quantized against the mesh's own bounds, which the draw's model matrix then undoes
+	if (m_vertexFormat == VertexFormat::Packed) {
+		glm::vec3 boundsMin, boundsMax;
+		vertexPacking::getBounds(m_mesh.vertices, boundsMin, boundsMax);
+		vertexPacking::packVertices(m_mesh, boundsMin, boundsMax, m_packedVertices);
+		m_dequantize = vertexPacking::getDequantizeTransform(boundsMin, boundsMax);
+		m_pVertexData = m_packedVertices.data();
+	}
+	m_indexCount = static_cast<uint32_t>(m_mesh.indices.size());
+	m_lods = m_mesh.lods;
+	if (m_lods.empty()) {
+		m_lods.push_back({ 0, m_indexCount, 0.0f });
+	}
+	m_meshlets = m_mesh.meshlets;
+
+	float radiusSquared = 0.0f;
+	for (const Vertex& vertex : m_mesh.vertices) {
+		radiusSquared = std::max(radiusSquared, glm::dot(vertex.pos, vertex.pos));
+	}
+	m_boundingRadius = std::sqrt(radiusSquared);
+
+	//Half the index bandwidth when every index fits
+	if (m_mesh.vertices.size() <= 0xFFFF) {
+		m_indices16.assign(m_mesh.indices.begin(), m_mesh.indices.end());
+		m_pIndexData = m_indices16.data();
+		m_indexType = VK_INDEX_TYPE_UINT16;
+	}
+	else {
+		m_pIndexData = m_mesh.indices.data();
+		m_indexType = VK_INDEX_TYPE_UINT32;
+	}
+}
+
+const uint32_t Model::selectLod(uint32_t current, float pixelsPerUnit, float maxPixels, float hysteresis) const
+{
+	current = std::min(current, getLodCount() - 1);
+
+	//Errors only grow down the chain, so walk it until the next one doesn't fit
+	auto coarsestWithin = [&](float pixels) {
+		uint32_t lod = 0;
+		while (lod + 1 < getLodCount() && m_lods[lod + 1].error * pixelsPerUnit <= pixels) {
+			lod++;
+		}
+		return lod;
+	};
+
+	//Too coarse now -- go as fine as it takes straight away
+	if (m_lods[current].error * pixelsPerUnit > maxPixels) {
+		return coarsestWithin(maxPixels);
+	}
+	//Only coarsen once there's margin
+	return std::max(current, coarsestWithin(maxPixels * (1.0f - hysteresis)));
+}
+
+void Model::releaseSourceData()
+{
+	m_cooked.close();
+	m_mesh = MeshData();
+	m_packedVertices = std::vector<PackedVertex>();
+	m_indices16 = std::vector<uint16_t>();
+	m_pVertexData = nullptr;
+	m_pIndexData = nullptr;
+}
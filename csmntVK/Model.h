@@ -4,9 +4,17 @@
 
 #include <vector>
 #include <array>
+#include <string>
 
 #include <vulkan/vulkan.h>
 #include "../Libraries/glm/glm.hpp"
+#include "CookedMesh.h"
+
+//Vertex layouts a Model can hand out. A run picks one & the pipeline's vertex input follows it
+enum class VertexFormat : uint32_t {
+	Full = 0,		//Vertex, 32 bytes of floats
+	Packed = 1		//PackedVertex, 20 bytes -- positions come back through Model::getDequantizeTransform
+};
 
 struct Vertex {
   glm::vec3 pos;
@@ -42,27 +50,193 @@ struct Vertex {
   }
 };
 
+//Quantized at import: position snorm16 within the mesh bounds, colour rgba8 unorm, uvs half float,
+//normal & tangent octahedral snorm8. Locations match Vertex, so the same shaders read either --
+//the vertex fetch unpacks everything to floats
+struct PackedVertex {
+  int16_t pos[4];				//xyz in the bounds, w the tangent's handedness
+  uint8_t colour[4];
+  uint16_t texCoord[2];
+  int8_t normalTangent[4];		//octahedral normal in xy, tangent in zw
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+	VkVertexInputBindingDescription bindingDescription = {};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(PackedVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	return bindingDescription;
+  }
+  static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+	//Position
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+	attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+	//Colour
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attributeDescriptions[1].offset = offsetof(PackedVertex, colour);
+
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+	attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
+	//Normal & tangent -- past the instance attributes, nothing lit reads them yet
+	attributeDescriptions[3].binding = 0;
+	attributeDescriptions[3].location = 8;
+	attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_SNORM;
+	attributeDescriptions[3].offset = offsetof(PackedVertex, normalTangent);
+
+	return attributeDescriptions;
+  }
+};
+
+//Per instance attributes, stepped once per instance from binding 1
+struct InstanceData {
+  glm::mat4 model;
+  uint32_t textureIndex;	//slot in the bindless texture table
+  uint32_t padding[3];
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+	VkVertexInputBindingDescription bindingDescription = {};
+	bindingDescription.binding = 1;
+	bindingDescription.stride = sizeof(InstanceData);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+	return bindingDescription;
+  }
+  static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = {};
+	//Model matrix -- a mat4 takes a location per column
+	for (uint32_t i = 0; i < 4; i++) {
+		attributeDescriptions[i].binding = 1;
+		attributeDescriptions[i].location = 3 + i;
+		attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[i].offset = offsetof(InstanceData, model) + i * sizeof(glm::vec4);
+	}
+	//Texture index
+	attributeDescriptions[4].binding = 1;
+	attributeDescriptions[4].location = 7;
+	attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+	attributeDescriptions[4].offset = offsetof(InstanceData, textureIndex);
+
+	return attributeDescriptions;
+  }
+};
+
+//One level of detail -- a range of the shared index buffer, over the shared vertices
+struct MeshLod {
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	float		error;			//how far the surface may have moved from LOD 0, in mesh units
+};
+
+//Cluster of LOD 0 the GPU culls on its own -- a range of the shared index buffer & its bounds (std430, matches cull.comp)
+struct Meshlet {
+	glm::vec4	boundingSphere;		//mesh space centre & radius
+	glm::vec4	cone;				//mesh space normal axis & the sine of the normals' spread, 1 = never backfacing
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	uint32_t	vertexCount;		//unique vertices
+	uint32_t	padding;
+};
+
+//CPU side geometry -- what the importers produce & the cooker consumes
+struct MeshData {
+	std::vector<Vertex>		vertices;
+	std::vector<uint32_t>	indices;
+	//Per vertex when the source has them, zero where it doesn't -- packing generates the rest
+	std::vector<glm::vec3>	normals;
+	std::vector<glm::vec4>	tangents;			//w = handedness
+	//Empty until a LOD chain is built -- then LOD 0 first, coarser ones after
+	std::vector<MeshLod>	lods;
+	//Empty until meshlets are built -- then they cover LOD 0's indices, in order
+	std::vector<Meshlet>	meshlets;
+};
+
+//How text meshes are prepared on load
+struct ModelLoadOptions {
+	VertexFormat	vertexFormat = VertexFormat::Full;
+	bool			optimize = true;		//meshOptimizer reordering
+	bool			generateLods = true;	//simplified LODs after LOD 0 in the index buffer
+	bool			buildMeshlets = false;	//LOD 0 regrouped into meshlets for cluster culling
+};
+
+/////////////////////////////////////////////////////
+//---Model:
+//---Vertex & index data ready to be staged. Text formats
+//---(.obj, .gltf/.glb) are parsed into a MeshData, cooked
+//---meshes (.cmesh) are mapped & handed out as-is.
+//---Imported meshes are reordered for the vertex cache,
+//---overdraw & fetch before anything else sees them, then
+//---get a chain of simplified LODs sharing their vertices.
+//---LOD 0 can also be split into meshlets for cluster culling.
+//---Text formats are packed on load when asked for packed
+//---vertices, cooked ones must have been cooked that way.
+//---Indices are 16 bit whenever the vertex count allows
+/////////////////////////////////////////////////////
+
 class Model {
- public:
-  const std::vector<Vertex>& getVertices() { return vertices; };
-  const std::vector<uint16_t>& getIndices() { return indices; };
- private:
-  const std::vector<Vertex> vertices = {
-	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
-	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-	{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
-	{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},
-
-	{{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
-	{{0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-	{{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
-	{{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
-
-	};
-  const std::vector<uint16_t> indices = {
-	0, 1, 2, 2, 3, 0,
-	4, 5, 6, 6, 7, 4
-  };
+public:
+	//Built-in test quads
+	Model(VertexFormat format = VertexFormat::Full);
+	//Throws if the file can't be loaded, or is a .cmesh cooked in another vertex format.
+	//Options only apply to text formats, cooked ones were prepared at cook time
+	Model(const std::string& path, const ModelLoadOptions& options = ModelLoadOptions());
+	~Model() {};
+	Model(Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	const void* getVertexData() const { return m_pVertexData; };
+	const VkDeviceSize getVertexDataSize() const { return static_cast<VkDeviceSize>(m_vertexCount) * m_vertexStride; };
+	const uint32_t getVertexCount() const { return m_vertexCount; };
+	const VertexFormat getVertexFormat() const { return m_vertexFormat; };
+	//Object space from what the vertex fetch hands the shader -- identity unless positions are quantized
+	const glm::mat4& getDequantizeTransform() const { return m_dequantize; };
+
+	const void* getIndexData() const { return m_pIndexData; };
+	const VkDeviceSize getIndexDataSize() const { return static_cast<VkDeviceSize>(m_indexCount) * (m_indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4); };
+	//Every LOD's indices
+	const uint32_t getIndexCount() const { return m_indexCount; };
+	const VkIndexType getIndexType() const { return m_indexType; };
+
+	//Sphere about the model's origin holding every vertex -- stays put under rotation
+	const float getBoundingRadius() const { return m_boundingRadius; };
+
+	//Always at least LOD 0, errors grow with the index
+	const uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); };
+	const MeshLod& getLod(uint32_t lod) const { return m_lods[lod]; };
+	//Coarsest LOD whose error projects to at most maxPixels, for a draw where one mesh unit covers
+	//pixelsPerUnit. Going coarser needs the error to fit (1 - hysteresis) of that, so a draw sitting
+	//on a threshold doesn't flip between two LODs every frame
+	const uint32_t selectLod(uint32_t current, float pixelsPerUnit, float maxPixels, float hysteresis) const;
+
+	//LOD 0's meshlets, empty unless they were built (or cooked)
+	const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; };
+
+	//Drop the CPU copy / mapping once the data has been staged
+	void releaseSourceData();
+
+private:
+	void setFromMeshData();
+
+	MeshData				m_mesh;
+	std::vector<PackedVertex> m_packedVertices;
+	std::vector<uint16_t>	m_indices16;
+	CookedMesh				m_cooked;
+
+	VertexFormat			m_vertexFormat = VertexFormat::Full;
+	uint32_t				m_vertexStride = sizeof(Vertex);
+	glm::mat4				m_dequantize = glm::mat4(1.0f);
+	const void*				m_pVertexData = nullptr;
+	uint32_t				m_vertexCount = 0;
+	const void*				m_pIndexData = nullptr;
+	uint32_t				m_indexCount = 0;
+	VkIndexType				m_indexType = VK_INDEX_TYPE_UINT16;
+	float					m_boundingRadius = 0.0f;
+	std::vector<MeshLod>	m_lods;
+	std::vector<Meshlet>	m_meshlets;
 };
 
-#endif
\ No newline at end of file
+#endif // !_MODEL_CLASS_
\ No newline at end of file
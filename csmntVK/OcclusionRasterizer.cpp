@@ -0,0 +1,592 @@
+#include "OcclusionRasterizer.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+//SSE2 is baseline on x64, AVX2 only where the build targets it (/arch:AVX2)
+#if defined(__AVX2__)
+#define OCCLUSION_AVX2 1
+#include <immintrin.h>
+#else
+#define OCCLUSION_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#else
+#define OCCLUSION_SSE 0
+#endif
+
+const float OcclusionRasterizer::s_guardBand = 2.0f;
+const float OcclusionRasterizer::s_nearClipW = 1e-4f;
+
+namespace {
+	const uint32_t TILE_WIDTH = OcclusionRasterizer::s_tileWidth;
+	const uint32_t TILE_HEIGHT = OcclusionRasterizer::s_tileHeight;
+	const uint32_t FULL_ROW = 0xFFFFFFFFu;
+
+	//Columns from the first covered one (0..32) / up to the last covered one (-1..31, looked up at + 1) of a row
+	struct RowMaskTables {
+		uint32_t	left[TILE_WIDTH + 1];
+		uint32_t	right[TILE_WIDTH + 1];
+
+		RowMaskTables()
+		{
+			for (uint32_t i = 0; i <= TILE_WIDTH; i++) {
+				left[i] = i < TILE_WIDTH ? FULL_ROW << i : 0;
+				right[i] = i > 0 ? FULL_ROW >> (TILE_WIDTH - i) : 0;
+			}
+		}
+	};
+	const RowMaskTables s_rowMasks;
+
+	//Where a row's crossing lands, kept clear of the int conversion & the tables' ends
+	const float CROSSING_MIN = -2.0f;
+	const float CROSSING_MAX = TILE_WIDTH + 1.0f;
+
+#if OCCLUSION_SSE
+	//No _mm_floor_ps before SSE4.1 -- truncate, then step down where that rounded up
+	inline __m128 floorSse(__m128 v)
+	{
+		const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, v), _mm_set1_ps(1.0f)));
+	}
+#endif
+
+	//Clip space planes, in outcode bit order -- near, then the guard band's sides
+	float planeDistance(const glm::vec4& v, uint32_t plane, float guardBand, float nearW)
+	{
+		switch (plane) {
+		case 0: return v.w - nearW;
+		case 1: return v.x + guardBand * v.w;
+		case 2: return guardBand * v.w - v.x;
+		case 3: return v.y + guardBand * v.w;
+		default: return guardBand * v.w - v.y;
+		}
+	}
+	const uint32_t PLANE_COUNT = 5;
+
+	uint32_t outcode(const glm::vec4& v, float guardBand, float nearW)
+	{
+		uint32_t code = 0;
+		for (uint32_t plane = 0; plane < PLANE_COUNT; plane++) {
+			if (planeDistance(v, plane, guardBand, nearW) < 0.0f) {
+				code |= 1u << plane;
+			}
+		}
+		return code;
+	}
+
+	//Sutherland-Hodgman against the planes in planeMask -- a triangle comes out with at most 3 + 5 vertices
+	const uint32_t MAX_CLIPPED_VERTICES = 3 + PLANE_COUNT;
+	uint32_t clipPolygon(glm::vec4* pVertices, uint32_t count, uint32_t planeMask, float guardBand, float nearW)
+	{
+		glm::vec4 scratch[MAX_CLIPPED_VERTICES];
+		for (uint32_t plane = 0; plane < PLANE_COUNT && count > 0; plane++) {
+			if (!(planeMask & (1u << plane))) {
+				continue;
+			}
+
+			uint32_t outCount = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				const glm::vec4& a = pVertices[i];
+				const glm::vec4& b = pVertices[(i + 1) % count];
+				const float da = planeDistance(a, plane, guardBand, nearW);
+				const float db = planeDistance(b, plane, guardBand, nearW);
+
+				if (da >= 0.0f) {
+					scratch[outCount++] = a;
+				}
+				if ((da >= 0.0f) != (db >= 0.0f)) {
+					scratch[outCount++] = a + (b - a) * (da / (da - db));
+				}
+			}
+
+			count = std::min(outCount, MAX_CLIPPED_VERTICES);
+			std::copy(scratch, scratch + count, pVertices);
+		}
+		return count;
+	}
+}
+
+#pragma region SETUP
+void OcclusionRasterizer::create(uint32_t width, uint32_t height)
+{
+	m_width = std::max(1u, width);
+	m_height = std::max(1u, height);
+	m_tilesX = (m_width + TILE_WIDTH - 1) / TILE_WIDTH;
+	m_tilesY = (m_height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+	m_masks.resize(static_cast<size_t>(m_tilesX) * m_tilesY * TILE_HEIGHT);
+	m_depths.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+	clear();
+}
+
+void OcclusionRasterizer::clear()
+{
+	std::fill(m_masks.begin(), m_masks.end(), 0u);
+	std::fill(m_depths.begin(), m_depths.end(), TileDepth{ 1.0f, 1.0f });
+	m_occluderCount = 0;
+	m_triangleCount = 0;
+}
+
+void OcclusionRasterizer::addOccluder(const glm::vec3* pPositions, const uint32_t* pIndices, uint32_t indexCount, const glm::mat4& modelViewProj)
+{
+	if (m_occluderCount == m_occluders.size()) {
+		m_occluders.emplace_back();
+	}
+
+	Occluder& occluder = m_occluders[m_occluderCount++];
+	occluder.pPositions = pPositions;
+	occluder.pIndices = pIndices;
+	occluder.indexCount = indexCount;
+	occluder.modelViewProj = modelViewProj;
+}
+
+void OcclusionRasterizer::setSimd(OcclusionSimd simd)
+{
+	m_simd = static_cast<OcclusionSimd>(std::min(static_cast<uint32_t>(simd), static_cast<uint32_t>(getBestSimd())));
+}
+
+OcclusionSimd OcclusionRasterizer::getBestSimd()
+{
+#if OCCLUSION_AVX2
+	return OcclusionSimd::Avx2;
+#elif OCCLUSION_SSE
+	return OcclusionSimd::Sse;
+#else
+	return OcclusionSimd::Scalar;
+#endif
+}
+
+const char* OcclusionRasterizer::getSimdName(OcclusionSimd simd)
+{
+	switch (simd) {
+	case OcclusionSimd::Avx2: return "avx2";
+	case OcclusionSimd::Sse: return "sse2";
+	default: return "scalar";
+	}
+}
+
+void OcclusionRasterizer::setupOccluder(Occluder& occluder) const
+{
+	occluder.triangles.clear();
+
+	for (uint32_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+		glm::vec4 clip[MAX_CLIPPED_VERTICES];
+		uint32_t codes[3];
+		for (uint32_t v = 0; v < 3; v++) {
+			clip[v] = occluder.modelViewProj * glm::vec4(occluder.pPositions[occluder.pIndices[i + v]], 1.0f);
+			codes[v] = outcode(clip[v], s_guardBand, s_nearClipW);
+		}
+
+		//All outside one plane -- nothing to see. All inside the guard band -- no clipping
+		if (codes[0] & codes[1] & codes[2]) {
+			continue;
+		}
+		if (!(codes[0] | codes[1] | codes[2])) {
+			addTriangle(clip, occluder.triangles);
+			continue;
+		}
+
+		//Clipped into a convex polygon, fanned back out into triangles
+		const uint32_t count = clipPolygon(clip, 3, codes[0] | codes[1] | codes[2], s_guardBand, s_nearClipW);
+		for (uint32_t v = 2; v < count; v++) {
+			const glm::vec4 fan[3] = { clip[0], clip[v - 1], clip[v] };
+			addTriangle(fan, occluder.triangles);
+		}
+	}
+}
+
+void OcclusionRasterizer::addTriangle(const glm::vec4 clip[3], std::vector<Triangle>& triangles) const
+{
+	//Pixels, y down like the swap chain, & depth
+	glm::vec3 v[3];
+	for (uint32_t i = 0; i < 3; i++) {
+		const float invW = 1.0f / clip[i].w;
+		v[i] = glm::vec3((clip[i].x * invW * 0.5f + 0.5f) * m_width, (clip[i].y * invW * 0.5f + 0.5f) * m_height, clip[i].z * invW);
+	}
+
+	const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	if (area == 0.0f) {
+		return;
+	}
+
+	Triangle triangle;
+	triangle.minX = std::min(std::min(v[0].x, v[1].x), v[2].x);
+	triangle.minY = std::min(std::min(v[0].y, v[1].y), v[2].y);
+	triangle.maxX = std::max(std::max(v[0].x, v[1].x), v[2].x);
+	triangle.maxY = std::max(std::max(v[0].y, v[1].y), v[2].y);
+	triangle.maxDepth = std::max(std::max(v[0].z, v[1].z), v[2].z);
+
+	//Past the far plane everywhere, it can't hide anything
+	if (std::min(std::min(v[0].z, v[1].z), v[2].z) >= 1.0f) {
+		return;
+	}
+
+	//Tiles holding a pixel centre the bounds could cover
+	const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(triangle.minX)));
+	const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(triangle.minY)));
+	const int32_t x1 = std::min(static_cast<int32_t>(m_width) - 1, static_cast<int32_t>(std::ceil(triangle.maxX)));
+	const int32_t y1 = std::min(static_cast<int32_t>(m_height) - 1, static_cast<int32_t>(std::ceil(triangle.maxY)));
+	if (x0 > x1 || y0 > y1) {
+		return;
+	}
+	triangle.tileX0 = x0 / TILE_WIDTH;
+	triangle.tileY0 = y0 / TILE_HEIGHT;
+	triangle.tileX1 = x1 / TILE_WIDTH;
+	triangle.tileY1 = y1 / TILE_HEIGHT;
+
+	//Edge i runs from vertex i to i + 1, positive inside once the winding is flipped to match
+	const float side = area > 0.0f ? 1.0f : -1.0f;
+	for (uint32_t i = 0; i < 3; i++) {
+		const glm::vec3& a = v[i];
+		const glm::vec3& b = v[(i + 1) % 3];
+		const float edgeA = (a.y - b.y) * side;
+		const float edgeB = (b.x - a.x) * side;
+		const float edgeC = -(edgeA * a.x + edgeB * a.y);
+
+		triangle.edgeB[i] = edgeB;
+		triangle.edgeC[i] = edgeC;
+		triangle.edgeSide[i] = edgeA > 0.0f ? 1 : edgeA < 0.0f ? -1 : 0;
+		triangle.crossX[i] = edgeA != 0.0f ? -edgeC / edgeA : 0.0f;
+		triangle.crossSlope[i] = edgeA != 0.0f ? -edgeB / edgeA : 0.0f;
+	}
+
+	//Depth across the screen is linear in z / w
+	const float dx1 = v[1].x - v[0].x, dy1 = v[1].y - v[0].y, dz1 = v[1].z - v[0].z;
+	const float dx2 = v[2].x - v[0].x, dy2 = v[2].y - v[0].y, dz2 = v[2].z - v[0].z;
+	triangle.depthA = (dz1 * dy2 - dy1 * dz2) / area;
+	triangle.depthB = (dx1 * dz2 - dz1 * dx2) / area;
+	triangle.depthC = v[0].z - triangle.depthA * v[0].x - triangle.depthB * v[0].y;
+
+	triangles.push_back(triangle);
+}
+#pragma endregion
+
+#pragma region RASTERIZATION
+void OcclusionRasterizer::rasterize(JobSystem* pJobSystem)
+{
+	//Triangle setup, an occluder per job
+	if (pJobSystem) {
+		pJobSystem->parallelFor(m_occluderCount, [&](uint32_t job, uint32_t) {
+			setupOccluder(m_occluders[job]);
+		});
+	}
+	else {
+		for (uint32_t i = 0; i < m_occluderCount; i++) {
+			setupOccluder(m_occluders[i]);
+		}
+	}
+
+	m_triangleCount = 0;
+	for (uint32_t i = 0; i < m_occluderCount; i++) {
+		m_triangleCount += static_cast<uint32_t>(m_occluders[i].triangles.size());
+	}
+
+	//Bands own their tiles outright -- no two jobs touch the same one
+	const uint32_t bandCount = (m_tilesY + s_bandTileRows - 1) / s_bandTileRows;
+	if (pJobSystem) {
+		pJobSystem->parallelFor(bandCount, [&](uint32_t band, uint32_t) {
+			rasterizeBand(band * s_bandTileRows, std::min(uint32_t{ s_bandTileRows }, m_tilesY - band * s_bandTileRows));
+		});
+	}
+	else {
+		for (uint32_t band = 0; band < bandCount; band++) {
+			rasterizeBand(band * s_bandTileRows, std::min(uint32_t{ s_bandTileRows }, m_tilesY - band * s_bandTileRows));
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterizeBand(uint32_t firstTileRow, uint32_t tileRowCount)
+{
+	const int32_t bandY0 = static_cast<int32_t>(firstTileRow);
+	const int32_t bandY1 = static_cast<int32_t>(firstTileRow + tileRowCount) - 1;
+
+	for (uint32_t i = 0; i < m_occluderCount; i++) {
+		for (const Triangle& triangle : m_occluders[i].triangles) {
+			const int32_t tileY0 = std::max(triangle.tileY0, bandY0);
+			const int32_t tileY1 = std::min(triangle.tileY1, bandY1);
+			for (int32_t tileY = tileY0; tileY <= tileY1; tileY++) {
+				for (int32_t tileX = triangle.tileX0; tileX <= triangle.tileX1; tileX++) {
+					rasterizeTile(triangle, tileX, tileY);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterizeTile(const Triangle& triangle, int32_t tileX, int32_t tileY)
+{
+	const float pixelX = static_cast<float>(tileX * static_cast<int32_t>(TILE_WIDTH));
+	const float pixelY = static_cast<float>(tileY * static_cast<int32_t>(TILE_HEIGHT));
+
+	uint32_t coverage[TILE_HEIGHT];
+	computeRowMasks(triangle, pixelX, pixelY, coverage);
+
+	uint32_t covered = 0;
+	for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+		covered |= coverage[row];
+	}
+	if (!covered) {
+		return;
+	}
+
+	//Farthest the plane gets over the part of the tile inside the bounds -- a corner of it, as it's linear
+	const float x0 = std::max(pixelX, triangle.minX);
+	const float x1 = std::min(pixelX + TILE_WIDTH, triangle.maxX);
+	const float y0 = std::max(pixelY, triangle.minY);
+	const float y1 = std::min(pixelY + TILE_HEIGHT, triangle.maxY);
+	const float planeDepth = triangle.depthC + triangle.depthA * (triangle.depthA > 0.0f ? x1 : x0) + triangle.depthB * (triangle.depthB > 0.0f ? y1 : y0);
+
+	mergeTile(static_cast<uint32_t>(tileY) * m_tilesX + static_cast<uint32_t>(tileX), coverage, std::min(planeDepth, triangle.maxDepth));
+}
+
+//A row's pixels are covered right of every left edge's crossing & left of every right edge's.
+//Crossings are turned into the first & last covered column (exclusive of a centre right on an edge,
+//so rounding leans towards leaving a pixel out), then into a mask
+void OcclusionRasterizer::computeRowMasks(const Triangle& triangle, float tileX, float tileY, uint32_t masks[s_tileHeight]) const
+{
+	//Crossings relative to the tile's first pixel centre
+	const float originX = tileX + 0.5f;
+	const float originY = tileY + 0.5f;
+
+#if OCCLUSION_AVX2
+	if (m_simd == OcclusionSimd::Avx2) {
+		const __m256 rowY = _mm256_add_ps(_mm256_set1_ps(originY), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+		const __m256 crossingMin = _mm256_set1_ps(CROSSING_MIN);
+		const __m256 crossingMax = _mm256_set1_ps(CROSSING_MAX);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256 first = _mm256_setzero_ps();
+		__m256 last = _mm256_set1_ps(TILE_WIDTH - 1.0f);
+
+		for (uint32_t e = 0; e < 3; e++) {
+			if (triangle.edgeSide[e] == 0) {
+				//Horizontal -- rows entirely inside or out
+				const __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeB[e]), rowY), _mm256_set1_ps(triangle.edgeC[e]));
+				const __m256 outside = _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_LE_OQ);
+				first = _mm256_max_ps(first, _mm256_and_ps(outside, _mm256_set1_ps(static_cast<float>(TILE_WIDTH))));
+				continue;
+			}
+
+			__m256 crossing = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.crossSlope[e]), rowY), _mm256_set1_ps(triangle.crossX[e] - originX));
+			crossing = _mm256_min_ps(_mm256_max_ps(crossing, crossingMin), crossingMax);
+			if (triangle.edgeSide[e] > 0) {
+				first = _mm256_max_ps(first, _mm256_add_ps(_mm256_floor_ps(crossing), one));
+			}
+			else {
+				last = _mm256_min_ps(last, _mm256_sub_ps(_mm256_ceil_ps(crossing), one));
+			}
+		}
+
+		//Shift counts of 32 come out as 0 -- nothing covered
+		first = _mm256_min_ps(first, _mm256_set1_ps(static_cast<float>(TILE_WIDTH)));
+		last = _mm256_max_ps(last, _mm256_set1_ps(-1.0f));
+		const __m256i ones = _mm256_set1_epi32(-1);
+		const __m256i leftMasks = _mm256_sllv_epi32(ones, _mm256_cvtps_epi32(first));
+		const __m256i rightMasks = _mm256_srlv_epi32(ones, _mm256_sub_epi32(_mm256_set1_epi32(TILE_WIDTH - 1), _mm256_cvtps_epi32(last)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(masks), _mm256_and_si256(leftMasks, rightMasks));
+		return;
+	}
+#endif
+
+#if OCCLUSION_SSE
+	if (m_simd != OcclusionSimd::Scalar) {
+		//No variable per lane shifts before AVX2 -- SSE finds the columns, the tables make the masks
+		const __m128 crossingMin = _mm_set1_ps(CROSSING_MIN);
+		const __m128 crossingMax = _mm_set1_ps(CROSSING_MAX);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		for (uint32_t half = 0; half < TILE_HEIGHT; half += 4) {
+			const __m128 rowY = _mm_add_ps(_mm_set1_ps(originY + half), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+			__m128 first = _mm_setzero_ps();
+			__m128 last = _mm_set1_ps(TILE_WIDTH - 1.0f);
+
+			for (uint32_t e = 0; e < 3; e++) {
+				if (triangle.edgeSide[e] == 0) {
+					const __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeB[e]), rowY), _mm_set1_ps(triangle.edgeC[e]));
+					const __m128 outside = _mm_cmple_ps(value, _mm_setzero_ps());
+					first = _mm_max_ps(first, _mm_and_ps(outside, _mm_set1_ps(static_cast<float>(TILE_WIDTH))));
+					continue;
+				}
+
+				__m128 crossing = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.crossSlope[e]), rowY), _mm_set1_ps(triangle.crossX[e] - originX));
+				crossing = _mm_min_ps(_mm_max_ps(crossing, crossingMin), crossingMax);
+				if (triangle.edgeSide[e] > 0) {
+					first = _mm_max_ps(first, _mm_add_ps(floorSse(crossing), one));
+				}
+				else {
+					//ceil(x) == -floor(-x)
+					const __m128 ceiled = _mm_sub_ps(_mm_setzero_ps(), floorSse(_mm_sub_ps(_mm_setzero_ps(), crossing)));
+					last = _mm_min_ps(last, _mm_sub_ps(ceiled, one));
+				}
+			}
+
+			first = _mm_min_ps(first, _mm_set1_ps(static_cast<float>(TILE_WIDTH)));
+			last = _mm_max_ps(last, _mm_set1_ps(-1.0f));
+			alignas(16) int32_t firstColumns[4];
+			alignas(16) int32_t lastColumns[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(firstColumns), _mm_cvtps_epi32(first));
+			_mm_store_si128(reinterpret_cast<__m128i*>(lastColumns), _mm_cvtps_epi32(last));
+			for (uint32_t row = 0; row < 4; row++) {
+				masks[half + row] = s_rowMasks.left[firstColumns[row]] & s_rowMasks.right[lastColumns[row] + 1];
+			}
+		}
+		return;
+	}
+#endif
+
+	for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+		const float y = originY + row;
+		float first = 0.0f;
+		float last = TILE_WIDTH - 1.0f;
+
+		for (uint32_t e = 0; e < 3; e++) {
+			if (triangle.edgeSide[e] == 0) {
+				if (triangle.edgeB[e] * y + triangle.edgeC[e] <= 0.0f) {
+					first = static_cast<float>(TILE_WIDTH);
+				}
+				continue;
+			}
+
+			const float crossing = std::min(std::max(triangle.crossSlope[e] * y + (triangle.crossX[e] - originX), CROSSING_MIN), CROSSING_MAX);
+			if (triangle.edgeSide[e] > 0) {
+				first = std::max(first, std::floor(crossing) + 1.0f);
+			}
+			else {
+				last = std::min(last, std::ceil(crossing) - 1.0f);
+			}
+		}
+
+		first = std::min(first, static_cast<float>(TILE_WIDTH));
+		last = std::max(last, -1.0f);
+		masks[row] = s_rowMasks.left[static_cast<int32_t>(first)] & s_rowMasks.right[static_cast<int32_t>(last) + 1];
+	}
+}
+
+//The working layer takes the triangle unless it's so much nearer that starting over from it bounds the
+//tile better -- whatever was in the layer falls back to the reference depth, which still holds for it
+void OcclusionRasterizer::mergeTile(uint32_t tile, const uint32_t coverage[s_tileHeight], float depth)
+{
+	TileDepth& tileDepth = m_depths[tile];
+	if (depth >= tileDepth.referenceDepth) {
+		return;
+	}
+
+	uint32_t* pMask = &m_masks[static_cast<size_t>(tile) * TILE_HEIGHT];
+	uint32_t working = 0;
+	for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+		working |= pMask[row];
+	}
+
+	const bool restart = !working || tileDepth.workingDepth - depth > tileDepth.referenceDepth - tileDepth.workingDepth;
+	uint32_t full = FULL_ROW;
+	for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+		pMask[row] = restart ? coverage[row] : pMask[row] | coverage[row];
+		full &= pMask[row];
+	}
+	tileDepth.workingDepth = restart ? depth : std::max(tileDepth.workingDepth, depth);
+
+	//Every pixel's in the working layer -- it bounds the whole tile now
+	if (full == FULL_ROW) {
+		tileDepth.referenceDepth = tileDepth.workingDepth;
+		std::fill(pMask, pMask + TILE_HEIGHT, 0u);
+	}
+}
+#pragma endregion
+
+#pragma region TESTS
+const bool OcclusionRasterizer::isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& modelViewProj) const
+{
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+	float nearest = 1e30f;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		const glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+		const glm::vec4 clip = modelViewProj * glm::vec4(corner, 1.0f);
+
+		//Past the near plane, the rect is unbounded
+		if (clip.w <= s_nearClipW) {
+			return true;
+		}
+
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+		const float y = (clip.y * invW * 0.5f + 0.5f) * m_height;
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * invW);
+	}
+
+	//Every pixel the rect touches, kept in int range
+	const float limitX = static_cast<float>(m_width) + 1.0f;
+	const float limitY = static_cast<float>(m_height) + 1.0f;
+	const int32_t x0 = static_cast<int32_t>(std::floor(std::min(std::max(minX, -1.0f), limitX)));
+	const int32_t y0 = static_cast<int32_t>(std::floor(std::min(std::max(minY, -1.0f), limitY)));
+	const int32_t x1 = std::max(x0 + 1, static_cast<int32_t>(std::ceil(std::min(std::max(maxX, -1.0f), limitX))));
+	const int32_t y1 = std::max(y0 + 1, static_cast<int32_t>(std::ceil(std::min(std::max(maxY, -1.0f), limitY))));
+
+	return isRectVisible(x0, y0, x1, y1, nearest);
+}
+
+const bool OcclusionRasterizer::isRectVisible(int32_t x0, int32_t y0, int32_t x1, int32_t y1, float depth) const
+{
+	//Off screen is as good as hidden
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, static_cast<int32_t>(m_width));
+	y1 = std::min(y1, static_cast<int32_t>(m_height));
+	if (x0 >= x1 || y0 >= y1) {
+		return false;
+	}
+
+	const uint32_t tileX0 = x0 / TILE_WIDTH, tileX1 = (x1 - 1) / TILE_WIDTH;
+	const uint32_t tileY0 = y0 / TILE_HEIGHT, tileY1 = (y1 - 1) / TILE_HEIGHT;
+
+	for (uint32_t tileY = tileY0; tileY <= tileY1; tileY++) {
+		const uint32_t firstRow = tileY == tileY0 ? y0 % TILE_HEIGHT : 0;
+		const uint32_t lastRow = tileY == tileY1 ? (y1 - 1) % TILE_HEIGHT : TILE_HEIGHT - 1;
+
+		for (uint32_t tileX = tileX0; tileX <= tileX1; tileX++) {
+			const uint32_t firstColumn = tileX == tileX0 ? x0 % TILE_WIDTH : 0;
+			const uint32_t lastColumn = tileX == tileX1 ? (x1 - 1) % TILE_WIDTH : TILE_WIDTH - 1;
+			const uint32_t columnMask = s_rowMasks.left[firstColumn] & s_rowMasks.right[lastColumn + 1];
+
+			if (isTileRectVisible(tileY * m_tilesX + tileX, columnMask, firstRow, lastRow, depth)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+const bool OcclusionRasterizer::isTileRectVisible(uint32_t tile, uint32_t columnMask, uint32_t firstRow, uint32_t lastRow, float depth) const
+{
+	//Most tiles settle it on their depths alone
+	const TileDepth& tileDepth = m_depths[tile];
+	const bool beforeWorking = depth <= tileDepth.workingDepth;
+	const bool beforeReference = depth <= tileDepth.referenceDepth;
+	if (beforeWorking == beforeReference) {
+		return beforeReference;
+	}
+
+	//In front of one layer only -- visible if the rect has a pixel in it
+	const uint32_t* pMask = &m_masks[static_cast<size_t>(tile) * TILE_HEIGHT];
+	const uint32_t invert = beforeWorking ? 0 : FULL_ROW;
+	uint32_t hit = 0;
+	for (uint32_t row = firstRow; row <= lastRow; row++) {
+		hit |= (pMask[row] ^ invert) & columnMask;
+	}
+	return hit != 0;
+}
+
+const float OcclusionRasterizer::getPixelDepth(uint32_t x, uint32_t y) const
+{
+	const uint32_t tile = (y / TILE_HEIGHT) * m_tilesX + x / TILE_WIDTH;
+	const bool working = (m_masks[static_cast<size_t>(tile) * TILE_HEIGHT + y % TILE_HEIGHT] >> (x % TILE_WIDTH)) & 1;
+	return working ? m_depths[tile].workingDepth : m_depths[tile].referenceDepth;
+}
+#pragma endregion
@@ -0,0 +1,142 @@
+#pragma once
+#ifndef _OCCLUSION_RASTERIZER_
+#define _OCCLUSION_RASTERIZER_
+
+#include <vector>
+#include <cstdint>
+#include "../Libraries/glm/glm.hpp"
+
+class JobSystem;
+
+//Instruction sets the tile loops are built for -- only what the build targets is compiled in
+enum class OcclusionSimd : uint32_t {
+	Scalar = 0,
+	Sse,			//SSE2, 4 rows of a tile at a time
+	Avx2			//8 rows at a time, builds targeting AVX2 (/arch:AVX2) only
+};
+
+/////////////////////////////////////////////////////
+//---OcclusionRasterizer:
+//---Software occlusion culling, all on the CPU so there's
+//---no readback to wait for. A few big occluders are
+//---rasterized into a low resolution depth buffer of 32x8
+//---pixel tiles, each a coverage bit per pixel & two depths:
+//---covered pixels are at most the working depth, the rest
+//---at most the tile's reference depth. Triangles merge into
+//---the working layer until it covers the whole tile, which
+//---then becomes the reference. Depths only ever bound the
+//---occluders from behind & boxes are tested against every
+//---pixel they touch, but occluders cover a pixel when they
+//---cover its centre -- at this resolution an occluder thinner
+//---than a pixel, or a gap between two narrower than one, can
+//---still hide a box that shows through. Good enough to cull
+//---with, not a guarantee; inner coverage would be, at the
+//---price of a crack along every edge triangles share.
+//---Triangles are set up a mesh per job & rasterized a band
+//---of tile rows per job, in submission order -- the result
+//---is the same whatever the worker count.
+//---Depth is clip z / w, smaller is nearer
+/////////////////////////////////////////////////////
+
+class OcclusionRasterizer {
+public:
+	OcclusionRasterizer() {};
+	~OcclusionRasterizer() {};
+	OcclusionRasterizer(OcclusionRasterizer&) = delete;
+	OcclusionRasterizer& operator=(const OcclusionRasterizer&) = delete;
+
+	//Resolution of the buffer, which covers the whole viewport whatever its size -- the tiles round it up
+	void create(uint32_t width, uint32_t height);
+
+	//Everything back to the far plane & the occluder list emptied, for the next frame
+	void clear();
+
+	//Indexed triangle list, both windings, clip space through modelViewProj. Only referenced --
+	//positions & indices have to stay put until rasterize() returns
+	void addOccluder(const glm::vec3* pPositions, const uint32_t* pIndices, uint32_t indexCount, const glm::mat4& modelViewProj);
+
+	//Occluders added since clear() into the buffer, on the job system when there is one
+	void rasterize(JobSystem* pJobSystem = nullptr);
+
+	//After rasterize() -- false only if the box is hidden behind the occluders everywhere it lands.
+	//Boxes crossing the near plane are always visible
+	const bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& modelViewProj) const;
+	//Pixels [x0, x1) x [y0, y1) with nothing nearer than depth
+	const bool isRectVisible(int32_t x0, int32_t y0, int32_t x1, int32_t y1, float depth) const;
+
+	//Farthest an occluder can be at this pixel -- 1 is the far plane
+	const float getPixelDepth(uint32_t x, uint32_t y) const;
+
+	const uint32_t getWidth() const { return m_width; };
+	const uint32_t getHeight() const { return m_height; };
+	//Triangles the last rasterize() set up, after clipping
+	const uint32_t getTriangleCount() const { return m_triangleCount; };
+
+	//Defaults to getBestSimd(), clamped to it
+	void setSimd(OcclusionSimd simd);
+	const OcclusionSimd getSimd() const { return m_simd; };
+	static OcclusionSimd getBestSimd();
+	static const char* getSimdName(OcclusionSimd);
+
+	static const uint32_t		s_tileWidth = 32;
+	static const uint32_t		s_tileHeight = 8;
+
+private:
+	//Screen space, ready for the tile loops. Edges are a * x + b * y + c, > 0 inside
+	struct Triangle {
+		//Where each edge crosses a row, x = crossX + crossSlope * y, & which side of it is inside:
+		//1 right, -1 left, 0 for horizontal edges -- those are inside where b * y + c > 0
+		float					crossX[3];
+		float					crossSlope[3];
+		float					edgeB[3];
+		float					edgeC[3];
+		int32_t					edgeSide[3];
+		float					depthA, depthB, depthC;		//depth plane, a * x + b * y + c
+		float					maxDepth;
+		float					minX, minY, maxX, maxY;
+		int32_t					tileX0, tileY0, tileX1, tileY1;	//tiles touched, inclusive
+	};
+
+	struct Occluder {
+		const glm::vec3*		pPositions;
+		const uint32_t*			pIndices;
+		uint32_t				indexCount;
+		glm::mat4				modelViewProj;
+		std::vector<Triangle>	triangles;		//kept between frames to reuse the memory
+	};
+
+	//Coverage of one tile & what bounds its depth
+	struct TileDepth {
+		float					workingDepth;		//pixels in the mask
+		float					referenceDepth;		//everything else
+	};
+
+	void setupOccluder(Occluder&) const;
+	void addTriangle(const glm::vec4 clip[3], std::vector<Triangle>&) const;
+	void rasterizeBand(uint32_t firstTileRow, uint32_t tileRowCount);
+	void rasterizeTile(const Triangle&, int32_t tileX, int32_t tileY);
+	void computeRowMasks(const Triangle&, float tileX, float tileY, uint32_t masks[s_tileHeight]) const;
+	void mergeTile(uint32_t tile, const uint32_t coverage[s_tileHeight], float depth);
+	const bool isTileRectVisible(uint32_t tile, uint32_t columnMask, uint32_t firstRow, uint32_t lastRow, float depth) const;
+
+	uint32_t					m_width = 0;
+	uint32_t					m_height = 0;
+	uint32_t					m_tilesX = 0;
+	uint32_t					m_tilesY = 0;
+	OcclusionSimd				m_simd = getBestSimd();
+
+	std::vector<uint32_t>		m_masks;			//a row per uint32 -- s_tileHeight per tile, bit x is column x
+	std::vector<TileDepth>		m_depths;
+	std::vector<Occluder>		m_occluders;
+	uint32_t					m_occluderCount = 0;
+	uint32_t					m_triangleCount = 0;
+
+	//Bands of tile rows, a job each
+	static const uint32_t		s_bandTileRows = 4;
+	//Past the viewport, in viewports, before x & y get clipped -- keeps edge setup precise
+	static const float			s_guardBand;
+	//Clip w below this is behind the near plane as far as clipping goes
+	static const float			s_nearClipW;
+};
+
+#endif // !_OCCLUSION_RASTERIZER_
@@ -0,0 +1,554 @@
+#include "PipelineCache.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
+
+#pragma region KEYS
+namespace {
+	//FNV-1a, 64 bit
+	const uint64_t s_fnvOffset = 14695981039346656037ull;
+	const uint64_t s_fnvPrime = 1099511628211ull;
+
+	void appendBytes(std::string& key, const void* pData, size_t size)
+	{
+		if (size > 0) {
+			key.append(static_cast<const char*>(pData), size);
+		}
+	}
+
+	//Scalars, enums & handles only -- structs go in a field at a time, so padding never ends up in the key
+	template<typename T>
+	void appendValue(std::string& key, const T& value)
+	{
+		static_assert(std::is_scalar<T>::value, "append structs with appendFields");
+		appendBytes(key, &value, sizeof(T));
+	}
+
+	//Arrays go in with their count, so neighbouring arrays can't run into each other
+	template<typename T>
+	void appendArray(std::string& key, const T* pData, uint32_t count)
+	{
+		static_assert(std::is_scalar<T>::value, "append arrays of structs with appendStructs");
+		appendValue(key, pData != nullptr ? count : 0u);
+		if (pData) {
+			appendBytes(key, pData, count * sizeof(T));
+		}
+	}
+
+	void appendFields(std::string& key, const VkSpecializationMapEntry& entry)
+	{
+		appendValue(key, entry.constantID);
+		appendValue(key, entry.offset);
+		appendValue(key, entry.size);
+	}
+
+	void appendFields(std::string& key, const VkVertexInputBindingDescription& binding)
+	{
+		appendValue(key, binding.binding);
+		appendValue(key, binding.stride);
+		appendValue(key, binding.inputRate);
+	}
+
+	void appendFields(std::string& key, const VkVertexInputAttributeDescription& attribute)
+	{
+		appendValue(key, attribute.location);
+		appendValue(key, attribute.binding);
+		appendValue(key, attribute.format);
+		appendValue(key, attribute.offset);
+	}
+
+	void appendFields(std::string& key, const VkViewport& viewport)
+	{
+		appendValue(key, viewport.x);
+		appendValue(key, viewport.y);
+		appendValue(key, viewport.width);
+		appendValue(key, viewport.height);
+		appendValue(key, viewport.minDepth);
+		appendValue(key, viewport.maxDepth);
+	}
+
+	void appendFields(std::string& key, const VkRect2D& rect)
+	{
+		appendValue(key, rect.offset.x);
+		appendValue(key, rect.offset.y);
+		appendValue(key, rect.extent.width);
+		appendValue(key, rect.extent.height);
+	}
+
+	void appendFields(std::string& key, const VkPipelineColorBlendAttachmentState& attachment)
+	{
+		appendValue(key, attachment.blendEnable);
+		appendValue(key, attachment.srcColorBlendFactor);
+		appendValue(key, attachment.dstColorBlendFactor);
+		appendValue(key, attachment.colorBlendOp);
+		appendValue(key, attachment.srcAlphaBlendFactor);
+		appendValue(key, attachment.dstAlphaBlendFactor);
+		appendValue(key, attachment.alphaBlendOp);
+		appendValue(key, attachment.colorWriteMask);
+	}
+
+	void appendFields(std::string& key, const VkStencilOpState& stencil)
+	{
+		appendValue(key, stencil.failOp);
+		appendValue(key, stencil.passOp);
+		appendValue(key, stencil.depthFailOp);
+		appendValue(key, stencil.compareOp);
+		appendValue(key, stencil.compareMask);
+		appendValue(key, stencil.writeMask);
+		appendValue(key, stencil.reference);
+	}
+
+	//State structs -- sType & pNext stay out, no extension structs are chained on
+	void appendFields(std::string& key, const VkPipelineInputAssemblyStateCreateInfo& state)
+	{
+		appendValue(key, state.flags);
+		appendValue(key, state.topology);
+		appendValue(key, state.primitiveRestartEnable);
+	}
+
+	void appendFields(std::string& key, const VkPipelineTessellationStateCreateInfo& state)
+	{
+		appendValue(key, state.flags);
+		appendValue(key, state.patchControlPoints);
+	}
+
+	void appendFields(std::string& key, const VkPipelineRasterizationStateCreateInfo& state)
+	{
+		appendValue(key, state.flags);
+		appendValue(key, state.depthClampEnable);
+		appendValue(key, state.rasterizerDiscardEnable);
+		appendValue(key, state.polygonMode);
+		appendValue(key, state.cullMode);
+		appendValue(key, state.frontFace);
+		appendValue(key, state.depthBiasEnable);
+		appendValue(key, state.depthBiasConstantFactor);
+		appendValue(key, state.depthBiasClamp);
+		appendValue(key, state.depthBiasSlopeFactor);
+		appendValue(key, state.lineWidth);
+	}
+
+	void appendFields(std::string& key, const VkPipelineDepthStencilStateCreateInfo& state)
+	{
+		appendValue(key, state.flags);
+		appendValue(key, state.depthTestEnable);
+		appendValue(key, state.depthWriteEnable);
+		appendValue(key, state.depthCompareOp);
+		appendValue(key, state.depthBoundsTestEnable);
+		appendValue(key, state.stencilTestEnable);
+		appendFields(key, state.front);
+		appendFields(key, state.back);
+		appendValue(key, state.minDepthBounds);
+		appendValue(key, state.maxDepthBounds);
+	}
+
+	//Pointed to structs go in by value, with their count
+	template<typename T>
+	void appendStructs(std::string& key, const T* pData, uint32_t count)
+	{
+		appendValue(key, pData != nullptr ? count : 0u);
+		for (uint32_t i = 0; pData && i < count; i++) {
+			appendFields(key, pData[i]);
+		}
+	}
+
+	void appendStage(std::string& key, const VkPipelineShaderStageCreateInfo& stage)
+	{
+		//Modules are owned by the cache & live until cleanup, so their handles are stable
+		appendValue(key, stage.flags);
+		appendValue(key, stage.stage);
+		appendValue(key, stage.module);
+		appendArray(key, stage.pName, static_cast<uint32_t>(strlen(stage.pName)));
+
+		appendValue(key, stage.pSpecializationInfo != nullptr);
+		if (stage.pSpecializationInfo) {
+			const VkSpecializationInfo& spec = *stage.pSpecializationInfo;
+			appendStructs(key, spec.pMapEntries, spec.mapEntryCount);
+			appendArray(key, static_cast<const uint8_t*>(spec.pData), static_cast<uint32_t>(spec.dataSize));
+		}
+	}
+
+	template<typename T>
+	void appendState(std::string& key, const T* pState)
+	{
+		appendValue(key, pState != nullptr);
+		if (pState) {
+			appendFields(key, *pState);
+		}
+	}
+
+	//Only which attachment a reference points at matters for compatibility, not its layout
+	void appendReferences(std::string& key, const VkAttachmentReference* pReferences, uint32_t count)
+	{
+		appendValue(key, pReferences != nullptr ? count : 0u);
+		for (uint32_t i = 0; pReferences && i < count; i++) {
+			appendValue(key, pReferences[i].attachment);
+		}
+	}
+}
+
+size_t PipelineCache::KeyHash::operator()(const std::string& key) const
+{
+	uint64_t h = s_fnvOffset;
+	for (char c : key) {
+		h ^= static_cast<uint8_t>(c);
+		h *= s_fnvPrime;
+	}
+	return static_cast<size_t>(h);
+}
+
+void PipelineCache::serializeRenderPass(const VkRenderPassCreateInfo& info, std::string& key)
+{
+	//Render pass compatibility: same attachment formats & sample counts, used the same way by each
+	//subpass. Load/store ops, layouts & dependencies can differ
+	appendValue(key, info.attachmentCount);
+	for (uint32_t i = 0; i < info.attachmentCount; i++) {
+		appendValue(key, info.pAttachments[i].format);
+		appendValue(key, info.pAttachments[i].samples);
+	}
+
+	appendValue(key, info.subpassCount);
+	for (uint32_t i = 0; i < info.subpassCount; i++) {
+		const VkSubpassDescription& subpass = info.pSubpasses[i];
+		appendValue(key, subpass.pipelineBindPoint);
+		appendReferences(key, subpass.pInputAttachments, subpass.inputAttachmentCount);
+		appendReferences(key, subpass.pColorAttachments, subpass.colorAttachmentCount);
+		appendReferences(key, subpass.pResolveAttachments, subpass.colorAttachmentCount);
+		appendReferences(key, subpass.pDepthStencilAttachment, 1);
+	}
+}
+
+void PipelineCache::serializeCreateInfo(const VkGraphicsPipelineCreateInfo& info, std::string& key, std::string& renderPassKey) const
+{
+	auto renderPass = m_renderPasses.find(info.renderPass);
+	if (renderPass == m_renderPasses.end()) {
+		throw std::runtime_error("pipeline cache: render pass wasn't registered!");
+	}
+	renderPassKey = renderPass->second;
+
+	appendValue(key, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
+	appendValue(key, info.flags);
+
+	//Shader stages
+	appendValue(key, info.stageCount);
+	for (uint32_t i = 0; i < info.stageCount; i++) {
+		appendStage(key, info.pStages[i]);
+	}
+
+	//Vertex input
+	appendValue(key, info.pVertexInputState != nullptr);
+	if (const VkPipelineVertexInputStateCreateInfo* pInput = info.pVertexInputState) {
+		appendValue(key, pInput->flags);
+		appendStructs(key, pInput->pVertexBindingDescriptions, pInput->vertexBindingDescriptionCount);
+		appendStructs(key, pInput->pVertexAttributeDescriptions, pInput->vertexAttributeDescriptionCount);
+	}
+
+	appendState(key, info.pInputAssemblyState);
+	appendState(key, info.pTessellationState);
+
+	//Viewports & scissors are only baked in when they aren't dynamic
+	appendValue(key, info.pViewportState != nullptr);
+	if (const VkPipelineViewportStateCreateInfo* pViewport = info.pViewportState) {
+		appendValue(key, pViewport->flags);
+		appendStructs(key, pViewport->pViewports, pViewport->viewportCount);
+		appendStructs(key, pViewport->pScissors, pViewport->scissorCount);
+		appendValue(key, pViewport->viewportCount);
+		appendValue(key, pViewport->scissorCount);
+	}
+
+	appendState(key, info.pRasterizationState);
+
+	appendValue(key, info.pMultisampleState != nullptr);
+	if (const VkPipelineMultisampleStateCreateInfo* pMultisample = info.pMultisampleState) {
+		appendValue(key, pMultisample->flags);
+		appendValue(key, pMultisample->rasterizationSamples);
+		appendValue(key, pMultisample->sampleShadingEnable);
+		appendValue(key, pMultisample->minSampleShading);
+		appendValue(key, pMultisample->alphaToCoverageEnable);
+		appendValue(key, pMultisample->alphaToOneEnable);
+		appendArray(key, pMultisample->pSampleMask, (pMultisample->rasterizationSamples + 31) / 32);
+	}
+
+	appendState(key, info.pDepthStencilState);
+
+	appendValue(key, info.pColorBlendState != nullptr);
+	if (const VkPipelineColorBlendStateCreateInfo* pBlend = info.pColorBlendState) {
+		appendValue(key, pBlend->flags);
+		appendValue(key, pBlend->logicOpEnable);
+		appendValue(key, pBlend->logicOp);
+		appendStructs(key, pBlend->pAttachments, pBlend->attachmentCount);
+		appendArray(key, pBlend->blendConstants, 4);
+	}
+
+	appendValue(key, info.pDynamicState != nullptr);
+	if (const VkPipelineDynamicStateCreateInfo* pDynamic = info.pDynamicState) {
+		appendValue(key, pDynamic->flags);
+		appendArray(key, pDynamic->pDynamicStates, pDynamic->dynamicStateCount);
+	}
+
+	//Layouts are released before they're destroyed, so a live handle is only ever one layout
+	appendValue(key, info.layout);
+	appendArray(key, renderPassKey.data(), static_cast<uint32_t>(renderPassKey.size()));
+	appendValue(key, info.subpass);
+}
+
+void PipelineCache::serializeCreateInfo(const VkComputePipelineCreateInfo& info, std::string& key)
+{
+	appendValue(key, VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO);
+	appendValue(key, info.flags);
+	appendStage(key, info.stage);
+	appendValue(key, info.layout);
+}
+#pragma endregion
+
+#pragma region CREATE & CLEANUP
+void PipelineCache::create(csmntVkApplication* pApp, const std::string& path)
+{
+	m_path = path;
+
+	//Seed from disk if the blob was written by this driver & device
+	std::vector<char> initialData = loadCacheData(pApp->getVkPhysicalDevice());
+	m_loadedFromDisk = !initialData.empty();
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialData.size();
+	cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	if (vkCreatePipelineCache(pApp->getVkDevice(), &cacheInfo, nullptr, &m_vkPipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+
+#if _DEBUG
+	std::cout << "HEY! pipeline cache " << (m_loadedFromDisk ? "seeded from " : "started empty, will save to ") << m_path
+		<< " (" << initialData.size() << " bytes)" << std::endl;
+#endif
+}
+
+void PipelineCache::cleanup(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	if (m_vkPipelineCache != VK_NULL_HANDLE) {
+		saveCacheData(device);
+	}
+
+	for (auto& pipeline : m_pipelines) {
+		vkDestroyPipeline(device, pipeline.second.pipeline, nullptr);
+	}
+	m_pipelines.clear();
+	m_renderPasses.clear();
+
+	for (auto& shaderModule : m_shaderModules) {
+		vkDestroyShaderModule(device, shaderModule.second, nullptr);
+	}
+	m_shaderModules.clear();
+
+	vkDestroyPipelineCache(device, m_vkPipelineCache, nullptr);
+	m_vkPipelineCache = VK_NULL_HANDLE;
+}
+#pragma endregion
+
+#pragma region LOOKUPS
+VkShaderModule PipelineCache::getShaderModule(VkDevice& device, const std::string& path)
+{
+	auto it = m_shaderModules.find(path);
+	if (it != m_shaderModules.end()) {
+		return it->second;
+	}
+
+	auto code = vkHelpers::readFile(path);
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	m_shaderModules[path] = shaderModule;
+	return shaderModule;
+}
+
+VkPipeline PipelineCache::getGraphicsPipeline(VkDevice& device, const VkGraphicsPipelineCreateInfo& pipelineInfo)
+{
+	std::string key, renderPassKey;
+	serializeCreateInfo(pipelineInfo, key, renderPassKey);
+
+	auto it = m_pipelines.find(key);
+	if (it != m_pipelines.end()) {
+		++m_hits;
+		return it->second.pipeline;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, m_vkPipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+
+	m_buildMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	++m_misses;
+
+	m_pipelines[key] = { pipeline, pipelineInfo.layout, renderPassKey };
+	return pipeline;
+}
+
+VkPipeline PipelineCache::getComputePipeline(VkDevice& device, const VkComputePipelineCreateInfo& pipelineInfo)
+{
+	std::string key;
+	serializeCreateInfo(pipelineInfo, key);
+
+	auto it = m_pipelines.find(key);
+	if (it != m_pipelines.end()) {
+		++m_hits;
+		return it->second.pipeline;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, m_vkPipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+
+	m_buildMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	++m_misses;
+
+	m_pipelines[key] = { pipeline, pipelineInfo.layout, std::string() };
+	return pipeline;
+}
+#pragma endregion
+
+#pragma region EVICTION
+void PipelineCache::registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& info)
+{
+	std::string key;
+	serializeRenderPass(info, key);
+	m_renderPasses[renderPass] = key;
+}
+
+void PipelineCache::unregisterRenderPass(VkRenderPass renderPass)
+{
+	//Pipelines built against it stay -- they work with any compatible render pass, like the next one
+	m_renderPasses.erase(renderPass);
+}
+
+void PipelineCache::releasePipelineLayout(VkDevice& device, VkPipelineLayout layout)
+{
+	for (auto it = m_pipelines.begin(); it != m_pipelines.end(); ) {
+		if (it->second.layout == layout) {
+			vkDestroyPipeline(device, it->second.pipeline, nullptr);
+			it = m_pipelines.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void PipelineCache::evictStalePipelines(VkDevice& device)
+{
+	for (auto it = m_pipelines.begin(); it != m_pipelines.end(); ) {
+		bool stale = !it->second.renderPassKey.empty();
+		for (auto& renderPass : m_renderPasses) {
+			stale = stale && renderPass.second != it->second.renderPassKey;
+		}
+
+		if (stale) {
+			vkDestroyPipeline(device, it->second.pipeline, nullptr);
+			it = m_pipelines.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+#pragma endregion
+
+#pragma region DISK
+std::vector<char> PipelineCache::loadCacheData(VkPhysicalDevice& physicalDevice)
+{
+	std::vector<char> data;
+
+	std::ifstream file(m_path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return data;
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	data.resize(fileSize);
+
+	file.seekg(0);
+	file.read(data.data(), fileSize);
+	file.close();
+
+	//Header layout (VK_PIPELINE_CACHE_HEADER_VERSION_ONE):
+	//u32 headerSize, u32 headerVersion, u32 vendorID, u32 deviceID, u8 pipelineCacheUUID[VK_UUID_SIZE]
+	const size_t headerSize = 16 + VK_UUID_SIZE;
+	if (fileSize < headerSize) {
+		data.clear();
+		return data;
+	}
+
+	uint32_t header[4];
+	memcpy(header, data.data(), sizeof(header));
+	const uint8_t* pUUID = reinterpret_cast<const uint8_t*>(data.data()) + 16;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	//Another driver/GPU's blob is useless at best -- start empty instead
+	if (header[0] < headerSize || header[0] > fileSize ||
+		header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		header[2] != properties.vendorID ||
+		header[3] != properties.deviceID ||
+		memcmp(pUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+#if _DEBUG
+		std::cout << "HEY! ignoring stale pipeline cache " << m_path << std::endl;
+#endif
+		data.clear();
+	}
+
+	return data;
+}
+
+void PipelineCache::saveCacheData(VkDevice& device)
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, m_vkPipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, m_vkPipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	//Write to the side & swap in, so a crash mid-write can't leave a torn cache
+	std::string tempPath = m_path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(data.data(), dataSize);
+	}
+
+	std::remove(m_path.c_str());
+	std::rename(tempPath.c_str(), m_path.c_str());
+
+#if _DEBUG
+	std::cout << "HEY! saved pipeline cache " << m_path << " (" << dataSize << " bytes)" << std::endl;
+#endif
+}
+#pragma endregion
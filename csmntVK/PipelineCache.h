@@ -0,0 +1,87 @@
+#pragma once
+#ifndef _PIPELINE_CACHE_
+#define _PIPELINE_CACHE_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---PipelineCache:
+//---VkPipelineCache seeded from / saved back to disk, plus
+//---an in-memory map of built pipelines keyed by their whole
+//---create info, serialized, so identical pipelines are only
+//---built once. Render passes go into the key as what makes
+//---them compatible rather than as handles, & pipelines go
+//---when their layout does -- a recycled handle can't match.
+//---Owns the pipelines & shader modules it hands out
+/////////////////////////////////////////////////////
+
+class PipelineCache {
+public:
+	PipelineCache() {};
+	~PipelineCache() {};
+
+	void create(csmntVkApplication*, const std::string& path);
+	//Writes the cache back to disk & destroys everything it handed out
+	void cleanup(csmntVkApplication*);
+
+	//Loaded once per path -- stable handles keep pipeline keys stable
+	VkShaderModule getShaderModule(VkDevice&, const std::string& path);
+
+	VkPipeline getGraphicsPipeline(VkDevice&, const VkGraphicsPipelineCreateInfo&);
+	VkPipeline getComputePipeline(VkDevice&, const VkComputePipelineCreateInfo&);
+
+	//Every render pass a graphics pipeline is built against has to be registered first
+	void registerRenderPass(VkRenderPass, const VkRenderPassCreateInfo&);
+	void unregisterRenderPass(VkRenderPass);
+	//Destroys the pipelines built with the layout -- call before destroying it
+	void releasePipelineLayout(VkDevice&, VkPipelineLayout);
+	//Destroys graphics pipelines no registered render pass is compatible with any more (after a
+	//format change). Nothing in flight may still be using them
+	void evictStalePipelines(VkDevice&);
+
+	const VkPipelineCache& getVkPipelineCache() const { return m_vkPipelineCache; };
+
+	//Stats
+	const bool loadedFromDisk() const { return m_loadedFromDisk; };
+	const uint32_t getHitCount() const { return m_hits; };
+	const uint32_t getMissCount() const { return m_misses; };
+	const double getBuildMs() const { return m_buildMs; };
+
+private:
+	std::vector<char> loadCacheData(VkPhysicalDevice&);
+	void saveCacheData(VkDevice&);
+
+	struct CachedPipeline {
+		VkPipeline			pipeline;
+		VkPipelineLayout	layout;
+		std::string			renderPassKey;		//empty for compute
+	};
+
+	//FNV-1a over the serialized key -- the map still compares the whole key on a match
+	struct KeyHash {
+		size_t operator()(const std::string& key) const;
+	};
+
+	void serializeCreateInfo(const VkGraphicsPipelineCreateInfo&, std::string& key, std::string& renderPassKey) const;
+	static void serializeCreateInfo(const VkComputePipelineCreateInfo&, std::string& key);
+	static void serializeRenderPass(const VkRenderPassCreateInfo&, std::string& key);
+
+	VkPipelineCache			m_vkPipelineCache = VK_NULL_HANDLE;
+	std::string				m_path;
+
+	std::unordered_map<std::string, CachedPipeline, KeyHash>	m_pipelines;
+	std::unordered_map<VkRenderPass, std::string>				m_renderPasses;		//compatibility keys
+	std::unordered_map<std::string, VkShaderModule>				m_shaderModules;
+
+	bool					m_loadedFromDisk = false;
+	uint32_t				m_hits = 0;
+	uint32_t				m_misses = 0;
+	double					m_buildMs = 0.0;
+};
+
+#endif // !_PIPELINE_CACHE_
@@ -0,0 +1,867 @@
+#include "RenderGraph.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+#pragma region BUILDING
+RenderGraph::Resource RenderGraph::importImage(const std::string& name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags readyStage)
+{
+	ResourceNode resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.format = format;
+	resource.extent = extent;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	resource.readyStage = readyStage;
+	m_resources.push_back(resource);
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string& name, VkFormat format, VkExtent2D extent)
+{
+	ResourceNode resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.format = format;
+	resource.extent = extent;
+	m_resources.push_back(resource);
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string& name, VkPipelineStageFlags finalStage, VkAccessFlags finalAccess)
+{
+	ResourceNode resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.finalStage = finalStage;
+	resource.finalAccess = finalAccess;
+	m_resources.push_back(resource);
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::addPass(const std::string& name, PassType type, RecordFunction record)
+{
+	PassNode pass;
+	pass.name = name;
+	pass.type = type;
+	pass.record = record;
+	m_passes.push_back(pass);
+	return static_cast<Pass>(m_passes.size() - 1);
+}
+
+void RenderGraph::read(Pass pass, Resource resource, Usage usage)
+{
+	Use use = {};
+	use.resource = resource;
+	getUsageAccess(usage, m_passes[pass].type, false, use.stage, use.access, use.layout);
+	addUse(pass, use);
+}
+
+void RenderGraph::write(Pass pass, Resource resource, Usage usage)
+{
+	if (usage == Usage::Sampled || usage == Usage::Indirect) {
+		throw std::runtime_error("render graph: sampled & indirect uses are read only!");
+	}
+
+	Use use = {};
+	use.resource = resource;
+	use.write = true;
+	getUsageAccess(usage, m_passes[pass].type, true, use.stage, use.access, use.layout);
+	addUse(pass, use);
+}
+
+void RenderGraph::addColorAttachment(Pass pass, Resource resource, const VkClearValue* pClearValue)
+{
+	PassNode& node = m_passes[pass];
+	if (node.type != PassType::Graphics || node.hasDepth) {
+		throw std::runtime_error("render graph: colour attachments go on graphics passes, before the depth attachment!");
+	}
+
+	Attachment attachment = {};
+	attachment.resource = resource;
+	attachment.clear = pClearValue != nullptr;
+	if (pClearValue) {
+		attachment.clearValue = *pClearValue;
+	}
+	node.attachments.push_back(attachment);
+	node.colorCount++;
+
+	Use use = {};
+	use.resource = resource;
+	use.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	use.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	use.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	use.write = true;
+	use.attachment = true;
+	addUse(pass, use);
+}
+
+void RenderGraph::setDepthAttachment(Pass pass, Resource resource, const VkClearValue* pClearValue)
+{
+	PassNode& node = m_passes[pass];
+	if (node.type != PassType::Graphics || node.hasDepth) {
+		throw std::runtime_error("render graph: one depth attachment per graphics pass!");
+	}
+
+	Attachment attachment = {};
+	attachment.resource = resource;
+	attachment.clear = pClearValue != nullptr;
+	if (pClearValue) {
+		attachment.clearValue = *pClearValue;
+	}
+	node.attachments.push_back(attachment);
+	node.hasDepth = true;
+
+	Use use = {};
+	use.resource = resource;
+	use.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	use.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	use.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	use.write = true;
+	use.attachment = true;
+	addUse(pass, use);
+}
+
+void RenderGraph::setSubpassContents(Pass pass, VkSubpassContents contents)
+{
+	m_passes[pass].contents = contents;
+}
+
+void RenderGraph::setSideEffects(Pass pass)
+{
+	m_passes[pass].sideEffects = true;
+}
+
+void RenderGraph::addUse(Pass pass, const Use& use)
+{
+	//One use per resource per pass, so a pass never needs a barrier against itself
+	for (Use& existing : m_passes[pass].uses) {
+		if (existing.resource != use.resource) {
+			continue;
+		}
+		if (m_resources[use.resource].isImage && existing.layout != use.layout) {
+			throw std::runtime_error("render graph: a pass can't use an image in two layouts!");
+		}
+		existing.stage |= use.stage;
+		existing.access |= use.access;
+		existing.write = existing.write || use.write;
+		existing.attachment = existing.attachment || use.attachment;
+		return;
+	}
+	m_passes[pass].uses.push_back(use);
+}
+
+void RenderGraph::getUsageAccess(Usage usage, PassType type, bool write, VkPipelineStageFlags& stage, VkAccessFlags& access, VkImageLayout& layout)
+{
+	const VkPipelineStageFlags shaderStage = type == PassType::Graphics ?
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	switch (usage) {
+	case Usage::Sampled:
+		stage = shaderStage;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		break;
+	case Usage::Storage:
+		stage = shaderStage;
+		access = write ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+		layout = VK_IMAGE_LAYOUT_GENERAL;
+		break;
+	case Usage::Indirect:
+		stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		break;
+	case Usage::Transfer:
+		stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = write ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+		layout = write ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		break;
+	}
+}
+#pragma endregion
+
+#pragma region COMPILE
+void RenderGraph::compile(csmntVkApplication* pApp)
+{
+	m_vkDevice = pApp->getVkDevice();
+	m_stats = RenderGraphStats();
+
+	cullPasses();
+	assignAttachmentOps();
+	createTransientImages(pApp);
+	buildBarriers();
+	createRenderPasses(pApp);
+
+#if _DEBUG
+	dumpStats(std::cout);
+#endif
+}
+
+void RenderGraph::cullPasses()
+{
+	//Backwards from whatever leaves the graph: a pass lives if it writes something a later
+	//live pass needs. A write replaces what was there unless it also reads it (a loaded attachment)
+	std::vector<bool> needed(m_resources.size(), false);
+	const VkAccessFlags readAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	for (size_t p = m_passes.size(); p-- > 0; ) {
+		PassNode& pass = m_passes[p];
+
+		bool alive = pass.sideEffects;
+		for (const Use& use : pass.uses) {
+			alive = alive || (use.write && (m_resources[use.resource].imported || needed[use.resource]));
+		}
+		pass.culled = !alive;
+		if (!alive) {
+			continue;
+		}
+
+		for (const Use& use : pass.uses) {
+			if (use.write) {
+				needed[use.resource] = false;
+			}
+		}
+		for (const Use& use : pass.uses) {
+			bool cleared = false;
+			for (const Attachment& attachment : pass.attachments) {
+				cleared = cleared || (attachment.resource == use.resource && attachment.clear);
+			}
+			const bool reads = use.attachment ? !cleared : (use.access & readAccess) != 0;
+			if (reads) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+	for (Pass p = 0; p < m_passes.size(); p++) {
+		if (m_passes[p].culled) {
+			m_stats.culledPassCount++;
+			continue;
+		}
+		for (const Use& use : m_passes[p].uses) {
+			m_resources[use.resource].passes.push_back(p);
+		}
+	}
+}
+
+void RenderGraph::assignAttachmentOps()
+{
+	for (Pass p = 0; p < m_passes.size(); p++) {
+		PassNode& pass = m_passes[p];
+		if (pass.culled || pass.type != PassType::Graphics) {
+			continue;
+		}
+		if (pass.attachments.empty()) {
+			throw std::runtime_error("render graph: graphics pass " + pass.name + " has no attachments!");
+		}
+
+		for (Attachment& attachment : pass.attachments) {
+			const ResourceNode& resource = m_resources[attachment.resource];
+			const size_t position = std::find(resource.passes.begin(), resource.passes.end(), p) - resource.passes.begin();
+
+			//Only pay for loads & stores somebody sees -- imported images are seen after the frame
+			const bool hasContents = position > 0 || (resource.imported && resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+			const bool readLater = position + 1 < resource.passes.size() || resource.imported;
+
+			attachment.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			attachment.storeOp = readLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		}
+
+		pass.extent = m_resources[pass.attachments[0].resource].extent;
+	}
+}
+
+void RenderGraph::createTransientImages(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+	vkHelpers::DeviceMemoryAllocator& allocator = pApp->getAllocator();
+
+	std::vector<Resource> transients;
+	std::vector<VkMemoryRequirements> requirements(m_resources.size());
+
+	for (Resource r = 0; r < m_resources.size(); r++) {
+		ResourceNode& resource = m_resources[r];
+		if (resource.imported || resource.passes.empty()) {
+			continue;
+		}
+
+		VkImageUsageFlags usage = 0;
+		bool attachmentOnly = true;
+		for (Pass p : resource.passes) {
+			const Use& use = findUse(p, r);
+			attachmentOnly = attachmentOnly && use.attachment;
+			if (use.attachment) {
+				usage |= isDepthFormat(resource.format) ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			}
+			else if (use.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+				usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+			}
+			else if (use.layout == VK_IMAGE_LAYOUT_GENERAL) {
+				usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			}
+			else if (use.layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+				usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			}
+			else if (use.layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+				usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			}
+		}
+
+		//Used by one render pass, neither loaded nor stored -- on a tiler it never has to leave tile memory
+		resource.lazy = attachmentOnly && resource.passes.size() == 1;
+		if (resource.lazy) {
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = resource.extent.width;
+		imageInfo.extent.height = resource.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render graph image " + resource.name + "!");
+		}
+		vkGetImageMemoryRequirements(device, resource.image, &requirements[r]);
+
+		//No lazily allocated type (desktop GPUs) -- it's an ordinary transient & may share memory after all
+		resource.lazy = resource.lazy && allocator.hasMemoryType(requirements[r].memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+		transients.push_back(r);
+		m_stats.transientImageCount++;
+		m_stats.transientBytes += requirements[r].size;
+	}
+
+	//Biggest first, each into the first slot whose residents it never overlaps
+	std::sort(transients.begin(), transients.end(), [&](Resource a, Resource b) { return requirements[a].size > requirements[b].size; });
+
+	for (Resource r : transients) {
+		ResourceNode& resource = m_resources[r];
+		const Pass first = resource.passes.front(), last = resource.passes.back();
+
+		uint32_t slot = static_cast<uint32_t>(m_memorySlots.size());
+		for (uint32_t s = 0; s < m_memorySlots.size() && !resource.lazy; s++) {
+			const MemorySlot& candidate = m_memorySlots[s];
+			if (candidate.lazy || (candidate.requirements.memoryTypeBits & requirements[r].memoryTypeBits) == 0) {
+				continue;
+			}
+
+			bool disjoint = true;
+			for (Resource other : candidate.resources) {
+				disjoint = disjoint && (m_resources[other].passes.back() < first || last < m_resources[other].passes.front());
+			}
+			if (disjoint) {
+				slot = s;
+				break;
+			}
+		}
+
+		if (slot == m_memorySlots.size()) {
+			MemorySlot newSlot;
+			newSlot.requirements = requirements[r];
+			newSlot.lazy = resource.lazy;
+			m_memorySlots.push_back(newSlot);
+		}
+		MemorySlot& memorySlot = m_memorySlots[slot];
+		memorySlot.requirements.size = std::max(memorySlot.requirements.size, requirements[r].size);
+		memorySlot.requirements.alignment = std::max(memorySlot.requirements.alignment, requirements[r].alignment);
+		memorySlot.requirements.memoryTypeBits &= requirements[r].memoryTypeBits;
+		memorySlot.resources.push_back(r);
+		resource.memorySlot = slot;
+	}
+
+	for (MemorySlot& memorySlot : m_memorySlots) {
+		std::sort(memorySlot.resources.begin(), memorySlot.resources.end(), [&](Resource a, Resource b) {
+			return m_resources[a].passes.front() < m_resources[b].passes.front();
+		});
+
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		if (memorySlot.lazy) {
+			properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			m_stats.lazyImageCount++;
+		}
+		else {
+			m_stats.allocatedBytes += memorySlot.requirements.size;
+		}
+		memorySlot.memory = allocator.allocate(memorySlot.requirements, properties, vkHelpers::AllocationType::ImageOptimal);
+
+		for (Resource r : memorySlot.resources) {
+			ResourceNode& resource = m_resources[r];
+			if (vkBindImageMemory(device, resource.image, memorySlot.memory.memory, memorySlot.memory.offset) != VK_SUCCESS) {
+				throw std::runtime_error("failed to bind render graph image " + resource.name + "!");
+			}
+			resource.view = vkHelpers::createVkImageView(device, resource.image, resource.format,
+				isDepthFormat(resource.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT);
+		}
+	}
+}
+
+bool RenderGraph::findDependency(const ResourceNode& resource, const ResourceState& state, const Use& use, VkPipelineStageFlags& srcStage, VkAccessFlags& srcAccess) const
+{
+	const bool layoutChange = resource.isImage && state.layout != use.layout;
+
+	//Writes & layout changes wait on everything since the last write, reads on the write alone
+	if (use.write || layoutChange) {
+		srcStage = state.writeStage | state.readStage;
+		srcAccess = state.writeAccess;
+		return layoutChange || srcStage != 0;
+	}
+
+	srcStage = state.writeStage;
+	srcAccess = state.writeAccess;
+	//An earlier barrier may already have made the write visible to this stage & access
+	return state.writeStage != 0 && ((use.stage & ~state.readStage) != 0 || (use.access & ~state.readAccess) != 0);
+}
+
+void RenderGraph::buildBarriers()
+{
+	std::vector<ResourceState> states(m_resources.size());
+
+	//Imported images are handed over ready at some stage. Transient ones start the frame after the
+	//last frame's user of their memory (or this frame's, when aliased) -- their contents never matter
+	for (Resource r = 0; r < m_resources.size(); r++) {
+		const ResourceNode& resource = m_resources[r];
+		if (resource.imported) {
+			states[r].layout = resource.initialLayout;
+			states[r].writeStage = resource.readyStage;
+			continue;
+		}
+		if (resource.passes.empty()) {
+			continue;
+		}
+
+		const std::vector<Resource>& residents = m_memorySlots[resource.memorySlot].resources;
+		const size_t position = std::find(residents.begin(), residents.end(), r) - residents.begin();
+		const Resource previous = residents[(position + residents.size() - 1) % residents.size()];
+		getFrameAccess(previous, states[r].writeStage, states[r].writeAccess);
+	}
+
+	for (Pass p = 0; p < m_passes.size(); p++) {
+		PassNode& pass = m_passes[p];
+		if (pass.culled) {
+			continue;
+		}
+
+		pass.barriers = BarrierBatch();
+		pass.incoming = {};
+		pass.incoming.srcSubpass = VK_SUBPASS_EXTERNAL;
+		pass.incoming.dstSubpass = 0;
+		pass.outgoing = {};
+		pass.outgoing.srcSubpass = 0;
+		pass.outgoing.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+		for (const Use& use : pass.uses) {
+			const ResourceNode& resource = m_resources[use.resource];
+			ResourceState& state = states[use.resource];
+
+			VkPipelineStageFlags srcStage = 0;
+			VkAccessFlags srcAccess = 0;
+			const bool synced = state.syncedPass == p;
+			if (!synced && findDependency(resource, state, use, srcStage, srcAccess)) {
+				if (use.attachment) {
+					//The render pass does the layout change itself, it just needs to wait
+					pass.incoming.srcStageMask |= srcStage;
+					pass.incoming.srcAccessMask |= srcAccess;
+					pass.incoming.dstStageMask |= use.stage;
+					pass.incoming.dstAccessMask |= use.access;
+				}
+				else {
+					pass.barriers.srcStage |= srcStage != 0 ? srcStage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					pass.barriers.dstStage |= use.stage;
+					if (resource.isImage) {
+						pass.barriers.imageBarriers.push_back({ use.resource, state.layout, use.layout, srcAccess, use.access });
+					}
+					else {
+						pass.barriers.bufferBarriers.push_back({ use.resource, srcAccess, use.access });
+					}
+				}
+			}
+
+			for (Attachment& attachment : pass.attachments) {
+				if (attachment.resource == use.resource) {
+					attachment.initialLayout = attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+			}
+
+			if (use.write || (resource.isImage && state.layout != use.layout)) {
+				state.writeStage = use.stage;
+				state.writeAccess = use.write ? use.access : 0;
+				state.readStage = use.write ? 0 : use.stage;
+				state.readAccess = use.write ? 0 : use.access;
+				state.layout = use.layout;
+			}
+			else {
+				state.readStage |= use.stage;
+				state.readAccess |= use.access;
+			}
+			state.syncedPass = s_noPass;
+		}
+
+		//Leave each attachment in whatever layout its next user wants. When that's outside a render pass
+		//the outgoing dependency covers it, so that pass needs no barrier of its own for it
+		for (Attachment& attachment : pass.attachments) {
+			const ResourceNode& resource = m_resources[attachment.resource];
+			ResourceState& state = states[attachment.resource];
+			const Use& use = findUse(p, attachment.resource);
+
+			const size_t position = std::find(resource.passes.begin(), resource.passes.end(), p) - resource.passes.begin();
+			attachment.finalLayout = use.layout;
+
+			if (position + 1 == resource.passes.size()) {
+				if (resource.imported && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+					attachment.finalLayout = resource.finalLayout;
+				}
+			}
+			else {
+				const Pass next = resource.passes[position + 1];
+				const Use& nextUse = findUse(next, attachment.resource);
+				if (!nextUse.attachment) {
+					attachment.finalLayout = nextUse.layout;
+					pass.outgoing.srcStageMask |= use.stage;
+					pass.outgoing.srcAccessMask |= use.access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+					pass.outgoing.dstStageMask |= nextUse.stage;
+					pass.outgoing.dstAccessMask |= nextUse.access;
+					state.syncedPass = next;
+				}
+			}
+			state.layout = attachment.finalLayout;
+		}
+
+		if (!pass.barriers.empty()) {
+			m_stats.barrierBatchCount++;
+			m_stats.imageBarrierCount += static_cast<uint32_t>(pass.barriers.imageBarriers.size());
+			m_stats.bufferBarrierCount += static_cast<uint32_t>(pass.barriers.bufferBarriers.size());
+		}
+	}
+
+	//Imported resources into the layout / access they're expected in after the frame
+	m_finalBarriers = BarrierBatch();
+	for (Resource r = 0; r < m_resources.size(); r++) {
+		const ResourceNode& resource = m_resources[r];
+		const ResourceState& state = states[r];
+		if (!resource.imported || resource.passes.empty()) {
+			continue;
+		}
+
+		if (resource.isImage && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED && state.layout != resource.finalLayout) {
+			m_finalBarriers.srcStage |= (state.writeStage | state.readStage) != 0 ? state.writeStage | state.readStage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			m_finalBarriers.dstStage |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			m_finalBarriers.imageBarriers.push_back({ r, state.layout, resource.finalLayout, state.writeAccess, 0 });
+		}
+		else if (!resource.isImage && resource.finalStage != 0 && state.writeStage != 0) {
+			m_finalBarriers.srcStage |= state.writeStage;
+			m_finalBarriers.dstStage |= resource.finalStage;
+			m_finalBarriers.bufferBarriers.push_back({ r, state.writeAccess, resource.finalAccess });
+		}
+	}
+
+	if (!m_finalBarriers.empty()) {
+		m_stats.barrierBatchCount++;
+		m_stats.imageBarrierCount += static_cast<uint32_t>(m_finalBarriers.imageBarriers.size());
+		m_stats.bufferBarrierCount += static_cast<uint32_t>(m_finalBarriers.bufferBarriers.size());
+	}
+}
+
+void RenderGraph::createRenderPasses(csmntVkApplication* pApp)
+{
+	for (PassNode& pass : m_passes) {
+		if (pass.culled || pass.type != PassType::Graphics) {
+			continue;
+		}
+
+		std::vector<VkAttachmentDescription> descriptions;
+		std::vector<VkAttachmentReference> colorReferences;
+		VkAttachmentReference depthReference = {};
+		pass.clearValues.clear();
+
+		for (uint32_t a = 0; a < pass.attachments.size(); a++) {
+			const Attachment& attachment = pass.attachments[a];
+
+			VkAttachmentDescription description = {};
+			description.format = m_resources[attachment.resource].format;
+			description.samples = VK_SAMPLE_COUNT_1_BIT;
+			description.loadOp = attachment.loadOp;
+			description.storeOp = attachment.storeOp;
+			description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.initialLayout = attachment.initialLayout;
+			description.finalLayout = attachment.finalLayout;
+			descriptions.push_back(description);
+
+			if (a < pass.colorCount) {
+				colorReferences.push_back({ a, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			}
+			else {
+				depthReference = { a, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			}
+
+			pass.clearValues.push_back(attachment.clearValue);
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pDepthStencilAttachment = pass.hasDepth ? &depthReference : nullptr;
+
+		//Nothing to wait on means the implicit dependencies do
+		std::vector<VkSubpassDependency> dependencies;
+		if (pass.incoming.srcStageMask != 0) {
+			dependencies.push_back(pass.incoming);
+		}
+		if (pass.outgoing.srcStageMask != 0) {
+			dependencies.push_back(pass.outgoing);
+		}
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+		renderPassInfo.pAttachments = descriptions.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(m_vkDevice, &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass for " + pass.name + "!");
+		}
+		//Pipelines are cached against what the pass is compatible with, not its handle
+		pApp->getPipelineCache().registerRenderPass(pass.renderPass, renderPassInfo);
+	}
+}
+
+const RenderGraph::Use& RenderGraph::findUse(Pass pass, Resource resource) const
+{
+	for (const Use& use : m_passes[pass].uses) {
+		if (use.resource == resource) {
+			return use;
+		}
+	}
+	throw std::runtime_error("render graph: pass " + m_passes[pass].name + " doesn't use " + m_resources[resource].name + "!");
+}
+
+void RenderGraph::getFrameAccess(Resource resource, VkPipelineStageFlags& stage, VkAccessFlags& writeAccess) const
+{
+	stage = 0;
+	writeAccess = 0;
+	for (Pass p : m_resources[resource].passes) {
+		const Use& use = findUse(p, resource);
+		stage |= use.stage;
+		if (use.write) {
+			writeAccess |= use.access;
+		}
+	}
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format)
+{
+	return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+		format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageAspectFlags RenderGraph::getAspectMask(VkFormat format)
+{
+	if (!isDepthFormat(format)) {
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	return vkHelpers::hasStencilComponent(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+#pragma endregion
+
+#pragma region EVERY FRAME
+void RenderGraph::setImage(Resource resource, VkImage image, VkImageView view)
+{
+	m_resources[resource].image = image;
+	m_resources[resource].view = view;
+}
+
+void RenderGraph::setBuffer(Resource resource, VkBuffer buffer)
+{
+	m_resources[resource].buffer = buffer;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(Pass pass)
+{
+	PassNode& node = m_passes[pass];
+
+	std::vector<VkImageView> views;
+	for (const Attachment& attachment : node.attachments) {
+		if (m_resources[attachment.resource].view == VK_NULL_HANDLE) {
+			throw std::runtime_error("render graph: " + m_resources[attachment.resource].name + " has no image bound!");
+		}
+		views.push_back(m_resources[attachment.resource].view);
+	}
+
+	auto it = node.framebuffers.find(views);
+	if (it != node.framebuffers.end()) {
+		return it->second;
+	}
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = node.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = node.extent.width;
+	framebufferInfo.height = node.extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(m_vkDevice, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create framebuffer for " + node.name + "!");
+	}
+	node.framebuffers[views] = framebuffer;
+	return framebuffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, size_t frame)
+{
+	for (Pass p = 0; p < m_passes.size(); p++) {
+		PassNode& pass = m_passes[p];
+		if (pass.culled) {
+			continue;
+		}
+
+		recordBarriers(commandBuffer, pass.barriers);
+
+		if (pass.type != PassType::Graphics) {
+			pass.record(commandBuffer, frame);
+			continue;
+		}
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = pass.renderPass;
+		renderPassInfo.framebuffer = getFramebuffer(p);
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = pass.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+		renderPassInfo.pClearValues = pass.clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, pass.contents);
+		pass.record(commandBuffer, frame);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	recordBarriers(commandBuffer, m_finalBarriers);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch)
+{
+	if (batch.empty()) {
+		return;
+	}
+
+	m_imageBarrierScratch.resize(batch.imageBarriers.size());
+	for (size_t i = 0; i < batch.imageBarriers.size(); i++) {
+		const ImageBarrier& source = batch.imageBarriers[i];
+		VkImageMemoryBarrier& barrier = m_imageBarrierScratch[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = source.srcAccess;
+		barrier.dstAccessMask = source.dstAccess;
+		barrier.oldLayout = source.oldLayout;
+		barrier.newLayout = source.newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_resources[source.resource].image;
+		barrier.subresourceRange.aspectMask = getAspectMask(m_resources[source.resource].format);
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	}
+
+	m_bufferBarrierScratch.resize(batch.bufferBarriers.size());
+	for (size_t i = 0; i < batch.bufferBarriers.size(); i++) {
+		const BufferBarrier& source = batch.bufferBarriers[i];
+		VkBufferMemoryBarrier& barrier = m_bufferBarrierScratch[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = source.srcAccess;
+		barrier.dstAccessMask = source.dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = m_resources[source.resource].buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, batch.srcStage, batch.dstStage, 0,
+		0, nullptr,
+		static_cast<uint32_t>(m_bufferBarrierScratch.size()), m_bufferBarrierScratch.data(),
+		static_cast<uint32_t>(m_imageBarrierScratch.size()), m_imageBarrierScratch.data());
+}
+#pragma endregion
+
+#pragma region CLEANUP & STATS
+void RenderGraph::cleanup(csmntVkApplication* pApp)
+{
+	VkDevice& device = pApp->getVkDevice();
+
+	for (PassNode& pass : m_passes) {
+		for (auto& framebuffer : pass.framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+		}
+		if (pass.renderPass != VK_NULL_HANDLE) {
+			pApp->getPipelineCache().unregisterRenderPass(pass.renderPass);
+			vkDestroyRenderPass(device, pass.renderPass, nullptr);
+		}
+	}
+
+	//Imported handles are the caller's
+	for (ResourceNode& resource : m_resources) {
+		if (resource.imported || resource.image == VK_NULL_HANDLE) {
+			continue;
+		}
+		vkDestroyImageView(device, resource.view, nullptr);
+		vkDestroyImage(device, resource.image, nullptr);
+	}
+	for (MemorySlot& memorySlot : m_memorySlots) {
+		pApp->getAllocator().free(memorySlot.memory);
+	}
+
+	m_passes.clear();
+	m_resources.clear();
+	m_memorySlots.clear();
+	m_finalBarriers = BarrierBatch();
+	m_stats = RenderGraphStats();
+}
+
+void RenderGraph::dumpStats(std::ostream& out)
+{
+	out << "render graph: " << (m_stats.passCount - m_stats.culledPassCount) << " passes (" << m_stats.culledPassCount << " culled), "
+		<< m_stats.barrierBatchCount << " barrier batches (" << m_stats.imageBarrierCount << " image, " << m_stats.bufferBarrierCount << " buffer), "
+		<< m_stats.transientImageCount << " transient images in " << (m_stats.allocatedBytes >> 10) << "KB of "
+		<< (m_stats.transientBytes >> 10) << "KB, " << m_stats.lazyImageCount << " lazily allocated" << std::endl;
+
+	for (const PassNode& pass : m_passes) {
+		out << "  " << pass.name << (pass.culled ? " [culled]" : "");
+		for (const Attachment& attachment : pass.attachments) {
+			if (!pass.culled) {
+				out << " " << m_resources[attachment.resource].name
+					<< (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? " load" : attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? " clear" : " discard")
+					<< (attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? "/store" : "/discard");
+			}
+		}
+		out << std::endl;
+	}
+}
+#pragma endregion
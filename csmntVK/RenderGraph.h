@@ -0,0 +1,244 @@
+#pragma once
+#ifndef _RENDER_GRAPH_
+#define _RENDER_GRAPH_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <ostream>
+#include "vkMemoryAllocator.h"
+
+class csmntVkApplication;
+
+//What compile() made of the graph -- per frame counts are what execute() records every frame
+struct RenderGraphStats {
+	uint32_t		passCount = 0;
+	uint32_t		culledPassCount = 0;
+	uint32_t		barrierBatchCount = 0;		//vkCmdPipelineBarrier calls per frame
+	uint32_t		imageBarrierCount = 0;
+	uint32_t		bufferBarrierCount = 0;
+	uint32_t		transientImageCount = 0;
+	uint32_t		lazyImageCount = 0;			//tile only, in lazily allocated memory where there is some
+	VkDeviceSize	transientBytes = 0;			//what the transient images would take on their own
+	VkDeviceSize	allocatedBytes = 0;			//what they take once aliased
+};
+
+/////////////////////////////////////////////////////
+//---RenderGraph:
+//---Passes declare which images & buffers they read & write
+//---instead of wiring render passes & barriers by hand.
+//---compile() walks the passes in the order they were added:
+//---passes nothing downstream reads are culled, transient
+//---images with disjoint lifetimes share memory, attachments
+//---that never leave a tile get lazily allocated memory, and
+//---each pass gets at most one batched barrier -- attachment
+//---transitions ride on its render pass' layouts & external
+//---dependencies instead. Imported resources belong to the
+//---caller & are bound to handles per frame, before execute()
+/////////////////////////////////////////////////////
+
+class RenderGraph {
+public:
+	typedef uint32_t Resource;
+	typedef uint32_t Pass;
+	//frame is whatever the caller hands execute()
+	typedef std::function<void(VkCommandBuffer, size_t frame)> RecordFunction;
+
+	enum class PassType : uint8_t {
+		Graphics = 0,		//one render pass, set up from its attachments
+		Compute,
+		Transfer
+	};
+
+	//How a pass touches a resource outside of attachments -- read() / write() pick the access
+	enum class Usage : uint8_t {
+		Sampled = 0,		//shader reads through a sampler, SHADER_READ_ONLY_OPTIMAL
+		Storage,			//storage buffer / image, GENERAL
+		Indirect,			//indirect draw parameters & counts
+		Transfer			//copies & fills
+	};
+
+	RenderGraph() {};
+	~RenderGraph() {};
+	RenderGraph(RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	//Building -- declarations are kept until cleanup(), every compile() starts from them.
+	//Imported images start each frame in initialLayout, ready once readyStage is reached (e.g. the
+	//acquire semaphore's wait stage), & are left in finalLayout -- UNDEFINED leaves them as the last pass did
+	Resource importImage(const std::string& name, VkFormat, VkExtent2D, VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags readyStage = 0);
+	//Lives only within the graph, created by compile()
+	Resource createImage(const std::string& name, VkFormat, VkExtent2D);
+	//finalStage / finalAccess: who reads it after the frame (e.g. HOST for a readback), 0 = no one in this queue
+	Resource importBuffer(const std::string& name, VkPipelineStageFlags finalStage = 0, VkAccessFlags finalAccess = 0);
+
+	Pass addPass(const std::string& name, PassType, RecordFunction);
+	void read(Pass, Resource, Usage);
+	void write(Pass, Resource, Usage);
+	//Graphics passes only, in attachment order. Without a clear value an attachment keeps what's there
+	void addColorAttachment(Pass, Resource, const VkClearValue* pClearValue = nullptr);
+	void setDepthAttachment(Pass, Resource, const VkClearValue* pClearValue = nullptr);
+	//Inline by default, secondaries need getRenderPass / getFramebuffer to inherit
+	void setSubpassContents(Pass, VkSubpassContents);
+	//Never culled, for passes whose results leave through something the graph doesn't see
+	void setSideEffects(Pass);
+
+	//Culls, allocates & creates everything execute() needs. Call again after cleanup() + rebuilding
+	void compile(csmntVkApplication*);
+	//Destroys what compile() made & forgets every declaration
+	void cleanup(csmntVkApplication*);
+
+	//Per frame -- bind imported resources, then record
+	void setImage(Resource, VkImage, VkImageView);
+	void setBuffer(Resource, VkBuffer);
+	VkImage getImage(Resource resource) const { return m_resources[resource].image; };
+	//Transient images have theirs once compiled -- depth only for depth formats
+	VkImageView getImageView(Resource resource) const { return m_resources[resource].view; };
+	VkBuffer getBuffer(Resource resource) const { return m_resources[resource].buffer; };
+	VkRenderPass getRenderPass(Pass pass) const { return m_passes[pass].renderPass; };
+	//Framebuffer for the images bound right now, made on first use & kept until cleanup()
+	VkFramebuffer getFramebuffer(Pass);
+	void execute(VkCommandBuffer, size_t frame);
+
+	const bool isCulled(Pass pass) const { return m_passes[pass].culled; };
+	const RenderGraphStats& getStats() const { return m_stats; };
+	void dumpStats(std::ostream&);
+
+private:
+	struct Use {
+		Resource				resource;
+		VkPipelineStageFlags	stage;
+		VkAccessFlags			access;
+		VkImageLayout			layout;
+		bool					write;
+		bool					attachment;
+	};
+
+	struct Attachment {
+		Resource				resource;
+		bool					clear;
+		VkClearValue			clearValue;
+		VkAttachmentLoadOp		loadOp;
+		VkAttachmentStoreOp		storeOp;
+		VkImageLayout			initialLayout;
+		VkImageLayout			finalLayout;
+	};
+
+	struct ImageBarrier {
+		Resource				resource;
+		VkImageLayout			oldLayout;
+		VkImageLayout			newLayout;
+		VkAccessFlags			srcAccess;
+		VkAccessFlags			dstAccess;
+	};
+
+	struct BufferBarrier {
+		Resource				resource;
+		VkAccessFlags			srcAccess;
+		VkAccessFlags			dstAccess;
+	};
+
+	//Everything one vkCmdPipelineBarrier does -- handles are looked up when it's recorded
+	struct BarrierBatch {
+		VkPipelineStageFlags	srcStage = 0;
+		VkPipelineStageFlags	dstStage = 0;
+		std::vector<ImageBarrier> imageBarriers;
+		std::vector<BufferBarrier> bufferBarriers;
+
+		const bool empty() const { return imageBarriers.empty() && bufferBarriers.empty(); };
+	};
+
+	struct PassNode {
+		std::string				name;
+		PassType				type;
+		RecordFunction			record;
+		std::vector<Use>		uses;
+		std::vector<Attachment> attachments;		//colours, then depth
+		uint32_t				colorCount = 0;
+		bool					hasDepth = false;
+		VkSubpassContents		contents = VK_SUBPASS_CONTENTS_INLINE;
+		bool					sideEffects = false;
+		bool					culled = false;
+
+		BarrierBatch			barriers;
+		VkSubpassDependency		incoming;
+		VkSubpassDependency		outgoing;
+		VkRenderPass			renderPass = VK_NULL_HANDLE;
+		VkExtent2D				extent = { 0, 0 };
+		std::vector<VkClearValue> clearValues;
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+	};
+
+	struct ResourceNode {
+		std::string				name;
+		bool					isImage;
+		bool					imported;
+		VkFormat				format = VK_FORMAT_UNDEFINED;
+		VkExtent2D				extent = { 0, 0 };
+		VkImageLayout			initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout			finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags	readyStage = 0;
+		VkPipelineStageFlags	finalStage = 0;
+		VkAccessFlags			finalAccess = 0;
+
+		VkImage					image = VK_NULL_HANDLE;
+		VkImageView				view = VK_NULL_HANDLE;
+		VkBuffer				buffer = VK_NULL_HANDLE;
+
+		//compile() -- alive passes using it, in order
+		std::vector<Pass>		passes;
+		bool					lazy = false;
+		uint32_t				memorySlot = 0;
+	};
+
+	//Where a resource stands while compile() replays the passes
+	struct ResourceState {
+		VkImageLayout			layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags	writeStage = 0;		//last write (or layout change) & what it wrote with
+		VkAccessFlags			writeAccess = 0;
+		VkPipelineStageFlags	readStage = 0;		//reads already ordered after it
+		VkAccessFlags			readAccess = 0;
+		Pass					syncedPass = s_noPass;	//a render pass' outgoing dependency already covers this pass' use
+	};
+
+	//Transient images with disjoint lifetimes, one allocation between them
+	struct MemorySlot {
+		VkMemoryRequirements	requirements = {};
+		std::vector<Resource>	resources;			//in lifetime order
+		bool					lazy = false;		//one tile only image, never shared
+		vkHelpers::Allocation	memory;
+	};
+
+	static void getUsageAccess(Usage, PassType, bool write, VkPipelineStageFlags& stage, VkAccessFlags& access, VkImageLayout& layout);
+	static bool isDepthFormat(VkFormat);
+	static VkImageAspectFlags getAspectMask(VkFormat);
+
+	void addUse(Pass, const Use&);
+	const Use& findUse(Pass, Resource) const;
+	//Every stage a resource is used at over the frame & what it writes with
+	void getFrameAccess(Resource, VkPipelineStageFlags& stage, VkAccessFlags& writeAccess) const;
+	void cullPasses();
+	void assignAttachmentOps();
+	void createTransientImages(csmntVkApplication*);
+	void buildBarriers();
+	void createRenderPasses(csmntVkApplication*);
+	bool findDependency(const ResourceNode&, const ResourceState&, const Use&, VkPipelineStageFlags& srcStage, VkAccessFlags& srcAccess) const;
+	void recordBarriers(VkCommandBuffer, const BarrierBatch&);
+
+	VkDevice					m_vkDevice = VK_NULL_HANDLE;
+	std::vector<PassNode>		m_passes;
+	std::vector<ResourceNode>	m_resources;
+	std::vector<MemorySlot>		m_memorySlots;
+	BarrierBatch				m_finalBarriers;		//imported resources into the state they leave in
+	RenderGraphStats			m_stats;
+
+	//execute() scratch, kept to avoid reallocating every frame
+	std::vector<VkImageMemoryBarrier>	m_imageBarrierScratch;
+	std::vector<VkBufferMemoryBarrier>	m_bufferBarrierScratch;
+
+	static const Pass			s_noPass = 0xFFFFFFFF;
+};
+
+#endif // !_RENDER_GRAPH_
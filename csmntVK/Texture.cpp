@@ -2,67 +2,143 @@
 #include <stdexcept>
 #include "vkHelpers.h"
 #include "Application.h"
+#include "MipChain.h"
+#include "Ktx2File.h"
+#include <algorithm>
+#include <iostream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-Texture::Texture(csmntVkApplication* pApp, VkCommandPool& cmdPool, const char* path, const int mode = STBI_rgb_alpha)
+Texture::Texture(csmntVkApplication* pApp, const char* path, const int mode = STBI_rgb_alpha, MipGeneration mips)
 {
-	createTextureImage(pApp, cmdPool, path, mode);
+	createTextureImage(pApp, path, mode, mips);
 	createTextureImageView(pApp->getVkDevice());
 }
 
-void Texture::createTextureImage(csmntVkApplication* pApp, VkCommandPool& cmdPool, const char* path, const int mode = STBI_rgb_alpha)
+Texture::Texture(csmntVkApplication* pApp, const TextureData& data)
 {
-	//TODO: map between stb & vk image formats?
+	createTextureImage(pApp, data);
+	createTextureImageView(pApp->getVkDevice());
+}
+
+void Texture::createTextureImage(csmntVkApplication* pApp, const char* path, const int mode = STBI_rgb_alpha, MipGeneration mips)
+{
+	//TODO: map between stb & vk image formats? (everything is loaded as RGBA8 for now, mode aside)
+	TextureData data;
+	loadTextureData(pApp, path, mips, data);
+	createTextureImage(pApp, data);
+}
+
+void Texture::createTextureImage(csmntVkApplication* pApp, const TextureData& data)
+{
+	m_format = data.format;
+	m_mipLevels = data.mipLevels;
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (data.blitMips) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	vkHelpers::createVkImage(pApp->getVkDevice(), pApp->getAllocator(), data.width, data.height,
+		m_format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage, m_textureImageMemory, m_mipLevels);
+
+	//Stage the pixels -- transitions, copies & blits land with the rest of the batch
+	if (data.blitMips) {
+		pApp->getUploadContext().uploadImageGenerateMips(pApp, m_textureImage, data.pData, data.dataSize,
+			data.width, data.height, m_mipLevels);
+	}
+	else {
+		pApp->getUploadContext().uploadImage(pApp, m_textureImage, data.pData, data.dataSize, data.levels);
+	}
+}
+
+void Texture::loadTextureData(csmntVkApplication* pApp, const std::string& path, MipGeneration mips, TextureData& data)
+{
+	if (ktx2::isKtx2Path(path)) {
+		loadTextureDataKtx2(pApp, path, data);
+		return;
+	}
 
 	int texWidth, texHeight, texChannels;
 
-	stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, mode);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
 	if (!pixels) {
 		throw std::runtime_error("failed to load texture image!");
 	}
 
-	//copy memory
-	VkBuffer		stagingBuffer;
-	VkDeviceMemory	stagingBufferMemory;
-	void*			data;
+	//Full chain down to 1x1
+	data.format = VK_FORMAT_R8G8B8A8_UNORM;
+	data.width = static_cast<uint32_t>(texWidth);
+	data.height = static_cast<uint32_t>(texHeight);
+	data.mipLevels = mipChain::getMipLevelCount(data.width, data.height);
+
+	data.blitMips = mips != MipGeneration::Cpu && supportsLinearBlit(pApp, VK_FORMAT_R8G8B8A8_UNORM);
+	if (mips == MipGeneration::Gpu && !data.blitMips) {
+		stbi_image_free(pixels);
+		throw std::runtime_error("texture format doesn't support linear blits for mip generation!");
+	}
+
+	if (data.blitMips) {
+		data.pixels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+	}
+	else {
+		//Colour textures are sRGB encoded even though we sample them as UNORM -- filter in linear
+		data.pixels = mipChain::buildMipChain(pixels, data.width, data.height, MipFilter::Kaiser, true, data.levels);
+	}
 
-	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), imageSize, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-		stagingBuffer, stagingBufferMemory);
-	vkMapMemory(pApp->getVkDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(pApp->getVkDevice(), stagingBufferMemory);
+	data.pData = data.pixels.data();
+	data.dataSize = static_cast<VkDeviceSize>(data.pixels.size());
 
 	stbi_image_free(pixels);
+}
 
-	vkHelpers::createVkImage(pApp->getVkDevice(), pApp->getVkPhysicalDevice(), texWidth, texHeight, 
-		VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-		m_textureImage, m_textureImageMemory);
+#pragma region KTX2
+void Texture::loadTextureDataKtx2(csmntVkApplication* pApp, const std::string& path, TextureData& data)
+{
+	data.format = ktx2::openSampledVariant(pApp->getVkPhysicalDevice(), path, data.file);
+
+	if (data.format != VK_FORMAT_UNDEFINED) {
+		//Straight from the mapping into staging, the mips are already in the file
+		data.pData = data.file.getPackedLevels(data.levels, data.dataSize);
+	}
+	else {
+#if _DEBUG
+		std::cout << "HEY! No compressed format of " << path << " is supported, decoding it on the CPU" << std::endl;
+#endif
 
-	//Store the buffer
-	vkHelpers::transitionVkImageLayout(pApp, cmdPool, m_textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	vkHelpers::copyBufferToVkImage(pApp, cmdPool, stagingBuffer, m_textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+		data.file.decodeLevels(data.levels, data.pixels);
+		data.file.close();
 
-	//transition to shader usage
-	vkHelpers::transitionVkImageLayout(pApp, cmdPool, m_textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		data.format = VK_FORMAT_R8G8B8A8_UNORM;
+		data.pData = data.pixels.data();
+		data.dataSize = static_cast<VkDeviceSize>(data.pixels.size());
+	}
 
-	//cleanup
-	vkDestroyBuffer(pApp->getVkDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), stagingBufferMemory, nullptr);
+	data.width = data.levels[0].width;
+	data.height = data.levels[0].height;
+	data.mipLevels = static_cast<uint32_t>(data.levels.size());
 }
+#pragma endregion
 
 void Texture::createTextureImageView(VkDevice& device)
 {
-	m_textureImageView = vkHelpers::createVkImageView(device, m_textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	m_textureImageView = vkHelpers::createVkImageView(device, m_textureImage, m_format, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
 }
 
 void Texture::cleanupTexture(csmntVkApplication* pApp)
 {
 	vkDestroyImageView(pApp->getVkDevice(), m_textureImageView, nullptr);
-	vkDestroyImage(pApp->getVkDevice(), m_textureImage, nullptr);
-	vkFreeMemory(pApp->getVkDevice(), m_textureImageMemory, nullptr);
+	vkHelpers::destroyVkImage(pApp->getVkDevice(), pApp->getAllocator(), m_textureImage, m_textureImageMemory);
 }
+
+bool Texture::supportsLinearBlit(csmntVkApplication* pApp, VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(pApp->getVkPhysicalDevice(), format, &formatProperties);
+
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
+}
\ No newline at end of file
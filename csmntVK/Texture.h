@@ -1,24 +1,70 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "vkMemoryAllocator.h"
+#include "MipChain.h"
+#include "Ktx2File.h"
 
 class csmntVkApplication;
 
+//Where a texture's mip chain comes from
+enum class MipGeneration {
+	Auto,		//blits if the format can be linearly filtered, CPU otherwise
+	Cpu,		//gamma-aware Kaiser filter before upload
+	Gpu			//vkCmdBlitImage down from mip 0
+};
+
+//CPU side of a texture load -- decoded (or mapped) & ready to stage
+struct TextureData {
+	VkFormat				format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	uint32_t				mipLevels = 1;
+	bool					blitMips = false;	//only level 0 is in the data, the rest get blitted down
+	std::vector<MipLevel>	levels;				//otherwise every level, offsets into pData
+	const uint8_t*			pData = nullptr;
+	VkDeviceSize			dataSize = 0;
+
+	std::vector<uint8_t>	pixels;				//what pData points into -- a decode...
+	Ktx2File				file;				//...or a mapped .ktx2
+};
+
 class Texture {
 public:
 	Texture() {};
-	Texture(csmntVkApplication*, VkCommandPool&, const char*, const int);
+	//Upload is recorded into the app's UploadContext -- flush/wait before sampling.
+	//.ktx2 paths upload their compressed mips as is, anything else goes through stb_image
+	Texture(csmntVkApplication*, const char*, const int, MipGeneration mips = MipGeneration::Auto);
+	//Same, from a payload loadTextureData already produced
+	Texture(csmntVkApplication*, const TextureData&);
 	~Texture() {};
 
 	void cleanupTexture(csmntVkApplication*);
-	void createTextureImage(csmntVkApplication*, VkCommandPool&, const char*, const int);
+	void createTextureImage(csmntVkApplication*, const char*, const int, MipGeneration mips = MipGeneration::Auto);
+	void createTextureImage(csmntVkApplication*, const TextureData&);
 	void createTextureImageView(VkDevice&);
 
 	const VkImage& getVkImage() const { return m_textureImage; };
-	const VkDeviceMemory& getVkImageMem() const { return m_textureImageMemory; };
+	const vkHelpers::Allocation& getVkImageMem() const { return m_textureImageMemory; };
 	const VkImageView& getVkImageView() const { return m_textureImageView; };
+	const uint32_t getMipLevels() const { return m_mipLevels; };
+	const VkFormat getFormat() const { return m_format; };
+
+	//Can vkCmdBlitImage build this format's mips (optimal tiling, linear filter)?
+	static bool supportsLinearBlit(csmntVkApplication*, VkFormat);
+
+	//File read, decode & CPU mips -- no device calls beyond format queries, so asset loader threads can run it
+	static void loadTextureData(csmntVkApplication*, const std::string& path, MipGeneration mips, TextureData&);
 
 private:
+	//Picks the first of path & its name.bc7/bc3/bc1/astc/etc2.ktx2 siblings the device can sample,
+	//decoding one to RGBA8 on the CPU if it can't sample any of them
+	static void loadTextureDataKtx2(csmntVkApplication*, const std::string& path, TextureData&);
+
 	VkImage			m_textureImage;
-	VkDeviceMemory	m_textureImageMemory;
+	vkHelpers::Allocation m_textureImageMemory;
 	VkImageView		m_textureImageView;
+	uint32_t		m_mipLevels = 1;
+	VkFormat		m_format = VK_FORMAT_R8G8B8A8_UNORM;
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "TextureCooker.h"
+#include "MipChain.h"
+#include "Ktx2File.h"
+#include "JobSystem.h"
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+
+#include <stb_image.h>
+
+namespace textureCooker {
+	TextureCookStats cookTexture(const std::string& inPath, const std::string& outPath, VkFormat format,
+		EncodeQuality quality, JobSystem& jobs)
+	{
+		if (!blockCompression::canEncode(format)) {
+			throw std::runtime_error("can't cook textures to this format!");
+		}
+
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load(inPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load texture image " + inPath);
+		}
+
+		TextureCookStats stats;
+		stats.width = static_cast<uint32_t>(texWidth);
+		stats.height = static_cast<uint32_t>(texHeight);
+
+		std::vector<MipLevel> levels;
+		std::vector<uint8_t> chain = mipChain::buildMipChain(pixels, stats.width, stats.height, MipFilter::Kaiser,
+			isSrgbFormat(format), levels);
+		stbi_image_free(pixels);
+
+		//Every level's blocks, packed like the RGBA chain was
+		std::vector<MipLevel> blockLevels(levels.size());
+		VkDeviceSize blockBytes = 0;
+		for (size_t i = 0; i < levels.size(); i++) {
+			blockLevels[i] = { blockBytes, levels[i].width, levels[i].height };
+			blockBytes += blockCompression::getImageSize(format, levels[i].width, levels[i].height);
+		}
+		std::vector<uint8_t> blocks(static_cast<size_t>(blockBytes));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < levels.size(); i++) {
+			blockCompression::encodeImage(format, chain.data() + levels[i].offset, levels[i].width, levels[i].height, quality,
+				blocks.data() + blockLevels[i].offset, &jobs);
+			stats.blockCount += static_cast<uint64_t>((levels[i].width + 3) / 4) * ((levels[i].height + 3) / 4);
+		}
+		stats.encodeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		ktx2::writeKtx2(outPath, format, blockLevels, blocks.data());
+
+		stats.levelCount = static_cast<uint32_t>(levels.size());
+		stats.dataSize = blockBytes;
+		return stats;
+	}
+
+	bool parseFormat(const std::string& name, bool linear, VkFormat& format)
+	{
+		if (name == "bc1") {
+			format = linear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		}
+		else if (name == "bc3") {
+			format = linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+		}
+		else if (name == "bc7") {
+			format = linear ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool parseQuality(const std::string& name, EncodeQuality& quality)
+	{
+		if (name == "fast") {
+			quality = EncodeQuality::Fast;
+		}
+		else if (name == "normal") {
+			quality = EncodeQuality::Normal;
+		}
+		else if (name == "best") {
+			quality = EncodeQuality::Best;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool isSrgbFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef _TEXTURE_COOKER_
+#define _TEXTURE_COOKER_
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+#include "BlockCompression.h"
+
+class JobSystem;
+
+//What a cook produced & how long the block encoding took
+struct TextureCookStats {
+	uint32_t	width = 0;
+	uint32_t	height = 0;
+	uint32_t	levelCount = 0;
+	uint64_t	blockCount = 0;
+	uint64_t	dataSize = 0;		//compressed bytes, every level
+	double		encodeSeconds = 0.0;
+};
+
+/////////////////////////////////////////////////////
+//---textureCooker:
+//---Offline image -> .ktx2. stb_image decodes, mipChain
+//---builds the mips (gamma-aware for sRGB formats),
+//---blockCompression encodes every level across the
+//---job system's workers. The result is what Texture maps
+/////////////////////////////////////////////////////
+
+namespace textureCooker {
+	//Throws on an unreadable image or a format blockCompression can't encode
+	TextureCookStats cookTexture(const std::string& inPath, const std::string& outPath, VkFormat format,
+		EncodeQuality quality, JobSystem& jobs);
+
+	//"bc1", "bc3" or "bc7" -- sRGB variants unless linear (normal maps & other data)
+	bool parseFormat(const std::string& name, bool linear, VkFormat& format);
+	//"fast", "normal" or "best"
+	bool parseQuality(const std::string& name, EncodeQuality& quality);
+
+	bool isSrgbFormat(VkFormat format);
+}
+
+#endif // !_TEXTURE_COOKER_
@@ -0,0 +1,314 @@
+#include "TextureStreamer.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <stb_image.h>
+
+#pragma region CREATE & CLEANUP
+void TextureStreamer::create(csmntVkApplication* pApp, uint32_t framesInFlight, VkDeviceSize budget)
+{
+	m_framesInFlight = framesInFlight;
+	m_budget = budget;
+	m_stats = TextureStreamStats();
+	m_stats.budgetBytes = budget;
+
+#if _DEBUG
+	std::cout << "HEY! texture streaming with a " << (budget >> 20) << "MB budget" << std::endl;
+#endif
+}
+
+void TextureStreamer::cleanup(csmntVkApplication* pApp)
+{
+	//Nothing may still be copying into a pending image
+	pApp->getUploadContext().flush(pApp);
+
+	for (RetiredImage& retired : m_retiredImages) {
+		destroyImage(pApp, retired.image);
+	}
+	m_retiredImages.clear();
+
+	for (std::unique_ptr<StreamedTexture>& pTexture : m_textures) {
+		destroyImage(pApp, pTexture->pending);
+		destroyImage(pApp, pTexture->resident);
+	}
+	m_textures.clear();
+	m_candidates.clear();
+}
+#pragma endregion
+
+#pragma region TEXTURES
+uint32_t TextureStreamer::addTexture(csmntVkApplication* pApp, const std::string& path)
+{
+	std::unique_ptr<StreamedTexture> pTexture(new StreamedTexture());
+	loadSource(pApp, *pTexture, path);
+
+	//The tail is the first level small enough to keep around for good
+	const uint32_t levelCount = static_cast<uint32_t>(pTexture->levels.size());
+	pTexture->tailLevel = levelCount - 1;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		if (std::max(pTexture->levels[i].width, pTexture->levels[i].height) <= s_mipTailSize) {
+			pTexture->tailLevel = i;
+			break;
+		}
+	}
+
+	pTexture->wantedLevel = pTexture->tailLevel;
+	pTexture->lastUsedFrame = m_frameNumber;
+	createStreamImage(pApp, *pTexture, pTexture->tailLevel, pTexture->resident);
+
+#if _DEBUG
+	if (m_stats.residentBytes > m_budget) {
+		std::cout << "HEY! texture mip tails alone are over the streaming budget (" << (m_stats.residentBytes >> 10) << "KB)" << std::endl;
+	}
+#endif
+
+	m_textures.push_back(std::move(pTexture));
+	return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+void TextureStreamer::loadSource(csmntVkApplication* pApp, StreamedTexture& texture, const std::string& path)
+{
+	if (ktx2::isKtx2Path(path)) {
+		texture.format = ktx2::openSampledVariant(pApp->getVkPhysicalDevice(), path, texture.file);
+		if (texture.format != VK_FORMAT_UNDEFINED) {
+			//The mapping stays open, later stream ins stage out of it
+			VkDeviceSize size;
+			texture.pData = texture.file.getPackedLevels(texture.levels, size);
+			return;
+		}
+
+#if _DEBUG
+		std::cout << "HEY! No compressed format of " << path << " is supported, decoding it on the CPU" << std::endl;
+#endif
+		texture.file.decodeLevels(texture.levels, texture.decoded);
+		texture.file.close();
+	}
+	else {
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+
+		//Same chain as Texture's CPU path -- sRGB encoded, sampled as UNORM
+		texture.decoded = mipChain::buildMipChain(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight),
+			MipFilter::Kaiser, true, texture.levels);
+		stbi_image_free(pixels);
+	}
+
+	texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+	texture.pData = texture.decoded.data();
+}
+
+void TextureStreamer::requestSize(uint32_t texture, float pixels)
+{
+	m_textures[texture]->requestedPixels = std::max(m_textures[texture]->requestedPixels, pixels);
+}
+
+VkDeviceSize TextureStreamer::getResidencySize(const StreamedTexture& texture, uint32_t baseLevel) const
+{
+	VkDeviceSize size = 0;
+	for (size_t i = baseLevel; i < texture.levels.size(); i++) {
+		size += Ktx2File::getExpectedLevelSize(texture.format, texture.levels[i].width, texture.levels[i].height);
+	}
+	return size;
+}
+
+uint32_t TextureStreamer::getWantedLevel(const StreamedTexture& texture, float pixels) const
+{
+	//A texel per pixel -- every level down halves the texels across
+	const float texels = static_cast<float>(std::max(texture.levels[0].width, texture.levels[0].height));
+	const float level = std::floor(std::log2(texels / std::max(pixels, 1.0f)));
+	return static_cast<uint32_t>(std::min(std::max(level, 0.0f), static_cast<float>(texture.tailLevel)));
+}
+#pragma endregion
+
+#pragma region RESIDENCY
+void TextureStreamer::update(csmntVkApplication* pApp, uint64_t frameNumber)
+{
+	m_frameNumber = frameNumber;
+	UploadContext& upload = pApp->getUploadContext();
+
+	//Swapped out in frame F -> last sampled by frame F at the latest, done m_framesInFlight frames on
+	while (!m_retiredImages.empty() && m_retiredImages.front().frameNumber + m_framesInFlight <= frameNumber) {
+		destroyImage(pApp, m_retiredImages.front().image);
+		m_retiredImages.pop_front();
+	}
+
+	m_candidates.clear();
+	for (std::unique_ptr<StreamedTexture>& pTexture : m_textures) {
+		StreamedTexture& texture = *pTexture;
+
+		//Finished uploads swap in, the old image may still be bound by frames in flight
+		if (texture.pending.image != VK_NULL_HANDLE && upload.isComplete(pApp, texture.pendingTicket)) {
+			retireImage(texture.resident);
+			texture.resident = texture.pending;
+			texture.pending = StreamImage();
+			texture.pendingTicket = 0;
+			texture.pendingEviction = false;
+			texture.version++;
+		}
+
+		//Textures nobody drew keep their last wish, they only drop levels under pressure
+		if (texture.requestedPixels > 0.0f) {
+			texture.wantedLevel = getWantedLevel(texture, texture.requestedPixels);
+			texture.lastUsedFrame = frameNumber;
+			texture.requestedPixels = 0.0f;
+		}
+
+		if (texture.pending.image == VK_NULL_HANDLE && texture.wantedLevel < texture.resident.baseLevel) {
+			m_candidates.push_back(&texture);
+		}
+	}
+
+	//Most recently drawn first, then whatever is furthest off what it wants
+	std::sort(m_candidates.begin(), m_candidates.end(), [](const StreamedTexture* pA, const StreamedTexture* pB) {
+		if (pA->lastUsedFrame != pB->lastUsedFrame) {
+			return pA->lastUsedFrame > pB->lastUsedFrame;
+		}
+		return pA->resident.baseLevel - pA->wantedLevel > pB->resident.baseLevel - pB->wantedLevel;
+	});
+
+	VkDeviceSize uploaded = 0;
+	for (StreamedTexture* pTexture : m_candidates) {
+		//Made room for someone else already
+		if (pTexture->pending.image != VK_NULL_HANDLE) {
+			continue;
+		}
+
+		//Straight to the wanted level if it fits this frame's uploads, a level at a time if not
+		uint32_t baseLevel = pTexture->wantedLevel;
+		VkDeviceSize size = getResidencySize(*pTexture, baseLevel);
+		if (uploaded + size > s_maxUploadPerFrame) {
+			baseLevel = pTexture->resident.baseLevel - 1;
+			size = getResidencySize(*pTexture, baseLevel);
+		}
+
+		if ((uploaded > 0 && uploaded + size > s_maxUploadPerFrame) || !makeRoom(pApp, size, pTexture->lastUsedFrame)) {
+			m_stats.deferred++;
+			continue;
+		}
+
+		createStreamImage(pApp, *pTexture, baseLevel, pTexture->pending);
+		m_stats.streamIns++;
+		uploaded += size;
+	}
+
+	//Everything recorded this update goes out in one batch, polled from here on
+	uint64_t ticket = upload.submit(pApp);
+	if (ticket != 0) {
+		for (std::unique_ptr<StreamedTexture>& pTexture : m_textures) {
+			if (pTexture->pending.image != VK_NULL_HANDLE && pTexture->pendingTicket == 0) {
+				pTexture->pendingTicket = ticket;
+			}
+		}
+	}
+}
+
+bool TextureStreamer::makeRoom(csmntVkApplication* pApp, VkDeviceSize bytes, uint64_t frame)
+{
+	while (m_stats.residentBytes - getReleasingBytes() + bytes > m_budget) {
+		//Levels nobody wants any more go first, then the least recently drawn -- never anything
+		//drawn as recently as what we're making room for, or textures would evict each other
+		StreamedTexture* pVictim = nullptr;
+		bool victimUnwanted = false;
+		for (std::unique_ptr<StreamedTexture>& pTexture : m_textures) {
+			StreamedTexture& texture = *pTexture;
+			if (texture.pending.image != VK_NULL_HANDLE || texture.resident.baseLevel >= texture.tailLevel) {
+				continue;
+			}
+
+			const bool unwanted = texture.resident.baseLevel < texture.wantedLevel;
+			if (!unwanted && texture.lastUsedFrame >= frame) {
+				continue;
+			}
+			if (!pVictim || (unwanted && !victimUnwanted) ||
+				(unwanted == victimUnwanted && texture.lastUsedFrame < pVictim->lastUsedFrame)) {
+				pVictim = &texture;
+				victimUnwanted = unwanted;
+			}
+		}
+
+		if (!pVictim) {
+			return false;
+		}
+
+		//Unwanted levels all go at once, anything still wanted a level at a time
+		const uint32_t baseLevel = victimUnwanted ? pVictim->wantedLevel : pVictim->resident.baseLevel + 1;
+		createStreamImage(pApp, *pVictim, baseLevel, pVictim->pending);
+		pVictim->pendingEviction = true;
+		m_stats.evictions++;
+	}
+
+	//The room is only really there once the evicted images have been swapped out & retired
+	return m_stats.residentBytes + bytes <= m_budget;
+}
+
+VkDeviceSize TextureStreamer::getReleasingBytes() const
+{
+	VkDeviceSize bytes = 0;
+	for (const RetiredImage& retired : m_retiredImages) {
+		bytes += retired.image.size;
+	}
+	for (const std::unique_ptr<StreamedTexture>& pTexture : m_textures) {
+		if (pTexture->pendingEviction) {
+			bytes += pTexture->resident.size;
+		}
+	}
+	return bytes;
+}
+#pragma endregion
+
+#pragma region IMAGES
+void TextureStreamer::createStreamImage(csmntVkApplication* pApp, const StreamedTexture& texture, uint32_t baseLevel, StreamImage& image)
+{
+	//Levels baseLevel.. are one contiguous range of the source either way round (smallest
+	//first in a .ktx2, largest first in a CPU chain) -- stage it with a single copy
+	const uint32_t levelCount = static_cast<uint32_t>(texture.levels.size()) - baseLevel;
+	std::vector<MipLevel> levels(texture.levels.begin() + baseLevel, texture.levels.end());
+
+	VkDeviceSize begin = UINT64_MAX, end = 0;
+	for (const MipLevel& level : levels) {
+		begin = std::min(begin, level.offset);
+		end = std::max(end, level.offset + Ktx2File::getExpectedLevelSize(texture.format, level.width, level.height));
+	}
+	for (MipLevel& level : levels) {
+		level.offset -= begin;
+	}
+
+	vkHelpers::createVkImage(pApp->getVkDevice(), pApp->getAllocator(), levels[0].width, levels[0].height,
+		texture.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.memory, levelCount);
+	image.view = vkHelpers::createVkImageView(pApp->getVkDevice(), image.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+	image.baseLevel = baseLevel;
+	image.size = std::max(image.memory.size, getResidencySize(texture, baseLevel));
+
+	pApp->getUploadContext().uploadImage(pApp, image.image, texture.pData + begin, end - begin, levels);
+
+	m_stats.residentBytes += image.size;
+}
+
+void TextureStreamer::retireImage(StreamImage& image)
+{
+	if (image.image != VK_NULL_HANDLE) {
+		m_retiredImages.push_back({ image, m_frameNumber });
+	}
+	image = StreamImage();
+}
+
+void TextureStreamer::destroyImage(csmntVkApplication* pApp, StreamImage& image)
+{
+	if (image.image == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkDestroyImageView(pApp->getVkDevice(), image.view, nullptr);
+	vkHelpers::destroyVkImage(pApp->getVkDevice(), pApp->getAllocator(), image.image, image.memory);
+	m_stats.residentBytes -= image.size;
+	image = StreamImage();
+}
+#pragma endregion
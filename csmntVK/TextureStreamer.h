@@ -0,0 +1,130 @@
+#pragma once
+#ifndef _TEXTURE_STREAMER_
+#define _TEXTURE_STREAMER_
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "vkMemoryAllocator.h"
+#include "MipChain.h"
+#include "Ktx2File.h"
+
+class csmntVkApplication;
+
+//Residency numbers since create
+struct TextureStreamStats {
+	VkDeviceSize	residentBytes = 0;		//resident, uploading & retired images -- what the budget covers
+	VkDeviceSize	budgetBytes = 0;
+	uint64_t		streamIns = 0;			//finer images uploaded
+	uint64_t		evictions = 0;			//coarser images uploaded to free memory
+	uint64_t		deferred = 0;			//stream ins held back by the budget or the per frame upload cap
+};
+
+/////////////////////////////////////////////////////
+//---TextureStreamer:
+//---Keeps textures resident from the mip tail up, as fine
+//---as their on-screen size asks for & the VRAM budget allows.
+//---A residency change uploads a new image holding just the
+//---wanted levels through the UploadContext without waiting,
+//---and swaps it in once its ticket completes. Replaced images
+//---are held until no frame in flight can sample them. Over
+//---budget, the least recently used textures drop levels
+/////////////////////////////////////////////////////
+
+class TextureStreamer {
+public:
+	TextureStreamer() {};
+	~TextureStreamer() {};
+
+	void create(csmntVkApplication*, uint32_t framesInFlight, VkDeviceSize budget);
+	void cleanup(csmntVkApplication*);
+
+	//.ktx2 levels stream straight out of the mapping, anything else is loaded through stb_image & mipped on the CPU.
+	//Only the mip tail is uploaded, into the app's UploadContext -- flush before the first frame. Returns the handle
+	uint32_t addTexture(csmntVkApplication*, const std::string& path);
+
+	//Screen space feedback -- the texture was drawn spanning this many pixels. Largest request per update wins
+	void requestSize(uint32_t texture, float pixels);
+
+	//Once per frame, after that frame's fence wait & before recording: frees retired images, swaps in
+	//finished uploads, then evicts & queues stream ins. Never waits on the GPU
+	void update(csmntVkApplication*, uint64_t frameNumber);
+
+	//The view changes (& the version bumps) when an update swaps an image in -- descriptors still
+	//holding the old view stay valid for the frames already in flight
+	const VkImageView& getImageView(uint32_t texture) const { return m_textures[texture]->resident.view; };
+	const uint32_t getViewVersion(uint32_t texture) const { return m_textures[texture]->version; };
+	//Finest level of the source that is resident
+	const uint32_t getResidentLevel(uint32_t texture) const { return m_textures[texture]->resident.baseLevel; };
+	const uint32_t getTextureCount() const { return static_cast<uint32_t>(m_textures.size()); };
+	const TextureStreamStats& getStats() const { return m_stats; };
+
+private:
+	//One residency of a texture -- source levels baseLevel.. down to 1x1
+	struct StreamImage {
+		VkImage					image = VK_NULL_HANDLE;
+		vkHelpers::Allocation	memory;
+		VkImageView				view = VK_NULL_HANDLE;
+		uint32_t				baseLevel = 0;
+		VkDeviceSize			size = 0;
+	};
+
+	struct RetiredImage {
+		StreamImage				image;
+		uint64_t				frameNumber;
+	};
+
+	struct StreamedTexture {
+		Ktx2File				file;			//mapped .ktx2 the levels come straight out of...
+		std::vector<uint8_t>	decoded;		//...or an RGBA8 chain built at load
+		const uint8_t*			pData = nullptr;
+		std::vector<MipLevel>	levels;			//whole chain, offsets into pData
+		VkFormat				format = VK_FORMAT_R8G8B8A8_UNORM;
+		uint32_t				tailLevel = 0;	//coarsest residency, never evicted
+
+		StreamImage				resident;
+		StreamImage				pending;		//uploading, swapped in when the ticket completes
+		uint64_t				pendingTicket = 0;
+		bool					pendingEviction = false;
+
+		uint32_t				wantedLevel = 0;
+		float					requestedPixels = 0.0f;
+		uint64_t				lastUsedFrame = 0;
+		uint32_t				version = 0;
+	};
+
+	void loadSource(csmntVkApplication*, StreamedTexture&, const std::string& path);
+
+	//Bytes of an image holding levels baseLevel.. of the texture
+	VkDeviceSize getResidencySize(const StreamedTexture&, uint32_t baseLevel) const;
+	//Finest level worth having for the texture drawn this many pixels across
+	uint32_t getWantedLevel(const StreamedTexture&, float pixels) const;
+
+	//Records the image's upload into the open batch
+	void createStreamImage(csmntVkApplication*, const StreamedTexture&, uint32_t baseLevel, StreamImage&);
+	void retireImage(StreamImage&);
+	void destroyImage(csmntVkApplication*, StreamImage&);
+
+	//Starts evicting until bytes more would fit -- false if what's left is in use as recently as frame
+	bool makeRoom(csmntVkApplication*, VkDeviceSize bytes, uint64_t frame);
+	//Bytes retired or on their way out, freed within a few frames
+	VkDeviceSize getReleasingBytes() const;
+
+	std::vector<std::unique_ptr<StreamedTexture>> m_textures;
+	std::deque<RetiredImage>	m_retiredImages;
+	std::vector<StreamedTexture*> m_candidates;
+
+	uint32_t					m_framesInFlight = 0;
+	uint64_t					m_frameNumber = 0;
+	VkDeviceSize				m_budget = 0;
+	TextureStreamStats			m_stats;
+
+	//Levels this size & below always stay resident
+	static const uint32_t		s_mipTailSize = 128;
+	//Staging handed to new residencies per update, so stream ins can't spike a frame
+	static const VkDeviceSize	s_maxUploadPerFrame = 16ull * 1024 * 1024;
+};
+
+#endif // !_TEXTURE_STREAMER_
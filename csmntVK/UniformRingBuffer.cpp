@@ -0,0 +1,55 @@
+#include "UniformRingBuffer.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include "vkHelpers.h"
+#include "Application.h"
+
+void UniformRingBuffer::create(csmntVkApplication* pApp, uint32_t regionCount, VkDeviceSize regionSize)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(pApp->getVkPhysicalDevice(), &deviceProperties);
+
+	//Every dynamic offset has to land on this alignment
+	m_alignment = std::max<VkDeviceSize>(1, deviceProperties.limits.minUniformBufferOffsetAlignment);
+	m_regionSize = (regionSize + m_alignment - 1) / m_alignment * m_alignment;
+	m_regionCount = regionCount;
+
+	VkDeviceSize bufferSize = m_regionSize * m_regionCount;
+
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), bufferSize,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_buffer, m_bufferMemory);
+
+	if (!m_bufferMemory.pMapped) {
+		throw std::runtime_error("uniform ring buffer memory is not host visible!");
+	}
+
+	beginRegion(0);
+}
+
+void UniformRingBuffer::cleanup(csmntVkApplication* pApp)
+{
+	vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), m_buffer, m_bufferMemory);
+}
+
+void UniformRingBuffer::beginRegion(uint32_t region)
+{
+	m_cursor = region * m_regionSize;
+	m_regionEnd = m_cursor + m_regionSize;
+}
+
+uint32_t UniformRingBuffer::push(const void* pData, VkDeviceSize size)
+{
+	if (m_cursor + size > m_regionEnd) {
+		throw std::runtime_error("uniform ring buffer region overflow!");
+	}
+
+	VkDeviceSize offset = m_cursor;
+	memcpy(static_cast<char*>(m_bufferMemory.pMapped) + offset, pData, static_cast<size_t>(size));
+
+	//Keep the next offset aligned for binding
+	m_cursor += (size + m_alignment - 1) / m_alignment * m_alignment;
+
+	return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef _UNIFORM_RING_BUFFER_
+#define _UNIFORM_RING_BUFFER_
+
+#include <vulkan/vulkan.h>
+#include "vkMemoryAllocator.h"
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---UniformRingBuffer:
+//---One persistently mapped, host coherent uniform buffer
+//---split into per-frame regions. Data is pushed linearly
+//---into the current region and bound with dynamic offsets,
+//---so there are no map/unmap calls per frame
+/////////////////////////////////////////////////////
+
+class UniformRingBuffer {
+public:
+	UniformRingBuffer() {};
+	~UniformRingBuffer() {};
+
+	void create(csmntVkApplication*, uint32_t regionCount, VkDeviceSize regionSize);
+	void cleanup(csmntVkApplication*);
+
+	//Rewind the write cursor to the start of a region -- only safe once
+	//the GPU has finished with the frame that last used it
+	void beginRegion(uint32_t region);
+
+	//Copy data into the current region, returns the dynamic offset to bind it with
+	uint32_t push(const void* pData, VkDeviceSize size);
+
+	template<typename T>
+	uint32_t push(const T& data) { return push(&data, sizeof(T)); };
+
+	const VkBuffer& getVkBuffer() const { return m_buffer; };
+	const VkDeviceSize getRegionSize() const { return m_regionSize; };
+	const uint32_t getRegionOffset(uint32_t region) const { return static_cast<uint32_t>(region * m_regionSize); };
+	const VkDeviceSize getAlignment() const { return m_alignment; };
+
+private:
+	VkBuffer				m_buffer = VK_NULL_HANDLE;
+	vkHelpers::Allocation	m_bufferMemory;
+
+	VkDeviceSize			m_alignment = 256;		//minUniformBufferOffsetAlignment
+	VkDeviceSize			m_regionSize = 0;
+	uint32_t				m_regionCount = 0;
+
+	VkDeviceSize			m_regionEnd = 0;
+	VkDeviceSize			m_cursor = 0;
+};
+
+#endif // !_UNIFORM_RING_BUFFER_
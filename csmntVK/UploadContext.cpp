@@ -0,0 +1,589 @@
+#include "UploadContext.h"
+#include "Application.h"
+#include "vkHelpers.h"
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+void UploadContext::create(csmntVkApplication* pApp)
+{
+	const QueueFamilyIndices& indices = pApp->getQueueFamilyIndices();
+	m_graphicsFamily = indices.graphicsFamily.value();
+	m_transferFamily = indices.transferFamily.value();
+	m_dedicatedTransfer = m_transferFamily != m_graphicsFamily;
+
+	//Command buffers get reset & reused once their batch retires
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+
+	if (vkCreateCommandPool(pApp->getVkDevice(), &poolInfo, nullptr, &m_transferPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	//Ownership acquires have to be recorded on the graphics family
+	if (m_dedicatedTransfer) {
+		poolInfo.queueFamilyIndex = m_graphicsFamily;
+
+		if (vkCreateCommandPool(pApp->getVkDevice(), &poolInfo, nullptr, &m_graphicsPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload acquire command pool!");
+		}
+	}
+
+#if _DEBUG
+	std::cout << "HEY! upload context on queue family " << m_transferFamily
+		<< (m_dedicatedTransfer ? " (dedicated transfer)" : " (shared with graphics)") << std::endl;
+#endif
+}
+
+void UploadContext::cleanup(csmntVkApplication* pApp)
+{
+	//Nothing may still be reading the staging memory
+	flush(pApp);
+
+	for (Batch& batch : m_freeBatches) {
+		destroyBatch(pApp, batch);
+	}
+	m_freeBatches.clear();
+
+	if (m_open.fence != VK_NULL_HANDLE) {
+		destroyBatch(pApp, m_open);
+	}
+
+	for (StagingChunk& chunk : m_freeChunks) {
+		destroyChunk(pApp, chunk);
+	}
+	m_freeChunks.clear();
+
+	vkDestroyCommandPool(pApp->getVkDevice(), m_transferPool, nullptr);
+	if (m_graphicsPool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(pApp->getVkDevice(), m_graphicsPool, nullptr);
+	}
+	m_transferPool = VK_NULL_HANDLE;
+	m_graphicsPool = VK_NULL_HANDLE;
+}
+
+#pragma region RECORDING
+void UploadContext::uploadBuffer(csmntVkApplication* pApp, VkBuffer dst, const void* pData, VkDeviceSize size, VkDeviceSize dstOffset,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	beginBatch(pApp);
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset = stage(pApp, pData, size, stagingBuffer);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = stagingOffset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(m_open.transferCmd, stagingBuffer, dst, 1, &copyRegion);
+
+	if (m_dedicatedTransfer) {
+		//Release on the transfer queue...
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.buffer = dst;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+
+		vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+
+		//...and acquire on graphics
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(m_open.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	m_open.dstStages |= dstStage;
+	m_open.dstAccess |= dstAccess;
+}
+
+void UploadContext::uploadImage(csmntVkApplication* pApp, VkImage dst, const void* pData, VkDeviceSize size, uint32_t width, uint32_t height)
+{
+	MipLevel level = {};
+	level.offset = 0;
+	level.width = width;
+	level.height = height;
+
+	uploadImage(pApp, dst, pData, size, std::vector<MipLevel>(1, level));
+}
+
+void UploadContext::uploadImage(csmntVkApplication* pApp, VkImage dst, const void* pData, VkDeviceSize size, const std::vector<MipLevel>& levels)
+{
+	beginBatch(pApp);
+	const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset = stage(pApp, pData, size, stagingBuffer);
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	//undefined -> transfer dst
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	//One region per level, all out of the same staging allocation
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		regions[i].bufferOffset = stagingOffset + levels[i].offset;
+		regions[i].bufferRowLength = 0;
+		regions[i].bufferImageHeight = 0;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.baseArrayLayer = 0;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageOffset = { 0, 0, 0 };
+		regions[i].imageExtent = { levels[i].width, levels[i].height, 1 };
+	}
+
+	vkCmdCopyBufferToImage(m_open.transferCmd, stagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
+	releaseImage(dst, 0, levelCount);
+}
+
+void UploadContext::uploadImageGenerateMips(csmntVkApplication* pApp, VkImage dst, const void* pData, VkDeviceSize size,
+	uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	beginBatch(pApp);
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset = stage(pApp, pData, size, stagingBuffer);
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	//undefined -> transfer dst, every level
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+
+	vkCmdCopyBufferToImage(m_open.transferCmd, stagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	//Blits need a graphics queue -- a dedicated transfer queue hands the image over first
+	VkCommandBuffer blitCmd = m_open.transferCmd;
+	if (m_dedicatedTransfer) {
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(m_open.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		blitCmd = m_open.acquireCmd;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		//the acquire waits on the transfer semaphore at this stage
+		m_open.dstStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+
+	//Each level is read from the one above, which then goes straight to shader read
+	barrier.subresourceRange.levelCount = 1;
+	int32_t mipWidth = static_cast<int32_t>(width);
+	int32_t mipHeight = static_cast<int32_t>(height);
+
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		mipWidth = std::max(1, mipWidth / 2);
+		mipHeight = std::max(1, mipHeight / 2);
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(blitCmd, dst, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	//Last level was only ever written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	m_open.dstStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	m_open.dstAccess |= VK_ACCESS_SHADER_READ_BIT;
+}
+
+void UploadContext::releaseImage(VkImage dst, uint32_t baseLevel, uint32_t levelCount)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = baseLevel;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	//transfer dst -> shader read, across queues if need be
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (m_dedicatedTransfer) {
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(m_open.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	else {
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	m_open.dstStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	m_open.dstAccess |= VK_ACCESS_SHADER_READ_BIT;
+}
+#pragma endregion
+
+#pragma region SUBMISSION
+uint64_t UploadContext::submit(csmntVkApplication* pApp)
+{
+	if (!m_open.recording) {
+		return 0;
+	}
+
+	//Same queue family -- one barrier makes every buffer copy visible to its consumers
+	if (!m_dedicatedTransfer) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = m_open.dstAccess;
+
+		vkCmdPipelineBarrier(m_open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, m_open.dstStages, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (vkEndCommandBuffer(m_open.transferCmd) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_open.transferCmd;
+
+	if (m_dedicatedTransfer) {
+		if (vkEndCommandBuffer(m_open.acquireCmd) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload acquire command buffer!");
+		}
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &m_open.transferDone;
+
+		if (vkQueueSubmit(pApp->getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+
+		//Graphics picks up ownership once the copies are done -- the fence covers both
+		VkSubmitInfo acquireInfo = {};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &m_open.transferDone;
+		acquireInfo.pWaitDstStageMask = &m_open.dstStages;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &m_open.acquireCmd;
+
+		if (vkQueueSubmit(pApp->getGraphicsQueue(), 1, &acquireInfo, m_open.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload acquire command buffer!");
+		}
+	}
+	else {
+		if (vkQueueSubmit(pApp->getTransferQueue(), 1, &submitInfo, m_open.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+	}
+
+	m_open.ticket = m_nextTicket++;
+	m_open.recording = false;
+
+	uint64_t ticket = m_open.ticket;
+	m_inFlight.push_back(m_open);
+	m_open = Batch();
+
+	return ticket;
+}
+
+bool UploadContext::isComplete(csmntVkApplication* pApp, uint64_t ticket)
+{
+	retireBatches(pApp);
+	return ticket <= m_completedTicket;
+}
+
+void UploadContext::wait(csmntVkApplication* pApp, uint64_t ticket)
+{
+	while (m_completedTicket < ticket && !m_inFlight.empty()) {
+		vkWaitForFences(pApp->getVkDevice(), 1, &m_inFlight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		retireBatches(pApp);
+	}
+}
+
+void UploadContext::retireBatches(csmntVkApplication* pApp)
+{
+	//Batches complete in submission order, so only ever look at the oldest
+	while (!m_inFlight.empty()) {
+		Batch& batch = m_inFlight.front();
+
+		if (vkGetFenceStatus(pApp->getVkDevice(), batch.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		m_completedTicket = batch.ticket;
+
+		//Standard chunks go back in the pool, oversized ones are let go
+		for (StagingChunk& chunk : batch.staging) {
+			if (chunk.size == s_stagingChunkSize) {
+				chunk.used = 0;
+				m_freeChunks.push_back(chunk);
+			}
+			else {
+				destroyChunk(pApp, chunk);
+			}
+		}
+		batch.staging.clear();
+
+		vkResetFences(pApp->getVkDevice(), 1, &batch.fence);
+		vkResetCommandBuffer(batch.transferCmd, 0);
+		if (batch.acquireCmd != VK_NULL_HANDLE) {
+			vkResetCommandBuffer(batch.acquireCmd, 0);
+		}
+
+		batch.dstStages = 0;
+		batch.dstAccess = 0;
+		m_freeBatches.push_back(batch);
+		m_inFlight.pop_front();
+	}
+}
+#pragma endregion
+
+#pragma region BATCHES
+void UploadContext::beginBatch(csmntVkApplication* pApp)
+{
+	if (m_open.recording) {
+		return;
+	}
+
+	//Reuse a retired batch where we can
+	retireBatches(pApp);
+	if (!m_freeBatches.empty()) {
+		m_open = m_freeBatches.back();
+		m_freeBatches.pop_back();
+	}
+	else {
+		m_open = createBatch(pApp);
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(m_open.transferCmd, &beginInfo);
+	if (m_dedicatedTransfer) {
+		vkBeginCommandBuffer(m_open.acquireCmd, &beginInfo);
+	}
+
+	m_open.recording = true;
+}
+
+UploadContext::Batch UploadContext::createBatch(csmntVkApplication* pApp)
+{
+	Batch batch;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = m_transferPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(pApp->getVkDevice(), &allocInfo, &batch.transferCmd) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(pApp->getVkDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload fence!");
+	}
+
+	if (m_dedicatedTransfer) {
+		allocInfo.commandPool = m_graphicsPool;
+
+		if (vkAllocateCommandBuffers(pApp->getVkDevice(), &allocInfo, &batch.acquireCmd) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload acquire command buffer!");
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateSemaphore(pApp->getVkDevice(), &semaphoreInfo, nullptr, &batch.transferDone) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore!");
+		}
+	}
+
+	return batch;
+}
+
+void UploadContext::destroyBatch(csmntVkApplication* pApp, Batch& batch)
+{
+	for (StagingChunk& chunk : batch.staging) {
+		destroyChunk(pApp, chunk);
+	}
+	batch.staging.clear();
+
+	vkFreeCommandBuffers(pApp->getVkDevice(), m_transferPool, 1, &batch.transferCmd);
+	if (batch.acquireCmd != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(pApp->getVkDevice(), m_graphicsPool, 1, &batch.acquireCmd);
+	}
+	if (batch.transferDone != VK_NULL_HANDLE) {
+		vkDestroySemaphore(pApp->getVkDevice(), batch.transferDone, nullptr);
+	}
+	vkDestroyFence(pApp->getVkDevice(), batch.fence, nullptr);
+
+	batch = Batch();
+}
+#pragma endregion
+
+#pragma region STAGING
+VkDeviceSize UploadContext::stage(csmntVkApplication* pApp, const void* pData, VkDeviceSize size, VkBuffer& buffer)
+{
+	//16 keeps buffer->image copies happy for every texel size we use
+	const VkDeviceSize alignment = 16;
+
+	StagingChunk* pChunk = m_open.staging.empty() ? nullptr : &m_open.staging.back();
+	VkDeviceSize offset = pChunk ? (pChunk->used + alignment - 1) & ~(alignment - 1) : 0;
+
+	if (!pChunk || offset + size > pChunk->size) {
+		if (size <= s_stagingChunkSize && !m_freeChunks.empty()) {
+			m_open.staging.push_back(m_freeChunks.back());
+			m_freeChunks.pop_back();
+		}
+		else {
+			//A copy -- std::max takes references & the in-class constant has no definition to bind one to
+			m_open.staging.push_back(createChunk(pApp, std::max(size, VkDeviceSize{ s_stagingChunkSize })));
+		}
+
+		pChunk = &m_open.staging.back();
+		offset = 0;
+	}
+
+	memcpy(static_cast<char*>(pChunk->memory.pMapped) + offset, pData, static_cast<size_t>(size));
+	pChunk->used = offset + size;
+
+	buffer = pChunk->buffer;
+	return offset;
+}
+
+UploadContext::StagingChunk UploadContext::createChunk(csmntVkApplication* pApp, VkDeviceSize size)
+{
+	StagingChunk chunk;
+	chunk.size = size;
+
+	//staging memory is persistently mapped by the allocator
+	vkHelpers::createVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, chunk.buffer, chunk.memory);
+
+	return chunk;
+}
+
+void UploadContext::destroyChunk(csmntVkApplication* pApp, StagingChunk& chunk)
+{
+	vkHelpers::destroyVkBuffer(pApp->getVkDevice(), pApp->getAllocator(), chunk.buffer, chunk.memory);
+}
+#pragma endregion
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef _UPLOAD_CONTEXT_
+#define _UPLOAD_CONTEXT_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include "vkMemoryAllocator.h"
+#include "MipChain.h"
+
+class csmntVkApplication;
+
+/////////////////////////////////////////////////////
+//---UploadContext:
+//---Batches staging copies & their barriers into one
+//---command buffer per submit. Runs on a dedicated transfer
+//---queue when the device has one (with queue ownership
+//---transfers back to graphics), and is fenced instead
+//---of draining the queue after every copy
+/////////////////////////////////////////////////////
+
+class UploadContext {
+public:
+	UploadContext() {};
+	~UploadContext() {};
+
+	void create(csmntVkApplication*);
+	void cleanup(csmntVkApplication*);
+
+	//Record uploads into the open batch -- data is staged straight away,
+	//the copies land on the device after submit()
+	void uploadBuffer(csmntVkApplication*, VkBuffer dst, const void* pData, VkDeviceSize size, VkDeviceSize dstOffset,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	//Whole image, mip 0 -- leaves it in SHADER_READ_ONLY_OPTIMAL
+	void uploadImage(csmntVkApplication*, VkImage dst, const void* pData, VkDeviceSize size, uint32_t width, uint32_t height);
+	//Prebuilt mip chain, one copy per level out of pData
+	void uploadImage(csmntVkApplication*, VkImage dst, const void* pData, VkDeviceSize size, const std::vector<MipLevel>& levels);
+	//Mip 0 only, the rest of the chain blitted down on the graphics queue -- the format
+	//has to support linear blits (see Texture::supportsLinearBlit)
+	void uploadImageGenerateMips(csmntVkApplication*, VkImage dst, const void* pData, VkDeviceSize size,
+		uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	//Submit the open batch, returns a ticket to poll/wait on (0 if there was nothing to submit)
+	uint64_t submit(csmntVkApplication*);
+	bool isComplete(csmntVkApplication*, uint64_t ticket);
+	void wait(csmntVkApplication*, uint64_t ticket);
+
+	//Submit and wait
+	void flush(csmntVkApplication* pApp) { wait(pApp, submit(pApp)); };
+
+	const bool hasDedicatedTransferQueue() const { return m_dedicatedTransfer; };
+
+private:
+	struct StagingChunk {
+		VkBuffer				buffer = VK_NULL_HANDLE;
+		vkHelpers::Allocation	memory;
+		VkDeviceSize			size = 0;
+		VkDeviceSize			used = 0;
+	};
+
+	struct Batch {
+		VkCommandBuffer			transferCmd = VK_NULL_HANDLE;
+		VkCommandBuffer			acquireCmd = VK_NULL_HANDLE;	//graphics side of ownership transfers
+		VkSemaphore				transferDone = VK_NULL_HANDLE;
+		VkFence					fence = VK_NULL_HANDLE;
+		std::vector<StagingChunk> staging;
+		VkPipelineStageFlags	dstStages = 0;
+		VkAccessFlags			dstAccess = 0;
+		uint64_t				ticket = 0;
+		bool					recording = false;
+	};
+
+	void beginBatch(csmntVkApplication*);
+	Batch createBatch(csmntVkApplication*);
+	void destroyBatch(csmntVkApplication*, Batch&);
+	void retireBatches(csmntVkApplication*);
+
+	//Transfer dst -> shader read for a range of levels, with the ownership transfer if need be
+	void releaseImage(VkImage, uint32_t baseLevel, uint32_t levelCount);
+
+	//Linear sub-allocation out of the open batch's staging chunks
+	VkDeviceSize stage(csmntVkApplication*, const void* pData, VkDeviceSize size, VkBuffer& buffer);
+	StagingChunk createChunk(csmntVkApplication*, VkDeviceSize);
+	void destroyChunk(csmntVkApplication*, StagingChunk&);
+
+	uint32_t				m_transferFamily = 0;
+	uint32_t				m_graphicsFamily = 0;
+	bool					m_dedicatedTransfer = false;
+
+	VkCommandPool			m_transferPool = VK_NULL_HANDLE;
+	VkCommandPool			m_graphicsPool = VK_NULL_HANDLE;
+
+	Batch					m_open;
+	std::deque<Batch>		m_inFlight;
+	std::vector<Batch>		m_freeBatches;
+	std::vector<StagingChunk> m_freeChunks;
+
+	uint64_t				m_nextTicket = 1;
+	uint64_t				m_completedTicket = 0;
+
+	//Staging is carved out of chunks this big, larger uploads get their own
+	static const VkDeviceSize s_stagingChunkSize = 8ull * 1024 * 1024;
+};
+
+#endif // !_UPLOAD_CONTEXT_
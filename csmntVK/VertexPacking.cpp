@@ -0,0 +1,237 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "../Libraries/glm/gtc/matrix_transform.hpp"
+#include "../Libraries/glm/gtc/packing.hpp"
+
+namespace vertexPacking {
+	namespace {
+		//Zero extents (flat meshes) would divide by zero -- any scale works, every value lands on 0
+		glm::vec3 getExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+		{
+			glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+			for (int i = 0; i < 3; i++) {
+				if (extent[i] <= 0.0f) {
+					extent[i] = 1.0f;
+				}
+			}
+			return extent;
+		}
+
+		int16_t packSnorm16(float value)
+		{
+			return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		int8_t packSnorm8(float value)
+		{
+			return static_cast<int8_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 127.0f));
+		}
+
+		//Vulkan's snorm decode, -32768 & -128 clamp to -1
+		float unpackSnorm(int value, float scale)
+		{
+			return std::max(value / scale, -1.0f);
+		}
+
+		//Something perpendicular to n, for tangents the uvs can't give us
+		glm::vec3 getPerpendicular(const glm::vec3& n)
+		{
+			const glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			return glm::normalize(glm::cross(n, axis));
+		}
+	}
+
+	const uint32_t getVertexStride(VertexFormat format)
+	{
+		return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	}
+
+	void getBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		boundsMin = glm::vec3(FLT_MAX);
+		boundsMax = glm::vec3(-FLT_MAX);
+		for (const Vertex& v : vertices) {
+			boundsMin = glm::min(boundsMin, v.pos);
+			boundsMax = glm::max(boundsMax, v.pos);
+		}
+		if (vertices.empty()) {
+			boundsMin = boundsMax = glm::vec3(0.0f);
+		}
+	}
+
+	glm::mat4 getDequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		const glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+		return glm::scale(glm::translate(glm::mat4(1.0f), centre), getExtent(boundsMin, boundsMax));
+	}
+
+	void generateNormals(const MeshData& mesh, std::vector<glm::vec3>& normals)
+	{
+		normals = mesh.normals;
+		normals.resize(mesh.vertices.size(), glm::vec3(0.0f));
+
+		//Only vertices the source left without one take part
+		std::vector<bool> missing(normals.size());
+		bool anyMissing = false;
+		for (size_t v = 0; v < normals.size(); v++) {
+			missing[v] = glm::dot(normals[v], normals[v]) == 0.0f;
+			anyMissing = anyMissing || missing[v];
+		}
+		if (!anyMissing) {
+			return;
+		}
+
+		//Unnormalized cross products weight each face by its area
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			const uint32_t tri[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+			const glm::vec3 faceNormal = glm::cross(mesh.vertices[tri[1]].pos - mesh.vertices[tri[0]].pos,
+				mesh.vertices[tri[2]].pos - mesh.vertices[tri[0]].pos);
+
+			for (uint32_t v : tri) {
+				if (missing[v]) {
+					normals[v] += faceNormal;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < normals.size(); v++) {
+			if (missing[v]) {
+				const float length = glm::length(normals[v]);
+				normals[v] = length > 0.0f ? normals[v] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+		}
+	}
+
+	void generateTangents(const MeshData& mesh, const std::vector<glm::vec3>& normals, std::vector<glm::vec4>& tangents)
+	{
+		tangents = mesh.tangents;
+		tangents.resize(mesh.vertices.size(), glm::vec4(0.0f));
+
+		std::vector<bool> missing(tangents.size());
+		bool anyMissing = false;
+		for (size_t v = 0; v < tangents.size(); v++) {
+			missing[v] = tangents[v].w == 0.0f;
+			anyMissing = anyMissing || missing[v];
+		}
+		if (!anyMissing) {
+			return;
+		}
+
+		//Per face directions of increasing u & v, summed per vertex
+		std::vector<glm::vec3> uDirections(tangents.size(), glm::vec3(0.0f));
+		std::vector<glm::vec3> vDirections(tangents.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			const uint32_t tri[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+			const glm::vec3 edge1 = mesh.vertices[tri[1]].pos - mesh.vertices[tri[0]].pos;
+			const glm::vec3 edge2 = mesh.vertices[tri[2]].pos - mesh.vertices[tri[0]].pos;
+			const glm::vec2 uv1 = mesh.vertices[tri[1]].texCoord - mesh.vertices[tri[0]].texCoord;
+			const glm::vec2 uv2 = mesh.vertices[tri[2]].texCoord - mesh.vertices[tri[0]].texCoord;
+
+			//Degenerate uvs say nothing about the direction
+			const float area = uv1.x * uv2.y - uv2.x * uv1.y;
+			if (std::abs(area) < 1e-12f) {
+				continue;
+			}
+			const glm::vec3 uDirection = (edge1 * uv2.y - edge2 * uv1.y) / area;
+			const glm::vec3 vDirection = (edge2 * uv1.x - edge1 * uv2.x) / area;
+
+			for (uint32_t v : tri) {
+				if (missing[v]) {
+					uDirections[v] += uDirection;
+					vDirections[v] += vDirection;
+				}
+			}
+		}
+
+		//Gram-Schmidt against the normal, handedness from which way v runs
+		for (size_t v = 0; v < tangents.size(); v++) {
+			if (!missing[v]) {
+				continue;
+			}
+			const glm::vec3& n = normals[v];
+			glm::vec3 t = uDirections[v] - n * glm::dot(n, uDirections[v]);
+			const float length = glm::length(t);
+			t = length > 1e-12f ? t / length : getPerpendicular(n);
+
+			tangents[v] = glm::vec4(t, glm::dot(glm::cross(n, t), vDirections[v]) < 0.0f ? -1.0f : 1.0f);
+		}
+	}
+
+	glm::vec2 encodeOctahedral(const glm::vec3& n)
+	{
+		//Onto the octahedron, then the lower half folds out over the corners
+		glm::vec2 e = glm::vec2(n.x, n.y) / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		if (n.z < 0.0f) {
+			e = glm::vec2((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+		}
+		return e;
+	}
+
+	glm::vec3 decodeOctahedral(const glm::vec2& e)
+	{
+		glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+		const float fold = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -fold : fold;
+		n.y += n.y >= 0.0f ? -fold : fold;
+		return glm::normalize(n);
+	}
+
+	void packVertices(const MeshData& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<PackedVertex>& packed)
+	{
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec4> tangents;
+		generateNormals(mesh, normals);
+		generateTangents(mesh, normals, tangents);
+
+		const glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+		const glm::vec3 invExtent = 1.0f / getExtent(boundsMin, boundsMax);
+
+		packed.resize(mesh.vertices.size());
+		for (size_t v = 0; v < mesh.vertices.size(); v++) {
+			const Vertex& vertex = mesh.vertices[v];
+			PackedVertex& out = packed[v];
+
+			const glm::vec3 position = (vertex.pos - centre) * invExtent;
+			for (int c = 0; c < 3; c++) {
+				out.pos[c] = packSnorm16(position[c]);
+			}
+			out.pos[3] = packSnorm16(tangents[v].w);
+
+			for (int c = 0; c < 3; c++) {
+				out.colour[c] = static_cast<uint8_t>(std::round(glm::clamp(vertex.colour[c], 0.0f, 1.0f) * 255.0f));
+			}
+			out.colour[3] = 255;
+
+			out.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+			out.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+
+			const glm::vec2 normal = encodeOctahedral(normals[v]);
+			const glm::vec2 tangent = encodeOctahedral(glm::vec3(tangents[v]));
+			out.normalTangent[0] = packSnorm8(normal.x);
+			out.normalTangent[1] = packSnorm8(normal.y);
+			out.normalTangent[2] = packSnorm8(tangent.x);
+			out.normalTangent[3] = packSnorm8(tangent.y);
+		}
+	}
+
+	Vertex unpackVertex(const PackedVertex& packed, const glm::mat4& dequantize, glm::vec3* pNormal, glm::vec4* pTangent)
+	{
+		Vertex vertex;
+		const glm::vec4 position(unpackSnorm(packed.pos[0], 32767.0f), unpackSnorm(packed.pos[1], 32767.0f), unpackSnorm(packed.pos[2], 32767.0f), 1.0f);
+		vertex.pos = glm::vec3(dequantize * position);
+		vertex.colour = glm::vec3(packed.colour[0], packed.colour[1], packed.colour[2]) / 255.0f;
+		vertex.texCoord = glm::vec2(glm::unpackHalf1x16(packed.texCoord[0]), glm::unpackHalf1x16(packed.texCoord[1]));
+
+		if (pNormal) {
+			*pNormal = decodeOctahedral(glm::vec2(unpackSnorm(packed.normalTangent[0], 127.0f), unpackSnorm(packed.normalTangent[1], 127.0f)));
+		}
+		if (pTangent) {
+			const glm::vec3 t = decodeOctahedral(glm::vec2(unpackSnorm(packed.normalTangent[2], 127.0f), unpackSnorm(packed.normalTangent[3], 127.0f)));
+			*pTangent = glm::vec4(t, unpackSnorm(packed.pos[3], 32767.0f) < 0.0f ? -1.0f : 1.0f);
+		}
+		return vertex;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _VERTEX_PACKING_
+#define _VERTEX_PACKING_
+
+#include <vector>
+#include <cstdint>
+#include "Model.h"
+
+/////////////////////////////////////////////////////
+//---vertexPacking:
+//---Full float vertices -> PackedVertex. Positions are
+//---quantized against the mesh's bounds & the bounds turned
+//---back into a transform the vertex shader's model matrix
+//---absorbs, so no shader decodes anything by hand
+/////////////////////////////////////////////////////
+
+namespace vertexPacking {
+	const uint32_t getVertexStride(VertexFormat format);
+
+	//Every vertex's position, zeroes for an empty mesh
+	void getBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	//Maps [-1, 1] back onto the bounds
+	glm::mat4 getDequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	//Area weighted face normals & uv aligned tangents, for the vertices the mesh doesn't have them for
+	void generateNormals(const MeshData& mesh, std::vector<glm::vec3>& normals);
+	void generateTangents(const MeshData& mesh, const std::vector<glm::vec3>& normals, std::vector<glm::vec4>& tangents);
+
+	//Unit vector <-> the [-1, 1] square
+	glm::vec2 encodeOctahedral(const glm::vec3& n);
+	glm::vec3 decodeOctahedral(const glm::vec2& e);
+
+	void packVertices(const MeshData& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<PackedVertex>& packed);
+
+	//What the vertex fetch & dequantize transform hand back -- for measuring the error
+	Vertex unpackVertex(const PackedVertex& packed, const glm::mat4& dequantize, glm::vec3* pNormal = nullptr, glm::vec4* pTangent = nullptr);
+}
+
+#endif // !_VERTEX_PACKING_
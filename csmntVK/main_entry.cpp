@@ -4,23 +4,925 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../Libraries/glm/vec4.hpp"
 #include "../Libraries/glm/mat4x4.hpp"
+#include "../Libraries/glm/gtc/matrix_transform.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
 
 #include "Application.h"
+#include "MeshImport.h"
+#include "CookedMesh.h"
+#include "VertexPacking.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "TextureCooker.h"
+#include "JobSystem.h"
+#include "OcclusionRasterizer.h"
 
-int main() {
-	//Create the application
-	csmntVkApplication application(800, 600);
+#include <stb_image.h>
 
-	//Run the application
+#pragma region MESH TOOLS
+//Creates & runs a configured application on the given mesh, for the tools that compare scenes
+typedef std::function<int(const std::string& meshPath, const ModelLoadOptions& options)> SceneRunner;
+
+static bool parseVertexFormat(const std::string& name, VertexFormat& format)
+{
+	if (name == "full") {
+		format = VertexFormat::Full;
+		return true;
+	}
+	if (name == "packed") {
+		format = VertexFormat::Packed;
+		return true;
+	}
+	return false;
+}
+
+//Text mesh -> .cmesh, no device needed
+static int cookMeshFile(const std::string& inPath, const std::string& outPath, VertexFormat format)
+{
+	try {
+		MeshData mesh;
+		meshImport::loadMesh(inPath, mesh);
+		MeshOptimizeStats stats = meshOptimizer::optimizeMesh(mesh);
+		meshletBuilder::buildMeshlets(mesh);
+		meshSimplifier::buildLodChain(mesh);
+		meshCooker::cookMesh(mesh, outPath, format);
+
+		std::cout << "cooked " << inPath << " -> " << outPath << " (" << mesh.vertices.size() << " verts, "
+			<< mesh.lods[0].indexCount / 3 << " tris, " << mesh.meshlets.size() << " meshlets, " << (format == VertexFormat::Packed ? "packed" : "full") << ", ACMR "
+			<< stats.before.acmr << " -> " << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << ")" << std::endl;
+		for (size_t i = 1; i < mesh.lods.size(); i++) {
+			std::cout << "  lod " << i << ": " << mesh.lods[i].indexCount / 3 << " tris, error " << mesh.lods[i].error << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+//Flat n x n quad grid, for when there's no big mesh to hand
+static void writeGridOBJ(const std::string& path, uint32_t n)
+{
+	std::ofstream file(path);
+	for (uint32_t y = 0; y <= n; y++) {
+		for (uint32_t x = 0; x <= n; x++) {
+			file << "v " << x / float(n) - 0.5f << " " << y / float(n) - 0.5f << " 0\n";
+			file << "vt " << x / float(n) << " " << y / float(n) << "\n";
+		}
+	}
+	for (uint32_t y = 0; y < n; y++) {
+		for (uint32_t x = 0; x < n; x++) {
+			uint32_t i = y * (n + 1) + x + 1;
+			file << "f " << i << "/" << i << " " << i + 1 << "/" << i + 1 << " "
+				<< i + n + 2 << "/" << i + n + 2 << " " << i + n + 1 << "/" << i + n + 1 << "\n";
+		}
+	}
+}
+
+//Text parse vs cooked map + copy out (what staging does), same mesh
+static int benchmarkMeshLoad(std::string inPath)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	try {
+		if (inPath.empty()) {
+			inPath = "mesh_bench_grid.obj";
+			std::cout << "writing " << inPath << " (2M tris)..." << std::endl;
+			writeGridOBJ(inPath, 1024);
+		}
+		const std::string cookedPath = inPath + ".cmesh";
+
+		auto start = Clock::now();
+		MeshData mesh;
+		meshImport::loadMesh(inPath, mesh);
+		double textMs = elapsedMs(start);
+
+		meshCooker::cookMesh(mesh, cookedPath, VertexFormat::Full);
+
+		start = Clock::now();
+		CookedMesh cooked;
+		cooked.open(cookedPath);
+		const CookedMeshHeader& header = cooked.getHeader();
+		std::vector<uint8_t> staging(header.vertexCount * header.vertexStride + header.indexCount * header.indexSize);
+		memcpy(staging.data(), cooked.getVertexData(), header.vertexCount * header.vertexStride);
+		memcpy(staging.data() + header.vertexCount * header.vertexStride, cooked.getIndexData(), header.indexCount * header.indexSize);
+		double cookedMs = elapsedMs(start);
+
+		std::cout << "mesh load: " << inPath << ", " << mesh.indices.size() / 3 << " tris" << std::endl;
+		std::cout << "  text   " << textMs << "ms" << std::endl;
+		std::cout << "  cooked " << cookedMs << "ms (" << textMs / std::max(cookedMs, 0.001) << "x)" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+//Footprint & quantization error of the packed layout, then the same headless scene drawn with each layout
+static int benchmarkVertexFormats(std::string meshPath, const SceneRunner& runScene)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	try {
+		if (meshPath.empty()) {
+			meshPath = "vertex_bench_grid.obj";
+			std::cout << "writing " << meshPath << " (512K tris)..." << std::endl;
+			writeGridOBJ(meshPath, 512);
+		}
+
+		MeshData mesh;
+		meshImport::loadMesh(meshPath, mesh);
+
+		glm::vec3 boundsMin, boundsMax;
+		vertexPacking::getBounds(mesh.vertices, boundsMin, boundsMax);
+		auto start = Clock::now();
+		std::vector<PackedVertex> packed;
+		vertexPacking::packVertices(mesh, boundsMin, boundsMax, packed);
+		const double packMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		//Against what the packer was given, normals included
+		std::vector<glm::vec3> normals;
+		vertexPacking::generateNormals(mesh, normals);
+		const glm::mat4 dequantize = vertexPacking::getDequantizeTransform(boundsMin, boundsMax);
+		float maxPositionError = 0.0f, maxTexCoordError = 0.0f, maxNormalDegrees = 0.0f;
+		for (size_t v = 0; v < packed.size(); v++) {
+			glm::vec3 normal;
+			const Vertex unpacked = vertexPacking::unpackVertex(packed[v], dequantize, &normal);
+			maxPositionError = std::max(maxPositionError, glm::length(unpacked.pos - mesh.vertices[v].pos));
+			maxTexCoordError = std::max(maxTexCoordError, glm::length(unpacked.texCoord - mesh.vertices[v].texCoord));
+			maxNormalDegrees = std::max(maxNormalDegrees, glm::degrees(std::acos(glm::clamp(glm::dot(normal, normals[v]), -1.0f, 1.0f))));
+		}
+
+		const float diagonal = std::max(glm::length(boundsMax - boundsMin), 1e-6f);
+		std::cout << "vertex formats: " << meshPath << ", " << mesh.vertices.size() << " verts" << std::endl;
+		std::cout << "  full   " << sizeof(Vertex) << "B/vertex, " << mesh.vertices.size() * sizeof(Vertex) / 1024 << "KB" << std::endl;
+		std::cout << "  packed " << sizeof(PackedVertex) << "B/vertex, " << packed.size() * sizeof(PackedVertex) / 1024 << "KB ("
+			<< 100.0 * sizeof(PackedVertex) / sizeof(Vertex) << "%), packed in " << packMs << "ms" << std::endl;
+		std::cout << "  max error: position " << maxPositionError / diagonal * 100.0f << "% of the bounds, uv " << maxTexCoordError
+			<< ", normal " << maxNormalDegrees << " degrees" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	//Each scene reports its own frame times
+	const VertexFormat formats[] = { VertexFormat::Full, VertexFormat::Packed };
+	for (VertexFormat format : formats) {
+		std::cout << (format == VertexFormat::Packed ? "packed" : "full") << " vertices:" << std::endl;
+		ModelLoadOptions options;
+		options.vertexFormat = format;
+		if (runScene(meshPath, options) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+//Cache stats before & after each optimizer pass, then the same headless scene drawn authored & optimized
+static int benchmarkMeshOptimization(std::string meshPath, const SceneRunner& runScene)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+	auto printStats = [](const char* name, const MeshData& mesh, double ms) {
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		VertexCacheStats stats16 = meshOptimizer::analyzeVertexCache(mesh.indices, vertexCount, 16);
+		VertexCacheStats stats32 = meshOptimizer::analyzeVertexCache(mesh.indices, vertexCount, 32);
+		std::cout << "  " << name << " ACMR " << stats16.acmr << " (" << stats32.acmr << " @32), ATVR " << stats16.atvr
+			<< " (" << stats32.atvr << " @32)";
+		if (ms > 0.0) {
+			std::cout << ", " << ms << "ms";
+		}
+		std::cout << std::endl;
+	};
+
+	try {
+		if (meshPath.empty()) {
+			meshPath = "mesh_opt_bench_grid.obj";
+			std::cout << "writing " << meshPath << " (512K tris)..." << std::endl;
+			writeGridOBJ(meshPath, 512);
+		}
+
+		MeshData mesh;
+		meshImport::loadMesh(meshPath, mesh);
+		std::cout << "mesh optimization: " << meshPath << ", " << mesh.vertices.size() << " verts, " << mesh.indices.size() / 3 << " tris" << std::endl;
+		printStats("authored      ", mesh, 0.0);
+
+		//One pass at a time, same calls optimizeMesh makes
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		std::vector<uint32_t> clusters;
+		auto start = Clock::now();
+		meshOptimizer::optimizeVertexCache(mesh.indices, vertexCount, clusters);
+		printStats("vertex cache  ", mesh, elapsedMs(start));
+
+		start = Clock::now();
+		meshOptimizer::optimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+		printStats("overdraw      ", mesh, elapsedMs(start));
+		std::cout << "                 " << clusters.size() << " clusters sorted" << std::endl;
+
+		start = Clock::now();
+		meshOptimizer::optimizeVertexFetch(mesh);
+		printStats("vertex fetch  ", mesh, elapsedMs(start));
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	//Each scene reports its own frame times
+	for (int optimize = 0; optimize < 2; optimize++) {
+		std::cout << (optimize ? "optimized:" : "authored:") << std::endl;
+		ModelLoadOptions options;
+		options.optimize = optimize != 0;
+		if (runScene(meshPath, options) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+//The LOD chain's sizes, errors & build time, then the same headless scene with & without LOD selection
+static int benchmarkLods(std::string meshPath, const SceneRunner& runScene)
+{
 	try {
-		application.run();
+		if (meshPath.empty()) {
+			meshPath = "lod_bench_grid.obj";
+			std::cout << "writing " << meshPath << " (512K tris)..." << std::endl;
+			writeGridOBJ(meshPath, 512);
+		}
+
+		MeshData mesh;
+		meshImport::loadMesh(meshPath, mesh);
+		meshOptimizer::optimizeMesh(mesh);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		meshSimplifier::buildLodChain(mesh);
+		const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::cout << "lod chain: " << meshPath << ", " << mesh.lods.size() << " lods in " << buildMs << "ms" << std::endl;
+		for (size_t i = 0; i < mesh.lods.size(); i++) {
+			std::cout << "  lod " << i << ": " << mesh.lods[i].indexCount / 3 << " tris, error " << mesh.lods[i].error << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	//Each scene reports its own frame times & triangle counts
+	for (int lods = 0; lods < 2; lods++) {
+		std::cout << (lods ? "lod selection:" : "full detail:") << std::endl;
+		ModelLoadOptions options;
+		options.generateLods = lods != 0;
+		if (runScene(meshPath, options) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+#pragma endregion
+
+#pragma region TEXTURE TOOLS
+//Image -> block compressed .ktx2, no device needed
+static int cookTextureFile(const std::string& inPath, const std::string& outPath, const std::vector<std::string>& options)
+{
+	const bool linear = std::find(options.begin(), options.end(), "linear") != options.end();
+	std::string formatName = "bc7";
+	VkFormat format;
+	EncodeQuality quality = EncodeQuality::Normal;
+	textureCooker::parseFormat(formatName, linear, format);
+
+	for (const std::string& option : options) {
+		if (textureCooker::parseFormat(option, linear, format)) {
+			formatName = option;
+		}
+		else if (!textureCooker::parseQuality(option, quality) && option != "linear") {
+			std::cerr << "unknown texture cook option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	try {
+		JobSystem jobs;
+		jobs.create();
+		TextureCookStats stats = textureCooker::cookTexture(inPath, outPath, format, quality, jobs);
+		jobs.shutdown();
+
+		std::cout << "cooked " << inPath << " -> " << outPath << " (" << formatName << (linear ? "" : " srgb") << ", "
+			<< stats.width << "x" << stats.height << ", " << stats.levelCount << " levels, " << stats.dataSize / 1024 << "KB, "
+			<< stats.blockCount / std::max(stats.encodeSeconds, 1e-6) << " blocks/s on " << jobs.getWorkerCount() << " workers)" << std::endl;
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
+	return EXIT_SUCCESS;
+}
+
+//Gradients, hard edges & noise -- something every encoder has to work at
+static std::vector<uint8_t> makeBenchmarkImage(uint32_t size)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+	uint32_t noise = 12345;
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			noise = noise * 1664525u + 1013904223u;
+			uint8_t* pPixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+			pPixel[0] = static_cast<uint8_t>(128.0f + 100.0f * std::sin(x * 0.05f) * std::cos(y * 0.03f));
+			pPixel[1] = static_cast<uint8_t>(y * 255 / size);
+			pPixel[2] = static_cast<uint8_t>((((x / 16) + (y / 16)) & 1) * 200 + (noise >> 27));
+			pPixel[3] = static_cast<uint8_t>(x < size / 2 ? 255 : x * 255 / size);
+		}
+	}
+	return pixels;
+}
+
+//Encode throughput per format, on one worker & on all of them
+static int benchmarkTextureEncode(const std::string& qualityName, const std::string& inPath)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	EncodeQuality quality = EncodeQuality::Normal;
+	if (!qualityName.empty() && !textureCooker::parseQuality(qualityName, quality)) {
+		std::cerr << "unknown quality " << qualityName << ", want fast|normal|best" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	uint32_t width = 1024, height = 1024;
+	std::vector<uint8_t> pixels;
+	if (inPath.empty()) {
+		pixels = makeBenchmarkImage(width);
+	}
+	else {
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pLoaded = stbi_load(inPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pLoaded) {
+			std::cerr << "failed to load texture image " << inPath << std::endl;
+			return EXIT_FAILURE;
+		}
+		width = static_cast<uint32_t>(texWidth);
+		height = static_cast<uint32_t>(texHeight);
+		pixels.assign(pLoaded, pLoaded + static_cast<size_t>(width) * height * 4);
+		stbi_image_free(pLoaded);
+	}
+
+	JobSystem jobs;
+	jobs.create();
+	const uint64_t blockCount = static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+
+	std::cout << "texture encode: " << width << "x" << height << " (" << blockCount << " blocks), "
+		<< (qualityName.empty() ? "normal" : qualityName) << std::endl;
+
+	const char* formatNames[] = { "bc1", "bc3", "bc7" };
+	for (const char* formatName : formatNames) {
+		VkFormat format;
+		textureCooker::parseFormat(formatName, true, format);
+		std::vector<uint8_t> blocks(static_cast<size_t>(blockCompression::getImageSize(format, width, height)));
+
+		std::vector<uint32_t> workerCounts = { 1 };
+		if (jobs.getWorkerCount() > 1) {
+			workerCounts.push_back(jobs.getWorkerCount());
+		}
+
+		for (uint32_t workers : workerCounts) {
+			jobs.setActiveWorkerCount(workers);
+			auto start = Clock::now();
+			blockCompression::encodeImage(format, pixels.data(), width, height, quality, blocks.data(), &jobs);
+			const double seconds = std::max(std::chrono::duration<double>(Clock::now() - start).count(), 1e-6);
+
+			std::cout << "  " << formatName << " " << workers << " worker(s): " << static_cast<uint64_t>(blockCount / seconds)
+				<< " blocks/s, " << static_cast<uint64_t>(blockCount / seconds / workers) << " blocks/s/core" << std::endl;
+		}
+
+		//Quality of what was just encoded, RGB only
+		std::vector<uint8_t> decoded(pixels.size());
+		blockCompression::decodeImage(format, blocks.data(), width, height, decoded.data());
+		double squaredError = 0.0;
+		for (size_t i = 0; i < pixels.size(); i++) {
+			if ((i & 3) != 3) {
+				const double diff = static_cast<double>(pixels[i]) - decoded[i];
+				squaredError += diff * diff;
+			}
+		}
+		const double mse = squaredError / (static_cast<double>(width) * height * 3);
+		std::cout << "  " << formatName << " rgb psnr " << (mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0) << "dB" << std::endl;
+	}
+
+	jobs.shutdown();
+	return EXIT_SUCCESS;
+}
+#pragma endregion
+
+#pragma region OCCLUSION TOOLS
+//Unit cube, corners at +-0.5 -- every occluder & tested box in the benchmark scene is one scaled
+static void makeOcclusionBox(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		positions.push_back(glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f));
+	}
+	const uint32_t faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+	for (const uint32_t* pFace : faces) {
+		const uint32_t quad[6] = { pFace[0], pFace[1], pFace[2], pFace[0], pFace[2], pFace[3] };
+		indices.insert(indices.end(), quad, quad + 6);
+	}
+}
+
+//Per pixel reference -- nearest occluder at each pixel centre, edges taken a hair wide so the
+//rasterizer's rounding never has it covering something the reference doesn't
+static std::vector<double> rasterizeOcclusionReference(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+	const std::vector<glm::mat4>& transforms, uint32_t width, uint32_t height)
+{
+	std::vector<double> depths(static_cast<size_t>(width) * height, 1.0);
+	for (const glm::mat4& transform : transforms) {
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			double x[3], y[3], z[3];
+			for (uint32_t v = 0; v < 3; v++) {
+				glm::dvec4 clip = glm::dmat4(transform) * glm::dvec4(glm::dvec3(positions[indices[i + v]]), 1.0);
+				x[v] = (clip.x / clip.w * 0.5 + 0.5) * width;
+				y[v] = (clip.y / clip.w * 0.5 + 0.5) * height;
+				z[v] = clip.z / clip.w;
+			}
+
+			const double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (area == 0.0) {
+				continue;
+			}
+
+			const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(std::min({ x[0], x[1], x[2] }))) - 1);
+			const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(std::min({ y[0], y[1], y[2] }))) - 1);
+			const int32_t x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(std::max({ x[0], x[1], x[2] }))) + 1);
+			const int32_t y1 = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(std::max({ y[0], y[1], y[2] }))) + 1);
+			for (int32_t py = y0; py <= y1; py++) {
+				for (int32_t px = x0; px <= x1; px++) {
+					const double cx = px + 0.5, cy = py + 0.5;
+					double barycentric[3];
+					bool inside = true;
+					for (uint32_t e = 0; e < 3 && inside; e++) {
+						const uint32_t a = (e + 1) % 3, b = (e + 2) % 3;
+						const double edge = ((x[b] - x[a]) * (cy - y[a]) - (y[b] - y[a]) * (cx - x[a])) / area;
+						const double length = std::sqrt((x[b] - x[a]) * (x[b] - x[a]) + (y[b] - y[a]) * (y[b] - y[a]));
+						inside = edge * std::abs(area) > -0.01 * length;
+						barycentric[e] = edge;
+					}
+					if (inside) {
+						double& depth = depths[static_cast<size_t>(py) * width + px];
+						depth = std::min(depth, barycentric[0] * z[0] + barycentric[1] * z[1] + barycentric[2] * z[2]);
+					}
+				}
+			}
+		}
+	}
+	return depths;
+}
+
+//Self check against the per pixel reference, then occluders rasterized & boxes tested per ms,
+//per instruction set & on one worker vs all of them
+static int benchmarkOcclusion(uint32_t occluderCount, uint32_t testCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const uint32_t width = 512, height = 256;
+
+	//Walls & pillars ahead of the camera, with small boxes scattered through & behind them.
+	//0..1 depth by name -- plain perspective() follows GLM_FORCE_DEPTH_ZERO_TO_ONE, which Graphics.cpp doesn't set
+	glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(60.0f), width / static_cast<float>(height), 0.1f, 100.0f);
+	proj[1][1] *= -1;
+	const glm::mat4 viewProj = proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	uint32_t seed = 12345;
+	auto random = [&seed](float low, float high) {
+		seed = seed * 1664525u + 1013904223u;
+		return low + (high - low) * ((seed >> 8) / 16777216.0f);
+	};
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	makeOcclusionBox(positions, indices);
+
+	std::vector<glm::mat4> occluders(occluderCount);
+	for (glm::mat4& occluder : occluders) {
+		const bool wall = random(0.0f, 1.0f) < 0.5f;
+		const glm::vec3 size = wall ? glm::vec3(random(1.0f, 4.0f), random(0.5f, 2.0f), 0.2f) : glm::vec3(0.4f, random(1.0f, 3.0f), 0.4f);
+		occluder = viewProj * glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(random(-6.0f, 6.0f), random(-2.0f, 2.0f), random(-14.0f, -4.0f))), size);
+	}
+
+	std::vector<glm::mat4> tests(testCount);
+	for (glm::mat4& test : tests) {
+		const float size = random(0.1f, 0.6f);
+		test = viewProj * glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(random(-10.0f, 10.0f), random(-3.0f, 3.0f), random(-30.0f, -3.0f))), glm::vec3(size));
+	}
+	const glm::vec3 boxMin(-0.5f), boxMax(0.5f);
+
+	JobSystem jobs;
+	jobs.create();
+	OcclusionRasterizer rasterizer;
+	rasterizer.create(width, height);
+
+	auto rasterizeScene = [&](JobSystem* pJobs) {
+		rasterizer.clear();
+		for (const glm::mat4& occluder : occluders) {
+			rasterizer.addOccluder(positions.data(), indices.data(), static_cast<uint32_t>(indices.size()), occluder);
+		}
+		rasterizer.rasterize(pJobs);
+	};
+
+	std::cout << "occlusion: " << width << "x" << height << ", " << occluderCount << " occluders, " << testCount << " tests, "
+		<< OcclusionRasterizer::getSimdName(OcclusionRasterizer::getBestSimd()) << " build" << std::endl;
 
+	std::vector<OcclusionSimd> simds = { OcclusionSimd::Scalar };
+	for (uint32_t simd = 1; simd <= static_cast<uint32_t>(OcclusionRasterizer::getBestSimd()); simd++) {
+		simds.push_back(static_cast<OcclusionSimd>(simd));
+	}
+	std::vector<uint32_t> workerCounts = { 1 };
+	if (jobs.getWorkerCount() > 1) {
+		workerCounts.push_back(jobs.getWorkerCount());
+	}
+
+	//Checks -- every instruction set & worker count makes the same buffer, that buffer never has an
+	//occluder nearer than the reference does, & no box the reference sees is culled
+	const std::vector<double> reference = rasterizeOcclusionReference(positions, indices, occluders, width, height);
+	std::vector<float> baseline;
+	bool passed = true;
+	for (OcclusionSimd simd : simds) {
+		for (uint32_t workers : workerCounts) {
+			rasterizer.setSimd(simd);
+			jobs.setActiveWorkerCount(workers);
+			rasterizeScene(&jobs);
+
+			std::vector<float> depths(static_cast<size_t>(width) * height);
+			for (uint32_t y = 0; y < height; y++) {
+				for (uint32_t x = 0; x < width; x++) {
+					depths[static_cast<size_t>(y) * width + x] = rasterizer.getPixelDepth(x, y);
+				}
+			}
+			if (baseline.empty()) {
+				baseline = depths;
+			}
+			else if (depths != baseline) {
+				std::cerr << "  " << OcclusionRasterizer::getSimdName(simd) << " on " << workers << " worker(s) doesn't match scalar on 1" << std::endl;
+				passed = false;
+			}
+		}
+	}
+
+	uint64_t nearerPixels = 0, tightPixels = 0, occludedPixels = 0;
+	for (size_t p = 0; p < baseline.size(); p++) {
+		nearerPixels += baseline[p] < reference[p] - 1e-5 ? 1 : 0;
+		occludedPixels += reference[p] < 1.0 ? 1 : 0;
+		tightPixels += reference[p] < 1.0 && baseline[p] < 1.0f ? 1 : 0;
+	}
+
+	//Same rect as the rasterizer's, but against the reference -- pixels touched, nearest corner depth
+	uint32_t culled = 0, referenceCulled = 0, falseCulls = 0;
+	for (const glm::mat4& test : tests) {
+		double minX = 1e30, minY = 1e30, maxX = -1e30, maxY = -1e30, nearest = 1e30;
+		for (uint32_t i = 0; i < 8; i++) {
+			glm::dvec4 clip = glm::dmat4(test) * glm::dvec4((i & 1) ? 0.5 : -0.5, (i & 2) ? 0.5 : -0.5, (i & 4) ? 0.5 : -0.5, 1.0);
+			minX = std::min(minX, (clip.x / clip.w * 0.5 + 0.5) * width);
+			maxX = std::max(maxX, (clip.x / clip.w * 0.5 + 0.5) * width);
+			minY = std::min(minY, (clip.y / clip.w * 0.5 + 0.5) * height);
+			maxY = std::max(maxY, (clip.y / clip.w * 0.5 + 0.5) * height);
+			nearest = std::min(nearest, clip.z / clip.w);
+		}
+
+		bool referenceVisible = false;
+		for (int32_t y = std::max(0, static_cast<int32_t>(std::floor(minY))); y < std::min(static_cast<int32_t>(height), static_cast<int32_t>(std::ceil(maxY))) && !referenceVisible; y++) {
+			for (int32_t x = std::max(0, static_cast<int32_t>(std::floor(minX))); x < std::min(static_cast<int32_t>(width), static_cast<int32_t>(std::ceil(maxX))); x++) {
+				if (nearest <= reference[static_cast<size_t>(y) * width + x] + 1e-5) {
+					referenceVisible = true;
+					break;
+				}
+			}
+		}
+
+		const bool visible = rasterizer.isBoxVisible(boxMin, boxMax, test);
+		culled += visible ? 0 : 1;
+		referenceCulled += referenceVisible ? 0 : 1;
+		falseCulls += (referenceVisible && !visible) ? 1 : 0;
+	}
+
+	std::cout << "  check: " << rasterizer.getTriangleCount() << " tris after clipping, " << nearerPixels << " pixels nearer than the reference, "
+		<< tightPixels << " of " << occludedPixels << " occluded pixels below the far plane, " << culled << " culled vs " << referenceCulled
+		<< " by the reference, " << falseCulls << " culled while visible" << std::endl;
+	if (nearerPixels > 0 || falseCulls > 0) {
+		passed = false;
+	}
+
+	//Throughput -- whole frames of occluders, then every box against the result on one thread
+	const uint32_t rounds = std::max(1u, 200000u / std::max(1u, occluderCount * 12));
+	for (OcclusionSimd simd : simds) {
+		rasterizer.setSimd(simd);
+		for (uint32_t workers : workerCounts) {
+			jobs.setActiveWorkerCount(workers);
+			auto start = Clock::now();
+			for (uint32_t r = 0; r < rounds; r++) {
+				rasterizeScene(&jobs);
+			}
+			const double ms = std::max(std::chrono::duration<double, std::milli>(Clock::now() - start).count(), 1e-6) / rounds;
+
+			std::cout << "  " << OcclusionRasterizer::getSimdName(simd) << " " << workers << " worker(s): " << occluderCount / ms << " occluders/ms, "
+				<< rasterizer.getTriangleCount() / ms << " tris/ms (" << ms << "ms/frame)" << std::endl;
+		}
+
+		uint32_t visibleCount = 0;
+		auto start = Clock::now();
+		for (const glm::mat4& test : tests) {
+			visibleCount += rasterizer.isBoxVisible(boxMin, boxMax, test) ? 1 : 0;
+		}
+		const double ms = std::max(std::chrono::duration<double, std::milli>(Clock::now() - start).count(), 1e-6);
+		std::cout << "  " << OcclusionRasterizer::getSimdName(simd) << " tests: " << testCount / ms << " tests/ms, " << testCount - visibleCount << " culled" << std::endl;
+	}
+
+	jobs.shutdown();
+	if (!passed) {
+		std::cerr << "occlusion rasterizer doesn't match the reference!" << std::endl;
+		return EXIT_FAILURE;
+	}
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#pragma endregion
+
+//Usage: csmntVK [--headless [frameCount] [out.ppm]] [--frames-in-flight n] [--draws n] [--workers n] [--record-bench] [--mesh file] [--vertex-format full|packed] [--no-mesh-opt] [--no-lod] [--no-cluster-cull] [--no-occlusion-cull] [--depth-prepass] [--cpu-occlusion-cull] [--texture file]... [--texture-budget MB] [--async-assets] [--bindless] [--instanced] [--gpu-driven]
+//       csmntVK --alloc-test [frames] [--headless warmUpFrames] [--draws n] [--instanced] [--gpu-driven]...
+//         (at least 100 frames warm up; without --headless the frames are windowed & the window closes after -- don't resize it)
+//       csmntVK --bindless-test [--headless frameCount] [--frames-in-flight n] [--texture file]...
+//       csmntVK --cull-test [--draws n (100000)] [--mesh file] [--no-cluster-cull] [--no-occlusion-cull] [--depth-prepass]
+//       csmntVK --mip-bench [size]
+//       csmntVK --cook in.obj|in.gltf|in.glb out.cmesh [full|packed]
+//       csmntVK --mesh-bench [in.obj|in.gltf|in.glb]
+//       csmntVK --vertex-bench [frameCount] [--mesh in.obj|in.gltf|in.glb] [--draws n] [--instanced]
+//       csmntVK --mesh-opt-bench [frameCount] [--mesh in.obj|in.gltf|in.glb] [--draws n] [--instanced]
+//       csmntVK --lod-bench [frameCount] [--mesh in.obj|in.gltf|in.glb] [--draws n] [--instanced]
+//       csmntVK --cook-texture in.png|in.jpg out.ktx2 [bc1|bc3|bc7] [fast|normal|best] [linear]
+//       csmntVK --texture-bench [fast|normal|best] [in.png|in.jpg]
+//       csmntVK --occlusion-bench [occluders] [tests]
+int main(int argc, char** argv) {
+	bool headless = false;
+	uint32_t headlessFrames = 1;
+	std::string outPath;
+	uint32_t drawCount = 1;
+	bool drawCountGiven = false;
+	uint32_t framesInFlight = 2;
+	uint32_t allocationTestFrames = 0;
+	uint32_t workerCount = 0;
+	bool recordBenchmark = false;
+	std::string meshPath;
+	std::vector<std::string> texturePaths;
+	uint32_t textureBudgetMb = 0;
+	bool bindless = false;
+	bool instanced = false;
+	bool gpuDriven = false;
+	bool asyncAssets = false;
+	bool cullTest = false;
+	bool bindlessTest = false;
+	uint32_t mipBenchmarkSize = 0;
+	VertexFormat vertexFormat = VertexFormat::Full;
+	bool vertexBenchmark = false;
+	bool meshOptimization = true;
+	bool meshOptBenchmark = false;
+	bool lodSelection = true;
+	bool clusterCulling = true;
+	bool occlusionCulling = true;
+	bool depthPrepass = false;
+	bool cpuOcclusionCulling = false;
+	bool lodBenchmark = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		//Offline tools, these don't bring up the device
+		if (arg == "--cook") {
+			if (i + 2 >= argc) {
+				std::cerr << "usage: csmntVK --cook <in.obj|in.gltf|in.glb> <out.cmesh> [full|packed]" << std::endl;
+				return EXIT_FAILURE;
+			}
+			VertexFormat format = VertexFormat::Full;
+			if (i + 3 < argc && !parseVertexFormat(argv[i + 3], format)) {
+				std::cerr << "unknown vertex format " << argv[i + 3] << ", want full|packed" << std::endl;
+				return EXIT_FAILURE;
+			}
+			return cookMeshFile(argv[i + 1], argv[i + 2], format);
+		}
+		if (arg == "--mesh-bench") {
+			return benchmarkMeshLoad(i + 1 < argc ? argv[i + 1] : "");
+		}
+		if (arg == "--cook-texture") {
+			if (i + 2 >= argc) {
+				std::cerr << "usage: csmntVK --cook-texture <in.png|in.jpg> <out.ktx2> [bc1|bc3|bc7] [fast|normal|best] [linear]" << std::endl;
+				return EXIT_FAILURE;
+			}
+			return cookTextureFile(argv[i + 1], argv[i + 2], std::vector<std::string>(argv + i + 3, argv + argc));
+		}
+		if (arg == "--texture-bench") {
+			return benchmarkTextureEncode(i + 1 < argc ? argv[i + 1] : "", i + 2 < argc ? argv[i + 2] : "");
+		}
+		if (arg == "--occlusion-bench") {
+			const uint32_t occluders = i + 1 < argc ? static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10)) : 64;
+			const uint32_t tests = i + 2 < argc ? static_cast<uint32_t>(std::strtoul(argv[i + 2], nullptr, 10)) : 10000;
+			return benchmarkOcclusion(std::max(1u, occluders), std::max(1u, tests));
+		}
+
+		if (arg == "--mesh" && i + 1 < argc) {
+			meshPath = argv[++i];
+		}
+		else if (arg == "--vertex-format" && i + 1 < argc) {
+			if (!parseVertexFormat(argv[++i], vertexFormat)) {
+				std::cerr << "unknown vertex format " << argv[i] << ", want full|packed" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (arg == "--no-mesh-opt") {
+			meshOptimization = false;
+		}
+		else if (arg == "--no-lod") {
+			lodSelection = false;
+		}
+		else if (arg == "--no-cluster-cull") {
+			clusterCulling = false;
+		}
+		else if (arg == "--no-occlusion-cull") {
+			occlusionCulling = false;
+		}
+		else if (arg == "--depth-prepass") {
+			depthPrepass = true;
+		}
+		else if (arg == "--cpu-occlusion-cull") {
+			cpuOcclusionCulling = true;
+		}
+		//CPU side numbers, then the same headless frames per vertex format / authored & optimized / with & without LODs
+		else if (arg == "--vertex-bench" || arg == "--mesh-opt-bench" || arg == "--lod-bench") {
+			vertexBenchmark = arg == "--vertex-bench";
+			meshOptBenchmark = arg == "--mesh-opt-bench";
+			lodBenchmark = arg == "--lod-bench";
+			headless = true;
+			headlessFrames = 500;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				headlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+		}
+		else if (arg == "--texture" && i + 1 < argc) {
+			texturePaths.push_back(argv[++i]);
+		}
+		else if (arg == "--texture-budget" && i + 1 < argc) {
+			textureBudgetMb = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--draws" && i + 1 < argc) {
+			drawCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			drawCountGiven = true;
+		}
+		//How far the CPU may run ahead of the GPU -- 1 waits out every frame
+		else if (arg == "--frames-in-flight" && i + 1 < argc) {
+			framesInFlight = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (arg == "--workers" && i + 1 < argc) {
+			workerCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		//Draw placeholders until the mesh & textures finish decoding
+		else if (arg == "--async-assets") {
+			asyncAssets = true;
+		}
+		else if (arg == "--bindless") {
+			bindless = true;
+		}
+		else if (arg == "--instanced") {
+			instanced = true;
+		}
+		else if (arg == "--gpu-driven") {
+			gpuDriven = true;
+		}
+		//Headless GPU driven frames, then the culling checked against the CPU
+		else if (arg == "--cull-test") {
+			gpuDriven = true;
+			cullTest = true;
+			headless = true;
+		}
+		//Headless bindless frames, then slot recycling checked against the frames in flight
+		else if (arg == "--bindless-test") {
+			bindless = true;
+			bindlessTest = true;
+			headless = true;
+		}
+		//Frames to warm up, then more with every heap allocation counted -- fails if there are any.
+		//Windowed unless --headless, so drawFrame & the present path get counted too
+		else if (arg == "--alloc-test") {
+			allocationTestFrames = 100;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				allocationTestFrames = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+			}
+		}
+		//CPU filter vs blits, 4K unless told otherwise
+		else if (arg == "--mip-bench") {
+			mipBenchmarkSize = 4096;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				mipBenchmarkSize = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+			headless = true;
+		}
+		else if (arg == "--record-bench") {
+			recordBenchmark = true;
+		}
+		else if (arg == "--headless") {
+			headless = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				headlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				outPath = argv[++i];
+			}
+		}
+	}
+
+	//A single draw sits in the middle of the view & can't be culled -- test against a grid spread past the frustum
+	if (cullTest && !drawCountGiven) {
+		drawCount = 100000;
+	}
+
+	//Create & run the application -- once, or once per configuration when benchmarking
+	SceneRunner runApplication = [&](const std::string& modelPath, const ModelLoadOptions& options) {
+		csmntVkApplication application(800, 600, framesInFlight, headless);
+		application.setDrawCount(drawCount);
+		application.setRecordWorkerCount(workerCount);
+		application.setModelPath(modelPath);
+		application.setVertexFormat(options.vertexFormat);
+		application.setMeshOptimization(options.optimize);
+		application.setLodSelection(options.generateLods);
+		application.setTexturePaths(texturePaths);
+		application.setTextureBudget(static_cast<VkDeviceSize>(textureBudgetMb) * 1024 * 1024);
+		application.setBindless(bindless);
+		application.setInstanced(instanced);
+		application.setGpuDriven(gpuDriven);
+		application.setClusterCulling(clusterCulling);
+		application.setOcclusionCulling(occlusionCulling);
+		application.setDepthPrepass(depthPrepass);
+		application.setCpuOcclusionCulling(cpuOcclusionCulling);
+		application.setAsyncAssets(asyncAssets);
+		application.setCullTest(cullTest);
+		application.setBindlessTest(bindlessTest);
+		application.setAllocationTest(allocationTestFrames);
+
+		if (headless) {
+			application.setHeadlessFrameCount(headlessFrames);
+			application.setRecordBenchmark(recordBenchmark);
+			application.setMipBenchmark(mipBenchmarkSize);
+
+			//Dump the last frame as a binary PPM so CI can diff it
+			if (!outPath.empty()) {
+				application.setFrameReadbackCallback([&](const uint8_t* pPixels, uint32_t width, uint32_t height, uint64_t frameNumber) {
+					if (frameNumber + 1 != headlessFrames) {
+						return;
+					}
+
+					std::ofstream file(outPath, std::ios::binary);
+					file << "P6\n" << width << " " << height << "\n255\n";
+					for (uint32_t p = 0; p < width * height; p++) {
+						file.write(reinterpret_cast<const char*>(pPixels + p * 4), 3);
+					}
+				});
+			}
+		}
+
+		//Run the application
+		try {
+			application.run();
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	};
+
+	if (vertexBenchmark) {
+		return benchmarkVertexFormats(meshPath, runApplication);
+	}
+	if (meshOptBenchmark) {
+		return benchmarkMeshOptimization(meshPath, runApplication);
+	}
+	if (lodBenchmark) {
+		return benchmarkLods(meshPath, runApplication);
+	}
+
+	ModelLoadOptions options;
+	options.vertexFormat = vertexFormat;
+	options.optimize = meshOptimization;
+	options.generateLods = lodSelection;
+	return runApplication(meshPath, options);
+}
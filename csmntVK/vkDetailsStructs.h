@@ -17,6 +17,7 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily;	//dedicated transfer family if there is one, else graphics
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -40,11 +41,18 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 			indices.graphicsFamily = i;
 		}
 
-		//Window surface support
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-		if (queueFamily.queueCount > 0 && presentSupport) {
-			indices.presentFamily = i;
+		//Window surface support -- headless has no surface, so "present" is just the graphics queue
+		if (surface == VK_NULL_HANDLE) {
+			if (indices.graphicsFamily.has_value()) {
+				indices.presentFamily = indices.graphicsFamily;
+			}
+		}
+		else {
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+			if (queueFamily.queueCount > 0 && presentSupport) {
+				indices.presentFamily = i;
+			}
 		}
 
 		if (indices.isComplete()) {
@@ -54,6 +62,20 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 		i++;
 	}
 
+	//Prefer a transfer-only family (DMA engine) for uploads so they don't queue behind rendering
+	for (uint32_t f = 0; f < queueFamilyCount; f++) {
+		const VkQueueFamilyProperties& family = queueFamilies[f];
+		if (family.queueCount > 0 && (family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indices.transferFamily = f;
+			break;
+		}
+	}
+
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 };
 //-----------------------------
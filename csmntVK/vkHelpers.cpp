@@ -25,7 +25,7 @@ namespace vkHelpers {
 
 #pragma region BUFFER HELPERS
 	//Buffer Helpers
-	void createVkBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkDeviceSize& size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	void createVkBuffer(VkDevice& device, DeviceMemoryAllocator& allocator, VkDeviceSize& size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferMemory)
 	{
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -37,22 +37,15 @@ namespace vkHelpers {
 			throw std::runtime_error("failed to create vertex buffer!");
 		}
 
-		//Allocate memory
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice,
-			memRequirements.memoryTypeBits,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
+		//Sub-allocate from the shared memory blocks & bind
+		allocator.allocateForBuffer(buffer, properties, bufferMemory);
+	}
 
-		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+	void destroyVkBuffer(VkDevice& device, DeviceMemoryAllocator& allocator, VkBuffer& buffer, Allocation& bufferMemory)
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator.free(bufferMemory);
+		buffer = VK_NULL_HANDLE;
 	}
 
 	void copyVkBuffer(csmntVkApplication* pApp, VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize& size, VkCommandPool& cmdPool)
@@ -98,23 +91,31 @@ namespace vkHelpers {
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(queue);
+		//Wait on just this submit rather than draining the whole queue
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		vkCreateFence(device, &fenceInfo, nullptr, &fence);
 
+		vkQueueSubmit(queue, 1, &submitInfo, fence);
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+		vkDestroyFence(device, fence, nullptr);
 		vkFreeCommandBuffers(device, cmdPool, 1, &commandBuffer);
 	}
 #pragma endregion
 
 #pragma region IMAGES
 	//Image Creation
-	void createVkImage(VkDevice& device, VkPhysicalDevice& physicalDevice, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	void createVkImage(VkDevice& device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageMemory, uint32_t mipLevels) {
 		VkImageCreateInfo imageInfo = {};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
@@ -127,19 +128,15 @@ namespace vkHelpers {
 			throw std::runtime_error("failed to create image!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
-		}
+		//Sub-allocate from the shared memory blocks & bind
+		allocator.allocateForImage(image, tiling, properties, imageMemory);
+	}
 
-		vkBindImageMemory(device, image, imageMemory, 0);
+	void destroyVkImage(VkDevice& device, DeviceMemoryAllocator& allocator, VkImage& image, Allocation& imageMemory)
+	{
+		vkDestroyImage(device, image, nullptr);
+		allocator.free(imageMemory);
+		image = VK_NULL_HANDLE;
 	}
 
 	void transitionVkImageLayout(csmntVkApplication* pApp, VkCommandPool& cmdPool, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) 
@@ -249,7 +246,7 @@ namespace vkHelpers {
 		endSingleTimeCommands(commandBuffer, pApp->getGraphicsQueue(), pApp->getVkDevice(), cmdPool);
 	}
 
-	VkImageView createVkImageView(VkDevice& device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+	VkImageView createVkImageView(VkDevice& device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 	{
 		VkImageViewCreateInfo viewInfo = {};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -257,7 +254,7 @@ namespace vkHelpers {
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewInfo.format = format;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
@@ -1,6 +1,8 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
+#include "vkMemoryAllocator.h"
 class csmntVkApplication;
 
 namespace vkHelpers {
@@ -8,7 +10,8 @@ namespace vkHelpers {
 	uint32_t findMemoryType(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 	//Buffer Helpers
-	void createVkBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkDeviceSize& size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void createVkBuffer(VkDevice& device, DeviceMemoryAllocator& allocator, VkDeviceSize& size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferMemory);
+	void destroyVkBuffer(VkDevice& device, DeviceMemoryAllocator& allocator, VkBuffer& buffer, Allocation& bufferMemory);
 	void copyVkBuffer(csmntVkApplication* pApp, VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize& size, VkCommandPool& cmdPool);
 
 	//Command Buffers
@@ -16,10 +19,11 @@ namespace vkHelpers {
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue& queue, VkDevice& device, VkCommandPool& cmdPool);
 
 	//Image Creation
-	void createVkImage(VkDevice& device, VkPhysicalDevice& physicalDevice, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+	void createVkImage(VkDevice& device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageMemory, uint32_t mipLevels = 1);
+	void destroyVkImage(VkDevice& device, DeviceMemoryAllocator& allocator, VkImage& image, Allocation& imageMemory);
 	void transitionVkImageLayout(csmntVkApplication* pApp, VkCommandPool& cmdPool, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 	void copyBufferToVkImage(csmntVkApplication* pApp, VkCommandPool& cmdPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	VkImageView createVkImageView(VkDevice& device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkImageView createVkImageView(VkDevice& device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
 
 	VkFormat findSupportedFormat(VkPhysicalDevice&, const std::vector<VkFormat>&, VkImageTiling, VkFormatFeatureFlags);
 	bool hasStencilComponent(VkFormat);
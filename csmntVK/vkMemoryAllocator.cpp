@@ -0,0 +1,398 @@
+#include "vkMemoryAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+
+namespace vkHelpers {
+
+#pragma region HELPERS
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//Buffers & linear images may not share a granularity page with optimal images
+	static bool typesConflict(AllocationType a, AllocationType b)
+	{
+		if (a == AllocationType::Free || b == AllocationType::Free) {
+			return false;
+		}
+
+		const bool aOptimal = a == AllocationType::ImageOptimal;
+		const bool bOptimal = b == AllocationType::ImageOptimal;
+		return aOptimal != bOptimal;
+	}
+
+	//Does the last byte of resource A land on the same granularity page as the start of B?
+	static bool onSamePage(VkDeviceSize aOffset, VkDeviceSize aSize, VkDeviceSize bOffset, VkDeviceSize pageSize)
+	{
+		VkDeviceSize aEndPage = (aOffset + aSize - 1) & ~(pageSize - 1);
+		VkDeviceSize bStartPage = bOffset & ~(pageSize - 1);
+		return aEndPage == bStartPage;
+	}
+
+	float AllocatorStats::fragmentation() const
+	{
+		VkDeviceSize freeBytes = bytesReserved - bytesUsed;
+		if (freeBytes == 0) {
+			return 0.0f;
+		}
+		return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+	}
+#pragma endregion
+
+#pragma region CTOR & DTOR
+	DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice& device, VkPhysicalDevice& physicalDevice)
+		: m_vkDevice(device)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memProperties);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		m_bufferImageGranularity = std::max<VkDeviceSize>(1, deviceProperties.limits.bufferImageGranularity);
+		m_maxAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+		m_blocks.resize(m_memProperties.memoryTypeCount);
+
+#if _DEBUG
+		std::cout << "HEY! device memory allocator created (bufferImageGranularity " << m_bufferImageGranularity << ")" << std::endl;
+#endif
+	}
+
+	DeviceMemoryAllocator::~DeviceMemoryAllocator()
+	{
+		shutdown();
+	}
+
+	void DeviceMemoryAllocator::shutdown()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto& blocks : m_blocks) {
+			for (MemoryBlock* pBlock : blocks) {
+#if _DEBUG
+				if (pBlock->allocationCount > 0) {
+					std::cout << "HEY! memory block destroyed with " << pBlock->allocationCount << " live allocations" << std::endl;
+				}
+#endif
+				destroyBlock(pBlock);
+			}
+			blocks.clear();
+		}
+	}
+#pragma endregion
+
+#pragma region ALLOCATION
+	Allocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, AllocationType type)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Allocation allocation;
+		uint32_t memoryTypeIndex = findMemoryTypeIndex(memRequirements.memoryTypeBits, properties);
+		VkDeviceSize blockSize = getPreferredBlockSize(memoryTypeIndex);
+
+		//Big resources get their own block, they'd only fragment the shared ones
+		if (memRequirements.size > blockSize / 2) {
+			MemoryBlock* pBlock = createBlock(memoryTypeIndex, memRequirements.size, true);
+			allocateFromBlock(pBlock, memRequirements, type, allocation);
+			return allocation;
+		}
+
+		//Try the existing blocks first
+		for (MemoryBlock* pBlock : m_blocks[memoryTypeIndex]) {
+			if (pBlock->dedicated || pBlock->freeBytes < memRequirements.size) {
+				continue;
+			}
+
+			if (allocateFromBlock(pBlock, memRequirements, type, allocation)) {
+				return allocation;
+			}
+		}
+
+		//Nothing fits, grab a new block
+		MemoryBlock* pBlock = createBlock(memoryTypeIndex, blockSize, false);
+		if (!allocateFromBlock(pBlock, memRequirements, type, allocation)) {
+			throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+		}
+
+		return allocation;
+	}
+
+	void DeviceMemoryAllocator::free(Allocation& allocation)
+	{
+		if (!allocation.pBlock) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		MemoryBlock* pBlock = allocation.pBlock;
+		freeFromBlock(pBlock, allocation.offset);
+
+		//Give empty blocks back to the driver, but keep one spare per type so
+		//load/unload churn doesn't hammer vkAllocateMemory
+		if (pBlock->allocationCount == 0) {
+			auto& blocks = m_blocks[pBlock->memoryTypeIndex];
+
+			size_t emptyBlocks = std::count_if(blocks.begin(), blocks.end(), [](MemoryBlock* b) {
+				return b->allocationCount == 0 && !b->dedicated;
+			});
+
+			if (pBlock->dedicated || emptyBlocks > 1) {
+				blocks.erase(std::find(blocks.begin(), blocks.end(), pBlock));
+				destroyBlock(pBlock);
+			}
+		}
+
+		allocation = Allocation();
+	}
+
+	void DeviceMemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, Allocation& allocation)
+	{
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(m_vkDevice, buffer, &memRequirements);
+
+		allocation = allocate(memRequirements, properties, AllocationType::Buffer);
+
+		if (vkBindBufferMemory(m_vkDevice, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind buffer memory!");
+		}
+	}
+
+	void DeviceMemoryAllocator::allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, Allocation& allocation)
+	{
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(m_vkDevice, image, &memRequirements);
+
+		allocation = allocate(memRequirements, properties,
+			tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationType::ImageOptimal : AllocationType::ImageLinear);
+
+		if (vkBindImageMemory(m_vkDevice, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind image memory!");
+		}
+	}
+#pragma endregion
+
+#pragma region BLOCKS
+	uint32_t DeviceMemoryAllocator::findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+	{
+		for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	bool DeviceMemoryAllocator::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VkDeviceSize DeviceMemoryAllocator::getPreferredBlockSize(uint32_t memoryTypeIndex)
+	{
+		uint32_t heapIndex = m_memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		VkDeviceSize heapSize = m_memProperties.memoryHeaps[heapIndex].size;
+
+		return heapSize <= s_smallHeapLimit ? alignUp(heapSize / 8, 32) : s_defaultBlockSize;
+	}
+
+	MemoryBlock* DeviceMemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated)
+	{
+		if (m_deviceAllocationCount >= m_maxAllocationCount) {
+			throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+		}
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory block!");
+		}
+		++m_deviceAllocationCount;
+
+		MemoryBlock* pBlock = new MemoryBlock();
+		pBlock->memory = memory;
+		pBlock->size = size;
+		pBlock->memoryTypeIndex = memoryTypeIndex;
+		pBlock->freeBytes = size;
+		pBlock->dedicated = dedicated;
+		pBlock->suballocations.push_back({ 0, size, AllocationType::Free });
+
+		//Host visible blocks stay mapped for their whole lifetime -- sub-allocations
+		//can't map the same VkDeviceMemory twice anyway
+		if (m_memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			if (vkMapMemory(m_vkDevice, memory, 0, VK_WHOLE_SIZE, 0, &pBlock->pMapped) != VK_SUCCESS) {
+				throw std::runtime_error("failed to map memory block!");
+			}
+		}
+
+		m_blocks[memoryTypeIndex].push_back(pBlock);
+
+		return pBlock;
+	}
+
+	void DeviceMemoryAllocator::destroyBlock(MemoryBlock* pBlock)
+	{
+		if (pBlock->pMapped) {
+			vkUnmapMemory(m_vkDevice, pBlock->memory);
+		}
+
+		vkFreeMemory(m_vkDevice, pBlock->memory, nullptr);
+		--m_deviceAllocationCount;
+
+		delete pBlock;
+	}
+
+	bool DeviceMemoryAllocator::allocateFromBlock(MemoryBlock* pBlock, const VkMemoryRequirements& memRequirements, AllocationType type, Allocation& allocation)
+	{
+		const VkDeviceSize granularity = m_bufferImageGranularity;
+
+		auto best = pBlock->suballocations.end();
+		VkDeviceSize bestOffset = 0;
+
+		//Best fit over the free ranges
+		for (auto it = pBlock->suballocations.begin(); it != pBlock->suballocations.end(); ++it) {
+			if (it->type != AllocationType::Free || it->size < memRequirements.size) {
+				continue;
+			}
+
+			VkDeviceSize offset = alignUp(it->offset, memRequirements.alignment);
+
+			//Bump past a conflicting neighbour's granularity page
+			if (it != pBlock->suballocations.begin()) {
+				auto prev = std::prev(it);
+				if (typesConflict(prev->type, type) && onSamePage(prev->offset, prev->size, offset, granularity)) {
+					offset = alignUp(offset, granularity);
+				}
+			}
+
+			if (offset + memRequirements.size > it->offset + it->size) {
+				continue;
+			}
+
+			//Don't overlap the page of a conflicting resource after us
+			auto next = std::next(it);
+			if (next != pBlock->suballocations.end() && typesConflict(type, next->type) &&
+				onSamePage(offset, memRequirements.size, next->offset, granularity)) {
+				continue;
+			}
+
+			if (best == pBlock->suballocations.end() || it->size < best->size) {
+				best = it;
+				bestOffset = offset;
+			}
+		}
+
+		if (best == pBlock->suballocations.end()) {
+			return false;
+		}
+
+		//Split the free range into [padding][allocation][remainder]
+		const VkDeviceSize freeStart = best->offset;
+		const VkDeviceSize freeEnd = best->offset + best->size;
+		const VkDeviceSize padding = bestOffset - freeStart;
+		const VkDeviceSize remainder = freeEnd - (bestOffset + memRequirements.size);
+
+		if (padding > 0) {
+			pBlock->suballocations.insert(best, { freeStart, padding, AllocationType::Free });
+		}
+
+		best->offset = bestOffset;
+		best->size = memRequirements.size;
+		best->type = type;
+
+		if (remainder > 0) {
+			pBlock->suballocations.insert(std::next(best), { bestOffset + memRequirements.size, remainder, AllocationType::Free });
+		}
+
+		pBlock->freeBytes -= memRequirements.size;
+		pBlock->allocationCount++;
+
+		allocation.memory = pBlock->memory;
+		allocation.offset = bestOffset;
+		allocation.size = memRequirements.size;
+		allocation.memoryTypeIndex = pBlock->memoryTypeIndex;
+		allocation.pBlock = pBlock;
+		allocation.pMapped = pBlock->pMapped ? static_cast<char*>(pBlock->pMapped) + bestOffset : nullptr;
+
+		return true;
+	}
+
+	void DeviceMemoryAllocator::freeFromBlock(MemoryBlock* pBlock, VkDeviceSize offset)
+	{
+		auto it = std::find_if(pBlock->suballocations.begin(), pBlock->suballocations.end(), [offset](const Suballocation& s) {
+			return s.offset == offset && s.type != AllocationType::Free;
+		});
+
+		if (it == pBlock->suballocations.end()) {
+			throw std::runtime_error("freeing an allocation that isn't in its block!");
+		}
+
+		it->type = AllocationType::Free;
+		pBlock->freeBytes += it->size;
+		pBlock->allocationCount--;
+
+		//Merge with free neighbours so ranges stay as large as possible
+		auto next = std::next(it);
+		if (next != pBlock->suballocations.end() && next->type == AllocationType::Free) {
+			it->size += next->size;
+			pBlock->suballocations.erase(next);
+		}
+
+		if (it != pBlock->suballocations.begin()) {
+			auto prev = std::prev(it);
+			if (prev->type == AllocationType::Free) {
+				prev->size += it->size;
+				pBlock->suballocations.erase(it);
+			}
+		}
+	}
+#pragma endregion
+
+#pragma region STATS
+	AllocatorStats DeviceMemoryAllocator::getStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		AllocatorStats stats;
+
+		for (const auto& blocks : m_blocks) {
+			for (const MemoryBlock* pBlock : blocks) {
+				stats.blockCount++;
+				stats.allocationCount += pBlock->allocationCount;
+				stats.bytesReserved += pBlock->size;
+				stats.bytesUsed += pBlock->size - pBlock->freeBytes;
+
+				for (const Suballocation& s : pBlock->suballocations) {
+					if (s.type == AllocationType::Free) {
+						stats.freeRangeCount++;
+						stats.largestFreeRange = std::max(stats.largestFreeRange, s.size);
+					}
+				}
+			}
+		}
+
+		return stats;
+	}
+
+	void DeviceMemoryAllocator::dumpStats(std::ostream& out)
+	{
+		AllocatorStats stats = getStats();
+
+		out << "device memory: " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+			<< (stats.bytesUsed >> 10) << "KB used / " << (stats.bytesReserved >> 10) << "KB reserved, "
+			<< stats.freeRangeCount << " free ranges (largest " << (stats.largestFreeRange >> 10) << "KB), "
+			<< "fragmentation " << stats.fragmentation() << std::endl;
+	}
+#pragma endregion
+}
@@ -0,0 +1,122 @@
+#pragma once
+#ifndef _VK_MEMORY_ALLOCATOR_
+#define _VK_MEMORY_ALLOCATOR_
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <ostream>
+
+namespace vkHelpers {
+
+	//What a sub-allocation holds -- buffers and linear images can't share a
+	//bufferImageGranularity "page" with optimal images
+	enum class AllocationType : uint8_t {
+		Free = 0,
+		Buffer,
+		ImageLinear,
+		ImageOptimal
+	};
+
+	struct MemoryBlock;
+
+	//A range of device memory handed out by the DeviceMemoryAllocator
+	struct Allocation {
+		VkDeviceMemory	memory = VK_NULL_HANDLE;
+		VkDeviceSize	offset = 0;
+		VkDeviceSize	size = 0;
+		void*			pMapped = nullptr;	//persistently mapped (host visible types only)
+		uint32_t		memoryTypeIndex = 0;
+		MemoryBlock*	pBlock = nullptr;
+	};
+
+	//Fragmentation and usage numbers across all heaps
+	struct AllocatorStats {
+		uint32_t		blockCount = 0;
+		uint32_t		allocationCount = 0;
+		uint32_t		freeRangeCount = 0;
+		VkDeviceSize	bytesReserved = 0;		//total vkAllocateMemory'd
+		VkDeviceSize	bytesUsed = 0;			//handed out to resources (incl. alignment padding)
+		VkDeviceSize	largestFreeRange = 0;
+
+		//0 = all free space is one contiguous range, -> 1 = free space is scattered
+		float fragmentation() const;
+	};
+
+	struct Suballocation {
+		VkDeviceSize	offset;
+		VkDeviceSize	size;
+		AllocationType	type;
+	};
+
+	//One vkAllocateMemory, split into sorted used/free ranges covering the whole block
+	struct MemoryBlock {
+		VkDeviceMemory				memory = VK_NULL_HANDLE;
+		VkDeviceSize				size = 0;
+		void*						pMapped = nullptr;
+		uint32_t					memoryTypeIndex = 0;
+		uint32_t					allocationCount = 0;
+		VkDeviceSize				freeBytes = 0;
+		bool						dedicated = false;
+		std::list<Suballocation>	suballocations;
+	};
+
+	/////////////////////////////////////////////////////
+	//---DeviceMemoryAllocator:
+	//---Keeps large per-memory-type blocks and sub-allocates
+	//---buffers & images out of them, so we stay well under
+	//---maxMemoryAllocationCount
+	/////////////////////////////////////////////////////
+
+	class DeviceMemoryAllocator {
+	public:
+		DeviceMemoryAllocator(VkDevice&, VkPhysicalDevice&);
+		~DeviceMemoryAllocator();
+		DeviceMemoryAllocator(DeviceMemoryAllocator&) = delete;
+		DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+		void shutdown();
+
+		Allocation allocate(const VkMemoryRequirements&, VkMemoryPropertyFlags, AllocationType);
+		void free(Allocation&);
+
+		//Allocate and bind in one go
+		void allocateForBuffer(VkBuffer, VkMemoryPropertyFlags, Allocation&);
+		void allocateForImage(VkImage, VkImageTiling, VkMemoryPropertyFlags, Allocation&);
+
+		AllocatorStats getStats();
+		void dumpStats(std::ostream&);
+
+		VkDeviceSize getBufferImageGranularity() const { return m_bufferImageGranularity; };
+		//Whether any memory type allowed by typeFilter has all these properties (e.g. LAZILY_ALLOCATED, tilers only)
+		bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	private:
+		uint32_t findMemoryTypeIndex(uint32_t, VkMemoryPropertyFlags);
+		VkDeviceSize getPreferredBlockSize(uint32_t);
+
+		MemoryBlock* createBlock(uint32_t, VkDeviceSize, bool);
+		void destroyBlock(MemoryBlock*);
+
+		bool allocateFromBlock(MemoryBlock*, const VkMemoryRequirements&, AllocationType, Allocation&);
+		void freeFromBlock(MemoryBlock*, VkDeviceSize);
+
+		VkDevice							m_vkDevice;
+		VkPhysicalDeviceMemoryProperties	m_memProperties;
+		VkDeviceSize						m_bufferImageGranularity = 1;
+		uint32_t							m_maxAllocationCount = 4096;
+		uint32_t							m_deviceAllocationCount = 0;
+
+		//One list of blocks per memory type
+		std::vector<std::vector<MemoryBlock*>>	m_blocks;
+
+		std::mutex							m_mutex;
+
+		//Default block size for big heaps, smaller heaps get heapSize / 8
+		static const VkDeviceSize			s_defaultBlockSize = 64ull * 1024 * 1024;
+		static const VkDeviceSize			s_smallHeapLimit = 1024ull * 1024 * 1024;
+	};
+}
+
+#endif // !_VK_MEMORY_ALLOCATOR_